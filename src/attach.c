@@ -0,0 +1,441 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* wldbg attach - show the messages sent by the publish pass of another
+ * wldbg. The connections are mirrored here and the messages go through
+ * the passes as if this wldbg read them itself, only nothing is sent
+ * anywhere */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "wayland/wayland-util.h"
+#include "wayland/wayland-os.h"
+
+#include "wldbg.h"
+#include "wldbg-pass.h"
+#include "wldbg-private.h"
+#include "wldbg-ids-map.h"
+#include "resolve.h"
+#include "objinfo/objinfo.h"
+#include "passes.h"
+#include "getopt.h"
+#include "publish.h"
+
+/* defined in passes.c */
+int
+load_passes(struct wldbg *wldbg, struct wldbg_options *opts,
+	    int argc, const char *argv[]);
+
+struct attach {
+	struct wldbg *wldbg;
+	int fd;
+
+	/* mirrored connections, by their id */
+	struct wldbg_ids_map connections;
+	uint64_t dropped;
+
+	/* uint32_t so that the messages in it are aligned */
+	uint32_t buffer[PUBLISH_RECORD_MAX / sizeof(uint32_t)];
+};
+
+static struct wldbg_connection *
+get_connection(struct attach *attach, uint32_t id)
+{
+	struct wldbg *wldbg = attach->wldbg;
+	struct wldbg_connection *conn;
+
+	conn = wldbg_ids_map_get(&attach->connections, id);
+	if (conn)
+		return conn;
+
+	conn = calloc(1, sizeof *conn);
+	if (!conn)
+		return NULL;
+
+	conn->wldbg = wldbg;
+	conn->id = id;
+	conn->server.fd = -1;
+	conn->client.fd = -1;
+	wl_list_init(&conn->passes);
+
+	if (wldbg->resolving_objects) {
+		conn->resolved_objects = create_resolved_objects();
+		if (!conn->resolved_objects) {
+			free(conn);
+			return NULL;
+		}
+	}
+
+	if (wldbg->gathering_info) {
+		conn->objects_info = create_objects_info();
+		if (!conn->objects_info) {
+			destroy_resolved_objects(conn->resolved_objects);
+			free(conn);
+			return NULL;
+		}
+	}
+
+	wldbg_ids_map_insert(&attach->connections, id, conn);
+
+	return conn;
+}
+
+static void
+destroy_connection(struct wldbg_connection *conn)
+{
+	struct pass *pass, *tmp;
+
+	wl_list_for_each_safe(pass, tmp, &conn->passes, link) {
+		wl_list_remove(&pass->link);
+		destroy_pass(conn->wldbg, pass);
+	}
+
+	if (conn->resolved_objects)
+		destroy_resolved_objects(conn->resolved_objects);
+	if (conn->objects_info)
+		destroy_objects_info(conn->objects_info);
+
+	free(conn->client.program);
+	free(conn);
+}
+
+static void
+mirror_connection(struct attach *attach, struct publish_record *rec,
+		  const char *program)
+{
+	struct wldbg_connection *conn;
+
+	conn = get_connection(attach, rec->connection);
+	if (!conn) {
+		wldbg_error(attach->wldbg);
+		return;
+	}
+
+	conn->client.pid = rec->arg;
+	if (!conn->client.program && *program)
+		conn->client.program = strdup(program);
+
+	printf("Connection %u: %s (pid %d)\n", conn->id,
+	       conn->client.program ? conn->client.program : "unknown",
+	       conn->client.pid);
+}
+
+static void
+mirror_disconnect(struct attach *attach, struct publish_record *rec)
+{
+	struct wldbg_connection *conn;
+
+	conn = wldbg_ids_map_get(&attach->connections, rec->connection);
+	if (!conn)
+		return;
+
+	printf("Connection %u closed\n", conn->id);
+
+	wldbg_ids_map_insert(&attach->connections, conn->id, NULL);
+	wldbg_connection_closed(conn);
+	destroy_connection(conn);
+}
+
+static void
+mirror_message(struct attach *attach, struct publish_record *rec,
+	       const char *interface, uint32_t *data)
+{
+	struct wldbg *wldbg = attach->wldbg;
+	struct wldbg_connection *conn;
+	struct wldbg_message message;
+	const struct wl_interface *intf;
+	struct resolved_objects *ro;
+
+	if (rec->data_size < 2 * sizeof(uint32_t)
+	    || rec->data_size != data[1] >> 16) {
+		fprintf(stderr, "attach: broken message\n");
+		return;
+	}
+
+	conn = get_connection(attach, rec->connection);
+	if (!conn) {
+		wldbg_error(wldbg);
+		return;
+	}
+
+	memset(&message, 0, sizeof message);
+	message.data = data;
+	message.size = rec->data_size;
+	message.from = rec->arg == SERVER ? SERVER : CLIENT;
+	message.connection = conn;
+	message.time = rec->time;
+
+	/* the object was created before we attached or we missed
+	 * some records (the id may have been reused since then),
+	 * the publisher knows what it is */
+	ro = conn->resolved_objects;
+	if (ro && *interface) {
+		intf = wldbg_message_get_object(&message, data[0]);
+		if (!intf || strcmp(intf->name, interface) != 0) {
+			intf = resolved_objects_get_interface(ro, interface);
+			if (intf)
+				resolved_objects_put(ro, data[0], intf);
+		}
+	}
+
+	wldbg_run_passes(&message);
+
+	/* there's nothing to skip, the message was sent already */
+	wldbg->flags.skip = 0;
+}
+
+static int
+attach_dispatch(int fd, void *data)
+{
+	struct attach *attach = data;
+	struct publish_record *rec = (struct publish_record *) attach->buffer;
+	char *name;
+	ssize_t len;
+
+	len = recv(fd, attach->buffer, sizeof attach->buffer, 0);
+	if (len < 0) {
+		if (errno == EINTR || errno == EAGAIN)
+			return 1;
+
+		perror("attach: reading the socket");
+		wldbg_error(attach->wldbg);
+		return 1;
+	}
+
+	if (len == 0) {
+		printf("The publishing wldbg exited\n");
+		wldbg_exit(attach->wldbg);
+		return 1;
+	}
+
+	if ((size_t) len < sizeof *rec || rec->name_size == 0
+	    || rec->name_size % 4 != 0
+	    || (size_t) len != sizeof *rec + rec->name_size + rec->data_size) {
+		fprintf(stderr, "attach: broken record\n");
+		return 1;
+	}
+
+	name = (char *) (rec + 1);
+	name[rec->name_size - 1] = '\0';
+
+	if (rec->dropped > 0) {
+		attach->dropped += rec->dropped;
+		printf("-- %u messages dropped, not reading fast enough --\n",
+		       rec->dropped);
+	}
+
+	switch (rec->type) {
+	case PUBLISH_CONNECTION:
+		mirror_connection(attach, rec, name);
+		break;
+	case PUBLISH_MESSAGE:
+		mirror_message(attach, rec, name,
+			       (uint32_t *) (name + rec->name_size));
+		break;
+	case PUBLISH_DISCONNECT:
+		mirror_disconnect(attach, rec);
+		break;
+	default:
+		dbg("attach: unknown record %u\n", rec->type);
+		break;
+	}
+
+	return 1;
+}
+
+static int
+attach_message(void *user_data, struct wldbg_message *message)
+{
+	(void) user_data;
+	(void) message;
+
+	return PASS_NEXT;
+}
+
+static void
+attach_destroy(void *user_data)
+{
+	struct attach *attach = user_data;
+	struct wldbg_connection *conn;
+	uint32_t i;
+
+	if (attach->dropped > 0)
+		printf("Dropped %lu messages in total\n", attach->dropped);
+
+	for (i = 0; i < attach->connections.count; ++i) {
+		conn = wldbg_ids_map_get(&attach->connections, i);
+		if (conn)
+			destroy_connection(conn);
+	}
+
+	wldbg_ids_map_release(&attach->connections);
+	close(attach->fd);
+	free(attach);
+}
+
+static int
+connect_to_publisher(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof addr.sun_path) {
+		fprintf(stderr, "Path to the socket is too long\n");
+		return -1;
+	}
+
+	fd = wl_os_socket_cloexec(PF_LOCAL, SOCK_SEQPACKET, 0);
+	if (fd < 0)
+		return -1;
+
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_LOCAL;
+	strcpy(addr.sun_path, path);
+
+	if (connect(fd, (struct sockaddr *) &addr, sizeof addr) < 0) {
+		fprintf(stderr, "Failed connecting to '%s': %s\n"
+				"Is there wldbg with the publish pass?\n",
+			path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int
+load_default_pass(struct wldbg *wldbg)
+{
+	const char *argv[] = { "dump", "human", NULL };
+	struct pass *pass;
+
+	pass = create_pass("dump");
+	if (!pass)
+		return -1;
+
+	if (pass_init(wldbg, pass, 2, argv) != 0) {
+		dealloc_pass(pass);
+		return -1;
+	}
+
+	insert_pass(wldbg, pass);
+	return 0;
+}
+
+/* wldbg attach [socket=PATH] [PASS ARGUMENTS, ...] */
+int
+attach_init(struct wldbg *wldbg, struct wldbg_options *opts,
+	    int argc, const char *argv[])
+{
+	struct sockaddr_un addr;
+	char path[sizeof addr.sun_path];
+	struct attach *attach;
+	struct pass *pass;
+	int pass_num;
+
+	/* skip 'attach' */
+	--argc;
+	++argv;
+
+	if (argc > 0 && strncmp(argv[0], "socket=", 7) == 0) {
+		if (strlen(argv[0] + 7) >= sizeof path) {
+			fprintf(stderr, "Path to the socket is too long\n");
+			return -1;
+		}
+
+		strcpy(path, argv[0] + 7);
+		--argc;
+		++argv;
+	} else if (publish_default_path(path, sizeof path) < 0) {
+		fprintf(stderr, "Path to the socket is too long\n");
+		return -1;
+	}
+
+	attach = calloc(1, sizeof *attach);
+	if (!attach)
+		return -1;
+
+	attach->wldbg = wldbg;
+	wldbg_ids_map_init(&attach->connections);
+
+	attach->fd = connect_to_publisher(path);
+	if (attach->fd < 0) {
+		free(attach);
+		return -1;
+	}
+
+	pass = alloc_pass("attach");
+	if (!pass) {
+		close(attach->fd);
+		free(attach);
+		return -1;
+	}
+
+	pass->wldbg_pass.destroy = attach_destroy;
+	pass->wldbg_pass.server_pass = attach_message;
+	pass->wldbg_pass.client_pass = attach_message;
+	pass->wldbg_pass.user_data = attach;
+	pass->wldbg_pass.description
+		= "Read messages published by another wldbg (hardcoded)";
+	pass->wldbg_pass.flags = WLDBG_PASS_LOAD_ONCE;
+
+	/* insert always at the end */
+	wl_list_insert(wldbg->passes.prev, &pass->link);
+
+	if (wldbg_monitor_fd(wldbg, attach->fd,
+			     attach_dispatch, attach) == NULL)
+		return -1;
+
+	pass_num = load_passes(wldbg, opts, argc, argv);
+	if (pass_num == -1) {
+		fprintf(stderr, "Error occured while loading passes...\n");
+		return -1;
+	}
+
+	if (opts->path) {
+		fprintf(stderr, "wldbg attach does not run programs, "
+				"the publishing wldbg does\n");
+		return -1;
+	}
+
+	/* by default just print the messages */
+	if (pass_num == 0 && load_default_pass(wldbg) < 0) {
+		fprintf(stderr, "Loading pass 'dump' failed\n");
+		return -1;
+	}
+
+	wldbg->flags.attached = 1;
+	printf("Attached to '%s'\n", path);
+
+	return 0;
+}
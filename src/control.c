@@ -0,0 +1,500 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "wldbg.h"
+#include "wldbg-pass.h"
+#include "wldbg-private.h"
+#include "passes.h"
+#include "metrics.h"
+#include "control.h"
+#include "pipeline.h"
+#include "request.h"
+#include "util.h"
+
+#include "wayland/wayland-os.h"
+
+#define CONTROL_MAX_ARGS	64
+
+struct wldbg_control {
+	struct wldbg_request_socket *socket;
+};
+
+static const char *control_help =
+	"Commands (ID is the id of a connection, without it the command\n"
+	"is for the passes that all connections share):\n"
+	"  connections                  list connections and their rates\n"
+	"  passes [ID]                  list loaded passes\n"
+	"  load [ID] PASS [ARGS...]     load the pass\n"
+	"  unload [ID] PASS             unload the pass\n"
+	"  reload [ID] PASS [ARGS...]   load the pass again with new arguments\n"
+	"  rules                        list the pipeline rules\n"
+	"  rule PATTERN:PASS,PASS,...   add a pipeline rule for new connections\n"
+	"  help                         show this help\n";
+
+int
+wldbg_control_default_path(char *path, size_t size)
+{
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	int ret;
+
+	if (!dir)
+		dir = "/tmp";
+
+	ret = snprintf(path, size, "%s/wldbg-control", dir);
+	if (ret < 0 || (size_t) ret >= size)
+		return -1;
+
+	return 0;
+}
+
+static struct wldbg_connection *
+find_connection(struct wldbg *wldbg, unsigned int id)
+{
+	struct wldbg_connection *conn;
+
+	wl_list_for_each(conn, &wldbg->connections, link)
+		if (conn->id == id)
+			return conn;
+
+	return NULL;
+}
+
+/* resolve, objinfo and interactive can not be changed */
+static int
+is_hardcoded(struct wldbg *wldbg, struct pass *pass)
+{
+	struct pass *p;
+	int hardcoded = wldbg->resolving_objects + wldbg->gathering_info;
+
+	if (pass->wldbg_pass.flags & WLDBG_PASS_LOAD_ONCE)
+		return 1;
+
+	wl_list_for_each(p, &wldbg->passes, link) {
+		if (hardcoded-- == 0)
+			break;
+		if (p == pass)
+			return 1;
+	}
+
+	return 0;
+}
+
+static struct pass *
+find_pass(struct wldbg *wldbg, FILE *out,
+	  struct wl_list *passes, const char *name)
+{
+	struct pass *pass;
+
+	wl_list_for_each(pass, passes, link) {
+		if (strcmp(pass->name, name) != 0)
+			continue;
+
+		if (is_hardcoded(wldbg, pass)) {
+			fprintf(out, "error: pass '%s' is hardcoded\n", name);
+			return NULL;
+		}
+
+		return pass;
+	}
+
+	fprintf(out, "error: pass '%s' is not loaded\n", name);
+	return NULL;
+}
+
+static void
+print_pass_names(FILE *out, struct wldbg_connection *conn)
+{
+	struct pass *pass;
+
+	/* these do not run the shared passes */
+	if (conn->own_pipeline && wl_list_empty(&conn->passes))
+		fprintf(out, " passthrough");
+	else if (conn->own_pipeline)
+		fprintf(out, " only:");
+
+	wl_list_for_each(pass, &conn->passes, link)
+		fprintf(out, " %s", pass->name);
+}
+
+static void
+cmd_connections(struct wldbg *wldbg, FILE *out)
+{
+	struct wldbg_connection *conn;
+	uint64_t now = wldbg_get_time();
+
+	fprintf(out, "%-4s %-8s %-20s %8s %10s  %s\n", "ID", "PID",
+		"PROGRAM", "MSGS/S", "MESSAGES", "PASSES");
+
+	wl_list_for_each(conn, &wldbg->connections, link) {
+		fprintf(out, "%-4u %-8d %-20s %8u %10lu ", conn->id,
+			conn->client.pid, conn->client.program ?
+				conn->client.program : "unknown",
+			wldbg_connection_rate(conn, now),
+			(unsigned long) (conn->counters.messages[SERVER]
+					 + conn->counters.messages[CLIENT]));
+		print_pass_names(out, conn);
+		fprintf(out, "%s\n", conn->paused ? " (stopped)" : "");
+	}
+}
+
+static void
+cmd_passes(struct wldbg *wldbg, FILE *out, struct wldbg_connection *conn)
+{
+	struct pass *pass;
+
+	if (conn) {
+		fprintf(out, "connection %u:", conn->id);
+		print_pass_names(out, conn);
+		fputc('\n', out);
+		return;
+	}
+
+	wl_list_for_each(pass, &wldbg->passes, link) {
+		fprintf(out, "%s%s\n", pass->name,
+			is_hardcoded(wldbg, pass) ? " (hardcoded)" : "");
+	}
+}
+
+static struct pass *
+control_load_pass(struct wldbg *wldbg, FILE *out,
+		  int argc, const char *argv[])
+{
+	unsigned int exiting = wldbg->flags.exit;
+	struct pass *pass;
+
+	pass = create_pass_with_args(wldbg, argc, argv);
+	if (!pass) {
+		fprintf(out, "error: failed loading pass '%s'\n", argv[0]);
+		return NULL;
+	}
+
+	/* with 'help' the passes print the help and exit wldbg */
+	if (!exiting && wldbg->flags.exit) {
+		wldbg->flags.exit = 0;
+		destroy_pass(wldbg, pass);
+		fprintf(out, "error: pass '%s' asked to exit\n", argv[0]);
+		return NULL;
+	}
+
+	return pass;
+}
+
+static void
+cmd_load(struct wldbg *wldbg, FILE *out, struct wldbg_connection *conn,
+	 int argc, const char *argv[])
+{
+	struct pass *pass;
+
+	pass = control_load_pass(wldbg, out, argc, argv);
+	if (!pass)
+		return;
+
+	if (conn)
+		wl_list_insert(conn->passes.prev, &pass->link);
+	else
+		insert_pass(wldbg, pass);
+
+	fprintf(out, "loaded %s\n", pass->name);
+}
+
+static void
+cmd_unload(struct wldbg *wldbg, FILE *out, struct wldbg_connection *conn,
+	   int argc, const char *argv[])
+{
+	struct pass *pass;
+
+	pass = find_pass(wldbg, out, conn ? &conn->passes : &wldbg->passes,
+			 argv[0]);
+	if (!pass)
+		return;
+
+	wl_list_remove(&pass->link);
+	destroy_pass(wldbg, pass);
+
+	fprintf(out, "unloaded %s\n", argv[0]);
+}
+
+static void
+cmd_reload(struct wldbg *wldbg, FILE *out, struct wldbg_connection *conn,
+	   int argc, const char *argv[])
+{
+	struct pass *pass;
+	struct wl_list *pos;
+
+	pass = find_pass(wldbg, out, conn ? &conn->passes : &wldbg->passes,
+			 argv[0]);
+	if (!pass)
+		return;
+
+	/* the old one must go first, it can hold
+	 * something that the new one needs (a socket) */
+	pos = pass->link.prev;
+	wl_list_remove(&pass->link);
+	destroy_pass(wldbg, pass);
+
+	pass = control_load_pass(wldbg, out, argc, argv);
+	if (!pass) {
+		fprintf(out, "error: pass '%s' was unloaded\n", argv[0]);
+		return;
+	}
+
+	wl_list_insert(pos, &pass->link);
+	fprintf(out, "reloaded %s\n", pass->name);
+}
+
+static void
+cmd_rule(struct wldbg *wldbg, FILE *out, int argc, const char *argv[])
+{
+	char rule[1024];
+	size_t len = 0;
+	int i, ret;
+
+	if (argc == 0) {
+		fprintf(out, "error: missing the rule\n");
+		return;
+	}
+
+	/* the request was split into words, join them back */
+	rule[0] = '\0';
+	for (i = 0; i < argc; ++i) {
+		ret = snprintf(rule + len, sizeof rule - len, "%s%s",
+			       i ? " " : "", argv[i]);
+		if (ret < 0 || (size_t) ret >= sizeof rule - len) {
+			fprintf(out, "error: the rule is too long\n");
+			return;
+		}
+		len += ret;
+	}
+
+	if (wldbg_add_pipeline_rule(wldbg, rule) < 0) {
+		fprintf(out, "error: invalid rule '%s'\n", rule);
+		return;
+	}
+
+	fprintf(out, "added rule %s\n", rule);
+}
+
+static void
+run_request(struct wldbg *wldbg, FILE *out, char *request)
+{
+	const char *args[CONTROL_MAX_ARGS + 1];
+	const char **argv = args;
+	struct wldbg_connection *conn = NULL;
+	void (*func)(struct wldbg *, FILE *, struct wldbg_connection *,
+		     int, const char *[]) = NULL;
+	char *word, *saveptr, *end;
+	unsigned long id;
+	int argc = 0;
+
+	for (word = strtok_r(request, " \t\r\n", &saveptr); word;
+	     word = strtok_r(NULL, " \t\r\n", &saveptr)) {
+		if (argc == CONTROL_MAX_ARGS) {
+			fprintf(out, "error: too many arguments\n");
+			return;
+		}
+		argv[argc++] = word;
+	}
+	argv[argc] = NULL;
+
+	if (argc == 0 || strcmp(argv[0], "help") == 0) {
+		fputs(control_help, out);
+		return;
+	}
+
+	if (strcmp(argv[0], "connections") == 0) {
+		cmd_connections(wldbg, out);
+		return;
+	}
+
+	if (strcmp(argv[0], "rules") == 0) {
+		wldbg_print_pipeline_rules(wldbg, out);
+		return;
+	}
+
+	if (strcmp(argv[0], "rule") == 0) {
+		cmd_rule(wldbg, out, argc - 1, argv + 1);
+		return;
+	}
+
+	/* the optional id of connection */
+	if (argc > 1) {
+		errno = 0;
+		id = strtoul(argv[1], &end, 10);
+		if (*end == '\0' && errno == 0) {
+			conn = find_connection(wldbg, id);
+			if (!conn) {
+				fprintf(out, "error: no connection %lu\n", id);
+				return;
+			}
+
+			/* drop the id, the command stays first */
+			argv[1] = argv[0];
+			--argc;
+			++argv;
+		}
+	}
+
+	if (strcmp(argv[0], "passes") == 0) {
+		cmd_passes(wldbg, out, conn);
+		return;
+	}
+
+	if (strcmp(argv[0], "load") == 0)
+		func = cmd_load;
+	else if (strcmp(argv[0], "unload") == 0)
+		func = cmd_unload;
+	else if (strcmp(argv[0], "reload") == 0)
+		func = cmd_reload;
+
+	if (!func) {
+		fprintf(out, "error: unknown command '%s'\n", argv[0]);
+		return;
+	}
+
+	if (argc < 2) {
+		fprintf(out, "error: missing the name of the pass\n");
+		return;
+	}
+
+	func(wldbg, out, conn, argc - 1, argv + 1);
+}
+
+static void
+control_answer(struct wldbg *wldbg, char *request, FILE *out)
+{
+	dbg("control: '%s'\n", request);
+	run_request(wldbg, out, request);
+}
+
+int
+wldbg_control_init(struct wldbg *wldbg, const char *path)
+{
+	struct wldbg_control *control;
+
+	control = calloc(1, sizeof *control);
+	if (!control)
+		return -1;
+
+	/* the command is not optional, wait for the whole line */
+	control->socket = wldbg_request_socket_create(wldbg, path, 0,
+						      control_answer);
+	if (!control->socket) {
+		free(control);
+		return -1;
+	}
+
+	wldbg->control = control;
+
+	return 0;
+}
+
+void
+wldbg_control_destroy(struct wldbg *wldbg)
+{
+	struct wldbg_control *control = wldbg->control;
+
+	if (!control)
+		return;
+
+	wldbg_request_socket_destroy(control->socket);
+
+	free(control);
+	wldbg->control = NULL;
+}
+
+int
+wldbg_control_command(int argc, char *argv[])
+{
+	struct sockaddr_un addr;
+	char buf[4096];
+	ssize_t len;
+	int fd, i, error = 0, first = 1;
+
+	/* skip 'control' */
+	--argc;
+	++argv;
+
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_LOCAL;
+
+	if (argc > 0 && strncmp(argv[0], "socket=", 7) == 0) {
+		if (strlen(argv[0] + 7) >= sizeof addr.sun_path) {
+			fprintf(stderr, "Path to the socket is too long\n");
+			return EXIT_FAILURE;
+		}
+
+		strcpy(addr.sun_path, argv[0] + 7);
+		--argc;
+		++argv;
+	} else if (wldbg_control_default_path(addr.sun_path,
+					      sizeof addr.sun_path) < 0) {
+		fprintf(stderr, "Path to the socket is too long\n");
+		return EXIT_FAILURE;
+	}
+
+	fd = wl_os_socket_cloexec(PF_LOCAL, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		return EXIT_FAILURE;
+	}
+
+	if (connect(fd, (struct sockaddr *) &addr, sizeof addr) < 0) {
+		fprintf(stderr, "Failed connecting to '%s': %s\n"
+				"Is there wldbg with --control?\n",
+			addr.sun_path, strerror(errno));
+		close(fd);
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < argc; ++i) {
+		if (i > 0)
+			send_all(fd, " ", 1);
+		send_all(fd, argv[i], strlen(argv[i]));
+	}
+	send_all(fd, "\n", 1);
+	shutdown(fd, SHUT_WR);
+
+	while ((len = recv(fd, buf, sizeof buf, 0)) > 0) {
+		if (first && len >= 6 && strncmp(buf, "error:", 6) == 0)
+			error = 1;
+		first = 0;
+
+		fwrite(buf, 1, len, stdout);
+	}
+
+	close(fd);
+
+	return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
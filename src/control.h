@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_CONTROL_H_
+#define _WLDBG_CONTROL_H_
+
+#include <stddef.h>
+
+struct wldbg;
+
+/* listen on the unix socket at path for commands that load, unload
+ * and reconfigure passes while wldbg runs. One connection is one
+ * command, a line of words, and the answer is text. See
+ * 'wldbg control help' for the commands */
+int
+wldbg_control_init(struct wldbg *wldbg, const char *path);
+
+void
+wldbg_control_destroy(struct wldbg *wldbg);
+
+/* $XDG_RUNTIME_DIR/wldbg-control. Returns -1 when it does not fit */
+int
+wldbg_control_default_path(char *path, size_t size);
+
+/* wldbg control [socket=PATH] COMMAND... - send the command to
+ * a running wldbg and print the answer. argv[0] is "control" */
+int
+wldbg_control_command(int argc, char *argv[]);
+
+#endif /* _WLDBG_CONTROL_H_ */
@@ -1,5 +1,13 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
 #include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
 #include <linux/input-event-codes.h>
 
 #include "wldbg-private.h"
@@ -62,6 +70,26 @@ static struct serial_message server_serials[] = {
     {"wl_touch", 1, 2}
 };
 
+// events with a timestamp, rewritten with virtual_time
+struct time_message {
+    char* name;
+    uint32_t opcode;
+    uint32_t time_index;
+};
+
+static struct time_message server_times[] = {
+    {"wl_pointer", 2, 2},
+    {"wl_pointer", 3, 3},
+    {"wl_pointer", 4, 2},
+    {"wl_pointer", 7, 2},
+    {"wl_keyboard", 3, 3},
+    {"wl_touch", 0, 3},
+    {"wl_touch", 1, 3},
+    {"wl_touch", 2, 2},
+    // done of frame callbacks, sync callbacks get a serial
+    {"wl_callback", 0, 2}
+};
+
 static struct serial_message client_serials[] = {
     {"wl_data_offer", 0, 2},
     {"wl_data_device", 0, 5},
@@ -113,38 +141,254 @@ static uint32_t buttons[] = {
     731, 732, 733, 734, 735, 736, 737, 738, 739, 740, 741, 742, 743
 };
 
-typedef void (*generate_f)();
+struct fuzz_connection;
+struct fuzz_instance;
+
+typedef void (*generate_f)(struct fuzz_connection *fc);
+
+// the most clients a campaign runs at once
+#define MAX_JOBS 64
+
+// how many deleted ids and serials we remember for mutations
+#define NUM_REPLAYED 16
+
+// the most event sequences we keep in the corpus
+#define MAX_CORPUS 4096
+
+// arguments that can be mutated, the rest is after fds
+// which are not in the data
+#define MAX_MUTATED_ARGS 20
+
+static const uint32_t boundary_uints[] = {
+    0, 1, 0x7fffffff, 0x80000000, 0xfffffffe, 0xffffffff
+};
+
+static const int32_t boundary_ints[] = {
+    0, 1, -1, INT32_MAX, INT32_MIN, INT32_MIN + 1
+};
+
+// in wl_fixed_t: 0, the smallest step, -1, 1, the extremes
+static const int32_t boundary_fixed[] = {
+    0, 1, -256, 256, INT32_MAX, INT32_MIN
+};
+
+// only events of these interfaces and opcodes are mutated
+struct mutate_mask {
+    char *interface;
+    uint32_t opcodes;
+};
+
+/* state of fuzzing one client. Every connection has its own
+ * random stream, so the events one client gets depend only
+ * on the seed and on the order in which the clients connected */
+struct fuzz_connection {
+    unsigned int id;
+    unsigned int stream;
+    uint64_t rng;
+    /* set to fuzz.generation while the connection is alive */
+    uint32_t generation;
 
-static struct {
     struct timespec timestamp_start;
     uint32_t serial_number;
     uint32_t surface_id; //TODO: Maybe could be multiple surfaces?
     uint32_t pointer_id;
     uint32_t keyboard_id;
-    struct timespec last_msg_ts;
+    // we waited delay before the last event, the next
+    // one is sent at next_time (wldbg_get_time())
     struct timespec delay;
+    uint64_t next_time;
     struct event next_event;
     struct {
         unsigned char key_status[sizeof (keys)/sizeof(*keys)];
         unsigned char button_status[sizeof (buttons)/sizeof(*buttons)];
         unsigned char mouse_entered;
     } events;
-    uint32_t delay_min;
-    uint32_t delay_max;
     uint32_t had_first_damage;
     uint32_t displayed;
     uint32_t ready_for_input;
-    uint32_t block_events;
     uint32_t buffer_width;
     uint32_t buffer_height;
     uint32_t sync_ids[NUM_SYNC_IDS];
     uint32_t sync_id_start;
     uint32_t sync_id_end;
     uint32_t frame_id;
+
+    // mutations use their own stream, so they
+    // don't change the events we generate
+    uint64_t mutate_rng;
+    uint32_t deleted_ids[NUM_REPLAYED];
+    uint32_t deleted_ids_num;
+    uint32_t serials[NUM_REPLAYED];
+    uint32_t serials_num;
+
+    // campaign only: the client we spawned for this connection
+    // and the events it got, saved if it crashes
+    struct fuzz_instance *instance;
+    uint32_t events_sent;
+    struct wl_array recorded;
+
+    // feedback: hash of the requests the client sent
+    // after the last event we sent (of type response_to)
+    uint64_t response;
+    enum event_type response_to;
+    uint32_t response_pending;
+    // events from the corpus we send first
+    struct event *prefix;
+    uint32_t prefix_len;
+    uint32_t prefix_pos;
+    // when we got the last real input event, with record
+    uint64_t last_real_event;
+    // replaying: all events were sent, the timestamp of the last one
+    // (with virtual_time the clock of the connection, starting at 0)
+    uint32_t replay_done;
+    uint32_t virtual_time;
+    uint32_t first_virtual_time;
+    uint64_t first_sent;
+
+    // sync pacing: the id of the wl_display.sync we sent for the
+    // client, whether the client was busy during its round trip
+    // and whether it is idle and can get the next event
+    uint32_t barrier_id;
+    uint32_t barrier_busy;
+    uint32_t idle;
+    uint64_t event_time;
+    uint64_t last_sent;
+
+    struct wl_list link;
+};
+
+// one client of a campaign
+struct fuzz_instance {
+    pid_t pid; // 0 if the slot is free
+    unsigned int stream;
+    uint64_t start;
+    // we sent SIGTERM or SIGKILL, the client did not crash
+    int killed;
+    uint64_t kill_time;
+    struct fuzz_connection *fc;
+
+    // minimizing: the events this client gets, which test
+    // of which round it is and when it got all the events
+    struct event *events;
+    uint32_t events_num;
+    uint32_t test;
+    uint32_t round;
+    uint64_t done_time;
+};
+
+enum fuzz_mode {
+    FUZZ,
+    FUZZ_CAMPAIGN,
+    FUZZ_MINIMIZE
+};
+
+/* options shared by all connections, so there is only one fuzzer */
+static struct {
+    // the fuzz pass is running, loading it again would overwrite this
+    uint32_t loaded;
+
+    uint64_t seed;
+    /* number of connections we started fuzzing */
+    unsigned int streams;
+    uint32_t generation;
+    struct wldbg_ids_map connections;
+    struct wl_list connections_list;
+
+    uint32_t delay_min;
+    uint32_t delay_max;
+    uint32_t block_events;
     uint32_t verbose;
     char* program_name;
-    struct wldbg_connection *conn;
+    char* seed_string;
     generate_f event_genarator;
+
+    // mutate events when mutate_rand() is below this, 0 is off
+    uint64_t mutate_threshold;
+    // the mutation options, to replay crashes
+    char mutate_options[256];
+    struct mutate_mask *mutate_masks;
+    uint32_t mutate_masks_num;
+    uint32_t no_events;
+    uint64_t mutations;
+
+    uint32_t feedback;
+    uint32_t record;
+    char* corpus_dir;
+    // wl_arrays of events that led to new responses
+    struct wl_array corpus;
+    uint32_t new_behaviours;
+    // hashes of the responses we have seen, open addressing
+    struct {
+        uint64_t *slots;
+        uint32_t size;
+        uint32_t count;
+    } coverage;
+
+    // send the next event when the client is idle, not after a delay
+    struct {
+        uint32_t enabled;
+        uint64_t events;
+        uint64_t round_trips;
+        // events sent without waiting for the client, it was not idle in delay_max
+        uint64_t timeouts;
+        // time from sending an event until the client was idle
+        uint64_t time;
+        uint64_t max;
+    } sync;
+
+    // timestamps run on a clock that moves by the delays of the events,
+    // the delays are not waited. The times of all connections summed up
+    struct {
+        uint32_t enabled;
+        uint64_t virtual_ms;
+        uint64_t real;
+    } virtual_time;
+
+    // send the events from a file (or the tests of minimize), nothing else
+    uint32_t replay_only;
+    struct wl_array replay_events;
+
+    // delta debugging of a crash, the tests of a round are
+    // the n chunks of the events and their complements
+    struct {
+        uint32_t enabled;
+        char *path;
+        // the signal that killed the client, 0 for any signal
+        int signal;
+        // how long we wait for the crash after the last event
+        uint32_t grace;
+        // the smallest sequence that crashes the client so far
+        struct wl_array events;
+        uint32_t original;
+        uint32_t n;
+        uint32_t verifying;
+        uint32_t round;
+        uint32_t tests;
+        uint32_t next_test;
+        int found;
+    } minimize;
+
+    struct {
+        uint32_t enabled;
+        uint32_t jobs;
+        uint32_t events;
+        uint32_t runs;
+        uint32_t timeout;
+        char* crashes_dir;
+
+        uint32_t execs;
+        uint32_t crashes;
+        uint32_t hangs;
+        uint32_t errors;
+        uint64_t start;
+        uint64_t last_report;
+        uint32_t last_report_execs;
+        struct fuzz_instance instances[MAX_JOBS];
+    } campaign;
+
+    // wakes us up for the next event, 0 in wakeup if not armed
+    struct wldbg_timer *timer;
+    uint64_t wakeup;
 } fuzz;
 
 static void print_usage(void *user_data) {
@@ -156,10 +400,88 @@ static void print_usage(void *user_data) {
            "    block           -- prevent real keyboard and mouse events from being sent\n"
            "    help            -- print this message\n"
            "    verbose         -- print messages generated by fuzzer as they are sent\n"
-           "    program=<name>  -- only send messages to connections with client program matching name\n"
+           "    program=<name>  -- only fuzz connections with client program matching name\n"
            "    delay_min=<min> -- minimum delay between events in milliseconds (default 10)\n"
            "    delay_max=<max> -- maximum delay between events in milliseconds (default 1000)\n"
            "    inconsistent    -- don't restrict to a consistent sequence of events\n"
+           "    stream=<n>      -- the first connection uses random stream n (default 0)\n"
+           "    mutate=<pct>    -- mutate arguments of pct %% of the events from the server\n"
+           "    mutate_mask=<interface>[:<opcodes>]\n"
+           "                    -- mutate only events of this interface, opcodes is\n"
+           "                       a bitmask of the events (default all). Can be repeated\n"
+           "    no_events       -- don't send generated events, only mutate\n"
+           "    feedback        -- prefer events that make the client respond differently\n"
+           "    corpus=<dir>    -- load event sequences from dir and save new ones there\n"
+           "    record          -- save real input events of every connection to corpus dir\n"
+           "    replay=<file>   -- send the events from the file instead of random ones,\n"
+           "                       the seed is not needed then\n"
+           "    sync            -- send the next event as soon as the client is idle\n"
+           "                       (at most delay_max later) and report how many\n"
+           "                       events per second the client handles\n"
+           "    virtual_time    -- don't wait the delays, only add them to the timestamps\n"
+           "                       of the events, which start at 0. Implies sync\n"
+           "\n"
+           "Mutations set integers and fixed numbers to boundary values, change the\n"
+           "length of strings and arrays (keeping their size on the wire), replace\n"
+           "objects by deleted ids and serials by old serials.\n"
+           "\n"
+           "With feedback, the requests the client sends after an event are hashed.\n"
+           "When the hash was not seen yet after this type of event, the events sent\n"
+           "so far are added to the corpus. New connections start with a part of\n"
+           "a sequence from the corpus and continue with random events. Sessions saved\n"
+           "with record are used as the initial corpus.\n"
+           "\n"
+           "With sync, wldbg sends wl_display.sync to the compositor for the client\n"
+           "after every event and hides the reply from the client. The client is idle\n"
+           "when a round trip ends without the client sending requests or having\n"
+           "unread events, then it gets the next event.\n"
+           "\n"
+           "With virtual_time, the timestamps of input and frame callbacks from the\n"
+           "compositor are rewritten to the virtual clock too, so the client sees the\n"
+           "same times in every run with the seed.\n"
+           "\n"
+           "Every fuzzed connection gets its own random stream derived from the seed,\n"
+           "the n-th connection gets the same events in every run with that seed.\n"
+    );
+}
+
+static void print_minimize_usage(void *user_data) {
+    printf("Minimize the events that crash a client\n"
+           "\n"
+           "Usage: wldbg fuzz-minimize [options] <crash-file> -- program [args]\n"
+           "\n"
+           "Available options:\n"
+           "    jobs=<n>        -- number of clients running at once (default 4)\n"
+           "    grace=<ms>      -- wait for the crash after the last event (default 500)\n"
+           "    timeout=<s>     -- kill clients running longer than s seconds (default 10)\n"
+           "    signal=<n>      -- the crash to look for, 0 is any (default from the file)\n"
+           "    delay_min=<ms>  -- delay between events (default 1)\n"
+           "\n"
+           "Runs the program with subsets of the events from the crash file (saved\n"
+           "by fuzz-campaign) until removing any single event stops the crash.\n"
+           "The events keep their timestamps, but are sent without the delays.\n"
+           "The result is saved next to the crash file with .min.txt suffix,\n"
+           "'wldbg fuzz replay=<file> -- program' replays it.\n"
+    );
+}
+
+static void print_campaign_usage(void *user_data) {
+    printf("Run many fuzzed clients in parallel\n"
+           "\n"
+           "Usage: wldbg fuzz-campaign [options] <seed> -- program [args]\n"
+           "\n"
+           "Takes the options of the fuzz pass and these:\n"
+           "    jobs=<n>        -- number of clients running at once (default 4)\n"
+           "    events=<n>      -- events sent to one client before it is stopped (default 200)\n"
+           "    runs=<n>        -- stop after running n clients, 0 is no limit (default 0)\n"
+           "    timeout=<s>     -- kill clients running longer than s seconds (default 10)\n"
+           "    crashes=<dir>   -- directory to save crashes into (default fuzz-crashes)\n"
+           "\n"
+           "Every client gets its own random stream. When a client is killed by a signal\n"
+           "that wldbg did not send, the seed, stream and the events it got are saved\n"
+           "to <dir>/crash-<stream>-<pid>.txt together with a command replaying them.\n"
+           "The number of runs per second and crashes are reported every second\n"
+           "and on SIGUSR1. The default delays are delay_min=1 delay_max=20.\n"
     );
 }
 
@@ -175,156 +497,1603 @@ static unsigned long hash(const char* str) {
     return hash;
 }
 
-static void generate_consistent_event() {
-    unsigned long millis = (rand() % (fuzz.delay_max - fuzz.delay_min)) + fuzz.delay_min;
-    fuzz.next_event.delay.tv_nsec = (millis % MILLIS_PER_SEC) * NANOS_PER_MILLI;
-    fuzz.next_event.delay.tv_sec = millis / MILLIS_PER_SEC;
-    int number_events = fuzz.events.mouse_entered ? 4 : 2;
-    switch (rand()%number_events) {
+// splitmix64, used to derive the streams of connections from the seed
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// xorshift64*, the state must never be 0
+static uint32_t xorshift64s(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return (*state * 0x2545f4914f6cdd1dULL) >> 32;
+}
+
+static uint32_t fuzz_rand(struct fuzz_connection *fc) {
+    return xorshift64s(&fc->rng);
+}
+
+static uint32_t mutate_rand(struct fuzz_connection *fc) {
+    return xorshift64s(&fc->mutate_rng);
+}
+
+// random number in [0, 1]
+static float fuzz_rand_float(struct fuzz_connection *fc) {
+    return (float) fuzz_rand(fc) / (float) UINT32_MAX;
+}
+
+static void generate_delay(struct fuzz_connection *fc) {
+    unsigned long millis = (fuzz_rand(fc) % (fuzz.delay_max - fuzz.delay_min)) + fuzz.delay_min;
+    fc->next_event.delay.tv_nsec = (millis % MILLIS_PER_SEC) * NANOS_PER_MILLI;
+    fc->next_event.delay.tv_sec = millis / MILLIS_PER_SEC;
+}
+
+static void generate_consistent_event(struct fuzz_connection *fc) {
+    struct event *event = &fc->next_event;
+
+    generate_delay(fc);
+    int number_events = fc->events.mouse_entered ? 4 : 2;
+    switch (fuzz_rand(fc)%number_events) {
+        case 0:
+            event->type = KEY;
+            uint32_t key_idx = fuzz_rand(fc) % (sizeof(keys)/sizeof(*keys));
+            event->key.key_code = keys[key_idx];
+            fc->events.key_status[key_idx] = 1 - fc->events.key_status[key_idx];
+            event->key.pressed = fc->events.key_status[key_idx];
+            break;
+        case 1:
+            if (fc->events.mouse_entered) {
+                event->type = MOUSE_LEAVE;
+            }
+            else {
+                event->type = MOUSE_ENTER;
+                event->mouse_enter.x = fuzz_rand_float(fc);
+                event->mouse_enter.y = fuzz_rand_float(fc);
+            }
+            fc->events.mouse_entered = 1 - fc->events.mouse_entered;
+            break;
+        case 2:
+            event->type = MOUSE_MOVE;
+            event->mouse_move.x = fuzz_rand_float(fc);
+            event->mouse_move.y = fuzz_rand_float(fc);
+            break;
+        case 3:
+            event->type = MOUSE_BUTTON;
+            uint32_t button_idx = fuzz_rand(fc) % (sizeof(buttons)/sizeof(*buttons));
+            event->mouse_button.button_code = buttons[button_idx];
+            fc->events.button_status[button_idx] = 1 - fc->events.button_status[button_idx];
+            event->mouse_button.pressed = fc->events.button_status[button_idx];
+            break;
+    }
+}
+
+static void generate_inconsistent_event(struct fuzz_connection *fc) {
+    struct event *event = &fc->next_event;
+
+    generate_delay(fc);
+    switch (fuzz_rand(fc)%4) {
         case 0:
-            fuzz.next_event.type = KEY;
-            uint32_t key_idx = rand() % (sizeof(keys)/sizeof(*keys));
-            fuzz.next_event.key.key_code = keys[key_idx];
-            fuzz.events.key_status[key_idx] = 1 - fuzz.events.key_status[key_idx];
-            fuzz.next_event.key.pressed = fuzz.events.key_status[key_idx];
+            event->type = KEY;
+            uint32_t key_idx = fuzz_rand(fc) % (sizeof(keys)/sizeof(*keys));
+            event->key.key_code = keys[key_idx];
+            event->key.pressed = fuzz_rand(fc) % 2;
             break;
         case 1:
-            if (fuzz.events.mouse_entered) {
-                fuzz.next_event.type = MOUSE_LEAVE;
+            if (fuzz_rand(fc) % 2) {
+                event->type = MOUSE_LEAVE;
             }
             else {
-                fuzz.next_event.type = MOUSE_ENTER;
-                fuzz.next_event.mouse_enter.x = ((float)rand()) / (float)RAND_MAX;
-                fuzz.next_event.mouse_enter.y = ((float)rand()) / (float)RAND_MAX;
+                event->type = MOUSE_ENTER;
+                event->mouse_enter.x = fuzz_rand_float(fc);
+                event->mouse_enter.y = fuzz_rand_float(fc);
             }
-            fuzz.events.mouse_entered = 1 - fuzz.events.mouse_entered;
             break;
         case 2:
-            fuzz.next_event.type = MOUSE_MOVE;
-            fuzz.next_event.mouse_move.x = ((float)rand()) / (float)RAND_MAX;
-            fuzz.next_event.mouse_move.y = ((float)rand()) / (float)RAND_MAX;
+            event->type = MOUSE_MOVE;
+            event->mouse_move.x = fuzz_rand_float(fc);
+            event->mouse_move.y = fuzz_rand_float(fc);
             break;
         case 3:
-            fuzz.next_event.type = MOUSE_BUTTON;
-            uint32_t button_idx = rand() % (sizeof(buttons)/sizeof(*buttons));
-            fuzz.next_event.mouse_button.button_code = buttons[button_idx];
-            fuzz.events.button_status[button_idx] = 1 - fuzz.events.button_status[button_idx];
-            fuzz.next_event.mouse_button.pressed = fuzz.events.button_status[button_idx];
+            event->type = MOUSE_BUTTON;
+            uint32_t button_idx = fuzz_rand(fc) % (sizeof(buttons)/sizeof(*buttons));
+            event->mouse_button.button_code = buttons[button_idx];
+            event->mouse_button.pressed = fuzz_rand(fc) % 2;
+            break;
+    }
+}
+
+// the campaign's instance of the client with pid, NULL if it's not ours
+static struct fuzz_instance *get_instance(pid_t pid) {
+    for (uint32_t i = 0; i < fuzz.campaign.jobs; ++i) {
+        if (pid > 0 && fuzz.campaign.instances[i].pid == pid) {
+            return &fuzz.campaign.instances[i];
+        }
+    }
+    return NULL;
+}
+
+static struct fuzz_instance *add_instance(pid_t pid) {
+    for (uint32_t i = 0; i < fuzz.campaign.jobs; ++i) {
+        struct fuzz_instance *inst = &fuzz.campaign.instances[i];
+        if (inst->pid == 0) {
+            memset(inst, 0, sizeof *inst);
+            inst->pid = pid;
+            inst->stream = fuzz.streams++;
+            inst->start = wldbg_get_time();
+            ++fuzz.campaign.execs;
+            return inst;
+        }
+    }
+    return NULL;
+}
+
+static uint32_t running_instances(void) {
+    uint32_t running = 0;
+    for (uint32_t i = 0; i < fuzz.campaign.jobs; ++i) {
+        if (fuzz.campaign.instances[i].pid) {
+            ++running;
+        }
+    }
+    return running;
+}
+
+// wake up at when (wldbg_get_time()) or earlier
+static void fuzz_schedule(uint64_t when) {
+    uint64_t now = wldbg_get_time();
+
+    if (!fuzz.timer || (fuzz.wakeup && fuzz.wakeup <= when)) {
+        return;
+    }
+
+    fuzz.wakeup = when;
+    // timeout 0 would disarm the timer
+    wldbg_timer_arm(fuzz.timer, when > now ? when - now : 1, 0);
+}
+
+static void print_event(FILE *f, struct event *event) {
+    unsigned long delay = event->delay.tv_sec * MILLIS_PER_SEC
+                          + event->delay.tv_nsec / NANOS_PER_MILLI;
+
+    switch (event->type) {
+        case KEY:
+            fprintf(f, "event %lu key %u %u\n", delay,
+                    event->key.key_code, event->key.pressed);
+            break;
+        case MOUSE_ENTER:
+            fprintf(f, "event %lu enter %.9g %.9g\n", delay,
+                    event->mouse_enter.x, event->mouse_enter.y);
+            break;
+        case MOUSE_LEAVE:
+            fprintf(f, "event %lu leave\n", delay);
+            break;
+        case MOUSE_BUTTON:
+            fprintf(f, "event %lu button %u %u\n", delay,
+                    event->mouse_button.button_code, event->mouse_button.pressed);
+            break;
+        case MOUSE_MOVE:
+            fprintf(f, "event %lu motion %.9g %.9g\n", delay,
+                    event->mouse_move.x, event->mouse_move.y);
+            break;
+    }
+}
+
+static int parse_event(const char *line, struct event *event) {
+    unsigned long delay;
+    char type[16];
+    int n;
+
+    memset(event, 0, sizeof *event);
+    if (sscanf(line, "event %lu %15s%n", &delay, type, &n) != 2) {
+        return -1;
+    }
+    line += n;
+
+    event->delay.tv_sec = delay / MILLIS_PER_SEC;
+    event->delay.tv_nsec = (delay % MILLIS_PER_SEC) * NANOS_PER_MILLI;
+
+    if (strcmp(type, "key") == 0) {
+        event->type = KEY;
+        return sscanf(line, "%u %u", &event->key.key_code, &event->key.pressed) == 2 ? 0 : -1;
+    }
+    else if (strcmp(type, "enter") == 0) {
+        event->type = MOUSE_ENTER;
+        return sscanf(line, "%f %f", &event->mouse_enter.x, &event->mouse_enter.y) == 2 ? 0 : -1;
+    }
+    else if (strcmp(type, "leave") == 0) {
+        event->type = MOUSE_LEAVE;
+        return 0;
+    }
+    else if (strcmp(type, "button") == 0) {
+        event->type = MOUSE_BUTTON;
+        return sscanf(line, "%u %u", &event->mouse_button.button_code,
+                      &event->mouse_button.pressed) == 2 ? 0 : -1;
+    }
+    else if (strcmp(type, "motion") == 0) {
+        event->type = MOUSE_MOVE;
+        return sscanf(line, "%f %f", &event->mouse_move.x, &event->mouse_move.y) == 2 ? 0 : -1;
+    }
+
+    return -1;
+}
+
+// read the event lines of a file saved by us, the rest is ignored
+static int load_events(const char *path, struct wl_array *events) {
+    char line[256];
+    unsigned int lineno = 0;
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        fprintf(stderr, "Failed opening '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof line, f)) {
+        ++lineno;
+        if (strncmp(line, "event ", 6) != 0) {
+            continue;
+        }
+
+        struct event *event = wl_array_add(events, sizeof *event);
+        if (!event || parse_event(line, event) < 0) {
+            fprintf(stderr, "%s:%u: invalid event\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+static void write_events(FILE *f, struct event *events, uint32_t num) {
+    for (uint32_t i = 0; i < num; ++i) {
+        print_event(f, &events[i]);
+    }
+}
+
+static int add_to_corpus(struct event *events, uint32_t num) {
+    struct wl_array *entry;
+
+    if (num == 0 || fuzz.corpus.size / sizeof *entry >= MAX_CORPUS) {
+        return -1;
+    }
+
+    entry = wl_array_add(&fuzz.corpus, sizeof *entry);
+    if (!entry) {
+        return -1;
+    }
+
+    wl_array_init(entry);
+    if (!wl_array_add(entry, num * sizeof *events)) {
+        fuzz.corpus.size -= sizeof *entry;
+        return -1;
+    }
+    memcpy(entry->data, events, num * sizeof *events);
+
+    return 0;
+}
+
+static int load_corpus(const char *dir) {
+    struct dirent *dirent;
+    char path[256];
+    DIR *d;
+
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        fprintf(stderr, "Failed creating '%s': %s\n", dir, strerror(errno));
+        return -1;
+    }
+
+    d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "Failed opening '%s': %s\n", dir, strerror(errno));
+        return -1;
+    }
+
+    while ((dirent = readdir(d))) {
+        const char *dot = strrchr(dirent->d_name, '.');
+        struct wl_array events;
+
+        if (!dot || strcmp(dot, ".txt") != 0) {
+            continue;
+        }
+
+        if (snprintf(path, sizeof path, "%s/%s", dir, dirent->d_name) >= (int) sizeof path) {
+            fprintf(stderr, "Path to '%s' is too long\n", dirent->d_name);
+            continue;
+        }
+        wl_array_init(&events);
+        if (load_events(path, &events) == 0) {
+            add_to_corpus(events.data, events.size / sizeof(struct event));
+        }
+        wl_array_release(&events);
+    }
+
+    closedir(d);
+    return 0;
+}
+
+static void save_events(const char *prefix, unsigned int n, struct wl_array *events) {
+    char path[256];
+    FILE *f;
+
+    if (snprintf(path, sizeof path, "%s/%s-%d-%u.txt", fuzz.corpus_dir,
+                 prefix, getpid(), n) >= (int) sizeof path) {
+        return;
+    }
+
+    f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Failed opening '%s': %s\n", path, strerror(errno));
+        return;
+    }
+
+    write_events(f, events->data, events->size / sizeof(struct event));
+    fclose(f);
+}
+
+// returns 1 if the hash was not seen yet
+static int coverage_add(uint64_t hash) {
+    uint32_t i;
+
+    if (hash == 0) {
+        hash = 1;
+    }
+
+    // keep the table at most half full
+    if (2 * (fuzz.coverage.count + 1) > fuzz.coverage.size) {
+        uint32_t size = fuzz.coverage.size ? 2 * fuzz.coverage.size : 1024;
+        uint64_t *slots = calloc(size, sizeof *slots);
+        if (!slots) {
+            return 0;
+        }
+
+        for (i = 0; i < fuzz.coverage.size; ++i) {
+            uint64_t h = fuzz.coverage.slots[i];
+            if (h) {
+                uint32_t j = h & (size - 1);
+                while (slots[j]) {
+                    j = (j + 1) & (size - 1);
+                }
+                slots[j] = h;
+            }
+        }
+
+        free(fuzz.coverage.slots);
+        fuzz.coverage.slots = slots;
+        fuzz.coverage.size = size;
+    }
+
+    i = hash & (fuzz.coverage.size - 1);
+    while (fuzz.coverage.slots[i]) {
+        if (fuzz.coverage.slots[i] == hash) {
+            return 0;
+        }
+        i = (i + 1) & (fuzz.coverage.size - 1);
+    }
+
+    fuzz.coverage.slots[i] = hash;
+    ++fuzz.coverage.count;
+    return 1;
+}
+
+// the client responded to the last event we sent with requests that hash
+// to fc->response. If no event was followed by these requests before,
+// the events that led to it are interesting
+static void response_done(struct fuzz_connection *fc) {
+    uint64_t x = fc->response ^ ((uint64_t) fc->response_to << 56);
+
+    if (!fc->response_pending) {
+        return;
+    }
+    fc->response_pending = 0;
+
+    if (coverage_add(splitmix64(&x))
+        && add_to_corpus(fc->recorded.data, fc->recorded.size / sizeof(struct event)) == 0) {
+        ++fuzz.new_behaviours;
+        if (fuzz.corpus_dir) {
+            save_events("corpus", fuzz.new_behaviours, &fc->recorded);
+        }
+    }
+}
+
+static uint32_t find_index(const uint32_t *codes, uint32_t num, uint32_t code) {
+    for (uint32_t i = 0; i < num; ++i) {
+        if (codes[i] == code) {
+            return i;
+        }
+    }
+    return num;
+}
+
+// keep the state of consistent events in sync with events from the corpus
+static void apply_event(struct fuzz_connection *fc, struct event *event) {
+    uint32_t idx;
+
+    switch (event->type) {
+        case KEY:
+            idx = find_index(keys, sizeof(keys)/sizeof(*keys), event->key.key_code);
+            if (idx < sizeof(keys)/sizeof(*keys)) {
+                fc->events.key_status[idx] = event->key.pressed;
+            }
+            break;
+        case MOUSE_ENTER:
+            fc->events.mouse_entered = 1;
+            break;
+        case MOUSE_LEAVE:
+            fc->events.mouse_entered = 0;
+            break;
+        case MOUSE_BUTTON:
+            idx = find_index(buttons, sizeof(buttons)/sizeof(*buttons),
+                             event->mouse_button.button_code);
+            if (idx < sizeof(buttons)/sizeof(*buttons)) {
+                fc->events.button_status[idx] = event->mouse_button.pressed;
+            }
             break;
+        case MOUSE_MOVE:
+            break;
+    }
+}
+
+static void next_event(struct fuzz_connection *fc) {
+    if (fc->prefix_pos < fc->prefix_len) {
+        fc->next_event = fc->prefix[fc->prefix_pos++];
+        apply_event(fc, &fc->next_event);
+    }
+    else if (fuzz.replay_only) {
+        fc->replay_done = 1;
+    }
+    else {
+        fuzz.event_genarator(fc);
+    }
+}
+
+// start with a part of some sequence from the corpus
+// and continue with random events from there
+static void choose_prefix(struct fuzz_connection *fc) {
+    struct wl_array *entries = fuzz.corpus.data;
+    uint32_t num = fuzz.corpus.size / sizeof *entries;
+
+    if (num == 0 || fuzz_rand(fc) % 4 == 0) {
+        return;
+    }
+
+    struct wl_array *entry = &entries[fuzz_rand(fc) % num];
+    fc->prefix = entry->data;
+    fc->prefix_len = 1 + fuzz_rand(fc) % (entry->size / sizeof(struct event));
+}
+
+// the events of the test-th test of the round: the chunks first, then their complements
+static int build_test(uint32_t test, struct wl_array *out) {
+    struct event *events = fuzz.minimize.events.data;
+    uint32_t len = fuzz.minimize.events.size / sizeof *events;
+    uint32_t n = fuzz.minimize.n;
+    uint32_t chunk = test < n ? test : test - n;
+    uint32_t start = (uint64_t) chunk * len / n;
+    uint32_t end = (uint64_t) (chunk + 1) * len / n;
+    struct event *dst;
+
+    wl_array_init(out);
+    if (test < n) {
+        dst = wl_array_add(out, (end - start) * sizeof *events);
+        if (!dst) {
+            return -1;
+        }
+        memcpy(dst, events + start, (end - start) * sizeof *events);
+    }
+    else {
+        dst = wl_array_add(out, (len - (end - start)) * sizeof *events);
+        if (!dst) {
+            return -1;
+        }
+        memcpy(dst, events, start * sizeof *events);
+        memcpy(dst + start, events + end, (len - end) * sizeof *events);
+    }
+
+    return 0;
+}
+
+static struct fuzz_instance *new_instance(pid_t pid) {
+    struct fuzz_instance *inst = add_instance(pid);
+    struct wl_array events;
+
+    if (!inst || !fuzz.minimize.enabled) {
+        return inst;
+    }
+
+    if (build_test(fuzz.minimize.next_test, &events) < 0) {
+        fprintf(stderr, "Out of memory\n");
+        return inst;
+    }
+
+    inst->events = events.data;
+    inst->events_num = events.size / sizeof(struct event);
+    inst->test = fuzz.minimize.next_test++;
+    inst->round = fuzz.minimize.round;
+
+    return inst;
+}
+
+static struct fuzz_connection *create_fuzz_connection(struct wldbg_connection *conn) {
+    struct fuzz_connection *fc = calloc(1, sizeof *fc);
+    if (!fc) {
+        fprintf(stderr, "Out of memory\n");
+        return NULL;
+    }
+
+    // clients of a campaign got their stream when we spawned them
+    if (fuzz.campaign.enabled) {
+        fc->instance = get_instance(conn->client.pid);
+        // the first client was spawned by wldbg
+        if (!fc->instance && fuzz.campaign.execs == 0) {
+            fc->instance = new_instance(conn->client.pid);
+        }
+    }
+    if (fc->instance) {
+        fc->instance->fc = fc;
+        fc->stream = fc->instance->stream;
+    }
+    else {
+        fc->stream = fuzz.streams++;
+    }
+    wl_array_init(&fc->recorded);
+
+    uint64_t x = fuzz.seed + fc->stream;
+    fc->rng = splitmix64(&x);
+    if (fc->rng == 0) {
+        fc->rng = 1;
+    }
+    fc->mutate_rng = splitmix64(&x);
+    if (fc->mutate_rng == 0) {
+        fc->mutate_rng = 1;
+    }
+
+    fc->id = conn->id;
+    fc->generation = fuzz.generation;
+    if (fc->instance && fc->instance->events) {
+        fc->prefix = fc->instance->events;
+        fc->prefix_len = fc->instance->events_num;
+    }
+    else if (fuzz.replay_only) {
+        fc->prefix = fuzz.replay_events.data;
+        fc->prefix_len = fuzz.replay_events.size / sizeof(struct event);
+    }
+    else if (fuzz.feedback) {
+        choose_prefix(fc);
+    }
+    next_event(fc);
+
+    wldbg_ids_map_insert(&fuzz.connections, conn->id, fc);
+    wl_list_insert(fuzz.connections_list.prev, &fc->link);
+
+    dbg("Fuzzing connection %u (stream %u)\n", conn->id, fc->stream);
+
+    return fc;
+}
+
+static void destroy_fuzz_connection(struct fuzz_connection *fc) {
+    if (fuzz.feedback) {
+        response_done(fc);
+    }
+    if (fuzz.record && fc->recorded.size > 0) {
+        save_events("session", fc->id, &fc->recorded);
+    }
+    if (fc->instance) {
+        fc->instance->fc = NULL;
+    }
+    if (fc->first_sent) {
+        fuzz.virtual_time.virtual_ms += fc->virtual_time - fc->first_virtual_time;
+        fuzz.virtual_time.real += fc->last_sent - fc->first_sent;
+    }
+    wldbg_ids_map_insert(&fuzz.connections, fc->id, NULL);
+    wl_list_remove(&fc->link);
+    wl_array_release(&fc->recorded);
+    free(fc);
+}
+
+// get the state of connection, NULL if we don't fuzz it
+static struct fuzz_connection *get_fuzz_connection(struct wldbg_connection *conn) {
+    struct fuzz_connection *fc = wldbg_ids_map_get(&fuzz.connections, conn->id);
+    if (fc) {
+        return fc;
+    }
+
+    if (fuzz.program_name) {
+        if (!conn->client.program || strcmp(conn->client.program, fuzz.program_name) != 0) {
+            return NULL;
+        }
+    }
+
+    return create_fuzz_connection(conn);
+}
+
+static void remember(uint32_t *ring, uint32_t *num, uint32_t value) {
+    ring[*num % NUM_REPLAYED] = value;
+    ++(*num);
+}
+
+static uint32_t replay(struct fuzz_connection *fc, uint32_t *ring, uint32_t num) {
+    return ring[mutate_rand(fc) % (num < NUM_REPLAYED ? num : NUM_REPLAYED)];
+}
+
+static int mutate_mask_matches(const struct wl_interface *interface, uint32_t opcode) {
+    if (fuzz.mutate_masks_num == 0) {
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < fuzz.mutate_masks_num; ++i) {
+        struct mutate_mask *mask = &fuzz.mutate_masks[i];
+        if (strcmp(mask->interface, interface->name) == 0) {
+            return opcode >= 32 || (mask->opcodes & (1U << opcode));
+        }
+    }
+
+    return 0;
+}
+
+// change one argument of the event, serial points to the serial
+// of the event if it has one. The size of the message never changes,
+// wldbg and the passes after us parse the message too
+static void mutate_message(struct fuzz_connection *fc, struct wldbg_resolved_message *rm,
+                           uint32_t *serial) {
+    struct wldbg_resolved_arg *arg;
+    uint32_t *args[MAX_MUTATED_ARGS];
+    char types[MAX_MUTATED_ARGS];
+    uint32_t n = 0, len, padded;
+
+    // this is all we do for most of the events
+    if ((uint64_t) mutate_rand(fc) >= fuzz.mutate_threshold) {
+        return;
+    }
+
+    if (!mutate_mask_matches(rm->wl_interface, rm->base.opcode)) {
+        return;
+    }
+
+    while ((arg = wldbg_resolved_message_next_argument(rm)) && n < MAX_MUTATED_ARGS) {
+        // file descriptors are not in the data
+        if (arg->type == 'h') {
+            break;
+        }
+        // new objects must stay, we would lose track of them
+        if (arg->type == 'n' || !arg->data) {
+            continue;
+        }
+
+        args[n] = arg->data;
+        types[n] = arg->type;
+        ++n;
+    }
+
+    if (n == 0) {
+        return;
+    }
+
+    uint32_t i = mutate_rand(fc) % n;
+    uint32_t *data = args[i];
+    switch (types[i]) {
+        case 'u':
+            if (data == serial && fc->serials_num > 0) {
+                *data = replay(fc, fc->serials, fc->serials_num);
+            }
+            else {
+                *data = boundary_uints[mutate_rand(fc) % (sizeof(boundary_uints)/sizeof(*boundary_uints))];
+            }
+            break;
+        case 'i':
+            *data = boundary_ints[mutate_rand(fc) % (sizeof(boundary_ints)/sizeof(*boundary_ints))];
+            break;
+        case 'f':
+            *data = boundary_fixed[mutate_rand(fc) % (sizeof(boundary_fixed)/sizeof(*boundary_fixed))];
+            break;
+        case 'o':
+            if (fc->deleted_ids_num > 0) {
+                *data = replay(fc, fc->deleted_ids, fc->deleted_ids_num);
+            }
+            else {
+                *data = 0;
+            }
+            break;
+        case 's':
+            len = data[-1];
+            padded = (len + 3) & ~3U;
+            if (len == padded || mutate_rand(fc) % 2) {
+                // not terminated
+                ((char *) data)[len - 1] = 'A';
+            }
+            else {
+                // zeros at the end
+                data[-1] = padded;
+            }
+            break;
+        case 'a':
+            len = data[-1];
+            padded = (len + 3) & ~3U;
+            data[-1] = padded - mutate_rand(fc) % 4;
+            break;
+    }
+
+    ++fuzz.mutations;
+    if (fuzz.verbose) {
+        printf("Mutating argument %u ('%c') of %s@%u.%s\n", i, types[i],
+               rm->wl_interface->name, rm->base.id, rm->wl_message->name);
+    }
+}
+
+static void add_mutate_option(const char *option) {
+    size_t len = strlen(fuzz.mutate_options);
+    snprintf(fuzz.mutate_options + len, sizeof fuzz.mutate_options - len, " %s", option);
+}
+
+// interface[:opcodes], commas separate passes so every interface has its option
+static int add_mutate_mask(const char *str) {
+    struct mutate_mask *masks = realloc(fuzz.mutate_masks,
+                                        (fuzz.mutate_masks_num + 1) * sizeof *masks);
+    if (!masks) {
+        return -1;
+    }
+    fuzz.mutate_masks = masks;
+
+    struct mutate_mask *mask = &masks[fuzz.mutate_masks_num];
+    const char *opcodes = strchr(str, ':');
+    mask->opcodes = UINT32_MAX;
+    if (opcodes) {
+        mask->opcodes = strtoul(opcodes + 1, NULL, 0);
+        mask->interface = strndup(str, opcodes - str);
+    }
+    else {
+        mask->interface = strdup(str);
+    }
+
+    if (!mask->interface) {
+        return -1;
+    }
+
+    ++fuzz.mutate_masks_num;
+    return 0;
+}
+
+static void campaign_report(void) {
+    uint64_t now = wldbg_get_time();
+    uint64_t elapsed = now - fuzz.campaign.last_report;
+    double rate = 0;
+
+    if (elapsed > 0) {
+        rate = (fuzz.campaign.execs - fuzz.campaign.last_report_execs)
+               / ((double) elapsed / NANOS_PER_SEC);
+    }
+
+    fprintf(stderr, "[%lus] execs %u (%.1f/s) running %u crashes %u hangs %u errors %u",
+            (unsigned long) ((now - fuzz.campaign.start) / NANOS_PER_SEC),
+            fuzz.campaign.execs, rate, running_instances(),
+            fuzz.campaign.crashes, fuzz.campaign.hangs, fuzz.campaign.errors);
+    if (fuzz.feedback) {
+        fprintf(stderr, " corpus %lu responses %u",
+                (unsigned long) (fuzz.corpus.size / sizeof(struct wl_array)),
+                fuzz.coverage.count);
+    }
+    fputc('\n', stderr);
+
+    fuzz.campaign.last_report = now;
+    fuzz.campaign.last_report_execs = fuzz.campaign.execs;
+}
+
+static void campaign_report_callback(void *data) {
+    (void) data;
+
+    if (fuzz.campaign.enabled) {
+        campaign_report();
+    }
+}
+
+// how the events were paced, for the commands in crash files
+static const char *clock_option(void) {
+    if (fuzz.virtual_time.enabled) {
+        return " virtual_time";
+    }
+    return fuzz.sync.enabled ? " sync" : "";
+}
+
+static void print_program(FILE *f, struct wldbg *wldbg) {
+    for (int i = 0; wldbg->client.argv[i]; ++i) {
+        fprintf(f, " %s", wldbg->client.argv[i]);
+    }
+}
+
+// save what we need to reproduce the crash, the events are in the order we sent them
+// and their delay is the time we waited before sending them
+static void save_crash(struct wldbg *wldbg, struct fuzz_instance *inst, int sig) {
+    struct fuzz_connection *fc = inst->fc;
+    struct event *event;
+    char path[256];
+    FILE *f;
+
+    if (snprintf(path, sizeof path, "%s/crash-%u-%d.txt", fuzz.campaign.crashes_dir,
+                 inst->stream, inst->pid) >= (int) sizeof path) {
+        fprintf(stderr, "Path to crash file is too long\n");
+        return;
+    }
+
+    f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Failed opening '%s': %s\n", path, strerror(errno));
+        return;
+    }
+
+    fprintf(f, "# client %d killed by signal %d (%s)\n", inst->pid, sig, strsignal(sig));
+    fprintf(f, "# program:");
+    print_program(f, wldbg);
+    fprintf(f, "\n# events: %u\n", fc ? fc->events_sent : 0);
+    fprintf(f, "# replay: wldbg fuzz stream=%u delay_min=%u delay_max=%u%s%s%s%s %s --",
+            inst->stream, fuzz.delay_min, fuzz.delay_max,
+            fuzz.event_genarator == generate_inconsistent_event ? " inconsistent" : "",
+            fuzz.block_events ? " block" : "", clock_option(), fuzz.mutate_options,
+            fuzz.seed_string);
+    print_program(f, wldbg);
+    fprintf(f, "\n# minimize: wldbg fuzz-minimize%s %s --", clock_option(), path);
+    print_program(f, wldbg);
+    fprintf(f, "\nseed %s\nstream %u\n", fuzz.seed_string, inst->stream);
+
+    if (fc) {
+        wl_array_for_each(event, &fc->recorded) {
+            print_event(f, event);
+        }
+    }
+
+    fclose(f);
+
+    fprintf(stderr, "Client %d (stream %u) crashed with signal %d, saved to '%s'\n",
+            inst->pid, inst->stream, sig, path);
+}
+
+static void minimize_done(struct wldbg *wldbg) {
+    uint32_t len = fuzz.minimize.events.size / sizeof(struct event);
+    char path[256];
+    const char *suffix = strrchr(fuzz.minimize.path, '.');
+    int base = suffix && strcmp(suffix, ".txt") == 0
+               ? suffix - fuzz.minimize.path : (int) strlen(fuzz.minimize.path);
+    FILE *f;
+
+    if (snprintf(path, sizeof path, "%.*s.min.txt", base, fuzz.minimize.path)
+        >= (int) sizeof path) {
+        fprintf(stderr, "Path to the minimized file is too long\n");
+        wldbg_error(wldbg);
+        return;
+    }
+
+    f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Failed opening '%s': %s\n", path, strerror(errno));
+        wldbg_error(wldbg);
+        return;
+    }
+
+    fprintf(f, "# minimized '%s' from %u to %u events in %u runs\n",
+            fuzz.minimize.path, fuzz.minimize.original, len, fuzz.campaign.execs);
+    fprintf(f, "# killed by signal %d\n", fuzz.minimize.signal);
+    fprintf(f, "# program:");
+    print_program(f, wldbg);
+    fprintf(f, "\n# replay: wldbg fuzz%s replay=%s --", clock_option(), path);
+    print_program(f, wldbg);
+    fputc('\n', f);
+    write_events(f, fuzz.minimize.events.data, len);
+    fclose(f);
+
+    fprintf(stderr, "Minimized %u events to %u in %u runs, saved to '%s'\n",
+            fuzz.minimize.original, len, fuzz.campaign.execs, path);
+    wldbg_exit(wldbg);
+}
+
+static void minimize_next_round(struct wldbg *wldbg) {
+    uint32_t len = fuzz.minimize.events.size / sizeof(struct event);
+    uint32_t n = fuzz.minimize.n;
+
+    if (fuzz.minimize.verifying) {
+        if (fuzz.minimize.found < 0) {
+            fprintf(stderr, "The crash from '%s' does not reproduce\n", fuzz.minimize.path);
+            wldbg_error(wldbg);
+            return;
+        }
+        fuzz.minimize.verifying = 0;
+        n = 2;
+    }
+    else if (fuzz.minimize.found >= 0) {
+        struct wl_array events;
+
+        if (build_test(fuzz.minimize.found, &events) < 0) {
+            fprintf(stderr, "Out of memory\n");
+            wldbg_error(wldbg);
+            return;
+        }
+        wl_array_release(&fuzz.minimize.events);
+        fuzz.minimize.events = events;
+        len = events.size / sizeof(struct event);
+
+        // a chunk crashes, start again with it. A complement
+        // crashes, keep the granularity of what's left
+        if ((uint32_t) fuzz.minimize.found < n) {
+            n = 2;
+        }
+        else if (n > 2) {
+            --n;
+        }
+    }
+    else if (n < len) {
+        n = 2 * n < len ? 2 * n : len;
+    }
+    else {
+        // removing any single event stops the crash
+        minimize_done(wldbg);
+        return;
+    }
+
+    if (len <= 1) {
+        minimize_done(wldbg);
+        return;
+    }
+
+    fuzz.minimize.n = n < len ? n : len;
+    // with two chunks the complements are the chunks
+    fuzz.minimize.tests = fuzz.minimize.n > 2 ? 2 * fuzz.minimize.n : fuzz.minimize.n;
+    fuzz.minimize.next_test = 0;
+    fuzz.minimize.found = -1;
+    ++fuzz.minimize.round;
+}
+
+static void minimize_tick(struct wldbg *wldbg) {
+    struct wldbg_connection *conn;
+
+    while (running_instances() < fuzz.campaign.jobs && fuzz.minimize.found < 0
+           && fuzz.minimize.next_test < fuzz.minimize.tests) {
+        conn = wldbg_spawn_client(wldbg);
+        if (!conn) {
+            wldbg_error(wldbg);
+            return;
+        }
+        new_instance(conn->client.pid);
+    }
+
+    // wait until all clients of the round are gone
+    if (running_instances() == 0) {
+        minimize_next_round(wldbg);
+    }
+}
+
+static void minimize_client_exited(struct fuzz_instance *inst, int status) {
+    int sig;
+
+    if (!WIFSIGNALED(status)) {
+        return;
+    }
+
+    sig = WTERMSIG(status);
+    if (inst->killed && (sig == SIGTERM || sig == SIGKILL)) {
+        return;
+    }
+    if (fuzz.minimize.signal && sig != fuzz.minimize.signal) {
+        return;
+    }
+
+    ++fuzz.campaign.crashes;
+    if (inst->round != fuzz.minimize.round || fuzz.minimize.found >= 0) {
+        return;
+    }
+
+    fuzz.minimize.found = inst->test;
+    if (!fuzz.minimize.signal) {
+        fuzz.minimize.signal = sig;
+    }
+
+    // the rest of the round is not needed
+    for (uint32_t i = 0; i < fuzz.campaign.jobs; ++i) {
+        struct fuzz_instance *other = &fuzz.campaign.instances[i];
+        if (other->pid && other != inst && !other->killed) {
+            kill(other->pid, SIGKILL);
+            other->killed = 1;
+            other->kill_time = wldbg_get_time();
+        }
+    }
+}
+
+// read the signal from the crash file saved by the campaign
+static int read_crash_signal(const char *path) {
+    char line[256];
+    int pid, sig = 0;
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        return 0;
+    }
+
+    while (fgets(line, sizeof line, f)) {
+        if (sscanf(line, "# client %d killed by signal %d", &pid, &sig) == 2
+            || sscanf(line, "# killed by signal %d", &sig) == 1) {
+            break;
+        }
+    }
+
+    fclose(f);
+    return sig;
+}
+
+static void campaign_client_exited(pid_t pid, int status, void *data) {
+    struct wldbg *wldbg = data;
+    struct fuzz_instance *inst;
+    struct fuzz_connection *fc;
+
+    if (!fuzz.campaign.enabled) {
+        return;
+    }
+
+    inst = get_instance(pid);
+    if (!inst) {
+        return;
+    }
+
+    if (fuzz.minimize.enabled) {
+        minimize_client_exited(inst, status);
+    }
+    else if (WIFSIGNALED(status)) {
+        int sig = WTERMSIG(status);
+        // the signals we stop clients with are not crashes
+        if (!inst->killed || (sig != SIGTERM && sig != SIGKILL)) {
+            ++fuzz.campaign.crashes;
+            save_crash(wldbg, inst, sig);
+        }
+    }
+    else if (WIFEXITED(status) && WEXITSTATUS(status) != 0 && !inst->killed) {
+        ++fuzz.campaign.errors;
+    }
+
+    // the connection may be still open, then
+    // the state is freed when it gets closed
+    fc = inst->fc;
+    if (fc) {
+        fc->instance = NULL;
+        // the events are freed with the instance
+        if (inst->events) {
+            fc->prefix = NULL;
+            fc->prefix_len = fc->prefix_pos = 0;
+            fc->replay_done = 1;
+        }
+        if (fc->generation != fuzz.generation) {
+            destroy_fuzz_connection(fc);
+        }
+    }
+
+    free(inst->events);
+    inst->events = NULL;
+    inst->pid = 0;
+    inst->fc = NULL;
+
+    // start the next one right away
+    fuzz_schedule(wldbg_get_time());
+}
+
+// stop the clients that are done, start new ones
+static void campaign_tick(struct wldbg *wldbg) {
+    struct wldbg_connection *conn;
+    uint64_t now = wldbg_get_time();
+
+    for (uint32_t i = 0; i < fuzz.campaign.jobs; ++i) {
+        struct fuzz_instance *inst = &fuzz.campaign.instances[i];
+        if (inst->pid == 0) {
+            continue;
+        }
+
+        if (!inst->killed && inst->fc && inst->fc->replay_done && !inst->done_time) {
+            inst->done_time = now;
+        }
+
+        if (!inst->killed && inst->fc && inst->fc->events_sent >= fuzz.campaign.events) {
+            kill(inst->pid, SIGTERM);
+            inst->killed = 1;
+            inst->kill_time = now;
+        }
+        else if (!inst->killed && inst->done_time
+                 && now - inst->done_time > (uint64_t) fuzz.minimize.grace * NANOS_PER_MILLI) {
+            // got all the events and did not crash
+            kill(inst->pid, SIGTERM);
+            inst->killed = 1;
+            inst->kill_time = now;
+        }
+        else if (!inst->killed && now - inst->start
+                 > (uint64_t) fuzz.campaign.timeout * NANOS_PER_SEC) {
+            kill(inst->pid, SIGKILL);
+            inst->killed = 1;
+            inst->kill_time = now;
+            ++fuzz.campaign.hangs;
+        }
+        else if (inst->killed && now - inst->kill_time > NANOS_PER_SEC) {
+            // does not react to SIGTERM
+            kill(inst->pid, SIGKILL);
+            inst->kill_time = now;
+        }
+    }
+
+    // the first client was spawned by wldbg
+    if (fuzz.campaign.execs == 0) {
+        wl_list_for_each(conn, &wldbg->connections, link) {
+            new_instance(conn->client.pid);
+        }
+    }
+
+    if (now - fuzz.campaign.last_report >= NANOS_PER_SEC) {
+        campaign_report();
+    }
+
+    if (fuzz.minimize.enabled) {
+        minimize_tick(wldbg);
+        return;
+    }
+
+    while (running_instances() < fuzz.campaign.jobs
+           && (fuzz.campaign.runs == 0 || fuzz.campaign.execs < fuzz.campaign.runs)) {
+        conn = wldbg_spawn_client(wldbg);
+        if (!conn) {
+            wldbg_error(wldbg);
+            return;
+        }
+        add_instance(conn->client.pid);
+    }
+
+    if (fuzz.campaign.runs && fuzz.campaign.execs >= fuzz.campaign.runs
+        && running_instances() == 0) {
+        campaign_report();
+        wldbg_exit(wldbg);
+    }
+}
+
+// defined at the end, next to the code sending the events
+static void fuzz_timer_fired(void *data);
+
+static int fuzz_setup(struct wldbg *wldbg, struct wldbg_pass *pass,
+                      int argc, const char *argv[], enum fuzz_mode mode) {
+    int campaign = mode != FUZZ;
+    const char *positional = NULL, *replay = NULL;
+
+    memset(&fuzz, 0, sizeof(fuzz));
+    wldbg_ids_map_init(&fuzz.connections);
+    wl_list_init(&fuzz.connections_list);
+    wl_array_init(&fuzz.corpus);
+
+    fuzz.delay_min = 10;
+    fuzz.delay_max = 1000;
+    fuzz.event_genarator = generate_consistent_event;
+
+    if (campaign) {
+        fuzz.campaign.enabled = 1;
+        fuzz.campaign.jobs = 4;
+        fuzz.campaign.events = 200;
+        fuzz.campaign.timeout = 10;
+        fuzz.delay_min = 1;
+        fuzz.delay_max = 20;
+    }
+
+    if (mode == FUZZ_MINIMIZE) {
+        fuzz.minimize.enabled = 1;
+        fuzz.minimize.grace = 500;
+        fuzz.minimize.signal = -1;
+        fuzz.campaign.events = UINT32_MAX;
+        fuzz.replay_only = 1;
+    }
+
+    // the last argument that is not an option is the seed (or the crash file)
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "block") == 0) {
+            fuzz.block_events = 1;
+        }
+        else if (strcmp(argv[i], "help") == 0) {
+            if (mode == FUZZ_MINIMIZE) {
+                print_minimize_usage(NULL);
+            }
+            else if (campaign) {
+                print_campaign_usage(NULL);
+            }
+            else {
+                print_usage(NULL);
+            }
+            wldbg_exit(wldbg);
+            return 0;
+        }
+        else if (strcmp(argv[i], "verbose") == 0) {
+            fuzz.verbose = 1;
+        }
+        else if (strncmp(argv[i], "program=", 8) == 0) {
+            fuzz.program_name = strdup(argv[i]+8);
+        }
+        else if (strncmp(argv[i], "delay_min=", 10) == 0) {
+            fuzz.delay_min = atoi(argv[i] + 10);
+        }
+        else if (strncmp(argv[i], "delay_max=", 10) == 0) {
+            fuzz.delay_max = atoi(argv[i] + 10);
+        }
+        else if (strcmp(argv[i], "sync") == 0) {
+            fuzz.sync.enabled = 1;
+        }
+        else if (strcmp(argv[i], "virtual_time") == 0) {
+            fuzz.virtual_time.enabled = 1;
+            fuzz.sync.enabled = 1;
+        }
+        else if (strcmp(argv[i], "inconsistent") == 0) {
+            fuzz.event_genarator = generate_inconsistent_event;
+        }
+        else if (strncmp(argv[i], "stream=", 7) == 0) {
+            fuzz.streams = atoi(argv[i] + 7);
+        }
+        else if (strncmp(argv[i], "mutate=", 7) == 0) {
+            double pct = atof(argv[i] + 7);
+            if (pct < 0) {
+                pct = 0;
+            }
+            else if (pct > 100) {
+                pct = 100;
+            }
+            fuzz.mutate_threshold = pct / 100 * ((uint64_t) UINT32_MAX + 1);
+            add_mutate_option(argv[i]);
+        }
+        else if (strncmp(argv[i], "mutate_mask=", 12) == 0) {
+            if (add_mutate_mask(argv[i] + 12) < 0) {
+                fprintf(stderr, "Out of memory\n");
+                return -1;
+            }
+            add_mutate_option(argv[i]);
+        }
+        else if (strcmp(argv[i], "no_events") == 0) {
+            fuzz.no_events = 1;
+            add_mutate_option(argv[i]);
+        }
+        else if (strcmp(argv[i], "feedback") == 0) {
+            fuzz.feedback = 1;
+        }
+        else if (strcmp(argv[i], "record") == 0) {
+            fuzz.record = 1;
+        }
+        else if (strncmp(argv[i], "corpus=", 7) == 0) {
+            fuzz.corpus_dir = strdup(argv[i] + 7);
+        }
+        else if (mode == FUZZ && strncmp(argv[i], "replay=", 7) == 0) {
+            replay = argv[i] + 7;
+        }
+        else if (mode == FUZZ_MINIMIZE && strncmp(argv[i], "grace=", 6) == 0) {
+            fuzz.minimize.grace = atoi(argv[i] + 6);
+        }
+        else if (mode == FUZZ_MINIMIZE && strncmp(argv[i], "signal=", 7) == 0) {
+            fuzz.minimize.signal = atoi(argv[i] + 7);
+        }
+        else if (campaign && strncmp(argv[i], "jobs=", 5) == 0) {
+            fuzz.campaign.jobs = atoi(argv[i] + 5);
+        }
+        else if (campaign && strncmp(argv[i], "events=", 7) == 0) {
+            fuzz.campaign.events = atoi(argv[i] + 7);
+        }
+        else if (campaign && strncmp(argv[i], "runs=", 5) == 0) {
+            fuzz.campaign.runs = atoi(argv[i] + 5);
+        }
+        else if (campaign && strncmp(argv[i], "timeout=", 8) == 0) {
+            fuzz.campaign.timeout = atoi(argv[i] + 8);
+        }
+        else if (campaign && strncmp(argv[i], "crashes=", 8) == 0) {
+            fuzz.campaign.crashes_dir = strdup(argv[i] + 8);
+        }
+        else if (i == argc - 1) {
+            positional = argv[i];
+        }
+        else {
+            printf("invalid option: %s\n", argv[i]);
+            wldbg_exit(wldbg);
+        }
+    }
+
+    if (!positional && !replay) {
+        if (mode == FUZZ_MINIMIZE) {
+            printf("fuzz-minimize needs a crash file\n");
+        }
+        else {
+            printf("fuzzer needs a random seed\n");
+        }
+        return -1;
+    }
+
+    if (fuzz.delay_max <= fuzz.delay_min) {
+        fuzz.delay_max = fuzz.delay_min + 1;
+    }
+
+    if (mode == FUZZ_MINIMIZE) {
+        fuzz.minimize.path = strdup(positional);
+        replay = positional;
+        positional = "0";
+        if (fuzz.minimize.signal < 0) {
+            fuzz.minimize.signal = read_crash_signal(fuzz.minimize.path);
+        }
+    }
+    else if (!positional) {
+        positional = "0";
+    }
+
+    if (replay) {
+        wl_array_init(&fuzz.replay_events);
+        if (load_events(replay, &fuzz.replay_events) < 0) {
+            return -1;
+        }
+        fuzz.replay_only = 1;
+    }
+
+    if (mode == FUZZ_MINIMIZE) {
+        // the minimized sequence starts as the whole one,
+        // check that it crashes first
+        wl_array_init(&fuzz.minimize.events);
+        if (wl_array_copy(&fuzz.minimize.events, &fuzz.replay_events) < 0) {
+            return -1;
+        }
+        fuzz.minimize.original = fuzz.minimize.events.size / sizeof(struct event);
+        if (fuzz.minimize.original == 0) {
+            fprintf(stderr, "No events in '%s'\n", fuzz.minimize.path);
+            return -1;
+        }
+        fuzz.minimize.verifying = 1;
+        fuzz.minimize.n = 1;
+        fuzz.minimize.tests = 1;
+        fuzz.minimize.round = 1;
+        fuzz.minimize.found = -1;
+    }
+
+    fuzz.seed = hash(positional) & 0xffffffff;
+    fuzz.seed_string = strdup(positional);
+
+    if (fuzz.record && !fuzz.corpus_dir) {
+        fprintf(stderr, "record needs corpus=<dir> to save the sessions to\n");
+        return -1;
+    }
+    if (fuzz.corpus_dir && load_corpus(fuzz.corpus_dir) < 0) {
+        return -1;
+    }
+
+    pass->user_data = wldbg;
+
+    if (campaign) {
+        if (wldbg->flags.server_mode) {
+            fprintf(stderr, "fuzz-campaign spawns the clients, it can't run in server mode\n");
+            return -1;
+        }
+
+        if (fuzz.campaign.jobs == 0) {
+            fuzz.campaign.jobs = 1;
+        }
+        else if (fuzz.campaign.jobs > MAX_JOBS) {
+            fuzz.campaign.jobs = MAX_JOBS;
+        }
+
+        if (!fuzz.campaign.crashes_dir) {
+            fuzz.campaign.crashes_dir = strdup("fuzz-crashes");
+        }
+        if (mode == FUZZ_CAMPAIGN && mkdir(fuzz.campaign.crashes_dir, 0755) < 0 && errno != EEXIST) {
+            fprintf(stderr, "Failed creating '%s': %s\n",
+                    fuzz.campaign.crashes_dir, strerror(errno));
+            return -1;
+        }
+
+        // with the user_data, so that they go with the pass
+        if (wldbg_add_exit_callback(wldbg, campaign_client_exited, pass->user_data) < 0
+            || wldbg_add_report_callback(wldbg, campaign_report_callback, pass->user_data) < 0) {
+            return -1;
+        }
+
+        // we spawn new clients when the old ones exit
+        wldbg->flags.keep_alive = 1;
+        fuzz.campaign.start = wldbg_get_time();
+        fuzz.campaign.last_report = fuzz.campaign.start;
+    }
+
+    // disarmed until there is something to do,
+    // the campaign starts its clients right away
+    fuzz.timer = wldbg_add_timer(wldbg, 0, 0, fuzz_timer_fired, wldbg);
+    if (!fuzz.timer) {
+        return -1;
+    }
+    if (campaign) {
+        fuzz_schedule(wldbg_get_time());
+    }
+
+    return 0;
+}
+
+static void fuzz_destroy(void *user_data);
+
+// all fuzz passes share the state above, so refuse a second one
+// (loaded by a pipeline rule for every connection or by 'load')
+static int fuzz_init_common(struct wldbg *wldbg, struct wldbg_pass *pass,
+                            int argc, const char *argv[], enum fuzz_mode mode) {
+    if (fuzz.loaded) {
+        fprintf(stderr, "%s: the fuzzer is already running, "
+                "it can be loaded only once\n", argv[0]);
+        return -1;
+    }
+
+    if (fuzz_setup(wldbg, pass, argc, argv, mode) < 0) {
+        // the pass is not destroyed when its init fails
+        wldbg_remove_report_callbacks(wldbg, wldbg);
+        wldbg_remove_exit_callbacks(wldbg, wldbg);
+        fuzz_destroy(wldbg);
+        pass->user_data = NULL;
+        return -1;
+    }
+
+    fuzz.loaded = 1;
+    return 0;
+}
+
+static int fuzz_init(struct wldbg *wldbg, struct wldbg_pass *pass, int argc, const char *argv[]) {
+    return fuzz_init_common(wldbg, pass, argc, argv, FUZZ);
+}
+
+static int campaign_init(struct wldbg *wldbg, struct wldbg_pass *pass,
+                         int argc, const char *argv[]) {
+    return fuzz_init_common(wldbg, pass, argc, argv, FUZZ_CAMPAIGN);
+}
+
+static int minimize_init(struct wldbg *wldbg, struct wldbg_pass *pass,
+                         int argc, const char *argv[]) {
+    return fuzz_init_common(wldbg, pass, argc, argv, FUZZ_MINIMIZE);
+}
+
+// save real input events as our events, so they can be used as the corpus
+static void record_real_event(struct fuzz_connection *fc, int pointer,
+                              uint32_t opcode, uint32_t *buf) {
+    struct event *event;
+    uint64_t now = wldbg_get_time();
+    uint64_t delay = fc->last_real_event ? now - fc->last_real_event : 0;
+    float width = fc->buffer_width ? fc->buffer_width : 1;
+    float height = fc->buffer_height ? fc->buffer_height : 1;
+
+    if (pointer && opcode > 3) {
+        return;
+    }
+
+    event = wl_array_add(&fc->recorded, sizeof *event);
+    if (!event) {
+        return;
+    }
+    memset(event, 0, sizeof *event);
+
+    if (!pointer) {
+        event->type = KEY;
+        event->key.key_code = buf[4];
+        event->key.pressed = buf[5];
+    }
+    else if (opcode == 0) {
+        event->type = MOUSE_ENTER;
+        event->mouse_enter.x = wl_fixed_to_double(buf[4]) / width;
+        event->mouse_enter.y = wl_fixed_to_double(buf[5]) / height;
+    }
+    else if (opcode == 1) {
+        event->type = MOUSE_LEAVE;
+    }
+    else if (opcode == 2) {
+        event->type = MOUSE_MOVE;
+        event->mouse_move.x = wl_fixed_to_double(buf[3]) / width;
+        event->mouse_move.y = wl_fixed_to_double(buf[4]) / height;
+    }
+    else {
+        event->type = MOUSE_BUTTON;
+        event->mouse_button.button_code = buf[4];
+        event->mouse_button.pressed = buf[5];
     }
-}
 
-static void generate_inconsistent_event() {
-    unsigned long millis = (rand() % (fuzz.delay_max - fuzz.delay_min)) + fuzz.delay_min;
-    fuzz.next_event.delay.tv_nsec = (millis % MILLIS_PER_SEC) * NANOS_PER_MILLI;
-    fuzz.next_event.delay.tv_sec = millis / MILLIS_PER_SEC;
-    switch (rand()%4) {
-        case 0:
-            fuzz.next_event.type = KEY;
-            uint32_t key_idx = rand() % (sizeof(keys)/sizeof(*keys));
-            fuzz.next_event.key.key_code = keys[key_idx];
-            fuzz.next_event.key.pressed = rand() % 2;
-            break;
-        case 1:
-            if (rand() % 2) {
-                fuzz.next_event.type = MOUSE_LEAVE;
-            }
-            else {
-                fuzz.next_event.type = MOUSE_ENTER;
-                fuzz.next_event.mouse_enter.x = ((float)rand()) / (float)RAND_MAX;
-                fuzz.next_event.mouse_enter.y = ((float)rand()) / (float)RAND_MAX;
-            }
-            break;
-        case 2:
-            fuzz.next_event.type = MOUSE_MOVE;
-            fuzz.next_event.mouse_move.x = ((float)rand()) / (float)RAND_MAX;
-            fuzz.next_event.mouse_move.y = ((float)rand()) / (float)RAND_MAX;
-            break;
-        case 3:
-            fuzz.next_event.type = MOUSE_BUTTON;
-            uint32_t button_idx = rand() % (sizeof(buttons)/sizeof(*buttons));
-            fuzz.next_event.mouse_button.button_code = buttons[button_idx];
-            fuzz.next_event.mouse_button.pressed = rand() % 2;
-            break;
-    }
+    event->delay.tv_sec = delay / NANOS_PER_SEC;
+    event->delay.tv_nsec = delay % NANOS_PER_SEC;
+    fc->last_real_event = now;
 }
 
-static int fuzz_init(struct wldbg *wldbg, struct wldbg_pass *pass, int argc, const char *argv[]) {
-    if (argc < 2) {
-        printf("fuzzer needs a random seed\n");
+// send wl_display.sync to the server as if the client sent it. The
+// server creates and destroys the callback before it reads the next
+// request, so the next free id of the client can be used for it
+static int send_barrier(struct wldbg_connection *conn, struct fuzz_connection *fc) {
+    uint32_t buffer[3];
+
+    if (!conn->resolved_objects) {
         return -1;
     }
-    wldbg->flags.fuzz_mode = 1;
 
-    memset(&fuzz, 0, sizeof(fuzz));
+    fc->barrier_id = conn->resolved_objects->objects.client_objects.count;
+    fc->barrier_busy = 0;
+    ++fuzz.sync.round_trips;
 
-    fuzz.delay_min = 10;
-    fuzz.delay_max = 1000;
-    fuzz.event_genarator = generate_consistent_event;
+    buffer[0] = 1;
+    buffer[1] = (sizeof buffer << 16) | 0;
+    buffer[2] = fc->barrier_id;
 
-    for (int i = 1; i < argc - 1; ++i) {
-        if (strcmp(argv[i], "block") == 0) {
-            fuzz.block_events = 1;
-        }
-        else if (strcmp(argv[i], "help") == 0) {
-            print_usage(NULL);
-            wldbg_exit(wldbg);
-            return 0;
-        }
-        else if (strcmp(argv[i], "verbose") == 0) {
-            fuzz.verbose = 1;
-        }
-        else if (strncmp(argv[i], "program=", 8) == 0) {
-            fuzz.program_name = strdup(argv[i]+8);
-        }
-        else if (strncmp(argv[i], "delay_min=", 10) == 0) {
-            fuzz.delay_min = atoi(argv[i] + 10);
-        }
-        else if (strncmp(argv[i], "delay_max=", 10) == 0) {
-            fuzz.delay_max = atoi(argv[i] + 10);
-        }
-        else if (strcmp(argv[i], "inconsistent") == 0) {
-            fuzz.event_genarator = generate_inconsistent_event;
-        }
-        else {
-            printf("invalid option: %s\n", argv[i]);
-            wldbg_exit(wldbg);
-        }
+    if (wl_connection_write(conn->server.connection, buffer, sizeof buffer) < 0
+        || wldbg_connection_flush(conn, conn->server.connection) < 0) {
+        perror("Sending wl_display.sync");
+        return -1;
+    }
+    return 0;
+}
+
+// the events we sent that the client did not read yet
+static int client_unread(struct wldbg_connection *conn) {
+    int unread = 0;
+
+    if (ioctl(conn->client.fd, SIOCOUTQ, &unread) < 0) {
+        return 0;
     }
+    return unread;
+}
+
+// hide the reply to our wl_display.sync from the client,
+// returns 1 if the message was the reply
+static int barrier_reply(struct wldbg_connection *conn, struct fuzz_connection *fc,
+                         uint32_t *buf) {
+    uint32_t opcode = buf[1] & 0xffff;
+    uint64_t now, time;
 
-    unsigned int seed = hash(argv[argc-1]) & 0xffffffff;
-    srand(seed);
+    // wl_callback.done
+    if (buf[0] == fc->barrier_id) {
+        return 1;
+    }
+    // wl_display.delete_id comes after done, the round trip is over
+    if (buf[0] != 1 || opcode != 1 || buf[2] != fc->barrier_id) {
+        return 0;
+    }
 
-    fuzz.event_genarator();
+    fc->barrier_id = 0;
+    if (fc->barrier_busy || client_unread(conn) > 0) {
+        send_barrier(conn, fc);
+        return 1;
+    }
 
-    pass->user_data = wldbg;
-    return 0;
+    fc->idle = 1;
+    if (fc->event_time) {
+        now = wldbg_get_time();
+        time = now - fc->event_time;
+        fuzz.sync.time += time;
+        if (time > fuzz.sync.max) {
+            fuzz.sync.max = time;
+        }
+        ++fuzz.sync.events;
+        fc->event_time = 0;
+    }
+    fuzz_schedule(wldbg_get_time());
+    return 1;
 }
 
 static int fuzz_in(void *user_data, struct wldbg_message *message) {
     struct wldbg* wldbg = user_data;
     struct wldbg_resolved_message rm;
-    if (!wldbg_resolve_message(message, &rm)) {
-        return PASS_NEXT;
+    struct fuzz_connection *fc;
+    uint32_t *serial = NULL;
+    uint32_t *buf = message->data;
+    int sync_done = 0;
+
+    // the reply is for an object the client does not know,
+    // so it must be hidden before resolving the message
+    fc = wldbg_ids_map_get(&fuzz.connections, message->connection->id);
+    if (fc && fc->barrier_id && barrier_reply(message->connection, fc, buf)) {
+        wldbg->flags.skip = 1;
+        return PASS_STOP;
     }
 
-    if (fuzz.program_name) {
-        if (strcmp(message->connection->client.program, fuzz.program_name) == 0) {
-            fuzz.conn = message->connection;
-        }
-    }
-    else {
-        fuzz.conn = message->connection;
+    if (!wldbg_resolve_message(message, &rm)) {
+        return PASS_NEXT;
     }
 
-    if (message->connection != fuzz.conn) {
+    fc = get_fuzz_connection(message->connection);
+    if (!fc) {
         return PASS_NEXT;
     }
 
-    uint32_t *buf = message->data;
     uint32_t opcode = buf[1] & 0xffff;
 
-    if (INTERFACE_MATCHES("wl_keyboard")) {
+    if (INTERFACE_MATCHES("wl_display")) {
+        if (opcode == 1) { // delete_id
+            remember(fc->deleted_ids, &fc->deleted_ids_num, buf[2]);
+        }
+    }
+    else if (INTERFACE_MATCHES("wl_keyboard")) {
         if (opcode == 2) {
             wldbg->flags.skip = 1;
             return PASS_STOP;
@@ -334,6 +2103,9 @@ static int fuzz_in(void *user_data, struct wldbg_message *message) {
                 wldbg->flags.skip = 1;
                 return PASS_STOP;
             }
+            if (fuzz.record) {
+                record_real_event(fc, 0, opcode, buf);
+            }
         }
     }
     else if (INTERFACE_MATCHES("wl_pointer")) {
@@ -341,121 +2113,146 @@ static int fuzz_in(void *user_data, struct wldbg_message *message) {
             wldbg->flags.skip = 1;
             return PASS_STOP;
         }
+        if (fuzz.record) {
+            record_real_event(fc, 1, opcode, buf);
+        }
     }
-    else if (buf[0] == fuzz.sync_ids[fuzz.sync_id_start]) {
+    else if (buf[0] == fc->sync_ids[fc->sync_id_start]) {
         // callback from display sync
         // response is the server's current serial number
-        if (fuzz.serial_number) {
-            buf[2] = ++(fuzz.serial_number);
+        if (fc->serial_number) {
+            buf[2] = ++(fc->serial_number);
         }
         else {
-            fuzz.serial_number = buf[2];
+            fc->serial_number = buf[2];
         }
-        ++(fuzz.sync_id_start);
-        fuzz.sync_id_start %= NUM_SYNC_IDS;
+        ++(fc->sync_id_start);
+        fc->sync_id_start %= NUM_SYNC_IDS;
+        sync_done = 1;
     }
-    else if (buf[0] == fuzz.frame_id && fuzz.frame_id != 0) {
-        fuzz.frame_id = 0;
-        clock_gettime(CLOCK_MONOTONIC, &(fuzz.timestamp_start));
+    else if (buf[0] == fc->frame_id && fc->frame_id != 0) {
+        fc->frame_id = 0;
+        clock_gettime(CLOCK_MONOTONIC, &(fc->timestamp_start));
         long millis = buf[2];
         long nanos = (millis % MILLIS_PER_SEC) * NANOS_PER_MILLI;
         long secs = millis / MILLIS_PER_SEC;
-        if (nanos > fuzz.timestamp_start.tv_nsec) {
-            fuzz.timestamp_start.tv_nsec += NANOS_PER_SEC;
-            fuzz.timestamp_start.tv_sec -= 1;
+        if (nanos > fc->timestamp_start.tv_nsec) {
+            fc->timestamp_start.tv_nsec += NANOS_PER_SEC;
+            fc->timestamp_start.tv_sec -= 1;
         }
-        fuzz.timestamp_start.tv_nsec -= nanos;
-        fuzz.timestamp_start.tv_sec -= secs;
+        fc->timestamp_start.tv_nsec -= nanos;
+        fc->timestamp_start.tv_sec -= secs;
     }
 
     for (int i = 0; i < sizeof(server_serials)/sizeof(struct serial_message); ++i) {
         if (INTERFACE_MATCHES(server_serials[i].name)) {
             if (opcode == server_serials[i].opcode) {
-                if (fuzz.serial_number) {
-                    buf[server_serials[i].serial_index] = ++(fuzz.serial_number);
+                if (fc->serial_number) {
+                    buf[server_serials[i].serial_index] = ++(fc->serial_number);
                 }
                 else {
-                    fuzz.serial_number = buf[server_serials[i].serial_index];
+                    fc->serial_number = buf[server_serials[i].serial_index];
                 }
+                serial = &buf[server_serials[i].serial_index];
             }
         }
     }
 
+    for (int i = 0; fuzz.virtual_time.enabled && !sync_done
+                    && i < sizeof(server_times)/sizeof(struct time_message); ++i) {
+        if (INTERFACE_MATCHES(server_times[i].name) && opcode == server_times[i].opcode) {
+            buf[server_times[i].time_index] = fc->virtual_time;
+        }
+    }
+
+    if (fuzz.mutate_threshold) {
+        mutate_message(fc, &rm, serial);
+    }
+    if (serial) {
+        remember(fc->serials, &fc->serials_num, *serial);
+    }
+
     return PASS_NEXT;
 }
 
 static int fuzz_out(void *user_data, struct wldbg_message *message) {
     struct wldbg_resolved_message rm;
+    struct fuzz_connection *fc;
     if (!wldbg_resolve_message(message, &rm)) {
         return PASS_NEXT;
     }
 
-    if (fuzz.program_name) {
-        if (strcmp(message->connection->client.program, fuzz.program_name) == 0) {
-            fuzz.conn = message->connection;
-        }
-    }
-    else {
-        fuzz.conn = message->connection;
-    }
-
-    if (message->connection != fuzz.conn) {
+    fc = get_fuzz_connection(message->connection);
+    if (!fc) {
         return PASS_NEXT;
     }
 
     uint32_t *buf = message->data;
     uint32_t opcode = buf[1] & 0xffff;
 
+    if (fc->barrier_id) {
+        fc->barrier_busy = 1;
+    }
+
+    // the interfaces live as long as wldbg, so their address
+    // identifies them and we don't need to hash the names
+    if (fc->response_pending) {
+        fc->response ^= (uintptr_t) rm.wl_interface + opcode;
+        fc->response *= 0x100000001b3ULL;
+    }
+
     if (INTERFACE_MATCHES("wl_compositor")) {
-        if (opcode == 0 && fuzz.surface_id == 0) {
-            fuzz.surface_id = buf[2];
+        if (opcode == 0 && fc->surface_id == 0) {
+            fc->surface_id = buf[2];
         }
     }
     else if (INTERFACE_MATCHES("wl_seat")) {
         if (opcode == 0) {
-            fuzz.pointer_id = buf[2];
+            fc->pointer_id = buf[2];
         }
         else if (opcode == 1) {
-            fuzz.keyboard_id = buf[2];
+            fc->keyboard_id = buf[2];
         }
     }
     else if (INTERFACE_MATCHES("wl_surface")) {
         if (opcode == 2) {
-            fuzz.had_first_damage = 1;
+            fc->had_first_damage = 1;
         }
         else if (opcode == 3) { // frame
-            fuzz.frame_id = buf[2];
+            fc->frame_id = buf[2];
         }
-        else if (opcode == 6 && fuzz.had_first_damage) {
-            fuzz.displayed = 1;
+        else if (opcode == 6 && fc->had_first_damage) {
+            fc->displayed = 1;
         }
     }
     else if (INTERFACE_MATCHES("wl_shm_pool")) {
-        fuzz.buffer_width = buf[4];
-        fuzz.buffer_height = buf[5];
+        fc->buffer_width = buf[4];
+        fc->buffer_height = buf[5];
     }
     else if (INTERFACE_MATCHES("wl_display")) {
         if (opcode == 0) {
-            fuzz.sync_ids[fuzz.sync_id_end++] = buf[2];
-            fuzz.sync_id_end %= NUM_SYNC_IDS;
+            fc->sync_ids[fc->sync_id_end++] = buf[2];
+            fc->sync_id_end %= NUM_SYNC_IDS;
         }
     }
 
-    if (!(fuzz.ready_for_input) && fuzz.pointer_id && fuzz.keyboard_id && fuzz.displayed && fuzz.conn) {
-        fuzz.ready_for_input = 1;
+    if (!(fc->ready_for_input) && fc->pointer_id && fc->keyboard_id && fc->displayed) {
+        fc->ready_for_input = 1;
         //wait 100 miliseconds to make sure everything is ready.
-        clock_gettime(CLOCK_MONOTONIC, &(fuzz.last_msg_ts ));
-        fuzz.delay.tv_nsec = 100 * NANOS_PER_MILLI;
+        fc->delay.tv_sec = 0;
+        fc->delay.tv_nsec = 100 * NANOS_PER_MILLI;
+        fc->next_time = wldbg_get_time() + 100 * NANOS_PER_MILLI;
+        fuzz_schedule(fc->next_time);
     }
 
     for (int i = 0; i < sizeof(client_serials)/sizeof(struct serial_message); ++i) {
         if (INTERFACE_MATCHES(client_serials[i].name)) {
             if (opcode == client_serials[i].opcode) {
-                if (fuzz.serial_number) {
-                    buf[client_serials[i].serial_index] = ++(fuzz.serial_number);
+                if (fc->serial_number) {
+                    buf[client_serials[i].serial_index] = ++(fc->serial_number);
                 }
                 else {
-                    fuzz.serial_number = buf[client_serials[i].serial_index];
+                    fc->serial_number = buf[client_serials[i].serial_index];
                 }
             }
         }
@@ -465,9 +2262,76 @@ static int fuzz_out(void *user_data, struct wldbg_message *message) {
 }
 
 static void fuzz_destroy(void *user_data) {
+    struct wldbg *wldbg = user_data;
+    struct fuzz_connection *fc, *tmp;
+
+    wl_list_for_each_safe(fc, tmp, &fuzz.connections_list, link) {
+        destroy_fuzz_connection(fc);
+    }
+    wldbg_ids_map_release(&fuzz.connections);
+
     if (fuzz.program_name) {
         free(fuzz.program_name);
     }
+    free(fuzz.seed_string);
+    free(fuzz.campaign.crashes_dir);
+    free(fuzz.minimize.path);
+    wl_array_release(&fuzz.minimize.events);
+    wl_array_release(&fuzz.replay_events);
+    for (uint32_t i = 0; i < fuzz.mutate_masks_num; ++i) {
+        free(fuzz.mutate_masks[i].interface);
+    }
+    free(fuzz.mutate_masks);
+
+    if (fuzz.mutations) {
+        printf("Mutated %lu events\n", (unsigned long) fuzz.mutations);
+    }
+
+    if (fuzz.sync.enabled && fuzz.sync.events > 0) {
+        printf("Client was idle after %lu events in %.3f ms on average (max %.3f ms),\n"
+               "%.0f events/s, %lu round trips, %lu events sent to a busy client\n",
+               (unsigned long) fuzz.sync.events,
+               (double) fuzz.sync.time / fuzz.sync.events / NANOS_PER_MILLI,
+               (double) fuzz.sync.max / NANOS_PER_MILLI,
+               (double) fuzz.sync.events * NANOS_PER_SEC / fuzz.sync.time,
+               (unsigned long) fuzz.sync.round_trips,
+               (unsigned long) fuzz.sync.timeouts);
+    }
+
+    if (fuzz.virtual_time.enabled && fuzz.virtual_time.real > 0) {
+        printf("Virtual time %.3f s passed in %.3f s (%.1fx)\n",
+               (double) fuzz.virtual_time.virtual_ms / MILLIS_PER_SEC,
+               (double) fuzz.virtual_time.real / NANOS_PER_SEC,
+               (double) fuzz.virtual_time.virtual_ms * NANOS_PER_MILLI
+               / fuzz.virtual_time.real);
+    }
+
+    if (fuzz.feedback) {
+        printf("Corpus has %lu sequences, %u new behaviours in %u responses\n",
+               (unsigned long) (fuzz.corpus.size / sizeof(struct wl_array)),
+               fuzz.new_behaviours, fuzz.coverage.count);
+    }
+    struct wl_array *entry;
+    wl_array_for_each(entry, &fuzz.corpus) {
+        wl_array_release(entry);
+    }
+    wl_array_release(&fuzz.corpus);
+    free(fuzz.coverage.slots);
+    free(fuzz.corpus_dir);
+
+    // the pass may be removed while wldbg is running,
+    // otherwise wldbg frees the timer itself
+    if (wldbg) {
+        if (fuzz.timer && wldbg->flags.running) {
+            wldbg_remove_timer(wldbg, fuzz.timer);
+        }
+        if (fuzz.campaign.enabled) {
+            wldbg->flags.keep_alive = 0;
+        }
+    }
+
+    // free for the next fuzz pass
+    memset(&fuzz, 0, sizeof(fuzz));
 }
 
 struct pass *create_fuzz_pass() {
@@ -487,15 +2351,48 @@ struct pass *create_fuzz_pass() {
     return pass;
 }
 
+struct pass *create_fuzz_minimize_pass() {
+    struct pass *pass;
+
+    pass = alloc_pass("fuzz-minimize");
+    if (!pass)
+        return NULL;
+
+    pass->wldbg_pass.init = minimize_init;
+    pass->wldbg_pass.destroy = fuzz_destroy;
+    pass->wldbg_pass.server_pass = fuzz_in;
+    pass->wldbg_pass.client_pass = fuzz_out;
+    pass->wldbg_pass.help = print_minimize_usage;
+    pass->wldbg_pass.description = "Minimize the events that crash a client";
+
+    return pass;
+}
+
+struct pass *create_fuzz_campaign_pass() {
+    struct pass *pass;
+
+    pass = alloc_pass("fuzz-campaign");
+    if (!pass)
+        return NULL;
+
+    pass->wldbg_pass.init = campaign_init;
+    pass->wldbg_pass.destroy = fuzz_destroy;
+    pass->wldbg_pass.server_pass = fuzz_in;
+    pass->wldbg_pass.client_pass = fuzz_out;
+    pass->wldbg_pass.help = print_campaign_usage;
+    pass->wldbg_pass.description = "Run many fuzzed clients in parallel and save crashes";
+
+    return pass;
+}
+
 static int wldbg_fuzz_send(struct wldbg_message *msg) {
-    msg->connection = fuzz.conn;
     struct wl_connection *conn = msg->connection->client.connection;
 
     if (wl_connection_write(conn, msg->data, msg->size) < 0) {
         perror("Writing message to connection");
         return -1;
     }
-    if (wl_connection_flush(conn) < 0) {
+    if (wldbg_connection_flush(msg->connection, conn) < 0) {
         perror("wl_connection_flush");
         return -1;
     }
@@ -505,199 +2402,316 @@ static int wldbg_fuzz_send(struct wldbg_message *msg) {
     return 0;
 }
 
-static uint32_t get_timestamp() {
+static int wldbg_fuzz_send_buffer(struct wldbg_connection *conn, uint32_t *buffer, uint32_t size) {
+    struct wldbg_message send_message;
+
+    buffer[1] |= size << 16;
+
+    send_message.connection = conn;
+    send_message.data = buffer;
+    send_message.size = size;
+    send_message.from = SERVER;
+
+    return wldbg_fuzz_send(&send_message);
+}
+
+static uint32_t get_real_timestamp(struct fuzz_connection *fc) {
     struct timespec ts;
     clock_gettime(CLOCK_MONOTONIC, &ts);
-    // compute millis in ts - fuzz.timestamp_start
+    // compute millis in ts - fc->timestamp_start
     long nanos, secs;
 
-    if (ts.tv_nsec < fuzz.timestamp_start.tv_nsec) {
+    if (ts.tv_nsec < fc->timestamp_start.tv_nsec) {
         ts.tv_nsec += NANOS_PER_SEC;
         ts.tv_sec -= 1;
     }
 
-    nanos = ts.tv_nsec - fuzz.timestamp_start.tv_nsec;
-    secs = ts.tv_sec - fuzz.timestamp_start.tv_sec;
+    nanos = ts.tv_nsec - fc->timestamp_start.tv_nsec;
+    secs = ts.tv_sec - fc->timestamp_start.tv_sec;
 
     return (secs * MILLIS_PER_SEC) + (nanos / NANOS_PER_MILLI);
 
 }
 
-static int wldbg_fuzz_send_keyboard(struct wldbg *wldbg, unsigned int key, unsigned char pressed) {
-    struct wldbg_message send_message;
+// replayed events have the timestamps they had when they were
+// recorded, even though we send them as fast as we can
+static uint32_t get_timestamp(struct fuzz_connection *fc) {
+    if (fuzz.replay_only || fuzz.virtual_time.enabled) {
+        return fc->virtual_time;
+    }
+    return get_real_timestamp(fc);
+}
+
+static int wldbg_fuzz_send_keyboard(struct wldbg_connection *conn, struct fuzz_connection *fc,
+                                    unsigned int key, unsigned char pressed) {
     uint32_t buffer[6];
-    uint32_t size = sizeof(buffer);
-    buffer[0] = fuzz.keyboard_id;
-    buffer[1] = (size << 16) | 3;
-    buffer[2] = ++(fuzz.serial_number);
-    buffer[3] = get_timestamp();
+    buffer[0] = fc->keyboard_id;
+    buffer[1] = 3;
+    buffer[2] = ++(fc->serial_number);
+    buffer[3] = get_timestamp(fc);
     buffer[4] = key;
     buffer[5] = pressed;
 
-    send_message.connection = wldbg->message.connection;
-    send_message.data = buffer;
-    send_message.size = size;
-    send_message.from = SERVER;
-
-    return wldbg_fuzz_send(&send_message);
+    return wldbg_fuzz_send_buffer(conn, buffer, sizeof(buffer));
 }
 
-static int wldbg_fuzz_send_button(struct wldbg *wldbg, unsigned int button, unsigned char pressed) {
-    struct wldbg_message send_message;
+static int wldbg_fuzz_send_button(struct wldbg_connection *conn, struct fuzz_connection *fc,
+                                  unsigned int button, unsigned char pressed) {
     uint32_t buffer[6];
-    uint32_t size = sizeof(buffer);
-    buffer[0] = fuzz.pointer_id;
-    buffer[1] = (size << 16) | 3;
-    buffer[2] = ++(fuzz.serial_number);
-    buffer[3] = get_timestamp();
+    buffer[0] = fc->pointer_id;
+    buffer[1] = 3;
+    buffer[2] = ++(fc->serial_number);
+    buffer[3] = get_timestamp(fc);
     buffer[4] = button;
     buffer[5] = pressed;
 
-    send_message.connection = wldbg->message.connection;
-    send_message.data = buffer;
-    send_message.size = size;
-    send_message.from = SERVER;
-
-    return wldbg_fuzz_send(&send_message);
+    return wldbg_fuzz_send_buffer(conn, buffer, sizeof(buffer));
 }
 
-static int wldbg_fuzz_end_pointer_frame(struct wldbg* wldbg) {
-    struct wldbg_message send_message;
+static int wldbg_fuzz_end_pointer_frame(struct wldbg_connection *conn, struct fuzz_connection *fc) {
     uint32_t buffer[2];
-    uint32_t size = sizeof(buffer);
-    buffer[0] = fuzz.pointer_id;
-    buffer[1] = (size << 16) | 5;
+    buffer[0] = fc->pointer_id;
+    buffer[1] = 5;
 
-    send_message.connection = wldbg->message.connection;
-    send_message.data = buffer;
-    send_message.size = size;
-    send_message.from = SERVER;
-
-    return wldbg_fuzz_send(&send_message);
+    return wldbg_fuzz_send_buffer(conn, buffer, sizeof(buffer));
 }
 
-static int wldbg_fuzz_pointer_enter(struct wldbg* wldbg, float x, float y) {
-    uint32_t real_x = fuzz.buffer_width * x;
-    uint32_t real_y = fuzz.buffer_height * y;
-    struct wldbg_message send_message;
+static int wldbg_fuzz_pointer_enter(struct wldbg_connection *conn, struct fuzz_connection *fc,
+                                    float x, float y) {
+    uint32_t real_x = fc->buffer_width * x;
+    uint32_t real_y = fc->buffer_height * y;
     uint32_t buffer[6];
-    uint32_t size = sizeof(buffer);
-    buffer[0] = fuzz.pointer_id;
-    buffer[1] = (size << 16) | 0;
-    buffer[2] = ++(fuzz.serial_number);
-    buffer[3] = fuzz.surface_id;
+    buffer[0] = fc->pointer_id;
+    buffer[1] = 0;
+    buffer[2] = ++(fc->serial_number);
+    buffer[3] = fc->surface_id;
     buffer[4] = real_x << 8;
     buffer[5] = real_y << 8;
 
-    send_message.connection = wldbg->message.connection;
-    send_message.data = buffer;
-    send_message.size = size;
-    send_message.from = SERVER;
-
-    return wldbg_fuzz_send(&send_message);
+    return wldbg_fuzz_send_buffer(conn, buffer, sizeof(buffer));
 }
 
-static int wldbg_fuzz_pointer_leave(struct wldbg* wldbg) {
-    struct wldbg_message send_message;
+static int wldbg_fuzz_pointer_leave(struct wldbg_connection *conn, struct fuzz_connection *fc) {
     uint32_t buffer[4];
-    uint32_t size = sizeof(buffer);
-    buffer[0] = fuzz.pointer_id;
-    buffer[1] = (size << 16) | 1;
-    buffer[2] = ++(fuzz.serial_number);
-    buffer[3] = fuzz.surface_id;
-
-    send_message.connection = wldbg->message.connection;
-    send_message.data = buffer;
-    send_message.size = size;
-    send_message.from = SERVER;
+    buffer[0] = fc->pointer_id;
+    buffer[1] = 1;
+    buffer[2] = ++(fc->serial_number);
+    buffer[3] = fc->surface_id;
 
-    return wldbg_fuzz_send(&send_message);
+    return wldbg_fuzz_send_buffer(conn, buffer, sizeof(buffer));
 }
 
-static int wldbg_fuzz_pointer_motion(struct wldbg* wldbg, float x, float y) {
-    uint32_t real_x = fuzz.buffer_width * x;
-    uint32_t real_y = fuzz.buffer_height * y;
-    struct wldbg_message send_message;
+static int wldbg_fuzz_pointer_motion(struct wldbg_connection *conn, struct fuzz_connection *fc,
+                                     float x, float y) {
+    uint32_t real_x = fc->buffer_width * x;
+    uint32_t real_y = fc->buffer_height * y;
     uint32_t buffer[5];
-    uint32_t size = sizeof(buffer);
-    buffer[0] = fuzz.pointer_id;
-    buffer[1] = (size << 16) | 2;
-    buffer[2] = get_timestamp();
+    buffer[0] = fc->pointer_id;
+    buffer[1] = 2;
+    buffer[2] = get_timestamp(fc);
     buffer[3] = real_x << 8;
     buffer[4] = real_y << 8;
 
-    send_message.connection = wldbg->message.connection;
-    send_message.data = buffer;
-    send_message.size = size;
-    send_message.from = SERVER;
-
-    return wldbg_fuzz_send(&send_message);
+    return wldbg_fuzz_send_buffer(conn, buffer, sizeof(buffer));
 }
 
-int wldbg_fuzz_send_next(struct wldbg *wldbg) {
-    if (fuzz.ready_for_input) {
-        struct timespec ts;
-        clock_gettime(CLOCK_MONOTONIC, &ts);
+static int fuzz_send_event(struct wldbg_connection *conn, struct fuzz_connection *fc) {
+    uint64_t now = wldbg_get_time();
 
-        //TODO: this comparison is still wrong
-        if ((fuzz.delay.tv_sec + fuzz.last_msg_ts.tv_sec) > ts.tv_sec) {
-            return 0;
-        }
-        else if ((fuzz.delay.tv_sec + fuzz.last_msg_ts.tv_sec) == ts.tv_sec){
-            if ((fuzz.delay.tv_nsec + fuzz.last_msg_ts.tv_nsec) > ts.tv_nsec){
-                return 0;
+    if (now < fc->next_time && !(fuzz.sync.enabled && fc->idle)) {
+        return 0;
+    }
+
+    if (fuzz.sync.enabled) {
+        if (!fc->idle) {
+            if (fc->events_sent == 0 && !fc->barrier_id) {
+                // start with an idle client
+                fc->next_time = now + (uint64_t) fuzz.delay_max * NANOS_PER_MILLI;
+                return send_barrier(conn, fc);
             }
+            ++fuzz.sync.timeouts;
+        }
+        // what we waited, for the recorded events
+        if (!fuzz.virtual_time.enabled) {
+            uint64_t waited = fc->last_sent ? now - fc->last_sent : 0;
+            fc->delay.tv_sec = waited / NANOS_PER_SEC;
+            fc->delay.tv_nsec = waited % NANOS_PER_SEC;
         }
+    }
 
-        struct event* event = &(fuzz.next_event);
-        switch (event->type) {
-            case KEY:
-                uint32_t pressed = event->key.pressed;
-                uint32_t key_code = event->key.key_code;
-                if (wldbg_fuzz_send_keyboard(wldbg, key_code, pressed)) {
-                    return -1;
-                }
-                break;
-            case MOUSE_BUTTON:
-                pressed = event->mouse_button.pressed;
-                uint32_t button_code = event->mouse_button.button_code;
-                if (wldbg_fuzz_send_button(wldbg, button_code, pressed)) {
-                    return -1;
-                }
-                if (wldbg_fuzz_end_pointer_frame(wldbg)) {
-                    return -1;
-                }
-                break;
-            case MOUSE_MOVE:
-                if (wldbg_fuzz_pointer_motion(wldbg, event->mouse_move.x, event->mouse_move.y)){
-                    return 1;
-                }
-                if (wldbg_fuzz_end_pointer_frame(wldbg)) {
-                    return -1;
-                }
-                break;
-            case MOUSE_ENTER:
-                if (wldbg_fuzz_pointer_enter(wldbg, event->mouse_enter.x, event->mouse_enter.y)) {
-                    return -1;
-                }
-                if (wldbg_fuzz_end_pointer_frame(wldbg)) {
-                    return -1;
-                }
-                break;
-            case MOUSE_LEAVE:
-                if (wldbg_fuzz_pointer_leave(wldbg)) {
-                    return -1;
-                }
-                if (wldbg_fuzz_end_pointer_frame(wldbg)) {
-                    return -1;
-                }
-                break;
+    struct event* event = &(fc->next_event);
+
+    if (fuzz.replay_only || fuzz.virtual_time.enabled) {
+        // the recorded delay of the event, or the delay we
+        // would have waited, is what the clock moves by
+        if (fuzz.replay_only) {
+            fc->delay = event->delay;
+        }
+        uint32_t delay = fc->delay.tv_sec * MILLIS_PER_SEC
+                         + fc->delay.tv_nsec / NANOS_PER_MILLI;
+        if (fc->events_sent == 0 && !fuzz.virtual_time.enabled) {
+            fc->virtual_time = get_real_timestamp(fc);
+        }
+        if (fc->events_sent == 0) {
+            fc->first_virtual_time = fc->virtual_time;
+            fc->first_sent = now;
+        }
+        fc->virtual_time += delay;
+    }
+    switch (event->type) {
+        case KEY:
+            if (wldbg_fuzz_send_keyboard(conn, fc, event->key.key_code, event->key.pressed)) {
+                return -1;
+            }
+            break;
+        case MOUSE_BUTTON:
+            if (wldbg_fuzz_send_button(conn, fc, event->mouse_button.button_code,
+                                       event->mouse_button.pressed)) {
+                return -1;
+            }
+            if (wldbg_fuzz_end_pointer_frame(conn, fc)) {
+                return -1;
+            }
+            break;
+        case MOUSE_MOVE:
+            if (wldbg_fuzz_pointer_motion(conn, fc, event->mouse_move.x, event->mouse_move.y)){
+                return -1;
+            }
+            if (wldbg_fuzz_end_pointer_frame(conn, fc)) {
+                return -1;
+            }
+            break;
+        case MOUSE_ENTER:
+            if (wldbg_fuzz_pointer_enter(conn, fc, event->mouse_enter.x, event->mouse_enter.y)) {
+                return -1;
+            }
+            if (wldbg_fuzz_end_pointer_frame(conn, fc)) {
+                return -1;
+            }
+            break;
+        case MOUSE_LEAVE:
+            if (wldbg_fuzz_pointer_leave(conn, fc)) {
+                return -1;
+            }
+            if (wldbg_fuzz_end_pointer_frame(conn, fc)) {
+                return -1;
+            }
+            break;
+    }
+
+    if (fuzz.feedback) {
+        response_done(fc);
+    }
+
+    if (fc->instance || fuzz.feedback) {
+        struct event *recorded = wl_array_add(&fc->recorded, sizeof *recorded);
+        if (recorded) {
+            *recorded = *event;
+            recorded->delay = fc->delay;
         }
+    }
+    ++fc->events_sent;
 
-        fuzz.delay = event->delay;
-        fuzz.event_genarator();
+    if (fuzz.feedback) {
+        // FNV-1a offset basis
+        fc->response = 0xcbf29ce484222325ULL;
+        fc->response_to = event->type;
+        fc->response_pending = 1;
+    }
 
-        clock_gettime(CLOCK_MONOTONIC, &(fuzz.last_msg_ts ));
+    if (fuzz.replay_only) {
+        fc->delay.tv_sec = fuzz.delay_min / MILLIS_PER_SEC;
+        fc->delay.tv_nsec = (fuzz.delay_min % MILLIS_PER_SEC) * NANOS_PER_MILLI;
+    }
+    else {
+        fc->delay = event->delay;
+    }
+    next_event(fc);
+
+    now = wldbg_get_time();
+    if (fuzz.sync.enabled) {
+        fc->idle = 0;
+        fc->event_time = fc->last_sent = now;
+        fc->next_time = now + (uint64_t) fuzz.delay_max * NANOS_PER_MILLI;
+        // a round trip may be running still when the client was busy
+        if (!fc->barrier_id) {
+            return send_barrier(conn, fc);
+        }
+        return 0;
     }
+
+    fc->next_time = now + (uint64_t) fc->delay.tv_sec * NANOS_PER_SEC + fc->delay.tv_nsec;
     return 0;
 }
+
+static int fuzz_send_next(struct wldbg *wldbg) {
+    struct wldbg_connection *conn;
+    struct fuzz_connection *fc, *tmp;
+    uint64_t next = 0;
+    int ret = 0;
+
+    ++fuzz.generation;
+
+    if (fuzz.campaign.enabled) {
+        campaign_tick(wldbg);
+    }
+
+    // fuzz only live connections, we must not touch
+    // the wldbg_connection of a client that is gone
+    wl_list_for_each(conn, &wldbg->connections, link) {
+        fc = wldbg_ids_map_get(&fuzz.connections, conn->id);
+        if (!fc) {
+            continue;
+        }
+
+        fc->generation = fuzz.generation;
+        if (fc->replay_done) {
+            continue;
+        }
+        if (fc->instance && (fc->instance->killed
+                             || fc->events_sent >= fuzz.campaign.events)) {
+            continue;
+        }
+        if (!fc->ready_for_input || fuzz.no_events) {
+            continue;
+        }
+        if (fuzz_send_event(conn, fc) < 0) {
+            ret = -1;
+        }
+        if (!fc->replay_done && (next == 0 || fc->next_time < next)) {
+            next = fc->next_time;
+        }
+    }
+
+    // forget connections that were closed, but keep what
+    // a campaign client got until we know how it exited
+    wl_list_for_each_safe(fc, tmp, &fuzz.connections_list, link) {
+        if (fc->generation != fuzz.generation && !fc->instance) {
+            destroy_fuzz_connection(fc);
+        }
+    }
+
+    if (wldbg->flags.exit || wldbg->flags.error) {
+        return ret;
+    }
+
+    // the campaign checks its clients every 10 ms
+    if (fuzz.campaign.enabled) {
+        uint64_t tick = wldbg_get_time() + 10 * NANOS_PER_MILLI;
+        if (next == 0 || tick < next) {
+            next = tick;
+        }
+    }
+    if (next) {
+        fuzz_schedule(next);
+    }
+
+    return ret;
+}
+
+static void fuzz_timer_fired(void *data) {
+    struct wldbg *wldbg = data;
+
+    fuzz.wakeup = 0;
+    fuzz_send_next(wldbg);
+}
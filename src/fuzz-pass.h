@@ -3,6 +3,8 @@
 
 struct pass *create_fuzz_pass();
 
-int wldbg_fuzz_send_next(struct wldbg* wldbg);
+struct pass *create_fuzz_campaign_pass();
+
+struct pass *create_fuzz_minimize_pass();
 
 #endif
@@ -64,6 +64,28 @@ set_opt(const char *arg, struct wldbg_options *opts)
 
 	if (is_prefix_of(arg, "help")) {
 		return 0;
+	} else if (strncmp(arg, "metrics=", 8) == 0) {
+		dbg("Command line option: metrics (%s)\n", arg + 8);
+		opts->metrics_path = arg + 8;
+		match = 1;
+	} else if (strncmp(arg, "control=", 8) == 0) {
+		dbg("Command line option: control (%s)\n", arg + 8);
+		opts->control_path = arg + 8;
+		match = 1;
+	} else if (strcmp(arg, "control") == 0) {
+		dbg("Command line option: control\n");
+		/* the default path, see main() */
+		opts->control_path = "";
+		match = 1;
+	} else if (strncmp(arg, "pipeline=", 9) == 0) {
+		dbg("Command line option: pipeline (%s)\n", arg + 9);
+		if (opts->pipelines_num == MAX_PIPELINE_RULES) {
+			fprintf(stderr, "Error: more than %d pipeline rules\n",
+				MAX_PIPELINE_RULES);
+			return 0;
+		}
+		opts->pipelines[opts->pipelines_num++] = arg + 9;
+		match = 1;
 	} else if (is_prefix_of(arg, "interactive")) {
 		dbg("Command line option: interactive\n");
 		opts->interactive = 1;
@@ -76,6 +98,10 @@ set_opt(const char *arg, struct wldbg_options *opts)
 		dbg("Command line option: pass-whole-buffer\n");
 		opts->pass_whole_buffer = 1;
 		match = 1;
+	} else if (is_prefix_of(arg, "profile")) {
+		dbg("Command line option: profile\n");
+		opts->profile = 1;
+		match = 1;
 	} else if (is_prefix_of(arg, "objinfo")) {
 		dbg("Command line option: objinfo\n");
 		opts->objinfo = 1;
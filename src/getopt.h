@@ -26,11 +26,22 @@
 #ifndef _WLDBG_GETOPT_H_
 #define _WLDBG_GETOPT_H_
 
+#define MAX_PIPELINE_RULES	16
+
 struct wldbg_options {
 	unsigned int interactive       : 1;
 	unsigned int objinfo           : 1;
 	unsigned int server_mode       : 1;
 	unsigned int pass_whole_buffer : 1;
+	unsigned int profile           : 1;
+
+	/* path to the socket for metrics */
+	const char *metrics_path;
+	/* path to the control socket, see control.h */
+	const char *control_path;
+	/* --pipeline rules, see pipeline.h */
+	const char *pipelines[MAX_PIPELINE_RULES];
+	int pipelines_num;
 
 	/* parsed path to the program and
 	 * its arguments */
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "wldbg-histogram.h"
+
+static unsigned int
+bucket_index(uint64_t value)
+{
+	unsigned int exp;
+
+	if (value < WLDBG_HISTOGRAM_SUB_COUNT)
+		return value;
+
+	exp = 63 - __builtin_clzll(value);
+	if (exp >= WLDBG_HISTOGRAM_MAX_EXP)
+		return WLDBG_HISTOGRAM_BUCKETS - 1;
+
+	/* the first group (values < SUB_COUNT) is linear,
+	 * then every power of two has its own group */
+	return (exp - WLDBG_HISTOGRAM_SUB_BITS + 1) * WLDBG_HISTOGRAM_SUB_COUNT
+		+ (value >> (exp - WLDBG_HISTOGRAM_SUB_BITS))
+		- WLDBG_HISTOGRAM_SUB_COUNT;
+}
+
+/* the highest value that falls into the bucket */
+static uint64_t
+bucket_highest_value(unsigned int idx)
+{
+	unsigned int group, sub, shift;
+
+	if (idx < WLDBG_HISTOGRAM_SUB_COUNT)
+		return idx;
+
+	group = idx / WLDBG_HISTOGRAM_SUB_COUNT;
+	sub = idx % WLDBG_HISTOGRAM_SUB_COUNT;
+	shift = group - 1;
+
+	return (((uint64_t) WLDBG_HISTOGRAM_SUB_COUNT + sub + 1) << shift) - 1;
+}
+
+void
+wldbg_histogram_init(struct wldbg_histogram *h)
+{
+	memset(h, 0, sizeof *h);
+	h->min = UINT64_MAX;
+}
+
+struct wldbg_histogram *
+wldbg_histogram_create(void)
+{
+	struct wldbg_histogram *h = malloc(sizeof *h);
+	if (!h)
+		return NULL;
+
+	wldbg_histogram_init(h);
+	return h;
+}
+
+void
+wldbg_histogram_destroy(struct wldbg_histogram *h)
+{
+	free(h);
+}
+
+void
+wldbg_histogram_add(struct wldbg_histogram *h, uint64_t value)
+{
+	++h->buckets[bucket_index(value)];
+	++h->count;
+	h->sum += value;
+
+	if (value < h->min)
+		h->min = value;
+	if (value > h->max)
+		h->max = value;
+}
+
+void
+wldbg_histogram_merge(struct wldbg_histogram *to,
+		      const struct wldbg_histogram *from)
+{
+	int i;
+
+	if (from->count == 0)
+		return;
+
+	for (i = 0; i < WLDBG_HISTOGRAM_BUCKETS; ++i)
+		to->buckets[i] += from->buckets[i];
+
+	to->count += from->count;
+	to->sum += from->sum;
+
+	if (from->min < to->min)
+		to->min = from->min;
+	if (from->max > to->max)
+		to->max = from->max;
+}
+
+uint64_t
+wldbg_histogram_percentile(const struct wldbg_histogram *h,
+			   double percentile)
+{
+	uint64_t target, seen = 0, val;
+	int i;
+
+	if (h->count == 0)
+		return 0;
+
+	if (percentile <= 0.0)
+		return h->min;
+	if (percentile >= 100.0)
+		return h->max;
+
+	target = (uint64_t) (percentile / 100.0 * h->count + 0.5);
+	if (target == 0)
+		target = 1;
+
+	for (i = 0; i < WLDBG_HISTOGRAM_BUCKETS; ++i) {
+		seen += h->buckets[i];
+		if (seen >= target) {
+			val = bucket_highest_value(i);
+			if (val > h->max)
+				return h->max;
+			if (val < h->min)
+				return h->min;
+			return val;
+		}
+	}
+
+	assert(0 && "Histogram count does not match buckets");
+	return h->max;
+}
+
+uint64_t
+wldbg_histogram_mean(const struct wldbg_histogram *h)
+{
+	if (h->count == 0)
+		return 0;
+
+	return h->sum / h->count;
+}
+
+const char *
+wldbg_format_nsec(uint64_t ns, char *buf, size_t size)
+{
+	if (ns < 1000)
+		snprintf(buf, size, "%luns", (unsigned long) ns);
+	else if (ns < 1000000)
+		snprintf(buf, size, "%.1fus", ns / 1000.0);
+	else if (ns < 1000000000)
+		snprintf(buf, size, "%.2fms", ns / 1000000.0);
+	else
+		snprintf(buf, size, "%.2fs", ns / 1000000000.0);
+
+	return buf;
+}
+
+void
+wldbg_histogram_print(const struct wldbg_histogram *h)
+{
+	char min[16], p50[16], p90[16], p99[16], max[16];
+
+	if (h->count == 0) {
+		printf("n=0");
+		return;
+	}
+
+	printf("n=%lu min=%s p50=%s p90=%s p99=%s max=%s",
+	       (unsigned long) h->count,
+	       wldbg_format_nsec(h->min, min, sizeof min),
+	       wldbg_format_nsec(wldbg_histogram_percentile(h, 50), p50,
+				 sizeof p50),
+	       wldbg_format_nsec(wldbg_histogram_percentile(h, 90), p90,
+				 sizeof p90),
+	       wldbg_format_nsec(wldbg_histogram_percentile(h, 99), p99,
+				 sizeof p99),
+	       wldbg_format_nsec(h->max, max, sizeof max));
+}
@@ -0,0 +1,491 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Measure how long a client needs to react on input. Every input event
+ * that goes to a client is timestamped and then paired with the next
+ * commit of the surface that has the focus of the input device and with
+ * the frame callback requested by that commit. As in the latency pass,
+ * the times are measured at wldbg, between compositor and client */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+/* for WL_SERVER_ID_START */
+#include "wayland/wayland-private.h"
+
+#include <wayland-server-protocol.h>
+#include <wayland-client-protocol.h>
+
+#include "wldbg.h"
+#include "wldbg-pass.h"
+#include "wldbg-private.h"
+#include "wldbg-ids-map.h"
+#include "wldbg-histogram.h"
+#include "wldbg-parse-message.h"
+#include "pass-connections.h"
+#include "passes.h"
+
+/* do not keep more unanswered events per surface
+ * (e.g. when the client does not draw on motion) */
+#define INPUT_MAX_PENDING 512
+
+enum input_device {
+	INPUT_POINTER,
+	INPUT_KEYBOARD,
+	INPUT_TOUCH,
+	INPUT_DEVICES_NUM
+};
+
+static const char *input_device_names[] = {
+	"pointer",
+	"keyboard",
+	"touch",
+};
+
+struct input_pending {
+	uint64_t time;
+	uint32_t device;
+};
+
+/* input events that are waiting for commit of the surface */
+struct input_surface {
+	/* array of struct input_pending */
+	struct wl_array pending;
+	/* the last frame callback requested since the last commit */
+	uint32_t frame;
+};
+
+/* input events that are waiting for the frame callback */
+struct input_callback {
+	struct wl_array pending;
+};
+
+struct input_connection {
+	struct wldbg_pass_connection base;
+
+	/* surfaces with the focus of input devices */
+	uint32_t focus[INPUT_DEVICES_NUM];
+
+	/* struct input_surface by surface id */
+	struct wldbg_ids_map surfaces;
+	/* struct input_callback by wl_callback id */
+	struct wldbg_ids_map callbacks;
+
+	uint64_t events[INPUT_DEVICES_NUM];
+	/* events that did not have focused surface or
+	 * did not fit into pending events */
+	uint64_t lost[INPUT_DEVICES_NUM];
+
+	struct wldbg_histogram to_commit[INPUT_DEVICES_NUM];
+	struct wldbg_histogram to_frame[INPUT_DEVICES_NUM];
+};
+
+struct input_latency {
+	/* struct input_connection */
+	struct wldbg_pass_connections connections;
+
+	/* interfaces we are interested in, filled
+	 * when we see them for the first time */
+	const struct wl_interface *wl_pointer;
+	const struct wl_interface *wl_keyboard;
+	const struct wl_interface *wl_touch;
+	const struct wl_interface *wl_surface;
+	const struct wl_interface *wl_callback;
+};
+
+static void
+init_connection(struct wldbg_pass_connection *pc)
+{
+	struct input_connection *ic = (struct input_connection *) pc;
+	int i;
+
+	wldbg_ids_map_init(&ic->surfaces);
+	wldbg_ids_map_init(&ic->callbacks);
+	for (i = 0; i < INPUT_DEVICES_NUM; ++i) {
+		wldbg_histogram_init(&ic->to_commit[i]);
+		wldbg_histogram_init(&ic->to_frame[i]);
+	}
+}
+
+static void
+release_map(struct wldbg_ids_map *map, size_t offset)
+{
+	unsigned int i;
+	void *item;
+
+	/* free the items together with their array at the offset */
+	for (i = 0; i < map->count; ++i) {
+		item = wldbg_ids_map_get(map, i);
+		if (!item)
+			continue;
+
+		wl_array_release((struct wl_array *) ((char *) item + offset));
+		free(item);
+	}
+
+	wldbg_ids_map_release(map);
+}
+
+static void
+release_connection(struct wldbg_pass_connection *pc)
+{
+	struct input_connection *ic = (struct input_connection *) pc;
+
+	release_map(&ic->surfaces, offsetof(struct input_surface, pending));
+	release_map(&ic->callbacks, offsetof(struct input_callback, pending));
+}
+
+static struct input_surface *
+get_surface(struct input_connection *ic, uint32_t id)
+{
+	struct input_surface *is;
+
+	/* surfaces are always created by client */
+	if (id == 0 || id >= WL_SERVER_ID_START)
+		return NULL;
+
+	is = wldbg_ids_map_get(&ic->surfaces, id);
+	if (is)
+		return is;
+
+	is = calloc(1, sizeof *is);
+	if (!is)
+		return NULL;
+
+	wl_array_init(&is->pending);
+	wldbg_ids_map_insert(&ic->surfaces, id, is);
+
+	return is;
+}
+
+static void
+destroy_surface(struct input_connection *ic, uint32_t id)
+{
+	struct input_surface *is = wldbg_ids_map_get(&ic->surfaces, id);
+	if (!is)
+		return;
+
+	wl_array_release(&is->pending);
+	free(is);
+	wldbg_ids_map_insert(&ic->surfaces, id, NULL);
+}
+
+static void
+input_event(struct input_connection *ic, enum input_device device,
+	    uint64_t time)
+{
+	struct input_surface *is;
+	struct input_pending *p;
+
+	++ic->events[device];
+
+	is = get_surface(ic, ic->focus[device]);
+	if (!is || is->pending.size >= INPUT_MAX_PENDING * sizeof *p) {
+		++ic->lost[device];
+		return;
+	}
+
+	p = wl_array_add(&is->pending, sizeof *p);
+	if (!p) {
+		++ic->lost[device];
+		return;
+	}
+
+	p->time = time;
+	p->device = device;
+}
+
+static void
+surface_commit(struct input_connection *ic, uint32_t id, uint64_t time)
+{
+	struct input_surface *is;
+	struct input_callback *cb;
+	struct input_pending *p;
+	uint32_t frame;
+
+	is = wldbg_ids_map_get(&ic->surfaces, id);
+	if (!is)
+		return;
+
+	frame = is->frame;
+	is->frame = 0;
+
+	if (is->pending.size == 0)
+		return;
+
+	wl_array_for_each(p, &is->pending)
+		wldbg_histogram_add(&ic->to_commit[p->device],
+				    time - p->time);
+
+	/* hand the events over to the frame callback */
+	if (frame && (cb = malloc(sizeof *cb))) {
+		cb->pending = is->pending;
+		wl_array_init(&is->pending);
+		wldbg_ids_map_insert(&ic->callbacks, frame, cb);
+	} else {
+		is->pending.size = 0;
+	}
+}
+
+static void
+frame_done(struct input_connection *ic, uint32_t id, uint64_t time)
+{
+	struct input_callback *cb;
+	struct input_pending *p;
+
+	cb = wldbg_ids_map_get(&ic->callbacks, id);
+	if (!cb)
+		return;
+
+	wl_array_for_each(p, &cb->pending)
+		wldbg_histogram_add(&ic->to_frame[p->device],
+				    time - p->time);
+
+	wl_array_release(&cb->pending);
+	free(cb);
+	wldbg_ids_map_insert(&ic->callbacks, id, NULL);
+}
+
+/* the argument at offset (in words, with the header) or 0 (no object)
+ * when the message is too short to have it */
+static uint32_t
+get_arg(struct wldbg_message *message, uint32_t offset)
+{
+	uint32_t words = message->size / sizeof(uint32_t);
+
+	if (offset >= words)
+		return 0;
+
+	return ((uint32_t *) message->data)[offset];
+}
+
+static void
+handle_request(struct input_latency *il, struct input_connection *ic,
+	       struct wldbg_message *message, uint32_t *data)
+{
+	const struct wl_interface *intf;
+	struct input_surface *is;
+	uint32_t opcode = data[1] & 0xffff;
+
+	intf = wldbg_message_get_object(message, data[0]);
+	if (!intf || !wldbg_is_interface(&il->wl_surface, intf, "wl_surface"))
+		return;
+
+	if (opcode == WL_SURFACE_FRAME) {
+		/* track frame callbacks only for surfaces
+		 * that got some input */
+		is = wldbg_ids_map_get(&ic->surfaces, data[0]);
+		if (is)
+			is->frame = get_arg(message, 2);
+	} else if (opcode == WL_SURFACE_COMMIT) {
+		surface_commit(ic, data[0], message->time);
+	} else if (opcode == WL_SURFACE_DESTROY) {
+		destroy_surface(ic, data[0]);
+	}
+}
+
+static void
+handle_event(struct input_latency *il, struct input_connection *ic,
+	     struct wldbg_message *message, uint32_t *data)
+{
+	const struct wl_interface *intf;
+	uint32_t opcode = data[1] & 0xffff;
+
+	intf = wldbg_message_get_object(message, data[0]);
+	if (!intf)
+		return;
+
+	if (wldbg_is_interface(&il->wl_callback, intf, "wl_callback")) {
+		if (opcode == WL_CALLBACK_DONE)
+			frame_done(ic, data[0], message->time);
+	} else if (wldbg_is_interface(&il->wl_pointer, intf, "wl_pointer")) {
+		if (opcode == WL_POINTER_ENTER)
+			ic->focus[INPUT_POINTER] = get_arg(message, 3);
+		else if (opcode == WL_POINTER_LEAVE)
+			ic->focus[INPUT_POINTER] = 0;
+		else if (opcode != WL_POINTER_FRAME)
+			input_event(ic, INPUT_POINTER, message->time);
+	} else if (wldbg_is_interface(&il->wl_keyboard, intf, "wl_keyboard")) {
+		if (opcode == WL_KEYBOARD_ENTER)
+			ic->focus[INPUT_KEYBOARD] = get_arg(message, 3);
+		else if (opcode == WL_KEYBOARD_LEAVE)
+			ic->focus[INPUT_KEYBOARD] = 0;
+		else if (opcode == WL_KEYBOARD_KEY)
+			input_event(ic, INPUT_KEYBOARD, message->time);
+	} else if (wldbg_is_interface(&il->wl_touch, intf, "wl_touch")) {
+		/* all touch points go to the surface
+		 * of the last touch down */
+		if (opcode == WL_TOUCH_DOWN)
+			ic->focus[INPUT_TOUCH] = get_arg(message, 4);
+
+		if (opcode == WL_TOUCH_DOWN || opcode == WL_TOUCH_UP
+		    || opcode == WL_TOUCH_MOTION)
+			input_event(ic, INPUT_TOUCH, message->time);
+	}
+}
+
+static void
+input_latency_one(struct wldbg_message *message, void *user_data)
+{
+	struct input_latency *il = user_data;
+	struct input_connection *ic;
+
+	ic = wldbg_pass_connection_get(&il->connections, message->connection);
+	if (!ic)
+		return;
+
+	if (message->from == CLIENT)
+		handle_request(il, ic, message, message->data);
+	else
+		handle_event(il, ic, message, message->data);
+}
+
+static int
+input_latency_message(void *user_data, struct wldbg_message *message)
+{
+	wldbg_for_each_message(message, input_latency_one, user_data);
+	return PASS_NEXT;
+}
+
+static void
+print_input_latency(void *data)
+{
+	struct input_latency *il = data;
+	struct input_connection *ic;
+	int i;
+
+	printf("\n-- Input latency --\n");
+
+	wl_list_for_each(ic, &il->connections.list, base.link) {
+		wldbg_pass_connection_print(&ic->base);
+
+		for (i = 0; i < INPUT_DEVICES_NUM; ++i) {
+			if (ic->events[i] == 0)
+				continue;
+
+			printf("  %s: %lu events, %lu without focus or lost\n",
+			       input_device_names[i],
+			       (unsigned long) ic->events[i],
+			       (unsigned long) ic->lost[i]);
+			printf("    input -> commit      ");
+			wldbg_histogram_print(&ic->to_commit[i]);
+			printf("\n    input -> frame done  ");
+			wldbg_histogram_print(&ic->to_frame[i]);
+			putchar('\n');
+		}
+	}
+
+	fflush(stdout);
+}
+
+static void
+input_latency_help(void *user_data)
+{
+	(void) user_data;
+
+	printf("Measure the time from input events (wl_pointer, wl_keyboard.key\n"
+	       "and wl_touch) to the next commit of the focused surface and\n"
+	       "to the frame callback requested by that commit\n"
+	       "\n"
+	       "The times are printed on exit and when wldbg gets SIGUSR1\n"
+	       "\n"
+	       "Usage: wldbg input-latency [help]\n");
+}
+
+static int
+input_latency_init(struct wldbg *wldbg, struct wldbg_pass *pass,
+		   int argc, const char *argv[])
+{
+	struct input_latency *il;
+	int i;
+
+	for (i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "help") == 0) {
+			input_latency_help(NULL);
+			wldbg_exit(wldbg);
+			return 0;
+		} else {
+			fprintf(stderr, "input-latency: unknown option '%s'\n",
+				argv[i]);
+			return -1;
+		}
+	}
+
+	il = calloc(1, sizeof *il);
+	if (!il)
+		return -1;
+
+	if (wldbg_pass_connections_init(&il->connections, wldbg,
+					sizeof(struct input_connection),
+					init_connection,
+					release_connection) < 0
+	    || wldbg_add_report_callback(wldbg, print_input_latency, il) < 0) {
+		wldbg_pass_connections_release(&il->connections);
+		free(il);
+		return -1;
+	}
+
+	pass->user_data = il;
+
+	return 0;
+}
+
+static void
+input_latency_destroy(void *user_data)
+{
+	struct input_latency *il = user_data;
+
+	if (!il)
+		return;
+
+	print_input_latency(il);
+
+	wldbg_pass_connections_release(&il->connections);
+	free(il);
+}
+
+struct pass *
+create_input_latency_pass(void)
+{
+	struct pass *pass;
+
+	pass = alloc_pass("input-latency");
+	if (!pass)
+		return NULL;
+
+	pass->wldbg_pass.init = input_latency_init;
+	pass->wldbg_pass.destroy = input_latency_destroy;
+	pass->wldbg_pass.server_pass = input_latency_message;
+	pass->wldbg_pass.client_pass = input_latency_message;
+	pass->wldbg_pass.help = input_latency_help;
+	pass->wldbg_pass.user_data = NULL;
+	pass->wldbg_pass.description
+		= "Time from input events to commit and frame";
+	pass->wldbg_pass.flags = 0;
+
+	return pass;
+}
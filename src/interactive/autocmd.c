@@ -146,6 +146,7 @@ add_autocmd(struct wldbg_interactive *wldbgi, char *buf)
 		return;
 
 	wl_list_insert(wldbgi->autocmds.next, &ac->link);
+	match_cache_invalidate(&wldbgi->match_cache);
 	printf("Added autocmd '%s' on '%s'\n", cmd, buf);
 }
 
@@ -162,16 +163,7 @@ message_match_autocmd(struct wldbg_message *msg, struct autocmd *ac)
 		return 0;
 	}
 
-	/* run regular expression */
-	ret = regexec(&ac->regex, buf, 0, NULL, 0);
-
-	/* got we match? */
-	if (ret == 0) {
-		return 1;
-	} else if (ret != REG_NOMATCH)
-		fprintf(stderr, "Executing regexp failed!\n");
-
-	return 0;
+	return match_message_name(&ac->regex, buf);
 }
 
 /* FIXME - don't duplicate code with filters */
@@ -201,6 +193,7 @@ remove_autocmd(struct wldbg_interactive *wldbgi, char *buf)
 			free(ac->cmd);
 			free(ac->filter);
 			free(ac);
+			match_cache_invalidate(&wldbgi->match_cache);
 			break;
 		}
 	}
@@ -53,6 +53,7 @@ free_breakpoint(struct breakpoint *b)
 	if (b->data_destr)
 		b->data_destr(b->data);
 
+	condition_free(b->condition);
 	free(b->description);
 	free(b);
 }
@@ -126,16 +127,7 @@ break_on_regex(struct wldbg_message *msg, struct breakpoint *b)
 		return 0;
 	}
 
-	/* run regular expression */
-	ret = regexec(re, buf, 0, NULL, 0);
-
-	/* got we match? */
-	if (ret == 0) {
-		return 1;
-	} else if (ret != REG_NOMATCH)
-		fprintf(stderr, "Executing regexp failed!\n");
-
-	return 0;
+	return match_message_name(re, buf);
 }
 
 static void
@@ -154,7 +146,7 @@ create_breakpoint(struct wldbg_message *message, char *buf)
 	struct breakpoint *b;
 	struct breakpoint_re_data *rd;
 	const struct wl_interface *intf = NULL;
-	char *at;
+	char *at, *expr, *description;
 
 	b = calloc(1, sizeof *b);
 	if (!b) {
@@ -164,6 +156,14 @@ create_breakpoint(struct wldbg_message *message, char *buf)
 
 	b->id = breakpoint_next_id;
 
+	/* split off the condition, the rest
+	 * of the parsing expects the newline */
+	expr = strstr(buf, " if ");
+	if (expr) {
+		strcpy(expr, "\n");
+		expr = remove_newline(skip_ws(expr + 4));
+	}
+
 	/* parse buf and find out what the breakpoint
 	 * should be */
 	if (strcmp(buf, "server\n") == 0) {
@@ -209,11 +209,20 @@ create_breakpoint(struct wldbg_message *message, char *buf)
 			goto err;
 		}
 
+		b->name_regex = &rd->re;
 		b->description = strdupf("regex matching '%s'", rd->pattern);
 		if (!b->description)
 			goto err_mem;
 	} else {
 		if ((at = strchr(buf, '@'))) {
+			/* interfaces are looked up in the
+			 * connection of the current message */
+			if (!message) {
+				printf("Breaking on interface@message needs "
+				       "a stopped client, use 'break re'\n");
+				goto err;
+			}
+
 			/* split the string on '@' */
 			*at = 0;
 			intf = wldbg_message_get_interface(message, buf);
@@ -256,7 +265,7 @@ create_breakpoint(struct wldbg_message *message, char *buf)
 				goto err_mem;
 
 			/* dont care about overflow, this is satisfactory description */
-			snprintf(b->description, 1024, "break on %s@%s",
+			snprintf(b->description, 256, "break on %s@%s",
 				 intf->name, ((struct wl_message *) b->data)->name);
 		} else {
 			printf("Wrong syntax. Try help break (help b) for more info\n");
@@ -264,6 +273,22 @@ create_breakpoint(struct wldbg_message *message, char *buf)
 		}
 	}
 
+	if (expr) {
+		/* with the message known, offsets of
+		 * the arguments are computed now */
+		b->condition = condition_compile(expr,
+						 b->applies == break_on_name ?
+							b->data : NULL);
+		if (!b->condition)
+			goto err;
+
+		description = strdupf("%s if %s", b->description, expr);
+		if (!description)
+			goto err_mem;
+		free(b->description);
+		b->description = description;
+	}
+
 	++breakpoint_next_id;
 	return b;
 
@@ -290,6 +315,7 @@ delete_breakpoint(char *buf, struct wldbg_interactive *wldbgi)
 		if (b->id == (unsigned) id) {
 			wl_list_remove(&b->link);
 			free_breakpoint(b);
+			match_cache_invalidate(&wldbgi->match_cache);
 
 			return;
 		}
@@ -319,6 +345,7 @@ cmd_break(struct wldbg_interactive *wldbgi,
 	b = create_breakpoint(message, buf);
 	if (b) {
 		wl_list_insert(wldbgi->breakpoints.next, &b->link);
+		match_cache_invalidate(&wldbgi->match_cache);
 		printf("Created breakpoint %u: %s\n", b->id, b->description);
 	}
 
@@ -342,5 +369,14 @@ cmd_break_help(int oneline)
 	       "\tbreak delete ID            - delete breakpoint id\n"
 	       "\tbreak d ID                 - delete breakpoint id\n"
 	       "\n"
-	       "Example: b re wl_surface.*\n");
+	       "Any breakpoint can be followed by 'if EXPR' to stop only when\n"
+	       "EXPR holds. EXPR is a C-like expression over integers using\n"
+	       "arg0, arg1, ... (arguments of the message; fixed numbers are\n"
+	       "truncated, strings and arrays give their length) and id\n"
+	       "(the object id) with operators ! - * / %% + - < <= > >= == !=\n"
+	       "&& || and parentheses. A message without the argument does\n"
+	       "not match.\n"
+	       "\n"
+	       "Example: b re wl_surface.*\n"
+	       "         b wl_pointer@motion if arg1 > 500 && arg0 %% 2 == 0\n");
 }
@@ -0,0 +1,622 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Conditions of breakpoints and filters, like
+ *
+ *   arg1 > 500 && arg0 % 2 == 0
+ *
+ * argN is the N-th argument of the message (wl_message has no names of
+ * the arguments), id is the id of the object. Integers, objects and
+ * new ids are their values, fixed numbers their integer part and
+ * strings and arrays their length. There are C operators
+ * || && == != < <= > >= + - * / % ! and parenthesis.
+ *
+ * The expression is compiled into a bytecode for a stack machine that
+ * reads the arguments right from the message data. When we know the
+ * message the condition is for, the offsets of the arguments are
+ * computed while compiling. Otherwise we walk the signature. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "wayland/wayland-util.h"
+
+#include "wldbg.h"
+#include "condition.h"
+
+/* deeper expressions are not worth it */
+#define MAX_STACK 32
+
+enum cond_op {
+	OP_CONST,
+	/* argument at a known offset (in words) */
+	OP_WORD,
+	/* argument we must find in the message */
+	OP_ARG,
+	OP_ID,
+	OP_NOT,
+	OP_NEG,
+	OP_ADD,
+	OP_SUB,
+	OP_MUL,
+	OP_DIV,
+	OP_MOD,
+	OP_EQ,
+	OP_NE,
+	OP_LT,
+	OP_LE,
+	OP_GT,
+	OP_GE,
+	/* jump if the top of the stack is (non)zero, keep it there */
+	OP_JZ,
+	OP_JNZ,
+	OP_POP,
+	OP_BOOL,
+};
+
+struct cond_insn {
+	enum cond_op op;
+	/* type of the argument from the signature */
+	char type;
+	/* argument index, offset in words or jump target */
+	uint32_t arg;
+	int64_t value;
+};
+
+struct condition {
+	struct cond_insn *code;
+	uint32_t len;
+	uint32_t alloc;
+
+	/* the source, for printing */
+	char *expr;
+	/* the message it was compiled for, or NULL */
+	const struct wl_message *wl_message;
+};
+
+struct parser {
+	const char *expr;
+	const char *p;
+	struct condition *cond;
+	int depth;
+	int max_depth;
+	int error;
+};
+
+/* the type of the n-th argument and its offset in words from the
+ * start of the arguments, -1 if it is after a string or array */
+static char
+arg_type(const char *signature, uint32_t n, int *offset)
+{
+	uint32_t i = 0;
+	int off = 0;
+
+	for (; *signature; ++signature) {
+		if (isdigit(*signature) || *signature == '?')
+			continue;
+
+		if (i == n) {
+			*offset = off;
+			return *signature;
+		}
+
+		if (*signature == 's' || *signature == 'a')
+			off = -1;
+		else if (*signature != 'h' && off >= 0)
+			++off;
+		++i;
+	}
+
+	return 0;
+}
+
+static void
+syntax_error(struct parser *ps, const char *what)
+{
+	if (ps->error)
+		return;
+
+	fprintf(stderr, "Condition: %s at '%s'\n", what, ps->p);
+	ps->error = 1;
+}
+
+static uint32_t
+emit(struct parser *ps, enum cond_op op, int64_t value)
+{
+	struct condition *cond = ps->cond;
+	struct cond_insn *code;
+
+	if (cond->len == cond->alloc) {
+		cond->alloc = cond->alloc ? cond->alloc * 2 : 16;
+		code = realloc(cond->code, cond->alloc * sizeof *code);
+		if (!code) {
+			syntax_error(ps, "out of memory");
+			return 0;
+		}
+		cond->code = code;
+	}
+
+	code = &cond->code[cond->len];
+	memset(code, 0, sizeof *code);
+	code->op = op;
+	code->value = value;
+
+	/* keep track of how deep the stack gets */
+	switch (op) {
+	case OP_CONST: case OP_WORD: case OP_ARG: case OP_ID:
+		++ps->depth;
+		break;
+	case OP_NOT: case OP_NEG: case OP_BOOL:
+	case OP_JZ: case OP_JNZ:
+		break;
+	default:
+		--ps->depth;
+	}
+	if (ps->depth > ps->max_depth)
+		ps->max_depth = ps->depth;
+
+	return cond->len++;
+}
+
+static void
+skip_space(struct parser *ps)
+{
+	while (isspace(*ps->p))
+		++ps->p;
+}
+
+/* consume the token if it is next */
+static int
+accept(struct parser *ps, const char *token)
+{
+	size_t len = strlen(token);
+
+	skip_space(ps);
+	if (strncmp(ps->p, token, len) != 0)
+		return 0;
+
+	/* don't take < for <= and so on */
+	if (len == 1 && strchr("<>=!", *token) && ps->p[1] == '=')
+		return 0;
+
+	ps->p += len;
+	return 1;
+}
+
+static void parse_or(struct parser *ps);
+
+static void
+parse_argument(struct parser *ps, uint32_t n)
+{
+	const struct wl_message *wl_message = ps->cond->wl_message;
+	uint32_t insn;
+	int offset;
+	char type;
+
+	if (!wl_message) {
+		insn = emit(ps, OP_ARG, 0);
+		if (!ps->error)
+			ps->cond->code[insn].arg = n;
+		return;
+	}
+
+	type = arg_type(wl_message->signature, n, &offset);
+	if (!type) {
+		syntax_error(ps, "no such argument");
+		return;
+	}
+	if (type == 'h') {
+		syntax_error(ps, "file descriptors have no value");
+		return;
+	}
+
+	if (offset >= 0) {
+		/* skip the header */
+		insn = emit(ps, OP_WORD, 0);
+		if (!ps->error)
+			ps->cond->code[insn].arg = offset + 2;
+	} else {
+		insn = emit(ps, OP_ARG, 0);
+		if (!ps->error)
+			ps->cond->code[insn].arg = n;
+	}
+
+	if (!ps->error)
+		ps->cond->code[insn].type = type;
+}
+
+static void
+parse_primary(struct parser *ps)
+{
+	char *end;
+	unsigned long n;
+	long long value;
+
+	skip_space(ps);
+
+	if (accept(ps, "(")) {
+		parse_or(ps);
+		if (!accept(ps, ")"))
+			syntax_error(ps, "expected ')'");
+	} else if (isdigit(*ps->p)) {
+		value = strtoll(ps->p, &end, 0);
+		ps->p = end;
+		emit(ps, OP_CONST, value);
+	} else if (strncmp(ps->p, "arg", 3) == 0 && isdigit(ps->p[3])) {
+		n = strtoul(ps->p + 3, &end, 10);
+		ps->p = end;
+		parse_argument(ps, n);
+	} else if (strncmp(ps->p, "id", 2) == 0
+		   && !isalnum(ps->p[2]) && ps->p[2] != '_') {
+		ps->p += 2;
+		emit(ps, OP_ID, 0);
+	} else {
+		syntax_error(ps, "expected a number, argN, id or '('");
+	}
+}
+
+static void
+parse_unary(struct parser *ps)
+{
+	if (accept(ps, "!")) {
+		parse_unary(ps);
+		emit(ps, OP_NOT, 0);
+	} else if (accept(ps, "-")) {
+		parse_unary(ps);
+		emit(ps, OP_NEG, 0);
+	} else {
+		parse_primary(ps);
+	}
+}
+
+static void
+parse_multiplicative(struct parser *ps)
+{
+	parse_unary(ps);
+
+	while (!ps->error) {
+		if (accept(ps, "*")) {
+			parse_unary(ps);
+			emit(ps, OP_MUL, 0);
+		} else if (accept(ps, "/")) {
+			parse_unary(ps);
+			emit(ps, OP_DIV, 0);
+		} else if (accept(ps, "%")) {
+			parse_unary(ps);
+			emit(ps, OP_MOD, 0);
+		} else
+			break;
+	}
+}
+
+static void
+parse_additive(struct parser *ps)
+{
+	parse_multiplicative(ps);
+
+	while (!ps->error) {
+		if (accept(ps, "+")) {
+			parse_multiplicative(ps);
+			emit(ps, OP_ADD, 0);
+		} else if (accept(ps, "-")) {
+			parse_multiplicative(ps);
+			emit(ps, OP_SUB, 0);
+		} else
+			break;
+	}
+}
+
+static void
+parse_comparison(struct parser *ps)
+{
+	static const struct {
+		const char *token;
+		enum cond_op op;
+	} ops[] = {
+		{ "==", OP_EQ }, { "!=", OP_NE },
+		{ "<=", OP_LE }, { ">=", OP_GE },
+		{ "<", OP_LT }, { ">", OP_GT },
+	};
+	unsigned int i;
+
+	parse_additive(ps);
+
+	while (!ps->error) {
+		for (i = 0; i < sizeof ops / sizeof *ops; ++i)
+			if (accept(ps, ops[i].token))
+				break;
+
+		if (i == sizeof ops / sizeof *ops)
+			break;
+
+		parse_additive(ps);
+		emit(ps, ops[i].op, 0);
+	}
+}
+
+/* a && b is a, if zero jump over b (keeping the zero), else pop it,
+ * compute b and make it 0 or 1. || is the same with a non-zero */
+static void
+parse_logical(struct parser *ps, const char *token, enum cond_op jump,
+	      void (*operand)(struct parser *))
+{
+	uint32_t insn;
+
+	operand(ps);
+
+	while (!ps->error && accept(ps, token)) {
+		emit(ps, OP_BOOL, 0);
+		insn = emit(ps, jump, 0);
+		emit(ps, OP_POP, 0);
+		operand(ps);
+		emit(ps, OP_BOOL, 0);
+		if (!ps->error)
+			ps->cond->code[insn].arg = ps->cond->len;
+	}
+}
+
+static void
+parse_and(struct parser *ps)
+{
+	parse_logical(ps, "&&", OP_JZ, parse_comparison);
+}
+
+static void
+parse_or(struct parser *ps)
+{
+	parse_logical(ps, "||", OP_JNZ, parse_and);
+}
+
+struct condition *
+condition_compile(const char *expr, const struct wl_message *wl_message)
+{
+	struct parser ps;
+	struct condition *cond;
+
+	cond = calloc(1, sizeof *cond);
+	if (!cond) {
+		fprintf(stderr, "Out of memory\n");
+		return NULL;
+	}
+
+	cond->wl_message = wl_message;
+	cond->expr = strdup(expr);
+	if (!cond->expr) {
+		fprintf(stderr, "Out of memory\n");
+		free(cond);
+		return NULL;
+	}
+
+	memset(&ps, 0, sizeof ps);
+	ps.expr = ps.p = expr;
+	ps.cond = cond;
+
+	parse_or(&ps);
+
+	skip_space(&ps);
+	if (*ps.p)
+		syntax_error(&ps, "unexpected input");
+	if (ps.max_depth > MAX_STACK)
+		syntax_error(&ps, "expression too deep");
+
+	if (ps.error) {
+		condition_free(cond);
+		return NULL;
+	}
+
+	return cond;
+}
+
+void
+condition_free(struct condition *cond)
+{
+	if (!cond)
+		return;
+
+	free(cond->expr);
+	free(cond->code);
+	free(cond);
+}
+
+const char *
+condition_expr(struct condition *cond)
+{
+	return cond->expr;
+}
+
+/* read the argument of given type at offset (in words),
+ * return -1 if the message is too short */
+static int
+load(const uint32_t *data, uint32_t words, uint32_t offset, char type,
+     int64_t *value)
+{
+	if (offset >= words)
+		return -1;
+
+	switch (type) {
+	case 'i':
+		*value = (int32_t) data[offset];
+		break;
+	case 'f':
+		*value = wl_fixed_to_int((wl_fixed_t) data[offset]);
+		break;
+	default:
+		/* uint, object, new id, length of string or array */
+		*value = data[offset];
+	}
+
+	return 0;
+}
+
+/* find the n-th argument in the message */
+static int
+load_arg(const struct wl_message *wl_message, const uint32_t *data,
+	 uint32_t words, uint32_t n, int64_t *value)
+{
+	const char *sig;
+	uint32_t i = 0, offset = 2;
+
+	if (!wl_message)
+		return -1;
+
+	for (sig = wl_message->signature; *sig; ++sig) {
+		if (isdigit(*sig) || *sig == '?')
+			continue;
+
+		if (i == n)
+			return *sig == 'h' ? -1 :
+				load(data, words, offset, *sig, value);
+
+		if (*sig == 's' || *sig == 'a') {
+			if (offset >= words)
+				return -1;
+			offset += 1 + (data[offset] + 3) / 4;
+		} else if (*sig != 'h') {
+			++offset;
+		}
+		++i;
+	}
+
+	return -1;
+}
+
+int
+condition_eval(struct condition *cond, const struct wl_message *wl_message,
+	       const uint32_t *data, size_t size)
+{
+	int64_t stack[MAX_STACK];
+	int64_t a, b;
+	uint32_t words = size / sizeof(uint32_t);
+	uint32_t pc;
+	int sp = 0;
+	struct cond_insn *insn;
+
+	/* compiled for another message */
+	if (cond->wl_message && wl_message != cond->wl_message)
+		return 0;
+
+	for (pc = 0; pc < cond->len; ++pc) {
+		insn = &cond->code[pc];
+
+		switch (insn->op) {
+		case OP_CONST:
+			stack[sp++] = insn->value;
+			continue;
+		case OP_WORD:
+			if (load(data, words, insn->arg, insn->type, &stack[sp]) < 0)
+				return 0;
+			++sp;
+			continue;
+		case OP_ARG:
+			if (load_arg(wl_message, data, words,
+				     insn->arg, &stack[sp]) < 0)
+				return 0;
+			++sp;
+			continue;
+		case OP_ID:
+			stack[sp++] = data[0];
+			continue;
+		case OP_NOT:
+			stack[sp - 1] = !stack[sp - 1];
+			continue;
+		case OP_NEG:
+			stack[sp - 1] = -stack[sp - 1];
+			continue;
+		case OP_BOOL:
+			stack[sp - 1] = !!stack[sp - 1];
+			continue;
+		case OP_JZ:
+			if (stack[sp - 1] == 0)
+				pc = insn->arg - 1;
+			continue;
+		case OP_JNZ:
+			if (stack[sp - 1] != 0)
+				pc = insn->arg - 1;
+			continue;
+		case OP_POP:
+			--sp;
+			continue;
+		default:
+			break;
+		}
+
+		/* binary operators */
+		b = stack[--sp];
+		a = stack[sp - 1];
+
+		/* wrap around instead of overflowing */
+		switch (insn->op) {
+		case OP_ADD: a = (int64_t) ((uint64_t) a + (uint64_t) b); break;
+		case OP_SUB: a = (int64_t) ((uint64_t) a - (uint64_t) b); break;
+		case OP_MUL: a = (int64_t) ((uint64_t) a * (uint64_t) b); break;
+		case OP_DIV:
+		case OP_MOD:
+			if (b == 0)
+				return 0;
+			if (b == -1)
+				a = insn->op == OP_DIV ?
+					(int64_t) (0 - (uint64_t) a) : 0;
+			else
+				a = insn->op == OP_DIV ? a / b : a % b;
+			break;
+		case OP_EQ: a = a == b; break;
+		case OP_NE: a = a != b; break;
+		case OP_LT: a = a < b; break;
+		case OP_LE: a = a <= b; break;
+		case OP_GT: a = a > b; break;
+		case OP_GE: a = a >= b; break;
+		default:
+			return 0;
+		}
+
+		stack[sp - 1] = a;
+	}
+
+	return sp > 0 && stack[sp - 1] != 0;
+}
+
+int
+condition_eval_message(struct condition *cond, struct wldbg_message *message)
+{
+	const struct wl_interface *intf;
+	const struct wl_message *wl_message = NULL;
+	uint32_t *data = message->data;
+	uint32_t opcode = data[1] & 0xffff;
+
+	intf = wldbg_message_get_object(message, data[0]);
+	if (intf) {
+		if (message->from == SERVER) {
+			if ((int) opcode < intf->event_count)
+				wl_message = &intf->events[opcode];
+		} else {
+			if ((int) opcode < intf->method_count)
+				wl_message = &intf->methods[opcode];
+		}
+	}
+
+	return condition_eval(cond, wl_message, data, message->size);
+}
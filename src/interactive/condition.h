@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_CONDITION_H_
+#define _WLDBG_CONDITION_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct wl_message;
+struct wldbg_message;
+
+/* condition on arguments of a message compiled to bytecode,
+ * like 'arg1 > 500 && arg0 % 2 == 0' (see condition.c) */
+struct condition;
+
+/* compile the expression. If wl_message is not NULL, the condition
+ * is only evaluated on this message and the arguments are checked
+ * and their offsets computed now. Returns NULL on error */
+struct condition *
+condition_compile(const char *expr, const struct wl_message *wl_message);
+
+void
+condition_free(struct condition *cond);
+
+/* the expression the condition was compiled from */
+const char *
+condition_expr(struct condition *cond);
+
+/* evaluate the condition on raw message data (with the header),
+ * size is in bytes. Returns 1 if it holds, 0 if not or if the
+ * message has no such argument */
+int
+condition_eval(struct condition *cond, const struct wl_message *wl_message,
+	       const uint32_t *data, size_t size);
+
+/* the same, but find the wl_message for the message */
+int
+condition_eval_message(struct condition *cond, struct wldbg_message *message);
+
+#endif /* _WLDBG_CONDITION_H_ */
@@ -35,7 +35,7 @@
 #include "util.h"
 
 static struct filter *
-create_filter(const char *pattern)
+create_filter(const char *pattern, const char *expr)
 {
 	static unsigned int pf_id;
 	struct filter *pf;
@@ -60,6 +60,17 @@ create_filter(const char *pattern)
 		return NULL;
 	}
 
+	pf->condition = NULL;
+	if (expr) {
+		pf->condition = condition_compile(expr, NULL);
+		if (!pf->condition) {
+			regfree(&pf->regex);
+			free(pf->filter);
+			free(pf);
+			return NULL;
+		}
+	}
+
 	pf->id = pf_id++;
 
 	return pf;
@@ -71,18 +82,35 @@ cmd_create_filter(struct wldbg_interactive *wldbgi,
 {
 	struct filter *pf;
 	char filter[128];
+	char *expr;
+
+	/* REGEXP [if EXPR] */
+	expr = strstr(buf, " if ");
+	if (expr) {
+		*expr = '\0';
+		expr = skip_ws(expr + 4);
+	}
 
-	sscanf(buf, "%s", filter);
+	if (sscanf(buf, "%127s", filter) != 1) {
+		printf("Missing regular expression\n");
+		return CMD_CONTINUE_QUERY;
+	}
 
-	pf = create_filter(filter);
+	pf = create_filter(filter, expr);
 	if (!pf)
 		return CMD_CONTINUE_QUERY;
 
 	pf->show_only = show_only;
 	wl_list_insert(wldbgi->filters.next, &pf->link);
+	if (pf->condition)
+		++wldbgi->conditional_filters;
+	match_cache_invalidate(&wldbgi->match_cache);
 
-	printf("Filtering messages: %s%s\n",
+	printf("Filtering messages: %s%s",
 	       show_only ? "" : "hide ", filter);
+	if (pf->condition)
+		printf(" if %s", condition_expr(pf->condition));
+	putchar('\n');
 
 	return CMD_CONTINUE_QUERY;
 }
@@ -93,8 +121,10 @@ cmd_hide_help(int oneline)
 	if (oneline)
 		printf("Hide particular messages");
 	else
-		printf("Hide messages matching given extended regular expression\n\n"
-		       "hide REGEXP\n");
+		printf("Hide messages matching given extended regular expression.\n"
+		       "With a condition, hide them only when it holds\n"
+		       "(see 'help break' for the syntax)\n\n"
+		       "hide REGEXP [if EXPR]\n");
 }
 
 int
@@ -121,8 +151,9 @@ cmd_showonly_help(int oneline)
 	else
 		printf("Show only messages matching given extended regular expression.\n"
 		       "Filters are accumulated, so the message is shown if\n"
-		       "it matches any of showonly commands\n\n"
-		       "showonly REGEXP\n");
+		       "it matches any of showonly commands. With a condition,\n"
+		       "the filter matches only when it holds\n\n"
+		       "showonly REGEXP [if EXPR]\n");
 }
 
 int
@@ -175,9 +206,13 @@ remove_filter(struct wldbg_interactive *wldbgi, char *buf)
 			found = 1;
 			wl_list_remove(&pf->link);
 
+			if (pf->condition)
+				--wldbgi->conditional_filters;
 			regfree(&pf->regex);
+			condition_free(pf->condition);
 			free(pf->filter);
 			free(pf);
+			match_cache_invalidate(&wldbgi->match_cache);
 			break;
 		}
 	}
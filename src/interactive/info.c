@@ -30,6 +30,8 @@
 #include "interactive.h"
 #include "interactive-commands.h"
 #include "wldbg-private.h"
+#include "objinfo/objinfo.h"
+#include "metrics.h"
 #include "util.h"
 
 static void
@@ -90,9 +92,12 @@ print_filters(struct wldbg_interactive *wldbgi)
 	}
 
 	wl_list_for_each(pf, &wldbgi->filters, link) {
-		printf("%u: %s %s\n", pf->id,
+		printf("%u: %s %s", pf->id,
 		       pf->show_only ? "show" : "hide",
 		       pf->filter);
+		if (pf->condition)
+			printf(" if %s", condition_expr(pf->condition));
+		putchar('\n');
 	}
 }
 
@@ -160,9 +165,48 @@ info_connections(struct wldbg_interactive *wldbgi)
 			printf("\t      :   argv[%d]=\'%s\'\n",
 			       i, conn->client.argv[i]);
 
+		if (conn->objects_info)
+			objects_info_print_shm(conn->objects_info, "\t      : ");
+
 	}
 }
 
+static void
+info_stats(struct wldbg_interactive *wldbgi)
+{
+	struct wldbg *wldbg = wldbgi->wldbg;
+	struct wldbg_connection *conn;
+	struct match_cache *mc = &wldbgi->match_cache;
+	uint64_t now = wldbg_get_time();
+	uint32_t queue[WLDBG_METRICS_QUEUES_NUM];
+
+	printf("\n-- Statistics -- \n");
+	printf("Messages: %lu from clients, %lu from servers\n",
+	       wldbgi->statistics.client_msg_no,
+	       wldbgi->statistics.server_msg_no);
+
+	wl_list_for_each(conn, &wldbg->connections, link) {
+		printf("\t%u (%s): %u messages/s", conn->id,
+		       conn->client.program ? conn->client.program : "unknown",
+		       wldbg_connection_rate(conn, now));
+
+		if (conn->paused) {
+			wldbg_connection_queues(conn, queue);
+			printf(", paused with %u + %u bytes queued",
+			       queue[WLDBG_METRICS_CLIENT_IN],
+			       queue[WLDBG_METRICS_SERVER_IN]);
+		}
+		putchar('\n');
+	}
+
+	printf("Decisions of rules: %u cached, %lu hits, %lu misses\n",
+	       mc->count, mc->hits, mc->misses);
+
+	/* what the passes gathered, the same as on SIGUSR1 */
+	if (wldbg_report(wldbg) == 0)
+		printf("No pass reports statistics\n");
+}
+
 void
 cmd_info_help(int oneline)
 {
@@ -179,7 +223,9 @@ cmd_info_help(int oneline)
 	       "breakpoints (b)\n"
 	       "filters (f)\n"
 	       "process (proc, p)\n"
-	       "connection (conn, c)\n");
+	       "connection (conn, c)\n"
+	       "stats (s)\n"
+	       "profile (prof)\n");
 }
 
 void
@@ -201,7 +247,11 @@ cmd_info(struct wldbg_interactive *wldbgi,
 {
 #define MATCH(buf, str) (strncmp((buf), (str), (sizeof((str)) + 1)) == 0)
 
-	if (MATCH(buf, "m") || MATCH(buf, "message")) {
+	/* typed while the client is running */
+	if (!message && (MATCH(buf, "m") || MATCH(buf, "message")
+			 || *buf == 'o')) {
+		printf("No message, the client is running\n");
+	} else if (MATCH(buf, "m") || MATCH(buf, "message")) {
 		printf("Sender: %s (no. %lu), size: %lu\n",
 			message->from == SERVER ? "server" : "client",
 			message->from == SERVER ? wldbgi->statistics.server_msg_no
@@ -227,6 +277,13 @@ cmd_info(struct wldbg_interactive *wldbgi,
 	} else if (MATCH(buf, "c") || MATCH(buf, "conn")
 		   || MATCH(buf, "connection")) {
 		info_connections(wldbgi);
+	} else if (MATCH(buf, "s") || MATCH(buf, "stats")) {
+		info_stats(wldbgi);
+	} else if (MATCH(buf, "prof") || MATCH(buf, "profile")) {
+		if (wldbgi->wldbg->flags.profiling)
+			wldbg_print_profile(wldbgi->wldbg);
+		else
+			printf("Not profiling, run wldbg with --profile\n");
 	} else {
 		printf("Unknown arguments\n");
 		cmd_info_help(0);
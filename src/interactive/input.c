@@ -3,6 +3,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
 
 #include "interactive.h"
 #include "input.h"
@@ -10,19 +14,237 @@
 
 #define WLDBG_PROMPT "(wldbg)"
 
+/* what to do while waiting for the input, see wldbgi_set_input_hook() */
+static struct {
+	int fd;
+	int (*dispatch)(void *data);
+	void *data;
+} hook = { -1, NULL, NULL };
+
+void
+wldbgi_set_input_hook(int fd, int (*dispatch)(void *data), void *data)
+{
+	hook.fd = fd;
+	hook.dispatch = dispatch;
+	hook.data = data;
+
+	/* anything buffered in stdin would not wake up poll() */
+	setvbuf(stdin, NULL, _IONBF, 0);
+}
+
+/* the line of the console that is not whole yet */
+static struct {
+	char buf[1024];
+	size_t len;
+} console;
+
+char *
+wldbgi_read_console(int fd, int *eof)
+{
+	int avail = 0;
+	ssize_t ret;
+	char c;
+
+	*eof = 0;
+
+	/* readable with nothing to read is the end of input */
+	if (ioctl(fd, FIONREAD, &avail) < 0 || avail == 0) {
+		*eof = 1;
+		return NULL;
+	}
+
+	/* read by bytes so that nothing after the line
+	 * is left in our buffer, the prompt reads it */
+	while (avail-- > 0) {
+		ret = read(fd, &c, 1);
+		if (ret <= 0) {
+			*eof = ret == 0 || errno != EINTR;
+			return NULL;
+		}
+
+		if (c == '\n') {
+			console.buf[console.len] = '\0';
+			console.len = 0;
+			return strdup(console.buf);
+		}
+
+		/* too long lines are truncated */
+		if (console.len < sizeof console.buf - 1)
+			console.buf[console.len++] = c;
+	}
+
+	return NULL;
+}
+
+/* the hook can print and open a prompt of its own, so the input
+ * that is being read is put aside while it runs */
+static void *
+suspend_input(int tty);
+
+static void
+resume_input(void *saved, int tty);
+
+/* wait until there is something to read on fd and
+ * run the hook meanwhile. Return -1 if the hook failed */
+static int
+wait_input(int fd)
+{
+	struct pollfd pfds[2];
+	int tty = isatty(STDOUT_FILENO), ret;
+	void *saved;
+
+	if (!hook.dispatch)
+		return 0;
+
+	pfds[0].fd = fd;
+	pfds[0].events = POLLIN;
+	pfds[1].fd = hook.fd;
+	pfds[1].events = POLLIN;
+
+	while (1) {
+		if (poll(pfds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("poll");
+			return -1;
+		}
+
+		if (pfds[0].revents)
+			return 0;
+
+		if (pfds[1].revents) {
+			saved = suspend_input(tty);
+			ret = hook.dispatch(hook.data);
+			resume_input(saved, tty);
+
+			if (ret <= 0)
+				return -1;
+		}
+	}
+}
+
 #ifdef HAVE_LIBREADLINE
 
 #include <readline/readline.h>
 #include <readline/history.h>
 
+/* the line read by the callback interface of readline */
+static struct {
+	char *line;
+	int done;
+} input;
+
+struct saved_input {
+	char *line;
+	int point;
+};
+
+static void
+line_handler(char *line)
+{
+	/* do not show the prompt again */
+	rl_callback_handler_remove();
+
+	input.line = line;
+	input.done = 1;
+}
+
+static void *
+suspend_input(int tty)
+{
+	struct saved_input *saved;
+
+	saved = malloc(sizeof *saved);
+	if (saved) {
+		saved->point = rl_point;
+		saved->line = rl_copy_text(0, rl_end);
+	}
+
+	/* clear the prompt with what the user typed so far */
+	if (tty) {
+		rl_save_prompt();
+		rl_replace_line("", 0);
+		rl_redisplay();
+		rl_restore_prompt();
+	}
+
+	/* readline is not reentrant, the hook
+	 * may need it for another prompt */
+	rl_callback_handler_remove();
+
+	return saved;
+}
+
+static void
+resume_input(void *data, int tty)
+{
+	struct saved_input *saved = data;
+
+	(void) tty;
+
+	rl_callback_handler_install(WLDBG_PROMPT " ", line_handler);
+	if (saved) {
+		rl_replace_line(saved->line ? saved->line : "", 0);
+		rl_point = saved->point;
+		rl_redisplay();
+
+		free(saved->line);
+		free(saved);
+	}
+}
+
 char *
 wldbgi_read_input(void)
 {
-	return readline(WLDBG_PROMPT " ");
+	char *line;
+
+	if (!hook.dispatch)
+		return readline(WLDBG_PROMPT " ");
+
+	input.line = NULL;
+	input.done = 0;
+
+	rl_callback_handler_install(WLDBG_PROMPT " ", line_handler);
+	while (!input.done) {
+		if (wait_input(fileno(rl_instream ? rl_instream : stdin)) < 0) {
+			rl_callback_handler_remove();
+			return NULL;
+		}
+
+		rl_callback_read_char();
+	}
+
+	/* reset it for the prompt we could be nested in */
+	line = input.line;
+	input.line = NULL;
+	input.done = 0;
+
+	return line;
 }
 
 #else /* HAVE_LIBREADLINE */
 
+static void *
+suspend_input(int tty)
+{
+	if (tty)
+		putchar('\r');
+
+	return NULL;
+}
+
+static void
+resume_input(void *saved, int tty)
+{
+	(void) saved;
+
+	if (tty) {
+		printf(WLDBG_PROMPT " ");
+		fflush(stdout);
+	}
+}
+
 char *
 wldbgi_read_input(void)
 {
@@ -34,7 +256,10 @@ wldbgi_read_input(void)
 	}
 
 	printf(WLDBG_PROMPT " ");
-	if (fgets(buf, DEFAULT_BUFFER_SIZE, stdin) == NULL) {
+	fflush(stdout);
+
+	if (wait_input(STDIN_FILENO) < 0
+	    || fgets(buf, DEFAULT_BUFFER_SIZE, stdin) == NULL) {
 		free(buf);
 		return NULL;
 	}
@@ -29,6 +29,17 @@
 char *
 wldbgi_read_input(void);
 
+/* while waiting for the input, call dispatch every time
+ * fd is readable. The input is not read when it returns <= 0 */
+void
+wldbgi_set_input_hook(int fd, int (*dispatch)(void *data), void *data);
+
+/* read what is available on fd without blocking. Returns the line when
+ * it is whole (without the newline), NULL otherwise. *eof is set when
+ * there is nothing more to read */
+char *
+wldbgi_read_console(int fd, int *eof);
+
 char *
 wldbgi_get_last_command(struct wldbg_interactive *);
 
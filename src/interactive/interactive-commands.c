@@ -110,7 +110,10 @@ cmd_next(struct wldbg_interactive *wldbgi,
 		return CMD_CONTINUE_QUERY;
 	}
 
+	/* in server mode, stop on the next
+	 * message of the same connection */
 	wldbgi->stop = 1;
+	wldbgi->stop_connection = wldbgi->current_connection;
 	return CMD_END_QUERY;
 }
 
@@ -155,19 +158,19 @@ cmd_help_help(int oneline)
 /* XXX keep sorted! (in the future I'd like to do
  * binary search in this array */
 const struct command commands[] = {
-	{"autocmd", NULL, cmd_autocmd, cmd_autocmd_help},
-	{"break", "b", cmd_break, cmd_break_help},
-	{"continue", "c", cmd_continue, cmd_continue_help},
-	{"edit", "e", cmd_edit, cmd_edit_help},
-	{"filter", "f", cmd_filter, cmd_filter_help},
-	{"help", NULL,  cmd_help, cmd_help_help},
-	{"hide", "h",  cmd_hide, cmd_hide_help},
-	{"info", "i", cmd_info, cmd_info_help},
-	{"next", "n",  cmd_next, cmd_next_help},
-	{"pass", NULL, cmd_pass, cmd_pass_help},
-	{"send", "s", cmd_send, cmd_send_help},
-	{"showonly", "so", cmd_showonly, cmd_showonly_help},
-	{"quit", "q", cmd_quit, cmd_quit_help},
+	{"autocmd", NULL, cmd_autocmd, cmd_autocmd_help, 1},
+	{"break", "b", cmd_break, cmd_break_help, 1},
+	{"continue", "c", cmd_continue, cmd_continue_help, 0},
+	{"edit", "e", cmd_edit, cmd_edit_help, 0},
+	{"filter", "f", cmd_filter, cmd_filter_help, 1},
+	{"help", NULL,  cmd_help, cmd_help_help, 1},
+	{"hide", "h",  cmd_hide, cmd_hide_help, 1},
+	{"info", "i", cmd_info, cmd_info_help, 1},
+	{"next", "n",  cmd_next, cmd_next_help, 0},
+	{"pass", NULL, cmd_pass, cmd_pass_help, 1},
+	{"send", "s", cmd_send, cmd_send_help, 0},
+	{"showonly", "so", cmd_showonly, cmd_showonly_help, 1},
+	{"quit", "q", cmd_quit, cmd_quit_help, 1},
 
 };
 
@@ -236,7 +239,9 @@ cmd_help(struct wldbg_interactive *wldbgi,
 	putchar ('\n');
 
 	if (!all)
-		printf("Try 'help all' or 'help command_name' for verbose output\n\n");
+		printf("Try 'help all' or 'help command_name' for verbose output.\n"
+		       "Commands marked with * can be typed also while\n"
+		       "the client is running\n\n");
 
 	for (i = 0; i < sizeof commands / sizeof *commands; ++i) {
 		if (all)
@@ -244,9 +249,10 @@ cmd_help(struct wldbg_interactive *wldbgi,
 		else
 			printf("\t");
 
-		printf("%-12s (%s)",
+		printf("%-12s (%s)%s",
 		       commands[i].name,
-		       commands[i].shortcut ? commands[i].shortcut : "-");
+		       commands[i].shortcut ? commands[i].shortcut : "-",
+		       commands[i].live ? " *" : "");
 
 		if (all)
 			printf(" ==\n\n");
@@ -297,3 +303,25 @@ run_command(char *buf,
 
 	return CMD_DONT_MATCH;
 }
+
+int
+run_live_command(char *buf, struct wldbg_interactive *wldbgi)
+{
+	size_t n;
+
+	for (n = 0; n < (sizeof commands / sizeof *commands); ++n) {
+		if (!is_the_cmd(buf, &commands[n]))
+			continue;
+
+		if (!commands[n].live) {
+			printf("'%s' needs a stopped client, "
+			       "press Ctrl-C to stop it\n", commands[n].name);
+			return CMD_CONTINUE_QUERY;
+		}
+
+		return commands[n].func(wldbgi, NULL, next_word(buf));
+	}
+
+	printf("Unknown command: %s\n", buf);
+	return CMD_DONT_MATCH;
+}
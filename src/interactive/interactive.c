@@ -78,6 +78,12 @@ query_user(struct wldbg_interactive *wldbgi, struct wldbg_message *message)
 
 		buf = wldbgi_read_input();
 		if (!buf) {
+			/* the other connections could have ended it
+			 * while we were waiting for the input */
+			if (wldbgi->wldbg->flags.exit
+			    || wldbgi->wldbg->flags.error)
+				break;
+
 			if(cmd_quit(wldbgi, NULL, NULL) == CMD_END_QUERY)
 				break;
 			else
@@ -109,65 +115,88 @@ query_user(struct wldbg_interactive *wldbgi, struct wldbg_message *message)
 	free(buf);
 }
 
+/* the console and the prompt must not read stdin both at once */
+static void
+prompt_begin(struct wldbg_interactive *wldbgi)
+{
+	if (wldbgi->prompts++ == 0 && wldbgi->console)
+		wldbg_pause_fd(wldbgi->wldbg, STDIN_FILENO, 1);
+}
+
+static void
+prompt_end(struct wldbg_interactive *wldbgi)
+{
+	if (--wldbgi->prompts == 0 && wldbgi->console)
+		wldbg_pause_fd(wldbgi->wldbg, STDIN_FILENO, 0);
+}
+
 /* return 1 if some of filters matches */
 static int
 filter_match(struct wl_list *filters, struct wldbg_message *message)
 {
-	struct filter *pf;
 	char buf[128];
-	int ret, has_show_only = 0;
-
-	wl_list_for_each(pf, filters, link) {
-		ret = wldbg_get_message_name(message, buf, sizeof buf);
-		if (ret >= (int) sizeof buf) {
-			fprintf(stderr, "BUG: buffer too small for message name\n");
-			continue;
-		}
-
-		/* run regular expression */
-		ret = regexec(&pf->regex, buf, 0, NULL, 0);
-
-		/* got we match? */
-		if (ret == 0) {
-			vdbg("filter: '%s' <-> '%s' MATCH\n", pf->filter, buf);
-
-			/* If this filter is show_only,
-			 * we must return 0, because we'd like to show this message */
-			if (pf->show_only)
-				return 0;
+	int ret;
 
-			return 1;
-		} else if (ret != REG_NOMATCH) {
-			fprintf(stderr, "Executing regexp failed!\n");
-			return 0;
-		}
+	if (wl_list_empty(filters))
+		return 0;
 
-		if (pf->show_only)
-			has_show_only = 1;
+	ret = wldbg_get_message_name(message, buf, sizeof buf);
+	if (ret >= (int) sizeof buf) {
+		fprintf(stderr, "BUG: buffer too small for message name\n");
+		return 0;
 	}
 
-	/* if we haven't found filter match and we have some show_only filters,
-	 * we must return 1 so that this message will get hidden */
-	if (has_show_only)
-		return 1;
+	return filter_match_name(filters, buf, message);
+}
 
-	return 0;
+/* stop flag set by the user is for this message */
+static int
+stop_pending(struct wldbg_interactive *wldbgi, struct wldbg_message *message)
+{
+	return wldbgi->stop
+		&& (wldbgi->stop_connection == 0
+		    || wldbgi->stop_connection == message->connection->id);
 }
 
 static void
 process_message(struct wldbg_interactive *wldbgi, struct wldbg_message *message)
 {
-	if (wldbgi->stop) {
-		dbg("Stopped at message no. %lu from %s\n",
-			message->from == SERVER ?
-				wldbgi->statistics.server_msg_no :
-				wldbgi->statistics.client_msg_no,
-			message->from == SERVER ?
-				"server" : "client");
-		/* reset flag */
+	struct wldbg *wldbg = wldbgi->wldbg;
+	struct wldbg_connection *conn = message->connection;
+	unsigned int current = wldbgi->current_connection;
+
+	dbg("Stopped at message no. %lu from %s\n",
+		message->from == SERVER ?
+			wldbgi->statistics.server_msg_no :
+			wldbgi->statistics.client_msg_no,
+		message->from == SERVER ?
+			"server" : "client");
+
+	/* reset flag, unless it is for another connection */
+	if (stop_pending(wldbgi, message)) {
 		wldbgi->stop = 0;
-		query_user(wldbgi, message);
+		wldbgi->stop_connection = 0;
 	}
+
+	/* in server mode, only this connection waits for the user,
+	 * the others are dispatched while reading the input */
+	if (wldbg->flags.server_mode) {
+		printf("Stopped connection %u (%s)\n", conn->id,
+		       conn->client.program ? conn->client.program : "unknown");
+		if (wldbg_connection_pause(conn, 1) < 0)
+			fprintf(stderr, "Failed pausing the connection\n");
+	}
+
+	wldbgi->current_connection = conn->id;
+	prompt_begin(wldbgi);
+
+	query_user(wldbgi, message);
+
+	prompt_end(wldbgi);
+	wldbgi->current_connection = current;
+
+	if (wldbg->flags.server_mode)
+		wldbg_connection_pause(conn, 0);
 }
 
 int
@@ -177,9 +206,12 @@ static int
 process_interactive(void *user_data, struct wldbg_message *message)
 {
 	struct wldbg_interactive *wldbgi = user_data;
+	struct match_decision *decision = NULL;
 	struct breakpoint *b;
 	struct autocmd *ac;
-	int skip_message = 0;
+	int skip_message = 0, applies, breakpoint = 0;
+	unsigned int i;
+	uint32_t generation;
 
 	vdbg("Mesagge from %s\n",
 		message->from == SERVER ? "SERVER" : "CLIENT");
@@ -196,14 +228,35 @@ process_interactive(void *user_data, struct wldbg_message *message)
 		wldbgi->stop = 1;
 	}
 
+	/* the rules matching on names decide the same
+	 * for all messages of one type on one object */
+	if (!wl_list_empty(&wldbgi->filters)
+	    || !wl_list_empty(&wldbgi->breakpoints)
+	    || !wl_list_empty(&wldbgi->autocmds))
+		decision = match_cache_get(wldbgi, message);
+
 	/* if some filter matches, we will skip this message
 	 * unless some other condition tell us that we should
 	 * not skip it (like breakpoint or so) */
-	skip_message = filter_match(&wldbgi->filters, message);
+	skip_message = -1;
+	if (decision)
+		skip_message = match_cache_skip(wldbgi, decision, message);
+	if (skip_message == -1)
+		skip_message = filter_match(&wldbgi->filters, message);
 
+	i = 0;
 	wl_list_for_each(b, &wldbgi->breakpoints, link) {
-		if (b->applies(message, b)) {
-			wldbgi->stop = 1;
+		if (decision && b->name_regex && i < MATCH_CACHE_MAX_RULES)
+			applies = !!(decision->breakpoints & ((uint64_t) 1 << i));
+		else
+			applies = b->applies(message, b);
+		++i;
+
+		if (applies && b->condition)
+			applies = condition_eval_message(b->condition, message);
+
+		if (applies) {
+			breakpoint = 1;
 			/* reset skip_message flag, we want
 			 * to stop on this message */
 			skip_message = 0;
@@ -212,15 +265,27 @@ process_interactive(void *user_data, struct wldbg_message *message)
 	}
 
 	/* autocommands */
+	i = 0;
 	wl_list_for_each(ac, &wldbgi->autocmds, link) {
-		if (message_match_autocmd(message, ac)) {
+		if (decision && i < MATCH_CACHE_MAX_RULES)
+			applies = !!(decision->autocmds & ((uint64_t) 1 << i));
+		else
+			applies = message_match_autocmd(message, ac);
+		++i;
+
+		if (applies) {
 			dbg("Running auto command: '%s'\n", ac->cmd);
 			/* XXX what if something changes the message? */
+			generation = wldbgi->match_cache.generation;
 			run_command(ac->cmd, wldbgi, message);
+			/* the command changed the rules */
+			if (generation != wldbgi->match_cache.generation)
+				decision = NULL;
 		}
 	}
 
-	if (!skip_message)
+	if (!skip_message
+	    && (breakpoint || stop_pending(wldbgi, message)))
 		process_message(wldbgi, message);
 
 	/* This is always the last pass. Even when user will add
@@ -264,11 +329,13 @@ wldbgi_destory(void *data)
 		free_breakpoint(b);
 	wl_list_for_each_safe(pf, pftmp, &wldbgi->filters, link) {
 		regfree(&pf->regex);
+		condition_free(pf->condition);
 		free(pf->filter);
 		free(pf);
 	}
 	wl_list_for_each_safe(ac, actmp, &wldbgi->autocmds, link)
 		free_autocmd(ac);
+	match_cache_release(&wldbgi->match_cache);
 
 	free(wldbgi);
 }
@@ -288,12 +355,64 @@ handle_sigint(int fd, void *data)
 
 	vdbg("Wldbgi: Got interrupt (SIGINT)\n");
 
+	/* we got here while dispatching the other
+	 * connections from the prompt, nothing to do */
+	if (wldbgi->prompts > 0)
+		return 1;
+
 	putchar('\n');
+
+	prompt_begin(wldbgi);
 	query_user(wldbgi, &wldbgi->wldbg->message);
+	prompt_end(wldbgi);
 
 	return 1;
 }
 
+/* commands typed while the client runs. They run between
+ * two messages, so no message is being processed meanwhile */
+static int
+handle_console(int fd, void *data)
+{
+	struct wldbg_interactive *wldbgi = data;
+	char *buf, *cmd;
+	int eof;
+
+	buf = wldbgi_read_console(fd, &eof);
+	if (eof) {
+		vdbg("Wldbgi: console closed\n");
+		wldbg_remove_callback(wldbgi->wldbg, wldbgi->console);
+		wldbgi->console = NULL;
+		return 1;
+	}
+
+	if (!buf)
+		return 1;
+
+	cmd = skip_ws(buf);
+	if (*cmd != '\0') {
+		wldbgi_add_history(wldbgi, cmd);
+		run_live_command(cmd, wldbgi);
+	}
+
+	free(buf);
+	return 1;
+}
+
+/* in server mode, the connections that are not
+ * stopped keep running while we wait for the user */
+static int
+dispatch_others(void *data)
+{
+	struct wldbg_interactive *wldbgi = data;
+	struct wldbg *wldbg = wldbgi->wldbg;
+
+	if (wldbg_dispatch_nested(wldbg) < 0)
+		wldbg->flags.error = 1;
+
+	return !wldbg->flags.exit && !wldbg->flags.error;
+}
+
 int
 interactive_init(struct wldbg *wldbg)
 {
@@ -311,6 +430,7 @@ interactive_init(struct wldbg *wldbg)
 	wl_list_init(&wldbgi->breakpoints);
 	wl_list_init(&wldbgi->filters);
 	wl_list_init(&wldbgi->autocmds);
+	match_cache_init(&wldbgi->match_cache);
 
 	wldbgi->wldbg = wldbg;
 
@@ -324,7 +444,7 @@ interactive_init(struct wldbg *wldbg)
             dealloc_pass ( pass );
         }
 
-        wl_list_insert ( wldbg->passes.next, &pass->link );
+        insert_pass ( wldbg, pass );
         dbg ( "Pass '%s' loaded\n", argv[0] );
     } else {
         dbg ( "Loading pass 'dump' failed\n");
@@ -376,11 +496,28 @@ interactive_init(struct wldbg *wldbg)
 	using_history();
 #endif
 
+	if (wldbg->flags.server_mode)
+		wldbgi_set_input_hook(wldbg->epoll_fd,
+				      dispatch_others, wldbgi);
+
 	vdbg("Adding interactive SIGINT handler (fd %d)\n", wldbgi->sigint_fd);
 	if (wldbg_monitor_fd(wldbg, wldbgi->sigint_fd,
 			     handle_sigint, wldbgi) == NULL)
 		goto err_pass;
 
+	/* only for a terminal, piped commands are meant
+	 * for the prompts and must wait for them */
+	if (isatty(STDIN_FILENO)) {
+		wldbgi->console = wldbg_monitor_fd(wldbg, STDIN_FILENO,
+						   handle_console, wldbgi);
+		if (!wldbgi->console)
+			fprintf(stderr, "Failed adding the console, "
+					"commands work only when stopped\n");
+		/* no stdio buffering, the prompt and the console
+		 * share stdin */
+		setvbuf(stdin, NULL, _IONBF, 0);
+	}
+
 	return 0;
 
 err_pass:
@@ -31,6 +31,46 @@
 
 #include "wldbg.h"
 #include "wayland/wayland-util.h"
+#include "condition.h"
+
+/* breakpoints and autocmds with a cached decision,
+ * the rest is matched on every message */
+#define MATCH_CACHE_MAX_RULES 64
+/* the decisions are dropped when there are this many,
+ * new objects keep coming when the client runs long */
+#define MATCH_CACHE_MAX_SIZE (1 << 16)
+
+/* what the rules matching on message names decided for
+ * messages of one type on one object, see match-cache.c */
+struct match_decision {
+	const struct wl_interface *interface;
+	uint32_t id;
+	uint32_t opcode;
+	int from;
+	int used;
+
+	/* filters hide the message, if they have no conditions */
+	int skip;
+	/* a bit for every filter, breakpoint and autocmd whose
+	 * regex matches, in the order of their lists */
+	uint64_t filters;
+	uint64_t breakpoints;
+	uint64_t autocmds;
+	/* there are no more filters than bits */
+	int all_filters;
+};
+
+/* open addressing hash table of decisions */
+struct match_cache {
+	struct match_decision *entries;
+	uint32_t size;
+	uint32_t count;
+	/* bumped on every invalidation */
+	uint32_t generation;
+
+	uint64_t hits;
+	uint64_t misses;
+};
 
 struct wldbg_interactive {
 	struct wldbg *wldbg;
@@ -53,8 +93,20 @@ struct wldbg_interactive {
 
 	/* query user on the next message */
 	int stop;
+	/* ... but only on a message of this connection, if not 0 */
+	unsigned int stop_connection;
 	int skip_first_query;
 
+	/* the connection we are stopped on, 0 if none */
+	unsigned int current_connection;
+	/* how many prompts are open, nested prompts
+	 * are open for other connections in server mode */
+	int prompts;
+
+	/* reads commands from the terminal while the client
+	 * is running, NULL if stdin is not a terminal */
+	struct wldbg_fd_callback *console;
+
 	/* commands history */
 	char *last_command;
 
@@ -63,9 +115,15 @@ struct wldbg_interactive {
 
 	/* filters for printing messages */
 	struct wl_list filters;
+	/* how many of them have a condition */
+	unsigned int conditional_filters;
 
 	/* auto commands */
 	struct wl_list autocmds;
+
+	/* decisions of filters, breakpoints and autocmds,
+	 * must be invalidated when any of them changes */
+	struct match_cache match_cache;
 };
 
 struct command {
@@ -79,6 +137,9 @@ struct command {
 	/* this function prints help for the command.
 	 * If argument is not zero, then print short, oneline description */
 	void (*help)(int oneline);
+	/* the command works also while the client is running,
+	 * then it gets NULL instead of the message */
+	int live;
 };
 
 /* exit state of command */
@@ -95,6 +156,10 @@ int
 run_command(char *buf,
 		struct wldbg_interactive *wldbgi, struct wldbg_message *message);
 
+/* run command typed while the client is running */
+int
+run_live_command(char *buf, struct wldbg_interactive *wldbgi);
+
 
 struct breakpoint {
 	unsigned int id;
@@ -104,6 +169,11 @@ struct breakpoint {
 	/* this function returns true if wldbg should stop
 	 * on given message */
 	int (*applies)(struct wldbg_message *, struct breakpoint *);
+	/* if set, the breakpoint applies to messages whose name matches
+	 * this regex and the decision is cached for the message type */
+	regex_t *name_regex;
+	/* if set, the breakpoint applies only when this holds */
+	struct condition *condition;
 	void *data;
 	uint64_t small_data;
 	/* function to destroy data */
@@ -116,6 +186,8 @@ struct breakpoint {
 struct filter {
 	char *filter;
 	regex_t regex;
+	/* hide or show only when this holds too, may be NULL */
+	struct condition *condition;
 	struct wl_list link;
 	int show_only;
     unsigned int id;
@@ -133,4 +205,34 @@ struct autocmd {
     unsigned int id;
 };
 
+/* defined in match-cache.c */
+int
+match_message_name(regex_t *regex, const char *name);
+
+/* return 1 if filters hide message with this name. The conditions
+ * of filters are evaluated only if message is not NULL */
+int
+filter_match_name(struct wl_list *filters, const char *name,
+		  struct wldbg_message *message);
+
+/* whether the filters hide the message, using the decision.
+ * -1 if there are too many filters with conditions to use it */
+int
+match_cache_skip(struct wldbg_interactive *wldbgi, struct match_decision *d,
+		 struct wldbg_message *message);
+
+void
+match_cache_init(struct match_cache *cache);
+
+void
+match_cache_release(struct match_cache *cache);
+
+void
+match_cache_invalidate(struct match_cache *cache);
+
+/* get the decision for the message, computing it if this is
+ * the first message of its type. NULL if out of memory */
+struct match_decision *
+match_cache_get(struct wldbg_interactive *wldbgi, struct wldbg_message *message);
+
 #endif /* _WLDBG_INTERACTIVE_H_ */
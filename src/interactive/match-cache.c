@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Filters, regex breakpoints and autocmds match on message names like
+ * wl_pointer@8.motion. The name depends only on the side, the interface,
+ * the object id and the opcode of the message, so we remember what the
+ * rules decided for these and run the regular expressions only for
+ * messages we haven't seen yet. The decisions are dropped whenever
+ * some rule is added or removed. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <regex.h>
+
+#include "wldbg.h"
+#include "interactive.h"
+#include "wldbg-private.h"
+#include "util.h"
+
+int
+match_message_name(regex_t *regex, const char *name)
+{
+	int ret;
+
+	ret = regexec(regex, name, 0, NULL, 0);
+	if (ret == 0)
+		return 1;
+	else if (ret != REG_NOMATCH)
+		fprintf(stderr, "Executing regexp failed!\n");
+
+	return 0;
+}
+
+static int
+filter_condition(struct filter *pf, struct wldbg_message *message)
+{
+	return !pf->condition || !message
+		|| condition_eval_message(pf->condition, message);
+}
+
+int
+filter_match_name(struct wl_list *filters, const char *name,
+		  struct wldbg_message *message)
+{
+	struct filter *pf;
+	int has_show_only = 0;
+
+	wl_list_for_each(pf, filters, link) {
+		if (match_message_name(&pf->regex, name)
+		    && filter_condition(pf, message)) {
+			vdbg("filter: '%s' <-> '%s' MATCH\n", pf->filter, name);
+
+			/* If this filter is show_only,
+			 * we must return 0, because we'd like to show this message */
+			return !pf->show_only;
+		}
+
+		if (pf->show_only)
+			has_show_only = 1;
+	}
+
+	/* if we haven't found filter match and we have some show_only filters,
+	 * we must return 1 so that this message will get hidden */
+	return has_show_only;
+}
+
+void
+match_cache_init(struct match_cache *cache)
+{
+	memset(cache, 0, sizeof *cache);
+}
+
+void
+match_cache_release(struct match_cache *cache)
+{
+	free(cache->entries);
+	match_cache_init(cache);
+}
+
+void
+match_cache_invalidate(struct match_cache *cache)
+{
+	++cache->generation;
+	if (cache->count == 0)
+		return;
+
+	memset(cache->entries, 0, cache->size * sizeof *cache->entries);
+	cache->count = 0;
+}
+
+static uint32_t
+hash_key(const struct wl_interface *intf, uint32_t id,
+	 uint32_t opcode, int from)
+{
+	uint64_t h = (uintptr_t) intf;
+
+	h ^= ((uint64_t) id << 17) ^ ((uint64_t) opcode << 1) ^ from;
+	h *= 0x9e3779b97f4a7c15ULL;
+
+	return h >> 32;
+}
+
+static int
+match_cache_grow(struct match_cache *cache)
+{
+	struct match_decision *old = cache->entries, *e;
+	uint32_t old_size = cache->size, i, size;
+
+	size = old_size ? old_size * 2 : 256;
+	if (size > MATCH_CACHE_MAX_SIZE) {
+		match_cache_invalidate(cache);
+		return 0;
+	}
+
+	cache->entries = calloc(size, sizeof *cache->entries);
+	if (!cache->entries) {
+		cache->entries = old;
+		return -1;
+	}
+
+	cache->size = size;
+	cache->count = 0;
+
+	for (i = 0; i < old_size; ++i) {
+		if (!old[i].used)
+			continue;
+
+		e = &cache->entries[hash_key(old[i].interface, old[i].id,
+					     old[i].opcode, old[i].from)
+				    & (size - 1)];
+		while (e->used)
+			e = e == &cache->entries[size - 1] ?
+				cache->entries : e + 1;
+
+		*e = old[i];
+		++cache->count;
+	}
+
+	free(old);
+	return 0;
+}
+
+static void
+decide(struct wldbg_interactive *wldbgi, struct match_decision *d,
+       const char *name)
+{
+	struct filter *pf;
+	struct breakpoint *b;
+	struct autocmd *ac;
+	unsigned int i = 0;
+
+	d->skip = filter_match_name(&wldbgi->filters, name, NULL);
+
+	d->all_filters = 1;
+	wl_list_for_each(pf, &wldbgi->filters, link) {
+		if (i >= MATCH_CACHE_MAX_RULES) {
+			d->all_filters = 0;
+			break;
+		}
+		if (match_message_name(&pf->regex, name))
+			d->filters |= (uint64_t) 1 << i;
+		++i;
+	}
+
+	i = 0;
+	wl_list_for_each(b, &wldbgi->breakpoints, link) {
+		if (i >= MATCH_CACHE_MAX_RULES)
+			break;
+		if (b->name_regex && match_message_name(b->name_regex, name))
+			d->breakpoints |= (uint64_t) 1 << i;
+		++i;
+	}
+
+	i = 0;
+	wl_list_for_each(ac, &wldbgi->autocmds, link) {
+		if (i >= MATCH_CACHE_MAX_RULES)
+			break;
+		if (match_message_name(&ac->regex, name))
+			d->autocmds |= (uint64_t) 1 << i;
+		++i;
+	}
+}
+
+int
+match_cache_skip(struct wldbg_interactive *wldbgi, struct match_decision *d,
+		 struct wldbg_message *message)
+{
+	struct filter *pf;
+	int has_show_only = 0;
+	unsigned int i = 0;
+
+	/* without conditions the decision is the same for all messages */
+	if (wldbgi->conditional_filters == 0)
+		return d->skip;
+	if (!d->all_filters)
+		return -1;
+
+	/* the same as filter_match_name() */
+	wl_list_for_each(pf, &wldbgi->filters, link) {
+		if ((d->filters & ((uint64_t) 1 << i))
+		    && filter_condition(pf, message))
+			return !pf->show_only;
+
+		if (pf->show_only)
+			has_show_only = 1;
+		++i;
+	}
+
+	return has_show_only;
+}
+
+struct match_decision *
+match_cache_get(struct wldbg_interactive *wldbgi, struct wldbg_message *message)
+{
+	struct match_cache *cache = &wldbgi->match_cache;
+	const struct wl_interface *intf;
+	struct match_decision *d;
+	uint32_t *data = message->data;
+	uint32_t id = data[0], opcode = data[1] & 0xffff;
+	char name[128];
+	int ret;
+
+	intf = wldbg_message_get_object(message, id);
+
+	if (cache->size) {
+		d = &cache->entries[hash_key(intf, id, opcode, message->from)
+				    & (cache->size - 1)];
+		while (d->used) {
+			if (d->interface == intf && d->id == id
+			    && d->opcode == opcode && d->from == message->from) {
+				++cache->hits;
+				return d;
+			}
+
+			d = d == &cache->entries[cache->size - 1] ?
+				cache->entries : d + 1;
+		}
+	}
+
+	/* keep the load under 3/4 */
+	if ((cache->count + 1) * 4 > cache->size * 3
+	    && match_cache_grow(cache) < 0)
+		return NULL;
+
+	ret = wldbg_get_message_name(message, name, sizeof name);
+	if (ret >= (int) sizeof name) {
+		fprintf(stderr, "BUG: buffer too small for message name\n");
+		return NULL;
+	}
+
+	d = &cache->entries[hash_key(intf, id, opcode, message->from)
+			    & (cache->size - 1)];
+	while (d->used)
+		d = d == &cache->entries[cache->size - 1] ?
+			cache->entries : d + 1;
+
+	d->used = 1;
+	d->interface = intf;
+	d->id = id;
+	d->opcode = opcode;
+	d->from = message->from;
+	decide(wldbgi, d, name);
+
+	++cache->count;
+	++cache->misses;
+
+	return d;
+}
@@ -72,7 +72,7 @@ add_pass(struct wldbg *wldbg, const char *name)
 			dealloc_pass(pass);
 		} else {
 			/* insert always at the head */
-			wl_list_insert(wldbg->passes.next, &pass->link);
+			insert_pass(wldbg, pass);
 
 			dbg("Added pass '%s'\n", name);
 		}
@@ -103,9 +103,7 @@ remove_pass(struct wldbg *wldbg, const char *name)
 	wl_list_for_each_safe(pass, tmp, &wldbg->passes, link) {
 		if (strcmp(pass->name, name) == 0) {
 			wl_list_remove(&pass->link);
-
-			free(pass->name);
-			free(pass);
+			dealloc_pass(pass);
 
 			dbg("Removed pass '%s'\n", name);
 			return;
@@ -0,0 +1,392 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Pair requests with the events that answer them and keep histograms
+ * of the round-trip times per client. Since wldbg sits between the
+ * client and the compositor, this is the time the compositor needed
+ * to answer (plus the time of going through wldbg) */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* for WL_SERVER_ID_START */
+#include "wayland/wayland-private.h"
+
+#include <wayland-server-protocol.h>
+#include <wayland-client-protocol.h>
+
+#include "wldbg.h"
+#include "wldbg-pass.h"
+#include "wldbg-private.h"
+#include "wldbg-histogram.h"
+#include "wldbg-parse-message.h"
+#include "pass-connections.h"
+#include "passes.h"
+
+enum latency_kind {
+	LATENCY_SYNC,
+	LATENCY_FRAME,
+	LATENCY_RELEASE,
+	LATENCY_REGISTRY,
+	LATENCY_KINDS_NUM
+};
+
+static const char *latency_names[] = {
+	"sync -> done",
+	"frame -> done",
+	"attach+commit -> release",
+	"get_registry -> last global",
+};
+
+/* what is pending on an object allocated by client */
+struct latency_object {
+	/* for callbacks and buffers */
+	uint64_t start;
+	uint32_t kind;
+	uint32_t pending;
+
+	/* for surfaces: buffer attached since the last commit */
+	uint32_t attached;
+};
+
+struct latency_connection {
+	struct wldbg_pass_connection base;
+
+	/* array of struct latency_object indexed by id */
+	struct wl_array objects;
+
+	struct {
+		uint32_t id;
+		uint64_t start;
+		uint64_t last_global;
+	} registry;
+
+	struct wldbg_histogram histograms[LATENCY_KINDS_NUM];
+};
+
+struct latency {
+	/* struct latency_connection */
+	struct wldbg_pass_connections connections;
+
+	/* interfaces we are interested in, filled
+	 * when we see them for the first time */
+	const struct wl_interface *wl_display;
+	const struct wl_interface *wl_surface;
+	const struct wl_interface *wl_callback;
+	const struct wl_interface *wl_buffer;
+};
+
+static void
+init_connection(struct wldbg_pass_connection *pc)
+{
+	struct latency_connection *lc = (struct latency_connection *) pc;
+	int i;
+
+	wl_array_init(&lc->objects);
+	for (i = 0; i < LATENCY_KINDS_NUM; ++i)
+		wldbg_histogram_init(&lc->histograms[i]);
+}
+
+static void
+release_connection(struct wldbg_pass_connection *pc)
+{
+	struct latency_connection *lc = (struct latency_connection *) pc;
+
+	wl_array_release(&lc->objects);
+}
+
+static struct latency_object *
+get_object(struct latency_connection *lc, uint32_t id)
+{
+	size_t size, old = lc->objects.size;
+
+	/* all objects we track are allocated by client */
+	if (id >= WL_SERVER_ID_START)
+		return NULL;
+
+	size = (id + 1) * sizeof(struct latency_object);
+	if (old < size) {
+		if (!wl_array_add(&lc->objects, size - old))
+			return NULL;
+
+		memset((char *) lc->objects.data + old, 0, size - old);
+	}
+
+	return (struct latency_object *) lc->objects.data + id;
+}
+
+static void
+start_pending(struct latency_connection *lc, uint32_t id,
+	      enum latency_kind kind, uint64_t time)
+{
+	struct latency_object *obj = get_object(lc, id);
+	if (!obj)
+		return;
+
+	obj->start = time;
+	obj->kind = kind;
+	obj->pending = 1;
+}
+
+static void
+finish_pending(struct latency_connection *lc, uint32_t id, uint64_t time)
+{
+	struct latency_object *obj = get_object(lc, id);
+	if (!obj || !obj->pending)
+		return;
+
+	wldbg_histogram_add(&lc->histograms[obj->kind], time - obj->start);
+	obj->pending = 0;
+}
+
+/* whether the message is long enough to have the argument
+ * at offset (in words, with the header) */
+static int
+has_arg(struct wldbg_message *message, uint32_t offset)
+{
+	return offset < message->size / sizeof(uint32_t);
+}
+
+static void
+handle_request(struct latency *lat, struct latency_connection *lc,
+	       struct wldbg_message *message, uint32_t *data)
+{
+	const struct wl_interface *intf;
+	struct latency_object *obj;
+	uint32_t opcode = data[1] & 0xffff;
+
+	intf = wldbg_message_get_object(message, data[0]);
+	if (!intf)
+		return;
+
+	if (wldbg_is_interface(&lat->wl_display, intf, "wl_display")) {
+		if (opcode == WL_DISPLAY_SYNC) {
+			if (!has_arg(message, 2))
+				return;
+			start_pending(lc, data[2], LATENCY_SYNC,
+				      message->time);
+		} else if (opcode == WL_DISPLAY_GET_REGISTRY) {
+			if (!has_arg(message, 2))
+				return;
+			lc->registry.id = data[2];
+			lc->registry.start = message->time;
+			lc->registry.last_global = 0;
+		}
+	} else if (wldbg_is_interface(&lat->wl_surface, intf, "wl_surface")) {
+		if (opcode == WL_SURFACE_FRAME) {
+			if (!has_arg(message, 2))
+				return;
+			start_pending(lc, data[2], LATENCY_FRAME,
+				      message->time);
+		} else if (opcode == WL_SURFACE_ATTACH) {
+			if (!has_arg(message, 2))
+				return;
+			if ((obj = get_object(lc, data[0])))
+				obj->attached = data[2];
+		} else if (opcode == WL_SURFACE_COMMIT) {
+			obj = get_object(lc, data[0]);
+			if (obj && obj->attached) {
+				start_pending(lc, obj->attached,
+					      LATENCY_RELEASE, message->time);
+				/* get_object could realloc the array */
+				obj = get_object(lc, data[0]);
+				obj->attached = 0;
+			}
+		}
+	}
+}
+
+static void
+handle_event(struct latency *lat, struct latency_connection *lc,
+	     struct wldbg_message *message, uint32_t *data)
+{
+	const struct wl_interface *intf;
+	uint32_t opcode = data[1] & 0xffff;
+
+	intf = wldbg_message_get_object(message, data[0]);
+	if (!intf)
+		return;
+
+	/* the registry is done with the first message
+	 * that is not a global after the globals */
+	if (lc->registry.id && lc->registry.last_global) {
+		if (data[0] != lc->registry.id
+		    || opcode != WL_REGISTRY_GLOBAL) {
+			wldbg_histogram_add(&lc->histograms[LATENCY_REGISTRY],
+					    lc->registry.last_global
+					    - lc->registry.start);
+			lc->registry.id = 0;
+		}
+	}
+
+	if (wldbg_is_interface(&lat->wl_callback, intf, "wl_callback")) {
+		if (opcode == WL_CALLBACK_DONE)
+			finish_pending(lc, data[0], message->time);
+	} else if (wldbg_is_interface(&lat->wl_buffer, intf, "wl_buffer")) {
+		if (opcode == WL_BUFFER_RELEASE)
+			finish_pending(lc, data[0], message->time);
+	} else if (data[0] == lc->registry.id && opcode == WL_REGISTRY_GLOBAL) {
+		lc->registry.last_global = message->time;
+	}
+}
+
+static void
+latency_one(struct wldbg_message *message, void *user_data)
+{
+	struct latency *lat = user_data;
+	struct latency_connection *lc;
+
+	lc = wldbg_pass_connection_get(&lat->connections,
+				       message->connection);
+	if (!lc)
+		return;
+
+	if (message->from == CLIENT)
+		handle_request(lat, lc, message, message->data);
+	else
+		handle_event(lat, lc, message, message->data);
+}
+
+static int
+latency_message(void *user_data, struct wldbg_message *message)
+{
+	wldbg_for_each_message(message, latency_one, user_data);
+	return PASS_NEXT;
+}
+
+static void
+print_latency(void *data)
+{
+	struct latency *lat = data;
+	struct latency_connection *lc;
+	int i;
+
+	printf("\n-- Round-trip latency --\n");
+
+	wl_list_for_each(lc, &lat->connections.list, base.link) {
+		wldbg_pass_connection_print(&lc->base);
+
+		for (i = 0; i < LATENCY_KINDS_NUM; ++i) {
+			printf("  %-28s ", latency_names[i]);
+			wldbg_histogram_print(&lc->histograms[i]);
+			putchar('\n');
+		}
+	}
+
+	fflush(stdout);
+}
+
+static void
+latency_help(void *user_data)
+{
+	(void) user_data;
+
+	printf("Pair requests with the events that answer them and print\n"
+	       "histograms of round-trip times for every client:\n"
+	       "\n"
+	       "  wl_display.sync           -> wl_callback.done\n"
+	       "  wl_surface.frame          -> wl_callback.done\n"
+	       "  wl_surface.attach+commit  -> wl_buffer.release\n"
+	       "  wl_display.get_registry   -> last wl_registry.global\n"
+	       "\n"
+	       "The times are printed on exit and when wldbg gets SIGUSR1\n"
+	       "\n"
+	       "Usage: wldbg latency [help]\n");
+}
+
+static int
+latency_init(struct wldbg *wldbg, struct wldbg_pass *pass,
+	     int argc, const char *argv[])
+{
+	struct latency *lat;
+	int i;
+
+	for (i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "help") == 0) {
+			latency_help(NULL);
+			wldbg_exit(wldbg);
+			return 0;
+		} else {
+			fprintf(stderr, "latency: unknown option '%s'\n",
+				argv[i]);
+			return -1;
+		}
+	}
+
+	lat = calloc(1, sizeof *lat);
+	if (!lat)
+		return -1;
+
+	if (wldbg_pass_connections_init(&lat->connections, wldbg,
+					sizeof(struct latency_connection),
+					init_connection,
+					release_connection) < 0
+	    || wldbg_add_report_callback(wldbg, print_latency, lat) < 0) {
+		wldbg_pass_connections_release(&lat->connections);
+		free(lat);
+		return -1;
+	}
+
+	pass->user_data = lat;
+
+	return 0;
+}
+
+static void
+latency_destroy(void *user_data)
+{
+	struct latency *lat = user_data;
+
+	if (!lat)
+		return;
+
+	print_latency(lat);
+
+	wldbg_pass_connections_release(&lat->connections);
+	free(lat);
+}
+
+struct pass *
+create_latency_pass(void)
+{
+	struct pass *pass;
+
+	pass = alloc_pass("latency");
+	if (!pass)
+		return NULL;
+
+	pass->wldbg_pass.init = latency_init;
+	pass->wldbg_pass.destroy = latency_destroy;
+	pass->wldbg_pass.server_pass = latency_message;
+	pass->wldbg_pass.client_pass = latency_message;
+	pass->wldbg_pass.help = latency_help;
+	pass->wldbg_pass.user_data = NULL;
+	pass->wldbg_pass.description
+		= "Round-trip latency of sync, frame and buffer release";
+	pass->wldbg_pass.flags = 0;
+
+	return pass;
+}
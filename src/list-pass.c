@@ -60,7 +60,12 @@ list_passes(void)
 	const char *env;
 	char path[256];
 
-	printf("    list (hardcoded)\n    resolve (hardcoded)\n");
+	printf("    list (hardcoded)\n    resolve (hardcoded)\n"
+	       "    stats (hardcoded)\n    latency (hardcoded)\n"
+	       "    pacing (hardcoded)\n    input-latency (hardcoded)\n"
+	       "    trace (hardcoded)\n    fuzz (hardcoded)\n"
+	       "    fuzz-campaign (hardcoded)\n    fuzz-minimize (hardcoded)\n"
+	       "    publish (hardcoded)\n");
 
 	list_dir(".");
 	snprintf(path, sizeof path, "passes/%s", LT_OBJDIR);
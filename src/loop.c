@@ -1,6 +1,9 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
 
 #include "wldbg.h"
 #include "wldbg-private.h"
@@ -44,6 +47,8 @@ wldbg_monitor_fd(struct wldbg *wldbg, int fd,
 	cb->fd = fd;
 	cb->data = data;
 	cb->dispatch = dispatch;
+	cb->events = EPOLLIN;
+	cb->paused = 0;
 
 	wl_list_insert(&wldbg->monitored_fds, &cb->link);
 
@@ -57,10 +62,14 @@ int
 wldbg_remove_callback(struct wldbg *wldbg, struct wldbg_fd_callback *cb)
 {
 	int fd = cb->fd;
+	int paused = cb->paused;
 
 	wl_list_remove(&cb->link);
 	free(cb);
 
+	if (paused)
+		return 0;
+
 	if (epoll_ctl(wldbg->epoll_fd, EPOLL_CTL_DEL, fd, NULL) == -1) {
 		perror("Failed removing fd from epoll");
 		return -1;
@@ -69,6 +78,182 @@ wldbg_remove_callback(struct wldbg *wldbg, struct wldbg_fd_callback *cb)
 	return 0;
 }
 
+/* Removing the fd from epoll instead of clearing its events
+ * also stops EPOLLHUP, so the paused fd's callback is not
+ * called at all until it is resumed */
+int
+wldbg_pause_fd(struct wldbg *wldbg, int fd, int pause)
+{
+	struct epoll_event ev;
+	struct wldbg_fd_callback *cb;
+
+	wl_list_for_each(cb, &wldbg->monitored_fds, link) {
+		if (cb->fd != fd)
+			continue;
+
+		if (cb->paused == !!pause)
+			return 0;
+
+		if (pause) {
+			if (epoll_ctl(wldbg->epoll_fd, EPOLL_CTL_DEL,
+				      fd, NULL) == -1) {
+				perror("Failed removing fd from epoll");
+				return -1;
+			}
+		} else {
+			ev.events = cb->events;
+			ev.data.ptr = cb;
+			if (epoll_ctl(wldbg->epoll_fd, EPOLL_CTL_ADD,
+				      fd, &ev) == -1) {
+				perror("Failed adding fd to epoll");
+				return -1;
+			}
+		}
+
+		cb->paused = !!pause;
+		return 0;
+	}
+
+	return -1;
+}
+
+int
+wldbg_set_fd_events(struct wldbg *wldbg, int fd, uint32_t events)
+{
+	struct epoll_event ev;
+	struct wldbg_fd_callback *cb;
+
+	wl_list_for_each(cb, &wldbg->monitored_fds, link) {
+		if (cb->fd != fd)
+			continue;
+
+		if (cb->events == events)
+			return 0;
+
+		cb->events = events;
+
+		/* it gets the events when it is resumed */
+		if (cb->paused)
+			return 0;
+
+		ev.events = events;
+		ev.data.ptr = cb;
+		if (epoll_ctl(wldbg->epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+			perror("Failed changing events of fd");
+			return -1;
+		}
+
+		return 0;
+	}
+
+	return -1;
+}
+
+int
+wldbg_add_report_callback(struct wldbg *wldbg,
+			  void (*func)(void *data), void *data)
+{
+	struct wldbg_report_callback *cb;
+
+	cb = malloc(sizeof *cb);
+	if (!cb)
+		return -1;
+
+	cb->func = func;
+	cb->data = data;
+	wl_list_insert(wldbg->report_callbacks.prev, &cb->link);
+
+	return 0;
+}
+
+void
+wldbg_remove_report_callbacks(struct wldbg *wldbg, void *data)
+{
+	struct wldbg_report_callback *cb, *tmp;
+
+	wl_list_for_each_safe(cb, tmp, &wldbg->report_callbacks, link) {
+		if (cb->data != data)
+			continue;
+
+		wl_list_remove(&cb->link);
+		free(cb);
+	}
+}
+
+int
+wldbg_add_exit_callback(struct wldbg *wldbg,
+			void (*func)(pid_t pid, int status, void *data),
+			void *data)
+{
+	struct wldbg_exit_callback *cb;
+
+	cb = malloc(sizeof *cb);
+	if (!cb)
+		return -1;
+
+	cb->func = func;
+	cb->data = data;
+	wl_list_insert(wldbg->exit_callbacks.prev, &cb->link);
+
+	return 0;
+}
+
+void
+wldbg_remove_exit_callbacks(struct wldbg *wldbg, void *data)
+{
+	struct wldbg_exit_callback *cb, *tmp;
+
+	wl_list_for_each_safe(cb, tmp, &wldbg->exit_callbacks, link) {
+		if (cb->data != data)
+			continue;
+
+		wl_list_remove(&cb->link);
+		free(cb);
+	}
+}
+
+int
+wldbg_add_close_callback(struct wldbg *wldbg,
+			 void (*func)(struct wldbg_connection *conn,
+				      void *data),
+			 void *data)
+{
+	struct wldbg_close_callback *cb;
+
+	cb = malloc(sizeof *cb);
+	if (!cb)
+		return -1;
+
+	cb->func = func;
+	cb->data = data;
+	wl_list_insert(wldbg->close_callbacks.prev, &cb->link);
+
+	return 0;
+}
+
+void
+wldbg_remove_close_callbacks(struct wldbg *wldbg, void *data)
+{
+	struct wldbg_close_callback *cb, *tmp;
+
+	wl_list_for_each_safe(cb, tmp, &wldbg->close_callbacks, link) {
+		if (cb->data != data)
+			continue;
+
+		wl_list_remove(&cb->link);
+		free(cb);
+	}
+}
+
+void
+wldbg_connection_closed(struct wldbg_connection *conn)
+{
+	struct wldbg_close_callback *cb, *tmp;
+
+	wl_list_for_each_safe(cb, tmp, &conn->wldbg->close_callbacks, link)
+		cb->func(conn, cb->data);
+}
+
 int
 wldbg_separate_messages(struct wldbg *wldbg, int state)
 {
@@ -78,3 +263,110 @@ wldbg_separate_messages(struct wldbg *wldbg, int state)
 	wldbg->flags.pass_whole_buffer = !!state;
 	return wldbg->flags.pass_whole_buffer;
 }
+
+static int
+dispatch_timer(int fd, void *data)
+{
+	struct wldbg_timer *timer = data;
+	uint64_t expirations;
+
+	/* the timer could have been re-armed or disarmed
+	 * in the meantime, then there's nothing to read */
+	if (read(fd, &expirations, sizeof expirations) != sizeof expirations)
+		return 1;
+
+	timer->func(timer->data);
+
+	/* never let wldbg take this fd for a connection */
+	return 1;
+}
+
+/**
+ * Call func after timeout nanoseconds and then every
+ * interval nanoseconds. The timer is disarmed if timeout is 0
+ * and it is one-shot if interval is 0.
+ */
+struct wldbg_timer *
+wldbg_add_timer(struct wldbg *wldbg, uint64_t timeout, uint64_t interval,
+		void (*func)(void *data), void *data)
+{
+	struct wldbg_timer *timer;
+
+	timer = malloc(sizeof *timer);
+	if (!timer)
+		return NULL;
+
+	timer->fd = timerfd_create(CLOCK_MONOTONIC,
+				   TFD_CLOEXEC | TFD_NONBLOCK);
+	if (timer->fd < 0) {
+		perror("Failed creating timer");
+		free(timer);
+		return NULL;
+	}
+
+	timer->func = func;
+	timer->data = data;
+
+	timer->cb = wldbg_monitor_fd(wldbg, timer->fd, dispatch_timer, timer);
+	if (!timer->cb) {
+		close(timer->fd);
+		free(timer);
+		return NULL;
+	}
+
+	if (wldbg_timer_arm(timer, timeout, interval) < 0) {
+		wldbg_remove_callback(wldbg, timer->cb);
+		close(timer->fd);
+		free(timer);
+		return NULL;
+	}
+
+	wl_list_insert(&wldbg->timers, &timer->link);
+
+	return timer;
+}
+
+static void
+nsec_to_timespec(uint64_t nsec, struct timespec *ts)
+{
+	ts->tv_sec = nsec / 1000000000;
+	ts->tv_nsec = nsec % 1000000000;
+}
+
+int
+wldbg_timer_arm(struct wldbg_timer *timer, uint64_t timeout, uint64_t interval)
+{
+	struct itimerspec its;
+
+	nsec_to_timespec(timeout, &its.it_value);
+	nsec_to_timespec(interval, &its.it_interval);
+
+	if (timerfd_settime(timer->fd, 0, &its, NULL) < 0) {
+		perror("Failed arming timer");
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+wldbg_remove_timer(struct wldbg *wldbg, struct wldbg_timer *timer)
+{
+	int ret;
+
+	ret = wldbg_remove_callback(wldbg, timer->cb);
+	wl_list_remove(&timer->link);
+	close(timer->fd);
+	free(timer);
+
+	return ret;
+}
+
+uint64_t
+wldbg_get_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
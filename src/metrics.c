@@ -0,0 +1,445 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+
+#include "wldbg.h"
+#include "wldbg-private.h"
+#include "wldbg-metrics.h"
+#include "metrics.h"
+#include "request.h"
+
+/* the request is optional, the clients that do not send
+ * any get the OpenMetrics text after this time */
+#define METRICS_WAIT	(100 * 1000000ULL)
+
+struct wldbg_metrics {
+	struct wldbg_request_socket *socket;
+};
+
+void
+wldbg_counters_add(struct wldbg_counters *to,
+		   const struct wldbg_counters *from)
+{
+	to->messages[SERVER] += from->messages[SERVER];
+	to->messages[CLIENT] += from->messages[CLIENT];
+	to->bytes[SERVER] += from->bytes[SERVER];
+	to->bytes[CLIENT] += from->bytes[CLIENT];
+	to->recvmsg += from->recvmsg;
+	to->sendmsg += from->sendmsg;
+}
+
+void
+wldbg_counters_total(struct wldbg *wldbg, struct wldbg_counters *total)
+{
+	struct wldbg_connection *conn;
+
+	*total = wldbg->counters;
+	wl_list_for_each(conn, &wldbg->connections, link)
+		wldbg_counters_add(total, &conn->counters);
+}
+
+/* passes of a single connection are labelled
+ * with its id, like stats@3 */
+static void
+print_passes_profile(struct wl_list *passes, unsigned int connection)
+{
+	struct pass *pass;
+	char label[WLDBG_METRICS_NAME_LEN + 16];
+
+	wl_list_for_each(pass, passes, link) {
+		if (!pass->histogram)
+			continue;
+
+		if (connection)
+			snprintf(label, sizeof label, "%s@%u",
+				 pass->name, connection);
+		else
+			snprintf(label, sizeof label, "%s", pass->name);
+
+		printf("  pass %-15s ", label);
+		wldbg_histogram_print(pass->histogram);
+		putchar('\n');
+	}
+}
+
+void
+wldbg_print_profile(struct wldbg *wldbg)
+{
+	struct wldbg_connection *conn;
+
+	printf("\n-- Overhead of wldbg --\n");
+
+	if (wldbg->proxy_latency) {
+		printf("  %-20s ", "read -> send");
+		wldbg_histogram_print(wldbg->proxy_latency);
+		putchar('\n');
+	}
+
+	print_passes_profile(&wldbg->passes, 0);
+	wl_list_for_each(conn, &wldbg->connections, link)
+		print_passes_profile(&conn->passes, conn->id);
+
+	fflush(stdout);
+}
+
+void
+wldbg_print_connection_profile(struct wldbg_connection *conn)
+{
+	struct pass *pass;
+
+	wl_list_for_each(pass, &conn->passes, link) {
+		if (pass->histogram)
+			break;
+	}
+
+	/* no pass of its own was run */
+	if (&pass->link == &conn->passes)
+		return;
+
+	printf("\n-- Overhead of passes of connection %u (%s) --\n",
+	       conn->id, conn->client.program ?
+	       conn->client.program : "unknown");
+	print_passes_profile(&conn->passes, conn->id);
+	fflush(stdout);
+}
+
+static uint32_t
+socket_queue(int fd, unsigned long request)
+{
+	int size = 0;
+
+	if (fd < 0 || ioctl(fd, request, &size) < 0)
+		return 0;
+
+	return size;
+}
+
+void
+wldbg_connection_queues(struct wldbg_connection *conn, uint32_t *queue)
+{
+	queue[WLDBG_METRICS_CLIENT_IN] = socket_queue(conn->client.fd, SIOCINQ);
+	queue[WLDBG_METRICS_CLIENT_OUT] = socket_queue(conn->client.fd, SIOCOUTQ);
+	queue[WLDBG_METRICS_SERVER_IN] = socket_queue(conn->server.fd, SIOCINQ);
+	queue[WLDBG_METRICS_SERVER_OUT] = socket_queue(conn->server.fd, SIOCOUTQ);
+}
+
+uint32_t
+wldbg_connection_rate(struct wldbg_connection *conn, uint64_t now)
+{
+	uint64_t second = now / 1000000000;
+
+	if (second == conn->rate.second)
+		return conn->rate.last;
+	if (second == conn->rate.second + 1)
+		return conn->rate.count;
+
+	return 0;
+}
+
+/* escape label value as OpenMetrics requires */
+static void
+print_label(FILE *out, const char *str)
+{
+	if (!str)
+		str = "unknown";
+
+	for (; *str; ++str) {
+		if (*str == '\\' || *str == '"')
+			fprintf(out, "\\%c", *str);
+		else if (*str == '\n')
+			fputs("\\n", out);
+		else
+			fputc(*str, out);
+	}
+}
+
+static void
+print_connection_labels(FILE *out, struct wldbg_connection *conn)
+{
+	fprintf(out, "connection=\"%u\",pid=\"%d\",program=\"",
+		conn->id, conn->client.pid);
+	print_label(out, conn->client.program);
+	fputc('"', out);
+}
+
+static void
+print_pass_labels(FILE *out, struct pass *pass, struct wldbg_connection *conn)
+{
+	fprintf(out, "pass=\"");
+	print_label(out, pass->name);
+	fputc('"', out);
+	if (conn)
+		fprintf(out, ",connection=\"%u\"", conn->id);
+}
+
+static void
+print_family(FILE *out, const char *name, const char *type,
+	     const char *help)
+{
+	fprintf(out, "# TYPE %s %s\n# HELP %s %s\n", name, type, name, help);
+}
+
+static void
+print_openmetrics(struct wldbg *wldbg, FILE *out)
+{
+	struct wldbg_counters total;
+	struct wldbg_connection *conn;
+	struct pass *pass;
+	uint64_t now = wldbg_get_time();
+	uint32_t queue[WLDBG_METRICS_QUEUES_NUM];
+	static const char *queue_names[] = {
+		"client_in", "client_out", "server_in", "server_out"
+	};
+	int i;
+
+	wldbg_counters_total(wldbg, &total);
+
+	print_family(out, "wldbg_messages", "counter",
+		     "Messages that went through wldbg.");
+	fprintf(out, "wldbg_messages_total{from=\"client\"} %lu\n"
+		     "wldbg_messages_total{from=\"server\"} %lu\n",
+		(unsigned long) total.messages[CLIENT],
+		(unsigned long) total.messages[SERVER]);
+
+	print_family(out, "wldbg_bytes", "counter",
+		     "Bytes that went through wldbg.");
+	fprintf(out, "wldbg_bytes_total{from=\"client\"} %lu\n"
+		     "wldbg_bytes_total{from=\"server\"} %lu\n",
+		(unsigned long) total.bytes[CLIENT],
+		(unsigned long) total.bytes[SERVER]);
+
+	print_family(out, "wldbg_syscalls", "counter",
+		     "System calls done by the main loop.");
+	fprintf(out, "wldbg_syscalls_total{syscall=\"recvmsg\"} %lu\n"
+		     "wldbg_syscalls_total{syscall=\"sendmsg\"} %lu\n"
+		     "wldbg_syscalls_total{syscall=\"epoll_wait\"} %lu\n",
+		(unsigned long) total.recvmsg,
+		(unsigned long) total.sendmsg,
+		(unsigned long) wldbg->epoll_wait);
+
+	print_family(out, "wldbg_connections", "gauge",
+		     "Live connections.");
+	fprintf(out, "wldbg_connections %d\n", wldbg->connections_num);
+
+	/* the passes of single connections have the connection label */
+	print_family(out, "wldbg_pass_calls", "counter",
+		     "Number of times the pass was run.");
+	wl_list_for_each(pass, &wldbg->passes, link) {
+		fprintf(out, "wldbg_pass_calls_total{");
+		print_pass_labels(out, pass, NULL);
+		fprintf(out, "} %lu\n", (unsigned long) pass->calls);
+	}
+	wl_list_for_each(conn, &wldbg->connections, link) {
+		wl_list_for_each(pass, &conn->passes, link) {
+			fprintf(out, "wldbg_pass_calls_total{");
+			print_pass_labels(out, pass, conn);
+			fprintf(out, "} %lu\n", (unsigned long) pass->calls);
+		}
+	}
+
+	print_family(out, "wldbg_pass_seconds", "counter",
+		     "Time spent in the pass.");
+	wl_list_for_each(pass, &wldbg->passes, link) {
+		fprintf(out, "wldbg_pass_seconds_total{");
+		print_pass_labels(out, pass, NULL);
+		fprintf(out, "} %.9f\n", pass->time / 1000000000.0);
+	}
+	wl_list_for_each(conn, &wldbg->connections, link) {
+		wl_list_for_each(pass, &conn->passes, link) {
+			fprintf(out, "wldbg_pass_seconds_total{");
+			print_pass_labels(out, pass, conn);
+			fprintf(out, "} %.9f\n", pass->time / 1000000000.0);
+		}
+	}
+
+	print_family(out, "wldbg_client_messages", "counter",
+		     "Messages of the connection.");
+	wl_list_for_each(conn, &wldbg->connections, link) {
+		for (i = SERVER; i <= CLIENT; ++i) {
+			fprintf(out, "wldbg_client_messages_total{");
+			print_connection_labels(out, conn);
+			fprintf(out, ",from=\"%s\"} %lu\n",
+				i == CLIENT ? "client" : "server",
+				(unsigned long) conn->counters.messages[i]);
+		}
+	}
+
+	print_family(out, "wldbg_client_bytes", "counter",
+		     "Bytes of the connection.");
+	wl_list_for_each(conn, &wldbg->connections, link) {
+		for (i = SERVER; i <= CLIENT; ++i) {
+			fprintf(out, "wldbg_client_bytes_total{");
+			print_connection_labels(out, conn);
+			fprintf(out, ",from=\"%s\"} %lu\n",
+				i == CLIENT ? "client" : "server",
+				(unsigned long) conn->counters.bytes[i]);
+		}
+	}
+
+	print_family(out, "wldbg_client_message_rate", "gauge",
+		     "Messages of the connection in the last whole second.");
+	wl_list_for_each(conn, &wldbg->connections, link) {
+		fprintf(out, "wldbg_client_message_rate{");
+		print_connection_labels(out, conn);
+		fprintf(out, "} %u\n", wldbg_connection_rate(conn, now));
+	}
+
+	print_family(out, "wldbg_client_queue_bytes", "gauge",
+		     "Bytes waiting in the sockets of the connection.");
+	wl_list_for_each(conn, &wldbg->connections, link) {
+		wldbg_connection_queues(conn, queue);
+		for (i = 0; i < WLDBG_METRICS_QUEUES_NUM; ++i) {
+			fprintf(out, "wldbg_client_queue_bytes{");
+			print_connection_labels(out, conn);
+			fprintf(out, ",queue=\"%s\"} %u\n",
+				queue_names[i], queue[i]);
+		}
+	}
+
+	fprintf(out, "# EOF\n");
+}
+
+static void
+copy_name(char *to, const char *from)
+{
+	memset(to, 0, WLDBG_METRICS_NAME_LEN);
+	if (from)
+		strncpy(to, from, WLDBG_METRICS_NAME_LEN - 1);
+}
+
+static void
+write_binary_pass(FILE *out, struct pass *pass, uint32_t connection)
+{
+	struct wldbg_metrics_pass mp;
+
+	memset(&mp, 0, sizeof mp);
+	copy_name(mp.name, pass->name);
+	mp.calls = pass->calls;
+	mp.time = pass->time;
+	mp.connection = connection;
+
+	fwrite(&mp, sizeof mp, 1, out);
+}
+
+static void
+print_binary(struct wldbg *wldbg, FILE *out)
+{
+	struct wldbg_metrics_header header;
+	struct wldbg_metrics_connection mc;
+	struct wldbg_connection *conn;
+	struct pass *pass;
+
+	memset(&header, 0, sizeof header);
+	header.magic = WLDBG_METRICS_MAGIC;
+	header.version = WLDBG_METRICS_VERSION;
+	header.time = wldbg_get_time();
+	header.connections_num = wl_list_length(&wldbg->connections);
+	header.passes_num = wl_list_length(&wldbg->passes);
+	wl_list_for_each(conn, &wldbg->connections, link)
+		header.passes_num += wl_list_length(&conn->passes);
+	header.epoll_wait = wldbg->epoll_wait;
+	wldbg_counters_total(wldbg, &header.total);
+
+	fwrite(&header, sizeof header, 1, out);
+
+	wl_list_for_each(conn, &wldbg->connections, link) {
+		memset(&mc, 0, sizeof mc);
+		mc.id = conn->id;
+		mc.pid = conn->client.pid;
+		copy_name(mc.program, conn->client.program);
+		mc.counters = conn->counters;
+		mc.rate = wldbg_connection_rate(conn, header.time);
+		wldbg_connection_queues(conn, mc.queue);
+
+		fwrite(&mc, sizeof mc, 1, out);
+	}
+
+	wl_list_for_each(pass, &wldbg->passes, link)
+		write_binary_pass(out, pass, 0);
+	wl_list_for_each(conn, &wldbg->connections, link) {
+		wl_list_for_each(pass, &conn->passes, link)
+			write_binary_pass(out, pass, conn->id);
+	}
+}
+
+static void
+metrics_answer(struct wldbg *wldbg, char *request, FILE *out)
+{
+	if (strncmp(request, "binary", 6) == 0) {
+		print_binary(wldbg, out);
+		return;
+	}
+
+	/* scrapers talk HTTP */
+	if (strncmp(request, "GET ", 4) == 0)
+		fprintf(out, "HTTP/1.0 200 OK\r\n"
+			"Content-Type: application/openmetrics-text;"
+			" version=1.0.0; charset=utf-8\r\n\r\n");
+
+	print_openmetrics(wldbg, out);
+}
+
+int
+wldbg_metrics_init(struct wldbg *wldbg, const char *path)
+{
+	struct wldbg_metrics *metrics;
+
+	metrics = calloc(1, sizeof *metrics);
+	if (!metrics)
+		return -1;
+
+	metrics->socket = wldbg_request_socket_create(wldbg, path,
+						      METRICS_WAIT,
+						      metrics_answer);
+	if (!metrics->socket) {
+		free(metrics);
+		return -1;
+	}
+
+	wldbg->metrics = metrics;
+
+	return 0;
+}
+
+void
+wldbg_metrics_destroy(struct wldbg *wldbg)
+{
+	struct wldbg_metrics *metrics = wldbg->metrics;
+
+	if (!metrics)
+		return;
+
+	wldbg_request_socket_destroy(metrics->socket);
+
+	free(metrics);
+	wldbg->metrics = NULL;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_METRICS_PRIVATE_H_
+#define _WLDBG_METRICS_PRIVATE_H_
+
+#include <stdint.h>
+
+struct wldbg;
+struct wldbg_counters;
+struct wldbg_connection;
+
+/* listen on the unix socket at path and answer requests for metrics.
+ * The metrics are sent in OpenMetrics text format, or as binary
+ * snapshot (see wldbg-metrics.h) if the request starts with "binary" */
+int
+wldbg_metrics_init(struct wldbg *wldbg, const char *path);
+
+void
+wldbg_metrics_destroy(struct wldbg *wldbg);
+
+void
+wldbg_counters_add(struct wldbg_counters *to,
+		   const struct wldbg_counters *from);
+
+/* print histograms of the time wldbg adds to messages
+ * and of the time spent in passes */
+void
+wldbg_print_profile(struct wldbg *wldbg);
+
+/* the same for the passes of the connection (see 'load ID'
+ * and --pipeline), which are gone when the connection is */
+void
+wldbg_print_connection_profile(struct wldbg_connection *conn);
+
+/* messages of the connection in the last whole second */
+uint32_t
+wldbg_connection_rate(struct wldbg_connection *conn, uint64_t now);
+
+/* bytes waiting in the sockets of the connection,
+ * indexed by enum wldbg_metrics_queue */
+void
+wldbg_connection_queues(struct wldbg_connection *conn, uint32_t *queue);
+
+/* sum of counters of all connections, including the closed ones */
+void
+wldbg_counters_total(struct wldbg *wldbg, struct wldbg_counters *total);
+
+#endif /* _WLDBG_METRICS_PRIVATE_H_ */
@@ -44,6 +44,9 @@
 #include "util.h"
 #include "resolve.h"
 
+void
+handle_wl_shm_message(struct wldbg_objects_info *oi,
+		      struct wldbg_resolved_message *rm, int from);
 void
 handle_shm_pool_message(struct wldbg_objects_info *oi,
 			struct wldbg_resolved_message *rm, int from);
@@ -95,6 +98,8 @@ gather_info(void *user_data, struct wldbg_message *message)
 		handle_wl_compositor_message(oinf, &rm, message->from);
 	else if (strcmp(rm.wl_interface->name, "wl_shm_pool") == 0)
 		handle_shm_pool_message(oinf, &rm, message->from);
+	else if (strcmp(rm.wl_interface->name, "wl_shm") == 0)
+		handle_wl_shm_message(oinf, &rm, message->from);
 	else if (strcmp(rm.wl_interface->name, "xdg_shell") == 0)
 		handle_xdg_shell_message(oinf, &rm, message->from);
 	else if (strcmp(rm.wl_interface->name, "wl_registry") == 0)
@@ -30,6 +30,7 @@
 
 struct wldbg_objects_info;
 struct wldbg_object_info;
+struct wldbg_wl_buffer_info;
 
 void
 objects_info_put(struct wldbg_objects_info *oi,
@@ -41,4 +42,10 @@ objects_info_get(struct wldbg_objects_info *oi, uint32_t id);
 void
 wldbg_object_info_free(struct wldbg_objects_info *oi, struct wldbg_object_info *info);
 
+/* defined in wl_shm-objinfo.c */
+void
+wl_buffer_info_set_in_flight(struct wldbg_objects_info *oi,
+			     struct wldbg_wl_buffer_info *buff_info,
+			     int in_flight);
+
 #endif /* _WLDBG_OBJINFO_PRIVATE_H_ */
@@ -44,6 +44,7 @@ create_objects_info(void)
 
 	wldbg_ids_map_init(&oi->client_objects);
 	wldbg_ids_map_init(&oi->server_objects);
+	memset(&oi->shm, 0, sizeof oi->shm);
 
 	return oi;
 }
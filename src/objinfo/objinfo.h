@@ -44,4 +44,9 @@ wldbg_message_get_object_info(struct wldbg_message *msg, uint32_t id);
 int
 wldbg_add_objinfo_pass(struct wldbg *wldbg);
 
+/* print accounting of shm pools and buffers,
+ * every line starts with prefix */
+void
+objects_info_print_shm(struct wldbg_objects_info *oi, const char *prefix);
+
 #endif /* _WLDBG_OBJINFO_H_ */
@@ -63,6 +63,7 @@ create_wl_seat_info(struct wldbg_resolved_message *rm)
 	oi->destroy = free_seat;
 
 	info->capabilities = 0;
+	info->name = NULL;
 
 	/* get version of the seat */
 	arg = wldbg_resolved_message_next_argument(rm);
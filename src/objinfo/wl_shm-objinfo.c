@@ -54,6 +54,105 @@ create_wl_buffer_info(struct wldbg_resolved_message *rm)
 	return oi;
 }
 
+static struct wldbg_object_info *
+create_wl_shm_pool_info(struct wldbg_resolved_message *rm)
+{
+	struct wldbg_object_info *oi = malloc(sizeof *oi);
+	if (!oi)
+		return NULL;
+
+	struct wldbg_wl_shm_pool_info *info = calloc(1, sizeof *info);
+	if (!info) {
+		free(oi);
+		return NULL;
+	}
+
+	/* types[0] should be wl_shm_pool_interface */
+	oi->wl_interface = rm->wl_message->types[0];
+	oi->info = info;
+	oi->destroy = free;
+
+	return oi;
+}
+
+static void
+shm_account_pool(struct wldbg_shm_accounting *shm, uint64_t time)
+{
+	uint64_t second;
+
+	if (shm->pools_created == 0)
+		shm->first_pool_time = time;
+
+	second = (time - shm->first_pool_time) / 1000000000;
+	if (second != shm->churn_second) {
+		/* the last whole second, or zero if there
+		 * were seconds without any pool */
+		shm->churn_last = second == shm->churn_second + 1 ?
+				  shm->churn_count : 0;
+		shm->churn_second = second;
+		shm->churn_count = 0;
+	}
+
+	++shm->churn_count;
+	if (shm->churn_count > shm->churn_max)
+		shm->churn_max = shm->churn_count;
+
+	++shm->pools_created;
+	++shm->pools;
+}
+
+static void
+shm_account_bytes(struct wldbg_shm_accounting *shm,
+		  int32_t old_size, int32_t new_size)
+{
+	shm->bytes -= old_size;
+	shm->bytes += new_size;
+
+	if (shm->bytes > shm->bytes_max)
+		shm->bytes_max = shm->bytes;
+}
+
+void
+handle_wl_shm_message(struct wldbg_objects_info *oi,
+		      struct wldbg_resolved_message *rm, int from)
+{
+	struct wldbg_object_info *info;
+	struct wldbg_wl_shm_pool_info *pool_info;
+	int32_t size;
+
+	if (from != CLIENT
+	    || strcmp(rm->wl_message->name, "create_pool") != 0)
+		return;
+
+	/* the file descriptor is not in the data,
+	 * so read the arguments directly: new_id, size */
+	if (rm->base.size < 4 * sizeof(uint32_t))
+		return;
+
+	/* the compositor refuses the pool with a protocol error,
+	 * it would never be destroyed */
+	size = (int32_t) rm->base.data[1];
+	if (size <= 0)
+		return;
+
+	info = create_wl_shm_pool_info(rm);
+	if (!info) {
+		fprintf(stderr, "Out of memory, loosing informaiton\n");
+		return;
+	}
+
+	pool_info = info->info;
+	info->id = rm->base.data[0];
+	pool_info->size = size;
+
+	shm_account_pool(&oi->shm, wldbg_get_time());
+	shm_account_bytes(&oi->shm, 0, pool_info->size);
+
+	objects_info_put(oi, info->id, info);
+	dbg("Created wl_shm_pool, id %u, size %d\n",
+	    info->id, pool_info->size);
+}
+
 void
 handle_shm_pool_message(struct wldbg_objects_info *oi,
 			struct wldbg_resolved_message *rm, int from)
@@ -61,9 +160,14 @@ handle_shm_pool_message(struct wldbg_objects_info *oi,
 	struct wldbg_object_info *info;
 	struct wldbg_resolved_arg *arg;
 	struct wldbg_wl_buffer_info *buff_info;
+	struct wldbg_wl_shm_pool_info *pool_info;
 
 	if (from == CLIENT) {
 		 if (strcmp(rm->wl_message->name, "create_buffer") == 0) {
+			/* new_id, offset, width, height, stride, format */
+			if (rm->base.size < 8 * sizeof(uint32_t))
+				return;
+
 			info = create_wl_buffer_info(rm);
 			if (!info) {
 				fprintf(stderr, "Out of memory, loosing informaiton\n");
@@ -96,12 +200,63 @@ handle_shm_pool_message(struct wldbg_objects_info *oi,
 			arg = wldbg_resolved_message_next_argument(rm);
 			buff_info->format = *arg->data;
 
+			++oi->shm.buffers_created;
+			++oi->shm.buffers;
+			if (oi->shm.buffers > oi->shm.buffers_max)
+				oi->shm.buffers_max = oi->shm.buffers;
+
 			objects_info_put(oi, info->id, info);
 			dbg("Created wl_buffer, id %u\n", info->id);
+			return;
+		}
+
+		/* pools created before we started gathering
+		 * the info are not accounted */
+		info = objects_info_get(oi, rm->base.id);
+		if (!info)
+			return;
+
+		pool_info = info->info;
+
+		if (strcmp(rm->wl_message->name, "resize") == 0) {
+			/* the compositor refuses sizes <= 0
+			 * and the pool keeps the old one */
+			if (rm->base.size < 3 * sizeof(uint32_t)
+			    || (int32_t) rm->base.data[0] <= 0)
+				return;
+
+			shm_account_bytes(&oi->shm, pool_info->size,
+					  (int32_t) rm->base.data[0]);
+			pool_info->size = (int32_t) rm->base.data[0];
+		} else if (strcmp(rm->wl_message->name, "destroy") == 0) {
+			/* the compositor can keep the memory mapped
+			 * until the buffers are destroyed, but the
+			 * client is done with it */
+			shm_account_bytes(&oi->shm, pool_info->size, 0);
+			--oi->shm.pools;
+			wldbg_object_info_free(oi, info);
 		}
 	}
 }
 
+void
+wl_buffer_info_set_in_flight(struct wldbg_objects_info *oi,
+			     struct wldbg_wl_buffer_info *buff_info,
+			     int in_flight)
+{
+	if (buff_info->in_flight == !!in_flight)
+		return;
+
+	buff_info->in_flight = !!in_flight;
+	if (in_flight) {
+		++oi->shm.in_flight;
+		if (oi->shm.in_flight > oi->shm.in_flight_max)
+			oi->shm.in_flight_max = oi->shm.in_flight;
+	} else {
+		--oi->shm.in_flight;
+	}
+}
+
 void
 handle_wl_buffer_message(struct wldbg_objects_info *oi,
 			 struct wldbg_resolved_message *rm, int from)
@@ -112,15 +267,54 @@ handle_wl_buffer_message(struct wldbg_objects_info *oi,
 		return;
 	}
 
+	struct wldbg_wl_buffer_info *buff_info = info->info;
+
 	if (from == SERVER) {
 		if (strcmp(rm->wl_message->name, "release") == 0) {
-			struct wldbg_wl_buffer_info *buff_info = info->info;
 			buff_info->released = 1;
+			wl_buffer_info_set_in_flight(oi, buff_info, 0);
 		}
 	} else {
 		if (strcmp(rm->wl_message->name, "destroy") == 0) {
+			wl_buffer_info_set_in_flight(oi, buff_info, 0);
+			--oi->shm.buffers;
 			wldbg_object_info_free(oi, info);
 		}
 	}
 }
 
+/* pools created in the last whole second */
+static uint32_t
+shm_churn_last(struct wldbg_shm_accounting *shm, uint64_t time)
+{
+	uint64_t second;
+
+	if (shm->pools_created == 0)
+		return 0;
+
+	second = (time - shm->first_pool_time) / 1000000000;
+	if (second == shm->churn_second)
+		return shm->churn_last;
+	if (second == shm->churn_second + 1)
+		return shm->churn_count;
+
+	return 0;
+}
+
+void
+objects_info_print_shm(struct wldbg_objects_info *oi, const char *prefix)
+{
+	struct wldbg_shm_accounting *shm = &oi->shm;
+
+	printf("%sshm pools: %u alive, %lu created, "
+	       "%u/s last second, %u/s max\n", prefix,
+	       shm->pools, (unsigned long) shm->pools_created,
+	       shm_churn_last(shm, wldbg_get_time()), shm->churn_max);
+	printf("%sshm bytes: %lu mapped, %lu max\n", prefix,
+	       (unsigned long) shm->bytes, (unsigned long) shm->bytes_max);
+	printf("%sbuffers: %u alive (%u max), %lu created, "
+	       "%u in flight (%u max)\n", prefix,
+	       shm->buffers, shm->buffers_max,
+	       (unsigned long) shm->buffers_created,
+	       shm->in_flight, shm->in_flight_max);
+}
@@ -77,6 +77,18 @@ make_wl_buffer_unreleased(struct wldbg_objects_info *oi, uint32_t id)
 	((struct wldbg_wl_buffer_info *) info->info)->released = 0;
 }
 
+static void
+make_wl_buffer_in_flight(struct wldbg_objects_info *oi, uint32_t id)
+{
+	struct wldbg_object_info *info = objects_info_get(oi, id);
+
+	/* buffers that are not from wl_shm are not tracked */
+	if (!info)
+		return;
+
+	wl_buffer_info_set_in_flight(oi, info->info, 1);
+}
+
 void
 handle_wl_surface_message(struct wldbg_objects_info *oi,
 			  struct wldbg_resolved_message *rm, int from)
@@ -116,6 +128,11 @@ handle_wl_surface_message(struct wldbg_objects_info *oi,
 				}
 			}
 
+			/* the newly attached buffer is used by
+			 * the compositor now */
+			if (surf_info->wl_buffer_id)
+				make_wl_buffer_in_flight(oi, surf_info->wl_buffer_id);
+
 			/* commit the state */
 			memcpy(surf_info->commited, surf_info, sizeof *surf_info);
 			surf_info->commited->commited = NULL;
@@ -0,0 +1,580 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Frame pacing analyzer. It uses the surface state tracked by objinfo
+ * (what buffer and frame callback were committed) and for every surface
+ * records commit intervals, jitter, frames dropped or duplicated
+ * with respect to frame callbacks and commits that did not wait
+ * for the frame callback. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* for WL_SERVER_ID_START */
+#include "wayland/wayland-private.h"
+
+#include <wayland-server-protocol.h>
+#include <wayland-client-protocol.h>
+
+#include "wldbg.h"
+#include "wldbg-pass.h"
+#include "wldbg-private.h"
+#include "wldbg-ids-map.h"
+#include "wldbg-histogram.h"
+#include "wldbg-objects-info.h"
+#include "wldbg-parse-message.h"
+#include "objinfo/objinfo.h"
+#include "pass-connections.h"
+#include "passes.h"
+
+/* number of buckets in the timeline of every surface */
+#define PACING_RING_SIZE 64
+
+struct pacing_bucket {
+	uint16_t commits;
+	uint16_t dropped;
+	uint16_t duplicated;
+	uint16_t unthrottled;
+};
+
+struct pacing_surface {
+	uint32_t id;
+	unsigned int destroyed : 1;
+	/* got frame done and waiting for the next commit */
+	unsigned int after_done : 1;
+
+	/* commits with new buffer */
+	uint64_t commits;
+	/* commits without new buffer */
+	uint64_t other_commits;
+	uint64_t first_commit;
+	uint64_t last_commit;
+	uint64_t last_interval;
+
+	struct wldbg_histogram intervals;
+	struct wldbg_histogram jitter;
+	/* frame done -> next commit */
+	struct wldbg_histogram render;
+
+	uint64_t frames_requested;
+	uint64_t frames_done;
+	uint32_t frames_pending;
+	uint64_t last_done;
+	uint32_t commits_since_done;
+
+	uint64_t dropped;
+	uint64_t duplicated;
+	uint64_t unthrottled;
+
+	/* fixed-size ring of time buckets, ring_head is
+	 * the number of the newest bucket (time / bucket size) */
+	struct pacing_bucket ring[PACING_RING_SIZE];
+	uint64_t ring_head;
+	uint64_t ring_first;
+
+	struct wl_list link;
+};
+
+struct pacing_connection {
+	struct wldbg_pass_connection base;
+
+	/* live surfaces by id */
+	struct wldbg_ids_map surfaces;
+	/* surface id (as uintptr_t) by frame callback id */
+	struct wldbg_ids_map callbacks;
+	/* all surfaces, including the destroyed ones */
+	struct wl_list surfaces_list;
+};
+
+struct pacing {
+	/* struct pacing_connection */
+	struct wldbg_pass_connections connections;
+
+	uint64_t bucket_ns;
+	uint64_t refresh_ns;
+
+	/* filled when we see it for the first time */
+	const struct wl_interface *wl_surface;
+};
+
+static void
+init_connection(struct wldbg_pass_connection *base)
+{
+	struct pacing_connection *pc = (struct pacing_connection *) base;
+
+	wldbg_ids_map_init(&pc->surfaces);
+	wldbg_ids_map_init(&pc->callbacks);
+	wl_list_init(&pc->surfaces_list);
+}
+
+static void
+release_connection(struct wldbg_pass_connection *base)
+{
+	struct pacing_connection *pc = (struct pacing_connection *) base;
+	struct pacing_surface *ps, *tmp;
+
+	wl_list_for_each_safe(ps, tmp, &pc->surfaces_list, link)
+		free(ps);
+
+	wldbg_ids_map_release(&pc->surfaces);
+	wldbg_ids_map_release(&pc->callbacks);
+}
+
+static struct pacing_surface *
+get_surface(struct pacing_connection *pc, uint32_t id)
+{
+	struct pacing_surface *ps;
+
+	/* we track only surfaces created by client */
+	if (id >= WL_SERVER_ID_START)
+		return NULL;
+
+	ps = wldbg_ids_map_get(&pc->surfaces, id);
+	if (ps)
+		return ps;
+
+	ps = calloc(1, sizeof *ps);
+	if (!ps)
+		return NULL;
+
+	ps->id = id;
+	wldbg_histogram_init(&ps->intervals);
+	wldbg_histogram_init(&ps->jitter);
+	wldbg_histogram_init(&ps->render);
+
+	wldbg_ids_map_insert(&pc->surfaces, id, ps);
+	wl_list_insert(pc->surfaces_list.prev, &ps->link);
+
+	return ps;
+}
+
+/* get the bucket for given time, moving the ring forward if needed.
+ * Returns NULL if the time is too old for the ring */
+static struct pacing_bucket *
+get_bucket(struct pacing *pacing, struct pacing_surface *ps, uint64_t time)
+{
+	uint64_t n = time / pacing->bucket_ns;
+	uint64_t i;
+
+	if (ps->ring_head == 0 && ps->ring_first == 0) {
+		ps->ring_head = ps->ring_first = n;
+	} else if (n > ps->ring_head) {
+		/* clear the buckets we skipped, but at most
+		 * the whole ring */
+		if (n - ps->ring_head >= PACING_RING_SIZE)
+			memset(ps->ring, 0, sizeof ps->ring);
+		else
+			for (i = ps->ring_head + 1; i <= n; ++i)
+				memset(&ps->ring[i % PACING_RING_SIZE], 0,
+				       sizeof(struct pacing_bucket));
+
+		ps->ring_head = n;
+	} else if (ps->ring_head - n >= PACING_RING_SIZE) {
+		return NULL;
+	}
+
+	return &ps->ring[n % PACING_RING_SIZE];
+}
+
+static void
+surface_commit(struct pacing *pacing, struct pacing_connection *pc,
+	       struct pacing_surface *ps,
+	       struct wldbg_wl_surface_info *commited, uint64_t time)
+{
+	struct pacing_bucket *bucket;
+	uint64_t interval, gap;
+
+	/* a frame callback requested in this commit */
+	if (commited->last_frame_id) {
+		wldbg_ids_map_insert(&pc->callbacks, commited->last_frame_id,
+				     (void *) (uintptr_t) ps->id);
+		++ps->frames_requested;
+		++ps->frames_pending;
+	}
+
+	if (!commited->wl_buffer_id) {
+		++ps->other_commits;
+		return;
+	}
+
+	bucket = get_bucket(pacing, ps, time);
+	if (bucket)
+		++bucket->commits;
+
+	++ps->commits;
+	if (ps->last_commit) {
+		interval = time - ps->last_commit;
+		wldbg_histogram_add(&ps->intervals, interval);
+
+		if (ps->last_interval)
+			wldbg_histogram_add(&ps->jitter,
+					    interval > ps->last_interval ?
+					    interval - ps->last_interval :
+					    ps->last_interval - interval);
+		ps->last_interval = interval;
+	} else {
+		ps->first_commit = time;
+	}
+	ps->last_commit = time;
+
+	/* new buffer while the frame callback from the previous commit
+	 * is still pending, the client does not wait for it */
+	if (ps->frames_pending > (commited->last_frame_id ? 1u : 0u)) {
+		++ps->unthrottled;
+		if (bucket)
+			++bucket->unthrottled;
+	}
+
+	/* the client was told to draw and it took longer than
+	 * the refresh period, so the old frame was shown again */
+	if (ps->after_done) {
+		gap = time - ps->last_done;
+		wldbg_histogram_add(&ps->render, gap);
+
+		if (gap > pacing->refresh_ns) {
+			ps->duplicated += gap / pacing->refresh_ns;
+			if (bucket)
+				bucket->duplicated += gap / pacing->refresh_ns;
+		}
+
+		ps->after_done = 0;
+	}
+
+	++ps->commits_since_done;
+}
+
+static void
+surface_frame_done(struct pacing *pacing, struct pacing_surface *ps,
+		   uint64_t time)
+{
+	struct pacing_bucket *bucket;
+
+	if (ps->frames_pending > 0)
+		--ps->frames_pending;
+	++ps->frames_done;
+
+	/* only one buffer can be shown for one frame,
+	 * the others were never presented */
+	if (ps->commits_since_done > 1) {
+		ps->dropped += ps->commits_since_done - 1;
+		bucket = get_bucket(pacing, ps, time);
+		if (bucket)
+			bucket->dropped += ps->commits_since_done - 1;
+	}
+
+	ps->commits_since_done = 0;
+	ps->last_done = time;
+	ps->after_done = 1;
+}
+
+static void
+handle_request(struct pacing *pacing, struct pacing_connection *pc,
+	       struct wldbg_message *message, uint32_t *data)
+{
+	const struct wl_interface *intf;
+	struct wldbg_object_info *info;
+	struct wldbg_wl_surface_info *surf_info;
+	struct pacing_surface *ps;
+	uint32_t opcode = data[1] & 0xffff;
+
+	intf = wldbg_message_get_object(message, data[0]);
+	if (!intf
+	    || !wldbg_is_interface(&pacing->wl_surface, intf, "wl_surface"))
+		return;
+
+	if (opcode == WL_SURFACE_COMMIT) {
+		/* objinfo pass runs before us, so the state
+		 * is already commited */
+		info = wldbg_message_get_object_info(message, data[0]);
+		if (!info || !info->info)
+			return;
+
+		surf_info = info->info;
+		if (!surf_info->commited)
+			return;
+
+		ps = get_surface(pc, data[0]);
+		if (ps)
+			surface_commit(pacing, pc, ps, surf_info->commited,
+				       message->time);
+	} else if (opcode == WL_SURFACE_DESTROY) {
+		ps = wldbg_ids_map_get(&pc->surfaces, data[0]);
+		if (ps) {
+			ps->destroyed = 1;
+			wldbg_ids_map_insert(&pc->surfaces, data[0], NULL);
+		}
+	}
+}
+
+static void
+handle_event(struct pacing *pacing, struct pacing_connection *pc,
+	     struct wldbg_message *message, uint32_t *data)
+{
+	struct pacing_surface *ps;
+	uint32_t surface_id;
+
+	if ((data[1] & 0xffff) != WL_CALLBACK_DONE
+	    || data[0] >= WL_SERVER_ID_START)
+		return;
+
+	surface_id = (uintptr_t) wldbg_ids_map_get(&pc->callbacks, data[0]);
+	if (!surface_id)
+		return;
+
+	/* the callback is gone now */
+	wldbg_ids_map_insert(&pc->callbacks, data[0], NULL);
+
+	ps = wldbg_ids_map_get(&pc->surfaces, surface_id);
+	if (ps)
+		surface_frame_done(pacing, ps, message->time);
+}
+
+static void
+pacing_one(struct wldbg_message *message, void *user_data)
+{
+	struct pacing *pacing = user_data;
+	struct pacing_connection *pc;
+
+	pc = wldbg_pass_connection_get(&pacing->connections,
+				       message->connection);
+	if (!pc)
+		return;
+
+	if (message->from == CLIENT)
+		handle_request(pacing, pc, message, message->data);
+	else
+		handle_event(pacing, pc, message, message->data);
+}
+
+static int
+pacing_message(void *user_data, struct wldbg_message *message)
+{
+	wldbg_for_each_message(message, pacing_one, user_data);
+	return PASS_NEXT;
+}
+
+static char
+count_char(unsigned int count)
+{
+	if (count == 0)
+		return '.';
+	if (count > 9)
+		return '+';
+
+	return '0' + count;
+}
+
+static void
+print_timeline(struct pacing *pacing, struct pacing_surface *ps)
+{
+	struct pacing_bucket *b;
+	uint64_t i, start;
+
+	if (ps->ring_head - ps->ring_first >= PACING_RING_SIZE)
+		start = ps->ring_head - PACING_RING_SIZE + 1;
+	else
+		start = ps->ring_first;
+
+	printf("    timeline (%lums per column, oldest first):\n",
+	       (unsigned long) (pacing->bucket_ns / 1000000));
+
+	printf("      commits   |");
+	for (i = start; i <= ps->ring_head; ++i)
+		putchar(count_char(ps->ring[i % PACING_RING_SIZE].commits));
+	printf("|\n      problems  |");
+	for (i = start; i <= ps->ring_head; ++i) {
+		b = &ps->ring[i % PACING_RING_SIZE];
+		if (b->dropped)
+			putchar('d');
+		else if (b->duplicated)
+			putchar('D');
+		else if (b->unthrottled)
+			putchar('u');
+		else
+			putchar(' ');
+	}
+	printf("|\n");
+}
+
+static void
+print_surface(struct pacing *pacing, struct pacing_surface *ps)
+{
+	uint64_t duration = ps->last_commit - ps->first_commit;
+
+	printf("  wl_surface@%u%s: %lu frames", ps->id,
+	       ps->destroyed ? " (destroyed)" : "",
+	       (unsigned long) ps->commits);
+	if (ps->commits > 1 && duration > 0)
+		printf(", %.1f fps",
+		       (ps->commits - 1) * 1000000000.0 / duration);
+	printf(", %lu commits without new buffer\n",
+	       (unsigned long) ps->other_commits);
+
+	if (ps->commits == 0)
+		return;
+
+	printf("    commit interval  ");
+	wldbg_histogram_print(&ps->intervals);
+	printf("\n    jitter           ");
+	wldbg_histogram_print(&ps->jitter);
+	printf("\n    done -> commit   ");
+	wldbg_histogram_print(&ps->render);
+	printf("\n    frame callbacks: %lu requested, %lu done\n",
+	       (unsigned long) ps->frames_requested,
+	       (unsigned long) ps->frames_done);
+	printf("    dropped (d): %lu, duplicated (D): %lu, "
+	       "without waiting for frame callback (u): %lu\n",
+	       (unsigned long) ps->dropped,
+	       (unsigned long) ps->duplicated,
+	       (unsigned long) ps->unthrottled);
+
+	print_timeline(pacing, ps);
+}
+
+static void
+print_pacing(void *data)
+{
+	struct pacing *pacing = data;
+	struct pacing_connection *pc;
+	struct pacing_surface *ps;
+
+	printf("\n-- Frame pacing --\n");
+
+	wl_list_for_each(pc, &pacing->connections.list, base.link) {
+		wldbg_pass_connection_print(&pc->base);
+
+		wl_list_for_each(ps, &pc->surfaces_list, link)
+			print_surface(pacing, ps);
+	}
+
+	fflush(stdout);
+}
+
+static void
+pacing_help(void *user_data)
+{
+	(void) user_data;
+
+	printf("Analyze frame pacing of surfaces (implies objinfo)\n"
+	       "\n"
+	       "Usage: wldbg pacing [help] [refresh=HZ] [bucket=MS]\n"
+	       "\n"
+	       "  refresh=HZ  refresh rate of the output (default 60)\n"
+	       "  bucket=MS   time covered by one column of the timeline\n"
+	       "              (default 100)\n"
+	       "\n"
+	       "A frame is dropped when more buffers were commited between\n"
+	       "two frame callbacks, duplicated when the client needed more\n"
+	       "than the refresh period to commit after a frame callback.\n"
+	       "The summary is printed on exit and when wldbg gets SIGUSR1\n");
+}
+
+static int
+pacing_init(struct wldbg *wldbg, struct wldbg_pass *pass,
+	    int argc, const char *argv[])
+{
+	struct pacing *pacing;
+	int i, refresh = 60, bucket = 100;
+
+	for (i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "help") == 0) {
+			pacing_help(NULL);
+			wldbg_exit(wldbg);
+			return 0;
+		} else if (strncmp(argv[i], "refresh=", 8) == 0) {
+			refresh = atoi(argv[i] + 8);
+		} else if (strncmp(argv[i], "bucket=", 7) == 0) {
+			bucket = atoi(argv[i] + 7);
+		} else {
+			fprintf(stderr, "pacing: unknown option '%s'\n",
+				argv[i]);
+			return -1;
+		}
+	}
+
+	if (refresh <= 0 || bucket <= 0) {
+		fprintf(stderr, "pacing: invalid refresh rate or bucket size\n");
+		return -1;
+	}
+
+	if (wldbg_add_objinfo_pass(wldbg) < 0)
+		return -1;
+
+	pacing = calloc(1, sizeof *pacing);
+	if (!pacing)
+		return -1;
+
+	pacing->refresh_ns = 1000000000 / refresh;
+	pacing->bucket_ns = (uint64_t) bucket * 1000000;
+	if (wldbg_pass_connections_init(&pacing->connections, wldbg,
+					sizeof(struct pacing_connection),
+					init_connection,
+					release_connection) < 0
+	    || wldbg_add_report_callback(wldbg, print_pacing, pacing) < 0) {
+		wldbg_pass_connections_release(&pacing->connections);
+		free(pacing);
+		return -1;
+	}
+
+	pass->user_data = pacing;
+
+	return 0;
+}
+
+static void
+pacing_destroy(void *user_data)
+{
+	struct pacing *pacing = user_data;
+
+	if (!pacing)
+		return;
+
+	print_pacing(pacing);
+
+	wldbg_pass_connections_release(&pacing->connections);
+	free(pacing);
+}
+
+struct pass *
+create_pacing_pass(void)
+{
+	struct pass *pass;
+
+	pass = alloc_pass("pacing");
+	if (!pass)
+		return NULL;
+
+	pass->wldbg_pass.init = pacing_init;
+	pass->wldbg_pass.destroy = pacing_destroy;
+	pass->wldbg_pass.server_pass = pacing_message;
+	pass->wldbg_pass.client_pass = pacing_message;
+	pass->wldbg_pass.help = pacing_help;
+	pass->wldbg_pass.user_data = NULL;
+	pass->wldbg_pass.description = "Frame pacing of surfaces";
+	pass->wldbg_pass.flags = 0;
+
+	return pass;
+}
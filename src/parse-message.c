@@ -50,6 +50,28 @@ wldbg_parse_message(struct wldbg_message *msg, struct wldbg_parsed_message *out)
 	return 1;
 }
 
+void
+wldbg_for_each_message(struct wldbg_message *message,
+		       void (*func)(struct wldbg_message *one, void *data),
+		       void *data)
+{
+	struct wldbg_message one = *message;
+	uint32_t size;
+	size_t off = 0;
+
+	while (off + 2 * sizeof(uint32_t) <= message->size) {
+		one.data = (char *) message->data + off;
+		size = ((uint32_t *) one.data)[1] >> 16;
+		if (size < 2 * sizeof(uint32_t) || off + size > message->size)
+			break;
+
+		one.size = size;
+		func(&one, data);
+
+		off += size;
+	}
+}
+
 static inline int
 is_valid_interface(const struct wl_interface *intf)
 {
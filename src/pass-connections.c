@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "wldbg-private.h"
+#include "pass-connections.h"
+
+static void
+free_connection(struct wldbg_pass_connections *pcs,
+		struct wldbg_pass_connection *pc)
+{
+	wldbg_ids_map_insert(&pcs->map, pc->id, NULL);
+	wl_list_remove(&pc->link);
+	if (pc->closed) {
+		wl_list_remove(&pc->closed_link);
+		--pcs->closed_num;
+	}
+
+	if (pcs->release)
+		pcs->release(pc);
+	free(pc->program);
+	free(pc);
+}
+
+static void
+connection_closed(struct wldbg_connection *conn, void *data)
+{
+	struct wldbg_pass_connections *pcs = data;
+	struct wldbg_pass_connection *pc;
+
+	pc = wldbg_ids_map_get(&pcs->map, conn->id);
+	if (!pc || pc->closed)
+		return;
+
+	pc->closed = 1;
+	wl_list_insert(pcs->closed.prev, &pc->closed_link);
+	++pcs->closed_num;
+
+	if (pcs->closed_num > WLDBG_PASS_CONNECTIONS_CLOSED) {
+		pc = wl_container_of(pcs->closed.next, pc, closed_link);
+		free_connection(pcs, pc);
+	}
+}
+
+int
+wldbg_pass_connections_init(struct wldbg_pass_connections *pcs,
+			    struct wldbg *wldbg, size_t size,
+			    void (*init)(struct wldbg_pass_connection *pc),
+			    void (*release)(struct wldbg_pass_connection *pc))
+{
+	wldbg_ids_map_init(&pcs->map);
+	wl_list_init(&pcs->list);
+	wl_list_init(&pcs->closed);
+	pcs->closed_num = 0;
+
+	pcs->wldbg = wldbg;
+	pcs->size = size;
+	pcs->init = init;
+	pcs->release = release;
+
+	return wldbg_add_close_callback(wldbg, connection_closed, pcs);
+}
+
+void
+wldbg_pass_connections_release(struct wldbg_pass_connections *pcs)
+{
+	struct wldbg_pass_connection *pc, *tmp;
+
+	wldbg_remove_close_callbacks(pcs->wldbg, pcs);
+
+	wl_list_for_each_safe(pc, tmp, &pcs->list, link)
+		free_connection(pcs, pc);
+
+	wldbg_ids_map_release(&pcs->map);
+}
+
+void *
+wldbg_pass_connection_get(struct wldbg_pass_connections *pcs,
+			  struct wldbg_connection *conn)
+{
+	struct wldbg_pass_connection *pc;
+
+	pc = wldbg_ids_map_get(&pcs->map, conn->id);
+	if (pc)
+		return pc;
+
+	pc = calloc(1, pcs->size);
+	if (!pc)
+		return NULL;
+
+	pc->id = conn->id;
+	pc->pid = conn->client.pid;
+	if (conn->client.program) {
+		pc->program = strdup(conn->client.program);
+		if (!pc->program) {
+			free(pc);
+			return NULL;
+		}
+	}
+
+	if (pcs->init)
+		pcs->init(pc);
+
+	wldbg_ids_map_insert(&pcs->map, conn->id, pc);
+	wl_list_insert(pcs->list.prev, &pc->link);
+
+	return pc;
+}
+
+void
+wldbg_pass_connection_print(struct wldbg_pass_connection *pc)
+{
+	printf("\n== Connection %u: %s (pid %d) ==\n", pc->id,
+	       pc->program ? pc->program : "unknown", pc->pid);
+}
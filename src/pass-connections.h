@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_PASS_CONNECTIONS_H_
+#define _WLDBG_PASS_CONNECTIONS_H_
+
+#include <sys/types.h>
+
+#include "wayland/wayland-util.h"
+#include "wldbg-ids-map.h"
+
+struct wldbg;
+struct wldbg_connection;
+
+/* how many closed connections are kept for the report,
+ * the older ones are freed */
+#define WLDBG_PASS_CONNECTIONS_CLOSED 16
+
+/* What the analysis passes keep about every connection they saw.
+ * The pass embeds it at the start of its own structure of the
+ * connection, that is created with the first message of the
+ * connection. It lives after the connection is closed, so the pass
+ * can print it after the client is gone, until there are more than
+ * WLDBG_PASS_CONNECTIONS_CLOSED closed connections newer than it */
+struct wldbg_pass_connection {
+	unsigned int id;
+	pid_t pid;
+	/* NULL if the program of the client is not known */
+	char *program;
+	int closed;
+
+	struct wl_list link;
+	/* in the list of closed connections */
+	struct wl_list closed_link;
+};
+
+struct wldbg_pass_connections {
+	struct wldbg *wldbg;
+
+	/* by the id of the connection */
+	struct wldbg_ids_map map;
+	/* struct wldbg_pass_connection in order of creation */
+	struct wl_list list;
+	/* the closed ones in order of closing */
+	struct wl_list closed;
+	unsigned int closed_num;
+
+	/* size of the pass' structure of the connection */
+	size_t size;
+	/* set up and release what the pass has in its structure,
+	 * both can be NULL */
+	void (*init)(struct wldbg_pass_connection *pc);
+	void (*release)(struct wldbg_pass_connection *pc);
+};
+
+/* returns -1 if out of memory */
+int
+wldbg_pass_connections_init(struct wldbg_pass_connections *pcs,
+			    struct wldbg *wldbg, size_t size,
+			    void (*init)(struct wldbg_pass_connection *pc),
+			    void (*release)(struct wldbg_pass_connection *pc));
+
+/* release and free all the connections, closed or not */
+void
+wldbg_pass_connections_release(struct wldbg_pass_connections *pcs);
+
+/* the structure of the connection, zeroed and initialized when the
+ * connection is new. NULL if it could not be created */
+void *
+wldbg_pass_connection_get(struct wldbg_pass_connections *pcs,
+			  struct wldbg_connection *conn);
+
+/* print the header the passes start the report of a connection with */
+void
+wldbg_pass_connection_print(struct wldbg_pass_connection *pc);
+
+#endif /* _WLDBG_PASS_CONNECTIONS_H_ */
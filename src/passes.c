@@ -37,6 +37,7 @@
 #include "util.h"
 #include "wldbg-pass.h"
 #include "getopt.h"
+#include "passes.h"
 
 #include "fuzz-pass.h"
 
@@ -117,6 +118,8 @@ dealloc_pass(struct pass *pass)
 {
 	if (pass->name)
 		free(pass->name);
+	if (pass->histogram)
+		wldbg_histogram_destroy(pass->histogram);
 
 	free(pass);
 }
@@ -129,6 +132,8 @@ alloc_pass(const char *name)
 		return NULL;
 
 	pass->name = strdup(name);
+	pass->calls = pass->time = 0;
+	pass->histogram = NULL;
 
 	if (!pass->name) {
 		dealloc_pass(pass);
@@ -161,6 +166,30 @@ create_pass(const char *name)
 	else if (strcmp(name, "fuzz") == 0) {
         return create_fuzz_pass();
     }
+	else if (strcmp(name, "fuzz-campaign") == 0) {
+		return create_fuzz_campaign_pass();
+	}
+	else if (strcmp(name, "fuzz-minimize") == 0) {
+		return create_fuzz_minimize_pass();
+	}
+	else if (strcmp(name, "stats") == 0) {
+		return create_stats_pass();
+	}
+	else if (strcmp(name, "latency") == 0) {
+		return create_latency_pass();
+	}
+	else if (strcmp(name, "pacing") == 0) {
+		return create_pacing_pass();
+	}
+	else if (strcmp(name, "input-latency") == 0) {
+		return create_input_latency_pass();
+	}
+	else if (strcmp(name, "trace") == 0) {
+		return create_trace_pass();
+	}
+	else if (strcmp(name, "publish") == 0) {
+		return create_publish_pass();
+	}
 	else {
 		/* try current directory */
 		if (build_path(path, "./", NULL, name) < 0)
@@ -248,6 +277,21 @@ create_pass(const char *name)
 	return pass;
 }
 
+void
+insert_pass(struct wldbg *wldbg, struct pass *pass)
+{
+	struct wl_list *pos = &wldbg->passes;
+
+	/* resolve and objinfo passes go always first,
+	 * so that other passes can use what they gathered */
+	if (wldbg->resolving_objects)
+		pos = pos->next;
+	if (wldbg->gathering_info)
+		pos = pos->next;
+
+	wl_list_insert(pos, &pass->link);
+}
+
 int
 pass_init(struct wldbg *wldbg, struct pass *pass,
 		int argc, const char *argv[])
@@ -259,6 +303,42 @@ pass_init(struct wldbg *wldbg, struct pass *pass,
 		return 0;
 }
 
+struct pass *
+create_pass_with_args(struct wldbg *wldbg, int argc, const char *argv[])
+{
+	struct pass *pass;
+
+	pass = create_pass(argv[0]);
+	if (!pass)
+		return NULL;
+
+	if (pass_init(wldbg, pass, argc, argv) != 0) {
+		fprintf(stderr, "Failed initializing pass '%s'\n", argv[0]);
+		dealloc_pass(pass);
+		return NULL;
+	}
+
+	return pass;
+}
+
+void
+destroy_pass(struct wldbg *wldbg, struct pass *pass)
+{
+	void *user_data = pass->wldbg_pass.user_data;
+
+	/* SIGUSR1 or SIGCHLD would call the pass after it is gone */
+	if (user_data) {
+		wldbg_remove_report_callbacks(wldbg, user_data);
+		wldbg_remove_exit_callbacks(wldbg, user_data);
+		wldbg_remove_close_callbacks(wldbg, user_data);
+	}
+
+	if (pass->wldbg_pass.destroy)
+		pass->wldbg_pass.destroy(user_data);
+
+	dealloc_pass(pass);
+}
+
 static int
 count_args(int argc, const char *argv[])
 {
@@ -328,12 +408,14 @@ load_passes(struct wldbg *wldbg, struct wldbg_options *opts,
 			if (pass) {
 				if (pass_init(wldbg, pass, count,
 						argv + argc - rest) != 0) {
+					fprintf(stderr, "Failed initializing pass '%s'\n",
+						argv[argc - rest]);
 					dealloc_pass(pass);
-					continue;
+					return -1;
 				}
 
 				++pass_created;
-				wl_list_insert(wldbg->passes.next, &pass->link);
+				insert_pass(wldbg, pass);
 				dbg("Pass '%s' loaded\n", argv[argc - rest]);
 			} else {
 				dbg("Loading pass '%s' failed\n",
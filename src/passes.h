@@ -41,6 +41,43 @@ int
 pass_init(struct wldbg *wldbg, struct pass *pass,
 		int argc, const char *argv[]);
 
+/* create the pass argv[0] and initialize it with the arguments */
+struct pass *
+create_pass_with_args(struct wldbg *wldbg, int argc, const char *argv[]);
+
+/* destroy the pass while wldbg is running. The pass
+ * must be removed from its list already */
+void
+destroy_pass(struct wldbg *wldbg, struct pass *pass);
+
+/* insert pass after the hardcoded resolve and objinfo passes */
+void
+insert_pass(struct wldbg *wldbg, struct pass *pass);
+
+/* defined in stats-pass.c */
+struct pass *
+create_stats_pass(void);
+
+/* defined in latency-pass.c */
+struct pass *
+create_latency_pass(void);
+
+/* defined in pacing-pass.c */
+struct pass *
+create_pacing_pass(void);
+
+/* defined in input-latency-pass.c */
+struct pass *
+create_input_latency_pass(void);
+
+/* defined in trace-pass.c */
+struct pass *
+create_trace_pass(void);
+
+/* defined in publish-pass.c */
+struct pass *
+create_publish_pass(void);
+
 /* defined in passes/list.c */
 void
 list_passes(int lng);
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fnmatch.h>
+
+#include "wldbg.h"
+#include "wldbg-pass.h"
+#include "wldbg-private.h"
+#include "passes.h"
+#include "pipeline.h"
+
+#define PIPELINE_MAX_ARGS	64
+
+struct pipeline_rule {
+	char *pattern;
+	/* PASS [ARGS],PASS [ARGS],... */
+	char *passes;
+	struct wl_list link;
+};
+
+/* does the list of passes contain the pass name? */
+static int
+rule_has_pass(const char *passes, const char *name)
+{
+	size_t len = strlen(name);
+	const char *p = passes;
+
+	while (*p) {
+		p += strspn(p, " \t");
+		if (strncmp(p, name, len) == 0
+		    && (p[len] == '\0' || p[len] == ','
+			|| p[len] == ' ' || p[len] == '\t'))
+			return 1;
+
+		p = strchr(p, ',');
+		if (!p)
+			break;
+		++p;
+	}
+
+	return 0;
+}
+
+int
+wldbg_add_pipeline_rule(struct wldbg *wldbg, const char *rule)
+{
+	struct pipeline_rule *r;
+	const char *colon = strchr(rule, ':');
+
+	if (!colon || colon == rule || colon[1] == '\0') {
+		fprintf(stderr, "Invalid pipeline rule '%s', "
+			"expected PATTERN:PASS,PASS,...\n", rule);
+		return -1;
+	}
+
+	/* objinfo gathers from the first message of the connection,
+	 * it can not be added later */
+	if (wldbg->flags.running && !wldbg->gathering_info
+	    && rule_has_pass(colon + 1, "objinfo")) {
+		fprintf(stderr, "Pipeline rule '%s' needs wldbg "
+			"started with -g\n", rule);
+		return -1;
+	}
+
+	r = calloc(1, sizeof *r);
+	if (!r)
+		return -1;
+
+	r->pattern = strndup(rule, colon - rule);
+	r->passes = strdup(colon + 1);
+	if (!r->pattern || !r->passes) {
+		free(r->pattern);
+		free(r->passes);
+		free(r);
+		return -1;
+	}
+
+	wl_list_insert(wldbg->pipeline_rules.prev, &r->link);
+	dbg("Added pipeline rule '%s' -> '%s'\n", r->pattern, r->passes);
+
+	return 0;
+}
+
+int
+wldbg_pipeline_rules_need_objinfo(struct wldbg *wldbg)
+{
+	struct pipeline_rule *r;
+
+	wl_list_for_each(r, &wldbg->pipeline_rules, link)
+		if (rule_has_pass(r->passes, "objinfo"))
+			return 1;
+
+	return 0;
+}
+
+void
+wldbg_print_pipeline_rules(struct wldbg *wldbg, FILE *out)
+{
+	struct pipeline_rule *r;
+
+	wl_list_for_each(r, &wldbg->pipeline_rules, link)
+		fprintf(out, "%-20s %s\n", r->pattern, r->passes);
+}
+
+void
+wldbg_pipeline_rules_destroy(struct wldbg *wldbg)
+{
+	struct pipeline_rule *r, *tmp;
+
+	wl_list_for_each_safe(r, tmp, &wldbg->pipeline_rules, link) {
+		free(r->pattern);
+		free(r->passes);
+		free(r);
+	}
+
+	wl_list_init(&wldbg->pipeline_rules);
+}
+
+/* the connection gets its own pass with the callbacks of the hardcoded
+ * resolve or objinfo pass. These keep everything in the connection,
+ * so the copy can share them. The shared pass destroys what it holds */
+static struct pass *
+copy_hardcoded_pass(struct wldbg *wldbg, const char *name)
+{
+	struct pass *pass, *copy;
+	int hardcoded = wldbg->resolving_objects + wldbg->gathering_info;
+
+	wl_list_for_each(pass, &wldbg->passes, link) {
+		if (hardcoded-- == 0)
+			break;
+		if (strcmp(pass->name, name) != 0)
+			continue;
+
+		copy = alloc_pass(name);
+		if (!copy)
+			return NULL;
+
+		copy->wldbg_pass = pass->wldbg_pass;
+		copy->wldbg_pass.init = NULL;
+		copy->wldbg_pass.destroy = NULL;
+
+		return copy;
+	}
+
+	fprintf(stderr, "Pass '%s' is not running%s\n", name,
+		strcmp(name, "objinfo") == 0 ? ", start wldbg with -g" : "");
+	return NULL;
+}
+
+static struct pass *
+create_rule_pass(struct wldbg *wldbg, char *spec)
+{
+	const char *argv[PIPELINE_MAX_ARGS + 1];
+	unsigned int exiting = wldbg->flags.exit;
+	struct pass *pass;
+	char *word, *saveptr;
+	int argc = 0;
+
+	for (word = strtok_r(spec, " \t", &saveptr); word;
+	     word = strtok_r(NULL, " \t", &saveptr)) {
+		if (argc == PIPELINE_MAX_ARGS) {
+			fprintf(stderr, "Too many arguments of pass '%s'\n",
+				argv[0]);
+			return NULL;
+		}
+		argv[argc++] = word;
+	}
+	argv[argc] = NULL;
+
+	if (argc == 0) {
+		fprintf(stderr, "Empty pass in pipeline rule\n");
+		return NULL;
+	}
+
+	if (strcmp(argv[0], "resolve") == 0
+	    || strcmp(argv[0], "objinfo") == 0)
+		return copy_hardcoded_pass(wldbg, argv[0]);
+
+	pass = create_pass_with_args(wldbg, argc, argv);
+	if (!pass)
+		return NULL;
+
+	/* with 'help' the passes print the help and exit wldbg */
+	if (!exiting && wldbg->flags.exit) {
+		wldbg->flags.exit = 0;
+		destroy_pass(wldbg, pass);
+		return NULL;
+	}
+
+	return pass;
+}
+
+static struct pipeline_rule *
+find_rule(struct wldbg *wldbg, const char *program)
+{
+	struct pipeline_rule *r;
+
+	wl_list_for_each(r, &wldbg->pipeline_rules, link)
+		if (fnmatch(r->pattern, program, 0) == 0)
+			return r;
+
+	return NULL;
+}
+
+int
+wldbg_connection_apply_rules(struct wldbg_connection *conn)
+{
+	struct wldbg *wldbg = conn->wldbg;
+	const char *program = conn->client.program ?
+			      conn->client.program : "unknown";
+	struct pipeline_rule *r;
+	struct pass *pass, *tmp;
+	char *passes, *spec, *saveptr;
+
+	r = find_rule(wldbg, program);
+	if (!r)
+		return 0;
+
+	passes = strdup(r->passes);
+	if (!passes)
+		return -1;
+
+	for (spec = strtok_r(passes, ",", &saveptr); spec;
+	     spec = strtok_r(NULL, ",", &saveptr)) {
+		/* no passes at all, just forward the messages */
+		if (rule_has_pass(spec, "passthrough"))
+			continue;
+
+		pass = create_rule_pass(wldbg, spec);
+		if (!pass)
+			goto err;
+
+		wl_list_insert(conn->passes.prev, &pass->link);
+	}
+
+	free(passes);
+	conn->own_pipeline = 1;
+
+	dbg("Connection %u (%s) matched pipeline rule '%s'\n",
+	    conn->id, program, r->pattern);
+
+	return 0;
+err:
+	free(passes);
+	wl_list_for_each_safe(pass, tmp, &conn->passes, link) {
+		wl_list_remove(&pass->link);
+		destroy_pass(wldbg, pass);
+	}
+
+	fprintf(stderr, "Failed creating pipeline '%s' for connection %u "
+		"(%s), using the shared passes\n", r->passes, conn->id,
+		program);
+	return -1;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_PIPELINE_H_
+#define _WLDBG_PIPELINE_H_
+
+#include <stdio.h>
+
+struct wldbg;
+struct wldbg_connection;
+
+/* Rules that give connections their own passes according to the
+ * program of the client, in the form
+ *
+ *   PATTERN:PASS [ARGS],PASS [ARGS],...
+ *
+ * PATTERN is a shell wildcard matched against the name of the program
+ * ("unknown" if wldbg could not find it). The first rule that matches
+ * is used. The connection then runs only the passes of its rule,
+ * not the shared ones. 'resolve' and 'objinfo' in the rule are the
+ * hardcoded passes, 'passthrough' is a rule without passes, the
+ * messages are just forwarded. For example:
+ *
+ *   firefox:resolve,objinfo,stats
+ *   *:passthrough
+ */
+int
+wldbg_add_pipeline_rule(struct wldbg *wldbg, const char *rule);
+
+/* 1 if some rule has objinfo, that needs wldbg_add_objinfo_pass() */
+int
+wldbg_pipeline_rules_need_objinfo(struct wldbg *wldbg);
+
+void
+wldbg_print_pipeline_rules(struct wldbg *wldbg, FILE *out);
+
+void
+wldbg_pipeline_rules_destroy(struct wldbg *wldbg);
+
+/* give the new connection the passes of the first rule that matches
+ * its program. Without a matching rule, the connection keeps running
+ * the shared passes. Returns -1 if the passes could not be created */
+int
+wldbg_connection_apply_rules(struct wldbg_connection *conn);
+
+#endif /* _WLDBG_PIPELINE_H_ */
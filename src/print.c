@@ -604,7 +604,10 @@ print_arg(struct wldbg_resolved_arg *arg, struct wldbg_resolved_message *rm,
 		break;
 	case 's':
 		if (arg->data)
-			printf("%u:\"%s\"", *(arg->data - 1),
+			/* the string may be not terminated, e.g. when
+			 * the fuzzer mutated it */
+			printf("%u:\"%.*s\"", *(arg->data - 1),
+			       (int) *(arg->data - 1),
 			       (const char *) (arg->data));
 		else
 			printf("0:\"\"");
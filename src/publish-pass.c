@@ -0,0 +1,445 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Send the messages to the processes attached by 'wldbg attach'.
+ * The proxy only resolves and forwards the messages, the printing
+ * and filtering is done by the attached process, so a slow terminal
+ * does not slow down the client */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include "wayland/wayland-util.h"
+#include "wayland/wayland-os.h"
+
+#include "wldbg.h"
+#include "wldbg-pass.h"
+#include "wldbg-private.h"
+#include "wldbg-ids-map.h"
+#include "wldbg-parse-message.h"
+#include "passes.h"
+#include "publish.h"
+
+struct subscriber {
+	int fd;
+	uint32_t dropped;
+	struct wl_list link;
+};
+
+struct publish {
+	struct wldbg *wldbg;
+	int fd;
+	char *path;
+	struct wldbg_fd_callback *cb;
+
+	struct wl_list subscribers;
+	/* connections that the subscribers know about */
+	struct wldbg_ids_map connections;
+
+	/* records dropped for all subscribers */
+	uint64_t dropped;
+};
+
+int
+publish_default_path(char *path, size_t size)
+{
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	int ret;
+
+	if (!dir)
+		dir = "/tmp";
+
+	ret = snprintf(path, size, "%s/wldbg-publish", dir);
+	if (ret < 0 || (size_t) ret >= size)
+		return -1;
+
+	return 0;
+}
+
+static void
+remove_subscriber(struct subscriber *sub)
+{
+	dbg("publish: subscriber %d left\n", sub->fd);
+
+	close(sub->fd);
+	wl_list_remove(&sub->link);
+	free(sub);
+}
+
+/* returns -1 if the subscriber is gone */
+static int
+send_record(struct publish *publish, struct subscriber *sub,
+	    struct publish_record *rec, const char *name,
+	    const void *data)
+{
+	static const char padding[4];
+	struct iovec iov[4];
+	struct msghdr msg;
+	size_t len;
+	int n = 0;
+
+	len = name ? strlen(name) : 0;
+	/* the program name can be anything */
+	if (len > 255 - 1)
+		len = 255 - 1;
+
+	rec->name_size = (len + 1 + 3) & ~3u;
+	rec->dropped = sub->dropped;
+
+	iov[n].iov_base = rec;
+	iov[n++].iov_len = sizeof *rec;
+	if (len > 0) {
+		iov[n].iov_base = (void *) name;
+		iov[n++].iov_len = len;
+	}
+	iov[n].iov_base = (void *) padding;
+	iov[n++].iov_len = rec->name_size - len;
+	if (rec->data_size > 0) {
+		iov[n].iov_base = (void *) data;
+		iov[n++].iov_len = rec->data_size;
+	}
+
+	memset(&msg, 0, sizeof msg);
+	msg.msg_iov = iov;
+	msg.msg_iovlen = n;
+
+	if (sendmsg(sub->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) >= 0) {
+		sub->dropped = 0;
+		return 0;
+	}
+
+	/* never wait for the subscriber */
+	if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+		++sub->dropped;
+		++publish->dropped;
+		return 0;
+	}
+
+	return -1;
+}
+
+static void
+publish_record(struct publish *publish, struct publish_record *rec,
+	       const char *name, const void *data)
+{
+	struct subscriber *sub, *tmp;
+
+	wl_list_for_each_safe(sub, tmp, &publish->subscribers, link) {
+		if (send_record(publish, sub, rec, name, data) < 0)
+			remove_subscriber(sub);
+	}
+}
+
+static void
+connection_record(struct wldbg_connection *conn, struct publish_record *rec)
+{
+	memset(rec, 0, sizeof *rec);
+	rec->type = PUBLISH_CONNECTION;
+	rec->connection = conn->id;
+	rec->time = wldbg_get_time();
+	rec->arg = conn->client.pid;
+}
+
+static void
+publish_closed(struct wldbg_connection *conn, void *data)
+{
+	struct publish *publish = data;
+	struct publish_record rec;
+
+	/* the subscribers don't know about it */
+	if (!wldbg_ids_map_get(&publish->connections, conn->id))
+		return;
+
+	memset(&rec, 0, sizeof rec);
+	rec.type = PUBLISH_DISCONNECT;
+	rec.connection = conn->id;
+	rec.time = wldbg_get_time();
+
+	publish_record(publish, &rec, NULL, NULL);
+
+	wldbg_ids_map_insert(&publish->connections, conn->id, NULL);
+}
+
+static void
+publish_one(struct wldbg_message *message, void *user_data)
+{
+	struct publish *publish = user_data;
+	struct wldbg_connection *conn = message->connection;
+	const struct wl_interface *intf;
+	struct publish_record rec;
+	const char *name = NULL;
+
+	if (!wldbg_ids_map_get(&publish->connections, conn->id)) {
+		connection_record(conn, &rec);
+		publish_record(publish, &rec, conn->client.program, NULL);
+
+		wldbg_ids_map_insert(&publish->connections, conn->id,
+				     (void *) 1);
+	}
+
+	/* the interface lets the subscriber resolve
+	 * objects that were created before it attached */
+	intf = wldbg_message_get_object(message,
+					((uint32_t *) message->data)[0]);
+	if (intf)
+		name = intf->name;
+
+	memset(&rec, 0, sizeof rec);
+	rec.type = PUBLISH_MESSAGE;
+	rec.connection = conn->id;
+	rec.time = message->time;
+	rec.arg = message->from;
+	rec.data_size = message->size;
+
+	publish_record(publish, &rec, name, message->data);
+}
+
+static int
+publish_message(void *user_data, struct wldbg_message *message)
+{
+	struct publish *publish = user_data;
+
+	/* nobody is listening, this is the hot path */
+	if (wl_list_empty(&publish->subscribers))
+		return PASS_NEXT;
+
+	wldbg_for_each_message(message, publish_one, publish);
+	return PASS_NEXT;
+}
+
+static int
+publish_accept(int fd, void *data)
+{
+	struct publish *publish = data;
+	struct wldbg_connection *conn;
+	struct publish_record rec;
+	struct subscriber *sub;
+	int cfd;
+
+	cfd = wl_os_accept_cloexec(fd, NULL, NULL);
+	if (cfd < 0) {
+		perror("publish: accept");
+		return 1;
+	}
+
+	sub = calloc(1, sizeof *sub);
+	if (!sub) {
+		close(cfd);
+		return 1;
+	}
+
+	sub->fd = cfd;
+	wl_list_insert(publish->subscribers.prev, &sub->link);
+
+	dbg("publish: subscriber %d attached\n", cfd);
+
+	/* tell it about the connections we already have */
+	wl_list_for_each(conn, &publish->wldbg->connections, link) {
+		wldbg_ids_map_insert(&publish->connections, conn->id,
+				     (void *) 1);
+
+		connection_record(conn, &rec);
+		if (send_record(publish, sub, &rec,
+				conn->client.program, NULL) < 0) {
+			remove_subscriber(sub);
+			break;
+		}
+	}
+
+	return 1;
+}
+
+static void
+publish_report(void *data)
+{
+	struct publish *publish = data;
+
+	printf("\n-- Publish --\n");
+	printf("  subscribers: %d\n", wl_list_length(&publish->subscribers));
+	printf("  dropped records: %lu\n", publish->dropped);
+}
+
+static void
+publish_help(void *user_data)
+{
+	(void) user_data;
+
+	printf("Send the messages to processes attached by 'wldbg attach'\n"
+	       "that print and filter them, so that the traced program\n"
+	       "does not wait for the terminal\n"
+	       "\n"
+	       "Usage: wldbg publish [help] [socket=PATH]\n"
+	       "\n"
+	       "  socket=PATH  where to listen (default\n"
+	       "               $XDG_RUNTIME_DIR/wldbg-publish)\n"
+	       "\n"
+	       "Messages are dropped for attached processes that do not\n"
+	       "keep up, the traced program never waits for them.\n");
+}
+
+static int
+publish_init(struct wldbg *wldbg, struct wldbg_pass *pass,
+	     int argc, const char *argv[])
+{
+	struct publish *publish;
+	struct sockaddr_un addr;
+	char path[sizeof addr.sun_path];
+	int i;
+
+	path[0] = '\0';
+
+	for (i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "help") == 0) {
+			publish_help(NULL);
+			wldbg_exit(wldbg);
+			return 0;
+		} else if (strncmp(argv[i], "socket=", 7) == 0) {
+			if (strlen(argv[i] + 7) >= sizeof path) {
+				fprintf(stderr, "publish: path too long\n");
+				return -1;
+			}
+			strcpy(path, argv[i] + 7);
+		} else {
+			fprintf(stderr, "publish: unknown option '%s'\n",
+				argv[i]);
+			return -1;
+		}
+	}
+
+	if (path[0] == '\0' && publish_default_path(path, sizeof path) < 0) {
+		fprintf(stderr, "publish: path too long\n");
+		return -1;
+	}
+
+	publish = calloc(1, sizeof *publish);
+	if (!publish)
+		return -1;
+
+	publish->wldbg = wldbg;
+	wl_list_init(&publish->subscribers);
+	wldbg_ids_map_init(&publish->connections);
+
+	publish->path = strdup(path);
+	if (!publish->path)
+		goto err;
+
+	publish->fd = wl_os_socket_cloexec(PF_LOCAL, SOCK_SEQPACKET, 0);
+	if (publish->fd < 0)
+		goto err;
+
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_LOCAL;
+	strcpy(addr.sun_path, path);
+
+	/* remove the socket from previous run */
+	unlink(path);
+
+	if (bind(publish->fd, (struct sockaddr *) &addr, sizeof addr) < 0
+	    || listen(publish->fd, 4) < 0) {
+		fprintf(stderr, "publish: failed creating socket '%s': %s\n",
+			path, strerror(errno));
+		close(publish->fd);
+		goto err;
+	}
+
+	publish->cb = wldbg_monitor_fd(wldbg, publish->fd,
+				       publish_accept, publish);
+	if (!publish->cb) {
+		close(publish->fd);
+		unlink(path);
+		goto err;
+	}
+
+	if (wldbg_add_report_callback(wldbg, publish_report, publish) < 0)
+		fprintf(stderr, "publish: failed adding report callback\n");
+
+	if (wldbg_add_close_callback(wldbg, publish_closed, publish) < 0)
+		fprintf(stderr, "publish: failed adding close callback\n");
+
+	pass->user_data = publish;
+
+	return 0;
+
+err:
+	wldbg_ids_map_release(&publish->connections);
+	free(publish->path);
+	free(publish);
+	return -1;
+}
+
+static void
+publish_destroy(void *user_data)
+{
+	struct publish *publish = user_data;
+	struct subscriber *sub, *tmp;
+
+	if (!publish)
+		return;
+
+	/* the pass may be removed while wldbg is running,
+	 * otherwise wldbg frees the callback itself */
+	if (publish->wldbg->flags.running)
+		wldbg_remove_callback(publish->wldbg, publish->cb);
+
+	wl_list_for_each_safe(sub, tmp, &publish->subscribers, link)
+		remove_subscriber(sub);
+
+	close(publish->fd);
+	unlink(publish->path);
+
+	wldbg_ids_map_release(&publish->connections);
+	free(publish->path);
+	free(publish);
+}
+
+struct pass *
+create_publish_pass(void)
+{
+	struct pass *pass;
+
+	pass = alloc_pass("publish");
+	if (!pass)
+		return NULL;
+
+	pass->wldbg_pass.init = publish_init;
+	pass->wldbg_pass.destroy = publish_destroy;
+	pass->wldbg_pass.server_pass = publish_message;
+	pass->wldbg_pass.client_pass = publish_message;
+	pass->wldbg_pass.help = publish_help;
+	pass->wldbg_pass.user_data = NULL;
+	pass->wldbg_pass.description
+		= "Send messages to processes attached by 'wldbg attach'";
+	pass->wldbg_pass.flags = 0;
+
+	return pass;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_PUBLISH_H_
+#define _WLDBG_PUBLISH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The publish pass sends every message to the processes attached
+ * to its socket (wldbg attach), which do the printing and filtering.
+ * The socket is SOCK_SEQPACKET, one packet is one record:
+ *
+ *   struct publish_record
+ *   name, NUL-terminated and padded to 4 bytes (name_size)
+ *   raw message (data_size), only in PUBLISH_MESSAGE
+ *
+ * The publisher never waits for the subscribers. When a subscriber
+ * does not read fast enough, its records are dropped and counted */
+
+enum publish_record_type {
+	/* new connection, the name is the program */
+	PUBLISH_CONNECTION = 1,
+	/* message, the name is the interface of the object
+	 * that the message is for, empty if not known */
+	PUBLISH_MESSAGE = 2,
+	/* the connection was closed, the name is empty */
+	PUBLISH_DISCONNECT = 3,
+};
+
+struct publish_record {
+	uint32_t type;
+	uint32_t connection;
+	/* when wldbg read the message (see wldbg_get_time) */
+	uint64_t time;
+	/* pid of the client for PUBLISH_CONNECTION,
+	 * SERVER or CLIENT for PUBLISH_MESSAGE */
+	int32_t arg;
+	/* records dropped for this subscriber since the last one */
+	uint32_t dropped;
+	uint32_t name_size;
+	uint32_t data_size;
+};
+
+/* the biggest record, a wayland message has at most 4096 bytes */
+#define PUBLISH_RECORD_MAX	(sizeof(struct publish_record) + 256 + 4096)
+
+/* the socket that is used when no path is given,
+ * $XDG_RUNTIME_DIR/wldbg-publish. Returns -1 when it does not fit */
+int
+publish_default_path(char *path, size_t size);
+
+#endif /* _WLDBG_PUBLISH_H_ */
@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "wldbg.h"
+#include "wldbg-private.h"
+#include "request.h"
+
+#include "wayland/wayland-os.h"
+
+#define REQUEST_MAX_SIZE	1024
+
+struct wldbg_request_socket {
+	struct wldbg *wldbg;
+	int fd;
+	char *path;
+	struct wldbg_fd_callback *cb;
+
+	uint64_t wait;
+	wldbg_answer_func answer;
+
+	struct wl_list clients;
+};
+
+struct request_client {
+	struct wldbg_request_socket *rs;
+	int fd;
+	struct wldbg_fd_callback *cb;
+	/* answers when the optional request does not come */
+	struct wldbg_timer *timer;
+
+	char request[REQUEST_MAX_SIZE];
+	size_t len;
+
+	/* NULL until the request is answered */
+	char *answer;
+	size_t size, sent;
+
+	struct wl_list link;
+};
+
+static void
+client_destroy(struct request_client *client)
+{
+	struct wldbg *wldbg = client->rs->wldbg;
+
+	/* otherwise wldbg frees the callback and the timer itself */
+	if (wldbg->flags.running) {
+		wldbg_remove_callback(wldbg, client->cb);
+		if (client->timer)
+			wldbg_remove_timer(wldbg, client->timer);
+	}
+
+	close(client->fd);
+	wl_list_remove(&client->link);
+	free(client->answer);
+	free(client);
+}
+
+/* returns 1 when the whole answer is sent */
+static int
+client_send(struct request_client *client)
+{
+	ssize_t len;
+
+	while (client->sent < client->size) {
+		len = send(client->fd, client->answer + client->sent,
+			   client->size - client->sent,
+			   MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0 && errno == EAGAIN)
+			return 0;
+		if (len < 0) {
+			/* the client is gone, nobody to tell */
+			dbg("request: send: %s\n", strerror(errno));
+			return 1;
+		}
+
+		client->sent += len;
+	}
+
+	return 1;
+}
+
+static void
+client_answer(struct request_client *client)
+{
+	struct wldbg_request_socket *rs = client->rs;
+	struct wldbg *wldbg = rs->wldbg;
+	FILE *out;
+
+	if (client->timer) {
+		wldbg_remove_timer(wldbg, client->timer);
+		client->timer = NULL;
+	}
+
+	client->request[client->len] = '\0';
+
+	out = open_memstream(&client->answer, &client->size);
+	if (!out) {
+		client_destroy(client);
+		return;
+	}
+
+	rs->answer(wldbg, client->request, out);
+	fclose(out);
+
+	if (client_send(client)) {
+		client_destroy(client);
+		return;
+	}
+
+	/* the rest goes when the client reads what it got */
+	if (wldbg_set_fd_events(wldbg, client->fd, EPOLLOUT) < 0)
+		client_destroy(client);
+}
+
+static void
+client_timeout(void *data)
+{
+	client_answer(data);
+}
+
+static int
+client_dispatch(int fd, void *data)
+{
+	struct request_client *client = data;
+	ssize_t len;
+
+	if (client->answer) {
+		if (client_send(client))
+			client_destroy(client);
+		return 1;
+	}
+
+	len = recv(fd, client->request + client->len,
+		   sizeof client->request - 1 - client->len, MSG_DONTWAIT);
+	if (len < 0 && (errno == EAGAIN || errno == EINTR))
+		return 1;
+
+	if (len < 0) {
+		client_destroy(client);
+		return 1;
+	}
+
+	client->len += len;
+
+	/* the request is the line, or what came until the client
+	 * shut down its side, or what fits */
+	if (len == 0
+	    || memchr(client->request, '\n', client->len)
+	    || client->len == sizeof client->request - 1)
+		client_answer(client);
+
+	/* never let the main loop remove anything */
+	return 1;
+}
+
+static int
+request_accept(int fd, void *data)
+{
+	struct wldbg_request_socket *rs = data;
+	struct wldbg *wldbg = rs->wldbg;
+	struct request_client *client;
+	int cfd;
+
+	cfd = wl_os_accept_cloexec(fd, NULL, NULL);
+	if (cfd < 0) {
+		perror("request: accept");
+		return 1;
+	}
+
+	client = calloc(1, sizeof *client);
+	if (!client) {
+		close(cfd);
+		return 1;
+	}
+
+	client->rs = rs;
+	client->fd = cfd;
+	wl_list_insert(&rs->clients, &client->link);
+
+	if (fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) | O_NONBLOCK) < 0)
+		goto err;
+
+	client->cb = wldbg_monitor_fd(wldbg, cfd, client_dispatch, client);
+	if (!client->cb)
+		goto err;
+
+	if (rs->wait) {
+		client->timer = wldbg_add_timer(wldbg, rs->wait, 0,
+						client_timeout, client);
+		if (!client->timer)
+			goto err;
+	}
+
+	return 1;
+
+err:
+	perror("request: setting up client");
+	if (client->cb)
+		wldbg_remove_callback(wldbg, client->cb);
+	close(cfd);
+	wl_list_remove(&client->link);
+	free(client);
+	return 1;
+}
+
+struct wldbg_request_socket *
+wldbg_request_socket_create(struct wldbg *wldbg, const char *path,
+			    uint64_t wait, wldbg_answer_func answer)
+{
+	struct wldbg_request_socket *rs;
+	struct sockaddr_un addr;
+
+	if (strlen(path) >= sizeof addr.sun_path) {
+		fprintf(stderr, "Path to socket '%s' is too long\n", path);
+		return NULL;
+	}
+
+	rs = calloc(1, sizeof *rs);
+	if (!rs)
+		return NULL;
+
+	rs->wldbg = wldbg;
+	rs->wait = wait;
+	rs->answer = answer;
+	wl_list_init(&rs->clients);
+
+	rs->path = strdup(path);
+	if (!rs->path)
+		goto err;
+
+	rs->fd = wl_os_socket_cloexec(PF_LOCAL, SOCK_STREAM, 0);
+	if (rs->fd < 0)
+		goto err;
+
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_LOCAL;
+	strcpy(addr.sun_path, path);
+
+	/* remove the socket from previous run */
+	unlink(path);
+
+	if (bind(rs->fd, (struct sockaddr *) &addr, sizeof addr) < 0
+	    || listen(rs->fd, 4) < 0) {
+		fprintf(stderr, "Failed creating socket '%s': %s\n",
+			path, strerror(errno));
+		close(rs->fd);
+		goto err;
+	}
+
+	rs->cb = wldbg_monitor_fd(wldbg, rs->fd, request_accept, rs);
+	if (!rs->cb) {
+		close(rs->fd);
+		unlink(path);
+		goto err;
+	}
+
+	return rs;
+
+err:
+	free(rs->path);
+	free(rs);
+	return NULL;
+}
+
+void
+wldbg_request_socket_destroy(struct wldbg_request_socket *rs)
+{
+	struct request_client *client, *tmp;
+
+	wl_list_for_each_safe(client, tmp, &rs->clients, link)
+		client_destroy(client);
+
+	if (rs->wldbg->flags.running)
+		wldbg_remove_callback(rs->wldbg, rs->cb);
+
+	close(rs->fd);
+	unlink(rs->path);
+
+	free(rs->path);
+	free(rs);
+}
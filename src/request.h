@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_REQUEST_H_
+#define _WLDBG_REQUEST_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+struct wldbg;
+struct wldbg_request_socket;
+
+/* write the answer to the request into out */
+typedef void (*wldbg_answer_func)(struct wldbg *wldbg,
+				  char *request, FILE *out);
+
+/* Listen on the unix socket at path and answer one request (a line)
+ * on every connection to it. The clients are served by the main loop
+ * without blocking it, so a slow client does not stop the connections
+ * wldbg forwards.
+ *
+ * With wait > 0 the request is optional, after wait nanoseconds
+ * the client gets the answer to what it has sent so far */
+struct wldbg_request_socket *
+wldbg_request_socket_create(struct wldbg *wldbg, const char *path,
+			    uint64_t wait, wldbg_answer_func answer);
+
+void
+wldbg_request_socket_destroy(struct wldbg_request_socket *rs);
+
+#endif /* _WLDBG_REQUEST_H_ */
@@ -45,7 +45,7 @@
 
 static struct wl_list shared_interfaces;
 
-static void
+void
 resolved_objects_put(struct resolved_objects *ro,
 		     uint32_t id, const struct wl_interface *intf)
 {
@@ -89,8 +89,8 @@ add_shared_interface(struct interface *intf)
 	add_interface(&shared_interfaces, intf);
 }
 
-static const struct wl_interface *
-get_interface(struct resolved_objects *ro, const char *name)
+const struct wl_interface *
+resolved_objects_get_interface(struct resolved_objects *ro, const char *name)
 {
 	struct interface *i;
 
@@ -306,7 +306,7 @@ get_new_ids(struct resolved_objects *ro, uint32_t *data,
 		if (!new_intf && guess_type){
 			dbg("RESOLVE: Guessing unknown type is '%s'\n",
 				guess_type);
-			new_intf = get_interface(ro, guess_type);
+			new_intf = resolved_objects_get_interface(ro, guess_type);
 		}
 
 		if (!new_intf)
@@ -434,7 +434,8 @@ create_resolved_objects(void)
 
 	/* id 0 is always empty and 1 is always display */
 	resolved_objects_put(ro, 0, NULL);
-	resolved_objects_put(ro, 1, get_interface(ro, "wl_display"));
+	resolved_objects_put(ro, 1,
+			     resolved_objects_get_interface(ro, "wl_display"));
 
 	return ro;
 }
@@ -71,6 +71,21 @@ wldbg_message_get_object(struct wldbg_message *msg, uint32_t id)
 	return resolved_objects_get(ro, id);
 }
 
+int
+wldbg_is_interface(const struct wl_interface **known,
+		   const struct wl_interface *intf, const char *name)
+{
+	if (*known)
+		return *known == intf;
+
+	if (strcmp(intf->name, name) == 0) {
+		*known = intf;
+		return 1;
+	}
+
+	return 0;
+}
+
 const struct wl_interface *
 wldbg_message_get_interface(struct wldbg_message *msg, const char *name)
 {
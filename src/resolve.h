@@ -41,9 +41,15 @@ wldbg_add_resolve_pass(struct wldbg *wldbg);
 const struct wl_interface *
 resolved_objects_get(struct resolved_objects *ro, uint32_t id);
 
+/* the interface called name that the objects can have, not
+ * necessarily one that some object has already */
 const struct wl_interface *
 resolved_objects_get_interface(struct resolved_objects *ro, const char *name);
 
+void
+resolved_objects_put(struct resolved_objects *ro,
+		     uint32_t id, const struct wl_interface *intf);
+
 void
 resolved_objects_iterate(struct resolved_objects *ro,
 			 void (*func)(uint32_t id,
@@ -0,0 +1,515 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Count messages and bytes for every connection, interface and opcode
+ * and keep histograms of inter-arrival times. The table is printed
+ * on exit and every time wldbg gets SIGUSR1. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* for WL_SERVER_ID_START */
+#include "wayland/wayland-private.h"
+
+#include "wldbg.h"
+#include "wldbg-pass.h"
+#include "wldbg-private.h"
+#include "wldbg-histogram.h"
+#include "wldbg-parse-message.h"
+#include "pass-connections.h"
+#include "passes.h"
+#include "resolve.h"
+
+/* Interfaces get a small integer slot when we see them for the first
+ * time. All counters of a connection are then in one flat array and
+ * the counter for a message is at the interface's base + opcode
+ * (events are placed after requests). */
+struct stats_interface {
+	const struct wl_interface *interface;
+	unsigned int base;
+};
+
+struct stats_counter {
+	uint64_t count;
+	uint64_t bytes;
+	uint64_t last;
+	/* allocated with the second message */
+	struct wldbg_histogram *interarrival;
+};
+
+/* cache object id -> slot, so that we do not need to search
+ * for the interface on every message */
+struct stats_object {
+	const struct wl_interface *interface;
+	unsigned int slot;
+};
+
+struct stats_direction {
+	uint64_t count;
+	uint64_t bytes;
+	uint64_t last;
+	/* messages on unknown objects */
+	uint64_t unknown;
+	struct wldbg_histogram interarrival;
+};
+
+struct stats_connection {
+	struct wldbg_pass_connection base;
+
+	/* indexed by wldbg_message::from */
+	struct stats_direction dir[2];
+
+	/* array of struct stats_counter */
+	struct wl_array counters;
+	/* arrays of struct stats_object for objects
+	 * allocated by client and by server */
+	struct wl_array client_objects;
+	struct wl_array server_objects;
+};
+
+struct stats {
+	struct wldbg *wldbg;
+
+	/* array of struct stats_interface */
+	struct wl_array interfaces;
+	unsigned int counters_num;
+
+	/* struct stats_connection */
+	struct wldbg_pass_connections connections;
+};
+
+static int
+array_ensure_size(struct wl_array *array, size_t size)
+{
+	size_t old = array->size;
+
+	if (old >= size)
+		return 0;
+
+	if (!wl_array_add(array, size - old))
+		return -1;
+
+	memset((char *) array->data + old, 0, size - old);
+	return 0;
+}
+
+static void
+init_connection(struct wldbg_pass_connection *pc)
+{
+	struct stats_connection *sc = (struct stats_connection *) pc;
+
+	wldbg_histogram_init(&sc->dir[SERVER].interarrival);
+	wldbg_histogram_init(&sc->dir[CLIENT].interarrival);
+	wl_array_init(&sc->counters);
+	wl_array_init(&sc->client_objects);
+	wl_array_init(&sc->server_objects);
+}
+
+static void
+release_connection(struct wldbg_pass_connection *pc)
+{
+	struct stats_connection *sc = (struct stats_connection *) pc;
+	struct stats_counter *counter;
+
+	wl_array_for_each(counter, &sc->counters)
+		wldbg_histogram_destroy(counter->interarrival);
+
+	wl_array_release(&sc->counters);
+	wl_array_release(&sc->client_objects);
+	wl_array_release(&sc->server_objects);
+}
+
+static int
+get_interface_slot(struct stats *stats, const struct wl_interface *intf)
+{
+	struct stats_interface *si;
+	int slot = 0;
+
+	wl_array_for_each(si, &stats->interfaces) {
+		if (si->interface == intf)
+			return slot;
+		++slot;
+	}
+
+	si = wl_array_add(&stats->interfaces, sizeof *si);
+	if (!si)
+		return -1;
+
+	si->interface = intf;
+	si->base = stats->counters_num;
+	stats->counters_num += intf->method_count + intf->event_count;
+
+	return slot;
+}
+
+static struct stats_object *
+get_object(struct stats_connection *sc, uint32_t id)
+{
+	struct wl_array *objects;
+
+	if (id >= WL_SERVER_ID_START) {
+		objects = &sc->server_objects;
+		id -= WL_SERVER_ID_START;
+	} else {
+		objects = &sc->client_objects;
+	}
+
+	if (array_ensure_size(objects, (id + 1) * sizeof(struct stats_object)) < 0)
+		return NULL;
+
+	return (struct stats_object *) objects->data + id;
+}
+
+static struct stats_counter *
+get_counter(struct stats *stats, struct stats_connection *sc,
+	    struct wldbg_message *message, uint32_t id, uint32_t opcode)
+{
+	const struct wl_interface *intf;
+	struct stats_object *obj;
+	struct stats_interface *si;
+	unsigned int idx;
+	int slot;
+
+	intf = wldbg_message_get_object(message, id);
+	if (!intf || intf == &unknown_interface || intf == &free_entry)
+		return NULL;
+
+	if (message->from == SERVER) {
+		if (opcode >= (uint32_t) intf->event_count)
+			return NULL;
+	} else {
+		if (opcode >= (uint32_t) intf->method_count)
+			return NULL;
+	}
+
+	obj = get_object(sc, id);
+	if (!obj)
+		return NULL;
+
+	if (obj->interface != intf) {
+		slot = get_interface_slot(stats, intf);
+		if (slot < 0)
+			return NULL;
+
+		obj->interface = intf;
+		obj->slot = slot;
+	}
+
+	si = (struct stats_interface *) stats->interfaces.data + obj->slot;
+	idx = si->base + opcode;
+	if (message->from == SERVER)
+		idx += intf->method_count;
+
+	if (array_ensure_size(&sc->counters, stats->counters_num
+			      * sizeof(struct stats_counter)) < 0)
+		return NULL;
+
+	return (struct stats_counter *) sc->counters.data + idx;
+}
+
+static void
+account_message(struct wldbg_message *message, void *user_data)
+{
+	struct stats *stats = user_data;
+	struct stats_connection *sc;
+	struct stats_direction *dir;
+	struct stats_counter *counter;
+	uint32_t *data = message->data;
+	uint64_t now = message->time;
+
+	sc = wldbg_pass_connection_get(&stats->connections,
+				       message->connection);
+	if (!sc)
+		return;
+
+	dir = &sc->dir[message->from];
+
+	++dir->count;
+	dir->bytes += message->size;
+	if (dir->last)
+		wldbg_histogram_add(&dir->interarrival, now - dir->last);
+	dir->last = now;
+
+	counter = get_counter(stats, sc, message, data[0], data[1] & 0xffff);
+	if (!counter) {
+		++dir->unknown;
+		return;
+	}
+
+	++counter->count;
+	counter->bytes += message->size;
+	if (counter->last) {
+		if (!counter->interarrival)
+			counter->interarrival = wldbg_histogram_create();
+		if (counter->interarrival)
+			wldbg_histogram_add(counter->interarrival,
+					    now - counter->last);
+	}
+	counter->last = now;
+}
+
+static int
+stats_message(void *user_data, struct wldbg_message *message)
+{
+	wldbg_for_each_message(message, account_message, user_data);
+	return PASS_NEXT;
+}
+
+struct stats_row {
+	const char *interface;
+	const char *message;
+	int from;
+	struct stats_counter *counter;
+};
+
+static int
+compare_rows(const void *a, const void *b)
+{
+	const struct stats_row *ra = a, *rb = b;
+
+	if (ra->counter->count > rb->counter->count)
+		return -1;
+	if (ra->counter->count < rb->counter->count)
+		return 1;
+
+	return 0;
+}
+
+static void
+print_interarrival(struct wldbg_histogram *h)
+{
+	char p50[16], p99[16], max[16];
+
+	if (!h || h->count == 0) {
+		printf("%10s %10s %10s\n", "-", "-", "-");
+		return;
+	}
+
+	printf("%10s %10s %10s\n",
+	       wldbg_format_nsec(wldbg_histogram_percentile(h, 50),
+				 p50, sizeof p50),
+	       wldbg_format_nsec(wldbg_histogram_percentile(h, 99),
+				 p99, sizeof p99),
+	       wldbg_format_nsec(h->max, max, sizeof max));
+}
+
+static void
+print_connection(struct stats *stats, struct stats_connection *sc)
+{
+	struct stats_interface *si;
+	struct stats_counter *counters = sc->counters.data;
+	struct stats_row *rows, *row;
+	unsigned int nrows = 0, i, n;
+	int j;
+
+	wldbg_pass_connection_print(&sc->base);
+
+	printf("  requests: %lu messages, %lu bytes, inter-arrival ",
+	       (unsigned long) sc->dir[CLIENT].count,
+	       (unsigned long) sc->dir[CLIENT].bytes);
+	wldbg_histogram_print(&sc->dir[CLIENT].interarrival);
+	printf("\n  events:   %lu messages, %lu bytes, inter-arrival ",
+	       (unsigned long) sc->dir[SERVER].count,
+	       (unsigned long) sc->dir[SERVER].bytes);
+	wldbg_histogram_print(&sc->dir[SERVER].interarrival);
+	putchar('\n');
+
+	if (sc->dir[CLIENT].unknown || sc->dir[SERVER].unknown)
+		printf("  on unknown objects: %lu requests, %lu events\n",
+		       (unsigned long) sc->dir[CLIENT].unknown,
+		       (unsigned long) sc->dir[SERVER].unknown);
+
+	n = sc->counters.size / sizeof(struct stats_counter);
+	if (n == 0)
+		return;
+
+	rows = calloc(n, sizeof *rows);
+	if (!rows) {
+		fprintf(stderr, "Out of memory\n");
+		return;
+	}
+
+	wl_array_for_each(si, &stats->interfaces) {
+		for (j = 0; j < si->interface->method_count; ++j) {
+			i = si->base + j;
+			if (i >= n || counters[i].count == 0)
+				continue;
+
+			row = &rows[nrows++];
+			row->interface = si->interface->name;
+			row->message = si->interface->methods[j].name;
+			row->from = CLIENT;
+			row->counter = &counters[i];
+		}
+
+		for (j = 0; j < si->interface->event_count; ++j) {
+			i = si->base + si->interface->method_count + j;
+			if (i >= n || counters[i].count == 0)
+				continue;
+
+			row = &rows[nrows++];
+			row->interface = si->interface->name;
+			row->message = si->interface->events[j].name;
+			row->from = SERVER;
+			row->counter = &counters[i];
+		}
+	}
+
+	qsort(rows, nrows, sizeof *rows, compare_rows);
+
+	printf("\n  %-40s %3s %10s %12s %10s %10s %10s\n",
+	       "message", "dir", "count", "bytes",
+	       "p50 inter", "p99 inter", "max inter");
+
+	for (i = 0; i < nrows; ++i) {
+		char name[256];
+
+		row = &rows[i];
+		snprintf(name, sizeof name, "%s.%s",
+			 row->interface, row->message);
+		printf("  %-40s %3s %10lu %12lu ", name,
+		       row->from == CLIENT ? "->" : "<-",
+		       (unsigned long) row->counter->count,
+		       (unsigned long) row->counter->bytes);
+		print_interarrival(row->counter->interarrival);
+	}
+
+	free(rows);
+}
+
+static void
+print_stats(struct stats *stats)
+{
+	struct stats_connection *sc;
+
+	printf("\n-- Statistics --\n");
+
+	if (wl_list_empty(&stats->connections.list)) {
+		printf("No messages\n");
+		return;
+	}
+
+	wl_list_for_each(sc, &stats->connections.list, base.link)
+		print_connection(stats, sc);
+
+	fflush(stdout);
+}
+
+static void
+stats_report(void *data)
+{
+	print_stats(data);
+}
+
+static void
+stats_help(void *user_data)
+{
+	(void) user_data;
+
+	printf("Count messages and bytes per connection, interface and opcode\n"
+	       "and keep histograms of inter-arrival times.\n"
+	       "The table is printed on exit and when wldbg gets SIGUSR1\n"
+	       "\n"
+	       "Usage: wldbg stats [help]\n");
+}
+
+static int
+stats_init(struct wldbg *wldbg, struct wldbg_pass *pass,
+	   int argc, const char *argv[])
+{
+	struct stats *stats;
+	int i;
+
+	for (i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "help") == 0) {
+			stats_help(NULL);
+			wldbg_exit(wldbg);
+			return 0;
+		} else {
+			fprintf(stderr, "stats: unknown option '%s'\n",
+				argv[i]);
+			return -1;
+		}
+	}
+
+	stats = calloc(1, sizeof *stats);
+	if (!stats)
+		return -1;
+
+	stats->wldbg = wldbg;
+	wl_array_init(&stats->interfaces);
+	if (wldbg_pass_connections_init(&stats->connections, wldbg,
+					sizeof(struct stats_connection),
+					init_connection,
+					release_connection) < 0
+	    || wldbg_add_report_callback(wldbg, stats_report, stats) < 0) {
+		wldbg_pass_connections_release(&stats->connections);
+		free(stats);
+		return -1;
+	}
+
+	pass->user_data = stats;
+
+	return 0;
+}
+
+static void
+stats_destroy(void *user_data)
+{
+	struct stats *stats = user_data;
+
+	if (!stats)
+		return;
+
+	print_stats(stats);
+
+	wldbg_pass_connections_release(&stats->connections);
+	wl_array_release(&stats->interfaces);
+	free(stats);
+}
+
+struct pass *
+create_stats_pass(void)
+{
+	struct pass *pass;
+
+	pass = alloc_pass("stats");
+	if (!pass)
+		return NULL;
+
+	pass->wldbg_pass.init = stats_init;
+	pass->wldbg_pass.destroy = stats_destroy;
+	pass->wldbg_pass.server_pass = stats_message;
+	pass->wldbg_pass.client_pass = stats_message;
+	pass->wldbg_pass.help = stats_help;
+	pass->wldbg_pass.user_data = NULL;
+	pass->wldbg_pass.description
+		= "Per interface and opcode statistics with histograms";
+	pass->wldbg_pass.flags = 0;
+
+	return pass;
+}
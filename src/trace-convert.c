@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Convert capture written by 'wldbg trace capture' to Chrome
+ * trace-event JSON. The capture is streamed line by line, so the
+ * memory does not depend on the size of the capture */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wldbg.h"
+#include "trace.h"
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: wldbg-trace-convert [CAPTURE [OUTPUT]]\n"
+		"\n"
+		"Convert capture from 'wldbg trace capture' to Chrome\n"
+		"trace-event JSON. Reads stdin and writes stdout by default\n");
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *in = stdin, *out = stdout;
+	struct trace_writer *tw;
+	struct trace_message msg;
+	const char *program;
+	uint32_t connection;
+	char *line = NULL;
+	size_t size = 0;
+	unsigned long lineno = 0;
+	int pid, ret = EXIT_SUCCESS;
+
+	if (argc > 3 || (argc > 1 && (strcmp(argv[1], "-h") == 0
+				      || strcmp(argv[1], "--help") == 0))) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 1 && strcmp(argv[1], "-") != 0) {
+		in = fopen(argv[1], "r");
+		if (!in) {
+			perror(argv[1]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (argc > 2 && strcmp(argv[2], "-") != 0) {
+		out = fopen(argv[2], "w");
+		if (!out) {
+			perror(argv[2]);
+			fclose(in);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (getline(&line, &size, in) < 0
+	    || strcmp(line, TRACE_CAPTURE_HEADER) != 0) {
+		fprintf(stderr, "Input is not a wldbg capture\n");
+		ret = EXIT_FAILURE;
+		goto out;
+	}
+
+	tw = trace_writer_create(out);
+	if (!tw) {
+		ret = EXIT_FAILURE;
+		goto out;
+	}
+
+	lineno = 1;
+	while (getline(&line, &size, in) >= 0) {
+		++lineno;
+
+		switch (trace_capture_parse(line, &msg, &connection,
+					    &pid, &program)) {
+		case 'c':
+			trace_writer_connection(tw, connection, pid, program);
+			break;
+		case 'm':
+			trace_writer_message(tw, &msg);
+			break;
+		case 0:
+			break;
+		default:
+			fprintf(stderr, "Skipping malformed line %lu\n",
+				lineno);
+		}
+	}
+
+	trace_writer_destroy(tw);
+
+out:
+	free(line);
+	if (in != stdin)
+		fclose(in);
+	if (out != stdout)
+		fclose(out);
+
+	return ret;
+}
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Write the protocol timeline as Chrome trace-event JSON, which can be
+ * opened in Perfetto or chrome://tracing, or as a capture that can be
+ * converted later with wldbg-trace-convert */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wayland/wayland-util.h"
+
+#include "wldbg.h"
+#include "wldbg-pass.h"
+#include "wldbg-private.h"
+#include "wldbg-ids-map.h"
+#include "wldbg-parse-message.h"
+#include "passes.h"
+#include "trace.h"
+
+struct trace {
+	FILE *out;
+	/* NULL when writing capture */
+	struct trace_writer *writer;
+	/* connections that we have already described */
+	struct wldbg_ids_map connections;
+};
+
+static void
+get_args(struct wldbg_resolved_message *rm, struct trace_message *tm)
+{
+	struct wldbg_resolved_arg *arg;
+	int first = 1;
+
+	while ((arg = wldbg_resolved_message_next_argument(rm))) {
+		/* file descriptors are not in the data */
+		if (arg->type == 'h')
+			break;
+
+		if (!arg->data)
+			continue;
+
+		if (first && (arg->type == 'u' || arg->type == 'i'
+			      || arg->type == 'n' || arg->type == 'o')) {
+			tm->first_arg = *arg->data;
+			first = 0;
+		}
+
+		if (arg->type == 'u')
+			tm->last_arg = *arg->data;
+	}
+}
+
+static void
+trace_one(struct wldbg_message *message, void *user_data)
+{
+	struct trace *trace = user_data;
+	struct wldbg_connection *conn = message->connection;
+	struct wldbg_resolved_message rm;
+	struct trace_message tm;
+
+	if (!wldbg_ids_map_get(&trace->connections, conn->id)) {
+		if (trace->writer)
+			trace_writer_connection(trace->writer, conn->id,
+						conn->client.pid,
+						conn->client.program);
+		else
+			trace_capture_connection(trace->out, conn->id,
+						 conn->client.pid,
+						 conn->client.program);
+
+		wldbg_ids_map_insert(&trace->connections, conn->id,
+				     (void *) 1);
+	}
+
+	if (!wldbg_resolve_message(message, &rm))
+		return;
+
+	memset(&tm, 0, sizeof tm);
+	tm.time = message->time;
+	tm.connection = conn->id;
+	tm.from = message->from;
+	tm.interface = rm.wl_interface->name;
+	tm.id = rm.base.id;
+	tm.name = rm.wl_message->name;
+	get_args(&rm, &tm);
+
+	if (trace->writer)
+		trace_writer_message(trace->writer, &tm);
+	else
+		trace_capture_message(trace->out, &tm);
+}
+
+static int
+trace_message(void *user_data, struct wldbg_message *message)
+{
+	wldbg_for_each_message(message, trace_one, user_data);
+	return PASS_NEXT;
+}
+
+static void
+trace_help(void *user_data)
+{
+	(void) user_data;
+
+	printf("Write the protocol timeline as Chrome trace-event JSON\n"
+	       "that can be opened in Perfetto (ui.perfetto.dev)\n"
+	       "or chrome://tracing\n"
+	       "\n"
+	       "Usage: wldbg trace [help] [capture] [file=PATH]\n"
+	       "\n"
+	       "  file=PATH  where to write the trace (default wldbg-trace.json,\n"
+	       "             or wldbg-trace.capture with capture)\n"
+	       "  capture    write compact capture instead, that can be\n"
+	       "             converted by wldbg-trace-convert later\n");
+}
+
+static int
+trace_init(struct wldbg *wldbg, struct wldbg_pass *pass,
+	   int argc, const char *argv[])
+{
+	struct trace *trace;
+	const char *path = NULL;
+	int i, capture = 0;
+
+	for (i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "help") == 0) {
+			trace_help(NULL);
+			wldbg_exit(wldbg);
+			return 0;
+		} else if (strcmp(argv[i], "capture") == 0) {
+			capture = 1;
+		} else if (strncmp(argv[i], "file=", 5) == 0) {
+			path = argv[i] + 5;
+		} else {
+			fprintf(stderr, "trace: unknown option '%s'\n",
+				argv[i]);
+			return -1;
+		}
+	}
+
+	if (!path)
+		path = capture ? "wldbg-trace.capture" : "wldbg-trace.json";
+
+	trace = calloc(1, sizeof *trace);
+	if (!trace)
+		return -1;
+
+	trace->out = fopen(path, "w");
+	if (!trace->out) {
+		perror("trace: opening output");
+		free(trace);
+		return -1;
+	}
+
+	if (capture) {
+		fputs(TRACE_CAPTURE_HEADER, trace->out);
+	} else {
+		trace->writer = trace_writer_create(trace->out);
+		if (!trace->writer) {
+			fclose(trace->out);
+			free(trace);
+			return -1;
+		}
+	}
+
+	wldbg_ids_map_init(&trace->connections);
+	pass->user_data = trace;
+
+	return 0;
+}
+
+static void
+trace_destroy(void *user_data)
+{
+	struct trace *trace = user_data;
+
+	if (!trace)
+		return;
+
+	if (trace->writer)
+		trace_writer_destroy(trace->writer);
+
+	fclose(trace->out);
+	wldbg_ids_map_release(&trace->connections);
+	free(trace);
+}
+
+struct pass *
+create_trace_pass(void)
+{
+	struct pass *pass;
+
+	pass = alloc_pass("trace");
+	if (!pass)
+		return NULL;
+
+	pass->wldbg_pass.init = trace_init;
+	pass->wldbg_pass.destroy = trace_destroy;
+	pass->wldbg_pass.server_pass = trace_message;
+	pass->wldbg_pass.client_pass = trace_message;
+	pass->wldbg_pass.help = trace_help;
+	pass->wldbg_pass.user_data = NULL;
+	pass->wldbg_pass.description
+		= "Write Chrome/Perfetto trace of the protocol";
+	pass->wldbg_pass.flags = 0;
+
+	return pass;
+}
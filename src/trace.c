@@ -0,0 +1,448 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "wldbg.h"
+#include "wldbg-ids-map.h"
+#include "wayland/wayland-util.h"
+#include "trace.h"
+
+/* tids of connections should not collide
+ * with real threads of the clients */
+#define TRACE_TID_BASE		0x40000000
+
+/* keep at most this much unacked configures per connection */
+#define TRACE_MAX_CONFIGURES	64
+
+enum trace_kind {
+	TRACE_SYNC,
+	TRACE_FRAME,
+	TRACE_CONFIGURE
+};
+
+static const char *trace_kind_names[] = {
+	"sync -> done",
+	"frame -> done",
+	"configure -> ack",
+};
+
+struct trace_pending {
+	uint64_t flow;
+	enum trace_kind kind;
+	/* for configures */
+	uint32_t object;
+	uint32_t serial;
+};
+
+struct trace_connection {
+	uint32_t id;
+	int pid;
+
+	/* struct trace_pending by callback id */
+	struct wldbg_ids_map callbacks;
+	/* array of struct trace_pending, the oldest first */
+	struct wl_array configures;
+
+	struct wl_list link;
+};
+
+struct trace_writer {
+	FILE *out;
+	int events;
+	uint64_t last_flow;
+
+	struct wldbg_ids_map connections;
+	struct wl_list connections_list;
+};
+
+struct trace_writer *
+trace_writer_create(FILE *out)
+{
+	struct trace_writer *tw = calloc(1, sizeof *tw);
+	if (!tw)
+		return NULL;
+
+	tw->out = out;
+	wldbg_ids_map_init(&tw->connections);
+	wl_list_init(&tw->connections_list);
+
+	/* JSON array format. The closing bracket is optional
+	 * there, so the trace is usable even when wldbg crashes */
+	fputs("[\n", out);
+
+	return tw;
+}
+
+static void
+destroy_connection(struct trace_connection *tc)
+{
+	unsigned int i;
+
+	for (i = 0; i < tc->callbacks.count; ++i)
+		free(wldbg_ids_map_get(&tc->callbacks, i));
+
+	wldbg_ids_map_release(&tc->callbacks);
+	wl_array_release(&tc->configures);
+	free(tc);
+}
+
+void
+trace_writer_destroy(struct trace_writer *tw)
+{
+	struct trace_connection *tc, *tmp;
+
+	fputs("\n]\n", tw->out);
+	fflush(tw->out);
+
+	wl_list_for_each_safe(tc, tmp, &tw->connections_list, link)
+		destroy_connection(tc);
+
+	wldbg_ids_map_release(&tw->connections);
+	free(tw);
+}
+
+static void
+begin_event(struct trace_writer *tw)
+{
+	if (tw->events++ > 0)
+		fputs(",\n", tw->out);
+}
+
+static void
+print_json_string(FILE *out, const char *str)
+{
+	fputc('"', out);
+	for (; str && *str; ++str) {
+		if (*str == '"' || *str == '\\')
+			fprintf(out, "\\%c", *str);
+		else if ((unsigned char) *str < 0x20)
+			fprintf(out, "\\u%04x", *str);
+		else
+			fputc(*str, out);
+	}
+	fputc('"', out);
+}
+
+static struct trace_connection *
+get_connection(struct trace_writer *tw, uint32_t id)
+{
+	struct trace_connection *tc;
+
+	tc = wldbg_ids_map_get(&tw->connections, id);
+	if (tc)
+		return tc;
+
+	tc = calloc(1, sizeof *tc);
+	if (!tc)
+		return NULL;
+
+	tc->id = id;
+	wldbg_ids_map_init(&tc->callbacks);
+	wl_array_init(&tc->configures);
+
+	wldbg_ids_map_insert(&tw->connections, id, tc);
+	wl_list_insert(tw->connections_list.prev, &tc->link);
+
+	return tc;
+}
+
+void
+trace_writer_connection(struct trace_writer *tw, uint32_t connection,
+			int pid, const char *program)
+{
+	struct trace_connection *tc = get_connection(tw, connection);
+	if (!tc)
+		return;
+
+	tc->pid = pid;
+
+	begin_event(tw);
+	fprintf(tw->out, "{\"name\":\"process_name\",\"ph\":\"M\","
+		"\"pid\":%d,\"args\":{\"name\":", pid);
+	print_json_string(tw->out, program ? program : "unknown");
+	fputs("}}", tw->out);
+
+	begin_event(tw);
+	fprintf(tw->out, "{\"name\":\"thread_name\",\"ph\":\"M\","
+		"\"pid\":%d,\"tid\":%u,\"args\":{\"name\":"
+		"\"wayland connection %u\"}}",
+		pid, TRACE_TID_BASE + connection, connection);
+}
+
+static void
+print_event(struct trace_writer *tw, struct trace_connection *tc,
+	    const char *name, const char *cat, const char *ph,
+	    uint64_t time, uint64_t flow)
+{
+	begin_event(tw);
+	fprintf(tw->out, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%s\","
+		"\"ts\":%lu.%03u,\"pid\":%d,\"tid\":%u", name, cat, ph,
+		(unsigned long) (time / 1000), (unsigned) (time % 1000),
+		tc->pid, TRACE_TID_BASE + tc->id);
+
+	if (flow)
+		fprintf(tw->out, ",\"id\":%lu", (unsigned long) flow);
+	/* bind the flow end to the slice of the answer */
+	if (ph[0] == 'f')
+		fputs(",\"bp\":\"e\"", tw->out);
+	else if (ph[0] == 'X')
+		fputs(",\"dur\":0", tw->out);
+
+	fputc('}', tw->out);
+}
+
+static void
+start_round_trip(struct trace_writer *tw, struct trace_connection *tc,
+		 struct trace_pending *p, uint64_t time)
+{
+	p->flow = ++tw->last_flow;
+
+	print_event(tw, tc, trace_kind_names[p->kind], "roundtrip", "b",
+		    time, p->flow);
+	print_event(tw, tc, trace_kind_names[p->kind], "roundtrip", "s",
+		    time, p->flow);
+}
+
+static void
+finish_round_trip(struct trace_writer *tw, struct trace_connection *tc,
+		  struct trace_pending *p, uint64_t time)
+{
+	print_event(tw, tc, trace_kind_names[p->kind], "roundtrip", "e",
+		    time, p->flow);
+	print_event(tw, tc, trace_kind_names[p->kind], "roundtrip", "f",
+		    time, p->flow);
+}
+
+static void
+start_callback(struct trace_writer *tw, struct trace_connection *tc,
+	       uint32_t id, enum trace_kind kind, uint64_t time)
+{
+	struct trace_pending *p;
+
+	p = wldbg_ids_map_get(&tc->callbacks, id);
+	if (!p) {
+		p = calloc(1, sizeof *p);
+		if (!p)
+			return;
+
+		wldbg_ids_map_insert(&tc->callbacks, id, p);
+	}
+
+	p->kind = kind;
+	start_round_trip(tw, tc, p, time);
+}
+
+static void
+finish_callback(struct trace_writer *tw, struct trace_connection *tc,
+		uint32_t id, uint64_t time)
+{
+	struct trace_pending *p;
+
+	p = wldbg_ids_map_get(&tc->callbacks, id);
+	if (!p)
+		return;
+
+	finish_round_trip(tw, tc, p, time);
+
+	wldbg_ids_map_insert(&tc->callbacks, id, NULL);
+	free(p);
+}
+
+static void
+start_configure(struct trace_writer *tw, struct trace_connection *tc,
+		uint32_t object, uint32_t serial, uint64_t time)
+{
+	struct trace_pending *p;
+
+	/* drop the oldest configure if the client does not ack */
+	if (tc->configures.size >= TRACE_MAX_CONFIGURES * sizeof *p) {
+		memmove(tc->configures.data,
+			(char *) tc->configures.data + sizeof *p,
+			tc->configures.size - sizeof *p);
+		tc->configures.size -= sizeof *p;
+	}
+
+	p = wl_array_add(&tc->configures, sizeof *p);
+	if (!p)
+		return;
+
+	p->kind = TRACE_CONFIGURE;
+	p->object = object;
+	p->serial = serial;
+	start_round_trip(tw, tc, p, time);
+}
+
+static void
+finish_configure(struct trace_writer *tw, struct trace_connection *tc,
+		 uint32_t object, uint32_t serial, uint64_t time)
+{
+	struct trace_pending *p, *end;
+	size_t n = 0;
+
+	end = (struct trace_pending *)
+		((char *) tc->configures.data + tc->configures.size);
+
+	/* ack of the serial acks the configures sent before too,
+	 * but only the acked one gets the slice */
+	for (p = tc->configures.data; p < end; ++p) {
+		if (p->object != object) {
+			((struct trace_pending *) tc->configures.data)[n++] = *p;
+			continue;
+		}
+
+		if (p->serial == serial)
+			finish_round_trip(tw, tc, p, time);
+		else if (serial - p->serial >= 0x80000000u)
+			/* newer than the acked one */
+			((struct trace_pending *) tc->configures.data)[n++] = *p;
+	}
+
+	tc->configures.size = n * sizeof *p;
+}
+
+void
+trace_writer_message(struct trace_writer *tw,
+		     const struct trace_message *msg)
+{
+	struct trace_connection *tc;
+	char name[128];
+
+	tc = get_connection(tw, msg->connection);
+	if (!tc)
+		return;
+
+	snprintf(name, sizeof name, "%s@%u.%s",
+		 msg->interface, msg->id, msg->name);
+	print_event(tw, tc, name, msg->from == CLIENT ? "request" : "event",
+		    "X", msg->time, 0);
+
+	if (msg->from == CLIENT) {
+		if (strcmp(msg->interface, "wl_display") == 0
+		    && strcmp(msg->name, "sync") == 0)
+			start_callback(tw, tc, msg->first_arg,
+				       TRACE_SYNC, msg->time);
+		else if (strcmp(msg->interface, "wl_surface") == 0
+			 && strcmp(msg->name, "frame") == 0)
+			start_callback(tw, tc, msg->first_arg,
+				       TRACE_FRAME, msg->time);
+		else if (strcmp(msg->name, "ack_configure") == 0)
+			finish_configure(tw, tc, msg->id, msg->first_arg,
+					 msg->time);
+	} else {
+		if (strcmp(msg->interface, "wl_callback") == 0
+		    && strcmp(msg->name, "done") == 0)
+			finish_callback(tw, tc, msg->id, msg->time);
+		/* xdg_surface and its unstable versions */
+		else if (strstr(msg->interface, "xdg_surface")
+			 && strcmp(msg->name, "configure") == 0)
+			start_configure(tw, tc, msg->id, msg->last_arg,
+					msg->time);
+	}
+}
+
+/* do not break the format with the name of program */
+static void
+print_field(FILE *out, const char *str)
+{
+	if (!str || !*str)
+		str = "unknown";
+
+	for (; *str; ++str)
+		fputc(*str == '\t' || *str == '\n' ? ' ' : *str, out);
+}
+
+void
+trace_capture_connection(FILE *out, uint32_t connection,
+			 int pid, const char *program)
+{
+	fprintf(out, "c\t%u\t%d\t", connection, pid);
+	print_field(out, program);
+	fputc('\n', out);
+}
+
+void
+trace_capture_message(FILE *out, const struct trace_message *msg)
+{
+	fprintf(out, "m\t%lu\t%u\t%c\t%s\t%u\t%s\t%u\t%u\n",
+		(unsigned long) msg->time, msg->connection,
+		msg->from == CLIENT ? 'C' : 'S', msg->interface, msg->id,
+		msg->name, msg->first_arg, msg->last_arg);
+}
+
+static int
+split(char *line, char **fields, int max)
+{
+	int n = 0;
+
+	while (n < max) {
+		fields[n++] = line;
+		line = strchr(line, '\t');
+		if (!line)
+			break;
+
+		*line++ = '\0';
+	}
+
+	return n;
+}
+
+int
+trace_capture_parse(char *line, struct trace_message *msg,
+		    uint32_t *connection, int *pid, const char **program)
+{
+	char *fields[9];
+	size_t len = strlen(line);
+	int n;
+
+	if (len > 0 && line[len - 1] == '\n')
+		line[--len] = '\0';
+
+	if (len == 0 || line[0] == '#')
+		return 0;
+
+	n = split(line, fields, 9);
+
+	if (strcmp(fields[0], "c") == 0 && n == 4) {
+		*connection = strtoul(fields[1], NULL, 10);
+		*pid = strtol(fields[2], NULL, 10);
+		*program = fields[3];
+		return 'c';
+	} else if (strcmp(fields[0], "m") == 0 && n == 9) {
+		msg->time = strtoull(fields[1], NULL, 10);
+		msg->connection = strtoul(fields[2], NULL, 10);
+		msg->from = fields[3][0] == 'C' ? CLIENT : SERVER;
+		msg->interface = fields[4];
+		msg->id = strtoul(fields[5], NULL, 10);
+		msg->name = fields[6];
+		msg->first_arg = strtoul(fields[7], NULL, 10);
+		msg->last_arg = strtoul(fields[8], NULL, 10);
+		return 'm';
+	}
+
+	return -1;
+}
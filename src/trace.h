@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_TRACE_H_
+#define _WLDBG_TRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Writer of Chrome trace-event JSON (that Perfetto can import too).
+ * It is shared by the trace pass and by the wldbg-trace-convert tool,
+ * which converts captures written by the trace pass. The output
+ * is streamed, the writer keeps only unanswered requests.
+ *
+ * Every connection is a track, messages are zero-length slices
+ * (so that flow arrows can be attached to them) and round trips
+ * (sync -> done, frame -> done and configure -> ack_configure)
+ * are async slices connected with flow arrows. */
+
+struct trace_writer;
+
+/* what the writer needs to know about a message */
+struct trace_message {
+	uint64_t time;
+	uint32_t connection;
+	/* SERVER or CLIENT */
+	int from;
+	const char *interface;
+	uint32_t id;
+	const char *name;
+	/* the first and the last integer argument, that's enough
+	 * to pair sync, frame and configure with their answers */
+	uint32_t first_arg;
+	uint32_t last_arg;
+};
+
+struct trace_writer *
+trace_writer_create(FILE *out);
+
+/* finish the trace and free the writer. The output is not closed */
+void
+trace_writer_destroy(struct trace_writer *tw);
+
+void
+trace_writer_connection(struct trace_writer *tw, uint32_t connection,
+			int pid, const char *program);
+
+void
+trace_writer_message(struct trace_writer *tw,
+		     const struct trace_message *msg);
+
+/* The capture written by the trace pass, one record per line:
+ *
+ *   # wldbg capture 1
+ *   c CONNECTION PID PROGRAM
+ *   m TIME CONNECTION C|S INTERFACE ID MESSAGE FIRST_ARG LAST_ARG
+ *
+ * Fields are separated by tabs, TIME is in nanoseconds */
+#define TRACE_CAPTURE_HEADER "# wldbg capture 1\n"
+
+void
+trace_capture_connection(FILE *out, uint32_t connection,
+			 int pid, const char *program);
+
+void
+trace_capture_message(FILE *out, const struct trace_message *msg);
+
+/* parse one line of the capture. Returns 'c' or 'm' according to what
+ * was parsed, 0 for lines that should be skipped and -1 on error.
+ * The strings point into the line, which is modified */
+int
+trace_capture_parse(char *line, struct trace_message *msg,
+		    uint32_t *connection, int *pid, const char **program);
+
+#endif /* _WLDBG_TRACE_H_ */
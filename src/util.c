@@ -31,6 +31,7 @@
 #include <unistd.h>
 #include <assert.h>
 #include <stdarg.h>
+#include <sys/socket.h>
 
 #include <wldbg.h>
 
@@ -184,3 +185,25 @@ remove_newline(char *str)
 
 	return str;
 }
+
+int
+send_all(int fd, const char *data, size_t size)
+{
+	ssize_t len;
+
+	while (size > 0) {
+		len = send(fd, data, size, MSG_NOSIGNAL);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("send");
+			return -1;
+		}
+
+		data += len;
+		size -= len;
+	}
+
+	return 0;
+}
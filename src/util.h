@@ -64,4 +64,9 @@ strdupf(const char *fmt, ...);
 char *
 remove_newline(char *str);
 
+/* send the whole data to the blocking socket fd.
+ * Returns -1 on error */
+int
+send_all(int fd, const char *data, size_t size);
+
 #endif /* _WLDBG_UTIL_H_ */
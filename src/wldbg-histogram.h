@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_HISTOGRAM_H_
+#define _WLDBG_HISTOGRAM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Log-linear (HDR-like) histogram of nanosecond values. Every power
+ * of two is split into 2^WLDBG_HISTOGRAM_SUB_BITS linear sub-buckets,
+ * so the relative error of a recorded value is at most 1/16
+ * whatever the magnitude is. Recording is O(1) and does not allocate.
+ * Values bigger than 2^WLDBG_HISTOGRAM_MAX_EXP ns (~18 minutes)
+ * land in the last bucket, but min and max are kept exact. */
+#define WLDBG_HISTOGRAM_SUB_BITS	4
+#define WLDBG_HISTOGRAM_SUB_COUNT	(1 << WLDBG_HISTOGRAM_SUB_BITS)
+#define WLDBG_HISTOGRAM_MAX_EXP		40
+#define WLDBG_HISTOGRAM_BUCKETS						\
+	((WLDBG_HISTOGRAM_MAX_EXP - WLDBG_HISTOGRAM_SUB_BITS + 1)	\
+	 * WLDBG_HISTOGRAM_SUB_COUNT)
+
+struct wldbg_histogram {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+
+	uint32_t buckets[WLDBG_HISTOGRAM_BUCKETS];
+};
+
+void
+wldbg_histogram_init(struct wldbg_histogram *h);
+
+/* allocate and initialize new histogram */
+struct wldbg_histogram *
+wldbg_histogram_create(void);
+
+void
+wldbg_histogram_destroy(struct wldbg_histogram *h);
+
+void
+wldbg_histogram_add(struct wldbg_histogram *h, uint64_t value);
+
+/* add all values from 'from' into 'to' */
+void
+wldbg_histogram_merge(struct wldbg_histogram *to,
+		      const struct wldbg_histogram *from);
+
+/* get value at given percentile (0.0 - 100.0). The result is
+ * the highest value equivalent to the bucket that the percentile
+ * falls into, so it is never lower than the real value. */
+uint64_t
+wldbg_histogram_percentile(const struct wldbg_histogram *h,
+			   double percentile);
+
+uint64_t
+wldbg_histogram_mean(const struct wldbg_histogram *h);
+
+/* format nanoseconds into human readable form (like 1.25ms),
+ * returns buf */
+const char *
+wldbg_format_nsec(uint64_t ns, char *buf, size_t size);
+
+/* print "n=.. min=.. p50=.. p90=.. p99=.. max=.." on stdout,
+ * without newline */
+void
+wldbg_histogram_print(const struct wldbg_histogram *h);
+
+#endif /* _WLDBG_HISTOGRAM_H_ */
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_METRICS_H_
+#define _WLDBG_METRICS_H_
+
+#include <stdint.h>
+
+/* Counters of wldbg. They are kept for every connection
+ * and summed only when somebody asks for them */
+struct wldbg_counters {
+	/* indexed by SERVER and CLIENT */
+	uint64_t messages[2];
+	uint64_t bytes[2];
+
+	uint64_t recvmsg;
+	uint64_t sendmsg;
+};
+
+/* Binary snapshot of metrics as sent by the metrics socket when
+ * it gets "binary" request. All numbers are in host byte order.
+ * The header is followed by connections_num records of
+ * struct wldbg_metrics_connection and passes_num records
+ * of struct wldbg_metrics_pass */
+#define WLDBG_METRICS_MAGIC	0x4d444c57 /* "WLDM" */
+#define WLDBG_METRICS_VERSION	2
+
+#define WLDBG_METRICS_NAME_LEN	32
+
+struct wldbg_metrics_header {
+	uint32_t magic;
+	uint32_t version;
+	/* CLOCK_MONOTONIC in nanoseconds */
+	uint64_t time;
+	uint32_t connections_num;
+	uint32_t passes_num;
+	uint64_t epoll_wait;
+	/* all connections, including the closed ones */
+	struct wldbg_counters total;
+};
+
+enum wldbg_metrics_queue {
+	WLDBG_METRICS_CLIENT_IN,
+	WLDBG_METRICS_CLIENT_OUT,
+	WLDBG_METRICS_SERVER_IN,
+	WLDBG_METRICS_SERVER_OUT,
+	WLDBG_METRICS_QUEUES_NUM
+};
+
+struct wldbg_metrics_connection {
+	uint32_t id;
+	int32_t pid;
+	char program[WLDBG_METRICS_NAME_LEN];
+	struct wldbg_counters counters;
+	/* messages in the last whole second */
+	uint32_t rate;
+	/* bytes waiting in the sockets, indexed
+	 * by enum wldbg_metrics_queue */
+	uint32_t queue[WLDBG_METRICS_QUEUES_NUM];
+};
+
+struct wldbg_metrics_pass {
+	char name[WLDBG_METRICS_NAME_LEN];
+	uint64_t calls;
+	/* nanoseconds spent in the pass */
+	uint64_t time;
+	/* the connection the pass runs for,
+	 * 0 for the passes of all connections */
+	uint32_t connection;
+};
+
+#endif /* _WLDBG_METRICS_H_ */
@@ -54,6 +54,38 @@ struct wldbg_wl_buffer_info
     int32_t width, height, offset, stride;
     uint32_t format;
     unsigned int released : 1;
+    /* commited to a surface and not released yet */
+    unsigned int in_flight : 1;
+};
+
+struct wldbg_wl_shm_pool_info
+{
+    int32_t size;
+};
+
+/* accounting of shared memory per connection */
+struct wldbg_shm_accounting
+{
+    /* pools */
+    uint32_t pools;
+    uint64_t pools_created;
+    uint64_t bytes;
+    uint64_t bytes_max;
+
+    /* pools created per second, counted in
+     * whole seconds since the first pool */
+    uint64_t churn_second;
+    uint32_t churn_count;
+    uint32_t churn_last;
+    uint32_t churn_max;
+    uint64_t first_pool_time;
+
+    /* buffers */
+    uint32_t buffers;
+    uint32_t buffers_max;
+    uint64_t buffers_created;
+    uint32_t in_flight;
+    uint32_t in_flight_max;
 };
 
 struct wldbg_wl_surface_info {
@@ -68,6 +68,15 @@ struct wldbg_resolved_message {
 
 int wldbg_parse_message(struct wldbg_message *msg, struct wldbg_parsed_message *out);
 
+/* call func on every message in message. A pass gets more messages
+ * at once when wldbg passes whole buffers (see wldbg_separate_messages),
+ * 'one' has the data and size of the single message then.
+ * A message that is cut off is skipped */
+void
+wldbg_for_each_message(struct wldbg_message *message,
+		       void (*func)(struct wldbg_message *one, void *data),
+		       void *data);
+
 int wldbg_resolve_message(struct wldbg_message *msg,
 			  struct wldbg_resolved_message *out);
 
@@ -40,6 +40,9 @@
 #include "wayland/wayland-util.h"
 #include "wldbg-pass.h"
 #include "wldbg-ids-map.h"
+#include "wldbg-objects-info.h"
+#include "wldbg-metrics.h"
+#include "wldbg-histogram.h"
 
 #ifdef DEBUG
 
@@ -99,6 +102,16 @@ struct wldbg {
 	sigset_t handled_signals;
 	struct wl_list passes;
 	struct wl_list monitored_fds;
+	/* called on SIGUSR1 */
+	struct wl_list report_callbacks;
+	/* called when a child exits */
+	struct wl_list exit_callbacks;
+	/* called when a connection is closed */
+	struct wl_list close_callbacks;
+	struct wl_list timers;
+	/* which passes connections get by their program,
+	 * see pipeline.h */
+	struct wl_list pipeline_rules;
 
 	unsigned int resolving_objects : 1;
 	unsigned int gathering_info    : 1;
@@ -114,12 +127,24 @@ struct wldbg {
 		unsigned int exit              : 1;
         /* running in server mode */
 		unsigned int server_mode       : 1;
-        /* running in fuzz testing mode */
-        unsigned int fuzz_mode         : 1;
         /* some pass asked to skip sending the current message */
         unsigned int skip              : 1;
+        /* measure overhead of wldbg and passes */
+        unsigned int profiling         : 1;
+        /* do not exit when the last connection closes,
+         * some pass is going to spawn new clients */
+        unsigned int keep_alive        : 1;
+        /* showing messages published by another wldbg */
+        unsigned int attached          : 1;
 	} flags;
 
+	/* the program wldbg spawned and its arguments,
+	 * NULL in server mode */
+	struct {
+		char *path;
+		char **argv;
+	} client;
+
 	struct {
 		int fd;
 		struct sockaddr_un addr;
@@ -137,22 +162,48 @@ struct wldbg {
 	/* this will be list later */
 	struct wl_list connections;
 	int connections_num;
+	/* id of the last created connection */
+	unsigned int last_connection_id;
+
+	/* counters of connections that are closed already,
+	 * the live connections have their own */
+	struct wldbg_counters counters;
+	uint64_t epoll_wait;
+
+	/* metrics socket, NULL if not exporting metrics */
+	struct wldbg_metrics *metrics;
+	/* control socket, NULL if not controlled (see control.h) */
+	struct wldbg_control *control;
+
+	/* time from reading a message to sending it,
+	 * only when profiling */
+	struct wldbg_histogram *proxy_latency;
 };
 
 struct pass {
 	struct wldbg_pass wldbg_pass;
 	struct wl_list link;
 	char *name;
+
+	/* measured only when exporting metrics or profiling */
+	uint64_t calls;
+	uint64_t time;
+	/* time of single runs, only when profiling */
+	struct wldbg_histogram *histogram;
 };
 
 struct wldbg_connection {
 	struct wldbg *wldbg;
+	/* unique id of the connection, never reused */
+	unsigned int id;
 
 	struct {
 		int fd;
 		/* TODO get rid of connection??? */
 		struct wl_connection *connection;
 		pid_t pid;
+		/* the socket is full, data waits in the connection */
+		int blocked;
 	} server;
 
 	struct {
@@ -167,10 +218,31 @@ struct wldbg_connection {
 		char **argv;
 
 		pid_t pid;
+		/* the socket is full, data waits in the connection */
+		int blocked;
 	} client;
 
 	struct resolved_objects *resolved_objects;
 	struct wldbg_objects_info *objects_info;
+
+	/* not read now, see wldbg_connection_pause() */
+	int paused;
+
+	/* passes only for this connection, they run after
+	 * resolve and objinfo (see wldbg_run_passes) */
+	struct wl_list passes;
+	/* the connection runs only its passes, not the shared
+	 * ones. Set by a pipeline rule (see pipeline.h) */
+	int own_pipeline;
+
+	struct wldbg_counters counters;
+	/* messages per second */
+	struct {
+		uint64_t second;
+		uint32_t count;
+		uint32_t last;
+	} rate;
+
 	struct wl_list link;
 };
 
@@ -178,6 +250,36 @@ struct wldbg_fd_callback {
 	int fd;
 	void *data;
 	int (*dispatch)(int fd, void *data);
+	/* what wakes the loop up, see wldbg_set_fd_events() */
+	uint32_t events;
+	/* removed from epoll for now, see wldbg_pause_fd() */
+	int paused;
+	struct wl_list link;
+};
+
+struct wldbg_report_callback {
+	void (*func)(void *data);
+	void *data;
+	struct wl_list link;
+};
+
+struct wldbg_timer {
+	int fd;
+	struct wldbg_fd_callback *cb;
+	void (*func)(void *data);
+	void *data;
+	struct wl_list link;
+};
+
+struct wldbg_exit_callback {
+	void (*func)(pid_t pid, int status, void *data);
+	void *data;
+	struct wl_list link;
+};
+
+struct wldbg_close_callback {
+	void (*func)(struct wldbg_connection *conn, void *data);
+	void *data;
 	struct wl_list link;
 };
 
@@ -203,6 +305,71 @@ struct wldbg_objects_info {
 	struct wldbg_ids_map client_objects;
 	/* id's allocated by server */
 	struct wldbg_ids_map server_objects;
+
+	struct wldbg_shm_accounting shm;
 };
 
+/* defined in wldbg.c. Spawn another instance of
+ * the program from wldbg->client and add its connection */
+struct wldbg_connection *
+wldbg_spawn_client(struct wldbg *wldbg);
+
+/* defined in wldbg.c. Run the passes on the message, but do not send
+ * it anywhere. For messages that wldbg did not read, see attach.c */
+void
+wldbg_run_passes(struct wldbg_message *message);
+
+/* defined in wldbg.c. Call the report callbacks, like on SIGUSR1.
+ * Returns how many there were */
+int
+wldbg_report(struct wldbg *wldbg);
+
+/* defined in loop.c. Remove the report callbacks with this data,
+ * for passes that are destroyed while wldbg is running */
+void
+wldbg_remove_report_callbacks(struct wldbg *wldbg, void *data);
+
+/* defined in loop.c. The same for the exit callbacks */
+void
+wldbg_remove_exit_callbacks(struct wldbg *wldbg, void *data);
+
+/* defined in loop.c. The same for the close callbacks */
+void
+wldbg_remove_close_callbacks(struct wldbg *wldbg, void *data);
+
+/* defined in loop.c. Call the close callbacks for the connection */
+void
+wldbg_connection_closed(struct wldbg_connection *conn);
+
+/* defined in loop.c. Stop (pause = 1) or resume monitoring the fd,
+ * its callback stays registered meanwhile */
+int
+wldbg_pause_fd(struct wldbg *wldbg, int fd, int pause);
+
+/* defined in loop.c. Set the epoll events (EPOLLIN, EPOLLOUT) that call
+ * the callback of the fd. EPOLLHUP and EPOLLERR come always */
+int
+wldbg_set_fd_events(struct wldbg *wldbg, int fd, uint32_t events);
+
+/* defined in wldbg.c. Send the data that waits in wl_conn, one of the
+ * wl_connections of conn. When the socket is full, the rest is sent
+ * from the main loop once the socket can take it and wldbg stops reading
+ * what would go into it meanwhile. Returns how much was sent or -1 */
+int
+wldbg_connection_flush(struct wldbg_connection *conn,
+		       struct wl_connection *wl_conn);
+
+/* defined in wldbg.c. Stop (pause = 1) or resume reading both sides
+ * of the connection. Its messages wait in the sockets meanwhile, so
+ * the client and the compositor block once the sockets are full */
+int
+wldbg_connection_pause(struct wldbg_connection *conn, int pause);
+
+/* defined in wldbg.c. Dispatch the events that are ready without
+ * blocking. For passes that block the main loop for long, like the
+ * interactive prompt in server mode. The message that is being
+ * processed is kept, paused connections are not dispatched */
+int
+wldbg_dispatch_nested(struct wldbg *wldbg);
+
 #endif /* _WLDBG_PRIVATE_H_ */
@@ -39,6 +39,7 @@
 #include <sys/epoll.h>
 #include <sys/signalfd.h>
 #include <signal.h>
+#include <spawn.h>
 #include <sys/wait.h>
 
 #include "wldbg.h"
@@ -53,7 +54,9 @@
 #include "wayland/wayland-os.h"
 #include "util.h"
 
-#include "fuzz-pass.h"
+#include "metrics.h"
+#include "control.h"
+#include "pipeline.h"
 
 #ifdef DEBUG
 void
@@ -64,7 +67,18 @@ debug_init(void);
 int
 interactive_init(struct wldbg *wldbg);
 
+/* defined in attach.c */
+int
+attach_init(struct wldbg *wldbg, struct wldbg_options *opts,
+	    int argc, const char *argv[]);
+
 /* defined in passes.c */
+void
+dealloc_pass(struct pass *pass);
+
+void
+destroy_pass(struct wldbg *wldbg, struct pass *pass);
+
 int
 load_passes(struct wldbg *wldbg, struct wldbg_options *opts,
 	    int argc, const char *argv[]);
@@ -100,6 +114,8 @@ wldbg_connection_create(struct wldbg *wldbg)
 	}
 
 	conn->wldbg = wldbg;
+	conn->id = ++wldbg->last_connection_id;
+	wl_list_init(&conn->passes);
 
 	if (wldbg->flags.server_mode) {
 		/* this one has precedence - so that we can connect
@@ -134,10 +150,33 @@ wldbg_connection_create(struct wldbg *wldbg)
 static void
 wldbg_connection_destroy(struct wldbg_connection *conn)
 {
+	struct pass *pass, *tmp;
+
+	wldbg_counters_add(&conn->wldbg->counters, &conn->counters);
+
+	if (conn->wldbg->flags.profiling)
+		wldbg_print_connection_profile(conn);
+
+	/* the shared passes drop what they keep about it */
+	wldbg_connection_closed(conn);
+
+	wl_list_for_each_safe(pass, tmp, &conn->passes, link) {
+		wl_list_remove(&pass->link);
+		destroy_pass(conn->wldbg, pass);
+	}
+
 	if (conn->resolved_objects)
 		destroy_resolved_objects(conn->resolved_objects);
-	if (conn->objects_info)
+	if (conn->objects_info) {
+		if (conn->objects_info->shm.pools_created > 0) {
+			printf("\n-- Shared memory of connection %u (%s) --\n",
+			       conn->id, conn->client.program ?
+			       conn->client.program : "unknown");
+			objects_info_print_shm(conn->objects_info, "  ");
+		}
+
 		destroy_objects_info(conn->objects_info);
+	}
 
 	wl_connection_destroy(conn->server.connection);
 	wl_connection_destroy(conn->client.connection);
@@ -215,12 +254,29 @@ remove_connection(struct wldbg_connection *conn, struct wldbg_fd_callback *cb)
 
 	wldbg_connection_destroy(conn);
 
-	/* if connections_num is 0, that we're done */
-	return wldbg->connections_num;
+	/* if connections_num is 0, that we're done,
+	 * unless some pass is going to spawn new clients */
+	return wldbg->connections_num || wldbg->flags.keep_alive;
+}
+
+int
+wldbg_connection_pause(struct wldbg_connection *conn, int pause)
+{
+	struct wldbg *wldbg = conn->wldbg;
+
+	if (conn->paused == !!pause)
+		return 0;
+
+	if (wldbg_pause_fd(wldbg, conn->server.fd, pause) < 0
+	    || wldbg_pause_fd(wldbg, conn->client.fd, pause) < 0)
+		return -1;
+
+	conn->paused = !!pause;
+	return 0;
 }
 
 static int
-wldbg_dispatch(struct wldbg *wldbg)
+wldbg_dispatch(struct wldbg *wldbg, int timeout)
 {
 	struct epoll_event ev;
 	struct wldbg_fd_callback *cb;
@@ -230,31 +286,45 @@ wldbg_dispatch(struct wldbg *wldbg)
 	assert(!wldbg->flags.exit);
 	assert(!wldbg->flags.error);
 
-	n = epoll_wait(wldbg->epoll_fd, &ev, 1, 10);
+	/* everything that needs to wake us up
+	 * periodically uses wldbg_add_timer() */
+	n = epoll_wait(wldbg->epoll_fd, &ev, 1, timeout);
+	++wldbg->epoll_wait;
 
 	if (n < 0) {
 		/* don't print error when we has been interrupted
 		 * by user */
 		if (errno == EINTR && wldbg->flags.exit)
 			return 0;
+		/* like after Ctrl-Z and fg (SIGSTOP and SIGCONT) */
+		if (errno == EINTR)
+			return 1;
 
 		perror("epoll_wait");
 		return -1;
 	}
-	else if (n == 0) {
-        return 1;
-    }
+
+	/* timed out, nothing to do */
+	if (n == 0)
+		return 1;
 
 	cb = ev.data.ptr;
 	assert(cb && "No callback set in event");
 	conn = cb->data;
 
-	if (ev.events & EPOLLHUP) {
+	/* other fds than connections (like a terminal)
+	 * handle the hang up themselves */
+	if (ev.events & EPOLLHUP && cb->dispatch == dispatch_messages) {
 		/* if connections_num is 0, that we're done */
 		return remove_connection(conn, cb);
 	}
 
-	if (ev.events & EPOLLERR) {
+	/* like writing to a client that is gone */
+	if (ev.events & EPOLLERR && cb->dispatch == dispatch_messages)
+		return remove_connection(conn, cb);
+
+	/* the fds that wait for writing see the error when they write */
+	if (ev.events & EPOLLERR && !(cb->events & EPOLLOUT)) {
 		fprintf(stderr, "epoll event error\n");
 		return -1;
 	}
@@ -271,41 +341,165 @@ wldbg_dispatch(struct wldbg *wldbg)
 	return ret;
 }
 
-static void
-run_passes(struct wldbg_message *message)
+static int
+run_pass(struct pass *pass, struct wldbg_message *message)
+{
+	if (message->from == SERVER)
+		return pass->wldbg_pass.server_pass(pass->wldbg_pass.user_data,
+						    message);
+	else
+		return pass->wldbg_pass.client_pass(pass->wldbg_pass.user_data,
+						    message);
+}
+
+/* the same as run_pass, but measure the time spent in the pass */
+static int
+run_pass_measured(struct wldbg *wldbg, struct pass *pass,
+		  struct wldbg_message *message)
+{
+	uint64_t start, end;
+	int ret;
+
+	start = wldbg_get_time();
+	ret = run_pass(pass, message);
+	end = wldbg_get_time();
+
+	++pass->calls;
+	pass->time += end - start;
+
+	if (wldbg->flags.profiling) {
+		if (!pass->histogram)
+			pass->histogram = wldbg_histogram_create();
+		if (pass->histogram)
+			wldbg_histogram_add(pass->histogram, end - start);
+	}
+
+	return ret;
+}
+
+static int
+run_pass_list(struct wldbg *wldbg, struct wl_list *passes,
+	      struct wldbg_message *message)
 {
 	struct pass *pass;
-	struct wldbg *wldbg = message->connection->wldbg;
+	int measure = wldbg->metrics || wldbg->flags.profiling;
+	int ret;
+
+	wl_list_for_each(pass, passes, link) {
+		if (measure)
+			ret = run_pass_measured(wldbg, pass, message);
+		else
+			ret = run_pass(pass, message);
+
+		if (ret == PASS_STOP)
+			return PASS_STOP;
+	}
+
+	return PASS_NEXT;
+}
+
+void
+wldbg_run_passes(struct wldbg_message *message)
+{
+	struct wldbg_connection *conn = message->connection;
+	struct wldbg *wldbg = conn->wldbg;
+	struct pass *pass;
+	int hardcoded;
+	int measure;
 
 	assert(wldbg && "BUG: No wldbg set in message->connection");
 
+	if (conn->own_pipeline) {
+		run_pass_list(wldbg, &conn->passes, message);
+		return;
+	}
+
+	if (wl_list_empty(&conn->passes)) {
+		run_pass_list(wldbg, &wldbg->passes, message);
+		return;
+	}
+
+	/* the passes of the connection go after resolve and objinfo,
+	 * so that they can use what these gathered */
+	hardcoded = wldbg->resolving_objects + wldbg->gathering_info;
+	measure = wldbg->metrics || wldbg->flags.profiling;
+
 	wl_list_for_each(pass, &wldbg->passes, link) {
-		if (message->from == SERVER) {
-			if (pass->wldbg_pass.server_pass(
-				pass->wldbg_pass.user_data,
-				message) == PASS_STOP)
-				break;
-		} else {
-			if (pass->wldbg_pass.client_pass(
-				pass->wldbg_pass.user_data,
-				message) == PASS_STOP)
-				break;
-		}
+		if (hardcoded-- == 0
+		    && run_pass_list(wldbg, &conn->passes,
+				     message) == PASS_STOP)
+			return;
+
+		if ((measure ? run_pass_measured(wldbg, pass, message)
+			     : run_pass(pass, message)) == PASS_STOP)
+			return;
 	}
+
+	/* there are only the hardcoded passes */
+	if (hardcoded >= 0)
+		run_pass_list(wldbg, &conn->passes, message);
+}
+
+/* read a side only while the other one can take what comes, wait
+ * for a full socket to be writable. The other connections and the
+ * loop keep running meanwhile */
+static int
+update_connection_events(struct wldbg_connection *conn)
+{
+	struct wldbg *wldbg = conn->wldbg;
+	uint32_t client_events, server_events;
+
+	client_events = (conn->server.blocked ? 0 : EPOLLIN)
+			| (conn->client.blocked ? EPOLLOUT : 0);
+	server_events = (conn->client.blocked ? 0 : EPOLLIN)
+			| (conn->server.blocked ? EPOLLOUT : 0);
+
+	if (wldbg_set_fd_events(wldbg, conn->client.fd, client_events) < 0
+	    || wldbg_set_fd_events(wldbg, conn->server.fd, server_events) < 0)
+		return -1;
+
+	return 0;
+}
+
+int
+wldbg_connection_flush(struct wldbg_connection *conn,
+		       struct wl_connection *wl_conn)
+{
+	int *blocked;
+	int ret;
+
+	if (wl_conn == conn->server.connection)
+		blocked = &conn->server.blocked;
+	else
+		blocked = &conn->client.blocked;
+
+	ret = wl_connection_flush(wl_conn);
+	if (ret < 0 && errno != EAGAIN)
+		return -1;
+
+	/* the other side does not read fast enough,
+	 * the rest stays in wl_conn */
+	if (*blocked != (ret < 0)) {
+		*blocked = ret < 0;
+		if (update_connection_events(conn) < 0)
+			return -1;
+	}
+
+	return ret < 0 ? 0 : ret;
 }
 
 static int
 process_one_by_one(struct wl_connection *write_conn,
 		   struct wldbg_message *message)
 {
-	int n = 0;
+	int n = 0, ret;
 	size_t rest = message->size;
 	struct wldbg *wldbg = message->connection->wldbg;
 
 	while (rest > 0) {
 		message->size = ((uint32_t *) message->data)[1] >> 16;
 
-		run_passes(message);
+		wldbg_run_passes(message);
 
 		/* in interactive mode we can quit here. Do not
 		 * write into connection if we quit */
@@ -324,10 +518,18 @@ process_one_by_one(struct wl_connection *write_conn,
                 return -1;
             }
 
-            if (wl_connection_flush(write_conn) < 0) {
+            ret = wldbg_connection_flush(message->connection,
+                                         write_conn);
+            if (ret < 0) {
                 perror("wl_connection_flush");
                 return -1;
+            } else if (ret > 0) {
+                ++message->connection->counters.sendmsg;
             }
+
+            if (wldbg->proxy_latency)
+                wldbg_histogram_add(wldbg->proxy_latency,
+                                    wldbg_get_time() - message->time);
         }
 
 		message->data = message->data + message->size;
@@ -340,6 +542,58 @@ process_one_by_one(struct wl_connection *write_conn,
 	return n;
 }
 
+static int
+whole_messages_length(const char *buffer, int len)
+{
+	uint32_t size;
+	int off = 0;
+
+	while (off + 2 * (int) sizeof(uint32_t) <= len) {
+		size = ((const uint32_t *) (buffer + off))[1] >> 16;
+		/* broken message, let the passes have it all */
+		if (size < 2 * sizeof(uint32_t))
+			return len;
+
+		if (off + (int) size > len)
+			break;
+
+		off += size;
+	}
+
+	return off;
+}
+
+static void
+count_messages(struct wldbg_connection *conn, struct wldbg_message *message)
+{
+	uint64_t second = message->time / 1000000000;
+	uint32_t n = 0, size;
+	size_t off = 0;
+
+	while (off + 2 * sizeof(uint32_t) <= message->size) {
+		size = ((uint32_t *) ((char *) message->data + off))[1] >> 16;
+		if (size < 2 * sizeof(uint32_t))
+			break;
+
+		off += size;
+		++n;
+	}
+
+	conn->counters.messages[message->from] += n;
+	conn->counters.bytes[message->from] += message->size;
+
+	if (second != conn->rate.second) {
+		/* the last whole second or zero if there
+		 * were no messages in it */
+		conn->rate.last = second == conn->rate.second + 1 ?
+				  conn->rate.count : 0;
+		conn->rate.second = second;
+		conn->rate.count = 0;
+	}
+
+	conn->rate.count += n;
+}
+
 static int
 process_data(struct wldbg_connection *conn,
 	     struct wl_connection *wl_connection, int len)
@@ -357,8 +611,17 @@ process_data(struct wldbg_connection *conn,
 
 	/* reset the message */
 	memset(message, 0, sizeof *message);
+	message->time = wldbg_get_time();
 
 	wl_connection_copy(wl_connection, buffer, len);
+
+	/* the end of the buffer can be a part of a message
+	 * that was not read whole yet, leave it in the connection
+	 * for the next time */
+	len = whole_messages_length(buffer, len);
+	if (len == 0)
+		return 1;
+
 	wl_connection_consume(wl_connection, len);
 
 	if (wl_connection == conn->server.connection) {
@@ -375,11 +638,15 @@ process_data(struct wldbg_connection *conn,
 	message->size = len;
 	message->connection = conn;
 
-	if (!wldbg->flags.pass_whole_buffer) {
+	count_messages(conn, message);
+
+	/* without passes there is nothing to split the buffer for */
+	if (!wldbg->flags.pass_whole_buffer
+	    && !(conn->own_pipeline && wl_list_empty(&conn->passes))) {
 		ret = process_one_by_one(write_wl_conn, message);
 	} else {
 		/* process passes */
-		run_passes(message);
+		wldbg_run_passes(message);
 
 		/* if some pass wants exit or an error occured,
 		 * do not write into the connection */
@@ -396,11 +663,18 @@ process_data(struct wldbg_connection *conn,
 			return -1;
 		}
 
-		if (wl_connection_flush(write_wl_conn) < 0) {
+		ret = wldbg_connection_flush(conn, write_wl_conn);
+		if (ret < 0) {
 			perror("wl_connection_flush");
 			return -1;
+		} else if (ret > 0) {
+			++conn->counters.sendmsg;
 		}
 
+		if (wldbg->proxy_latency)
+			wldbg_histogram_add(wldbg->proxy_latency,
+					    wldbg_get_time() - message->time);
+
 		ret = 1;
 	}
 
@@ -415,16 +689,35 @@ dispatch_messages(int fd, void *data)
 	int len;
 	struct wldbg_connection *conn = data;
 	struct wl_connection *wl_conn;
+	int blocked, other_blocked;
 
-	if (fd == conn->client.fd)
+	if (fd == conn->client.fd) {
 		wl_conn = conn->client.connection;
-	else
+		blocked = conn->client.blocked;
+		other_blocked = conn->server.blocked;
+	} else {
 		wl_conn = conn->server.connection;
+		blocked = conn->server.blocked;
+		other_blocked = conn->client.blocked;
+	}
+
+	/* the socket can take more of the data that waits */
+	if (blocked) {
+		if (wldbg_connection_flush(conn, wl_conn) < 0) {
+			perror("wl_connection_flush");
+			return -1;
+		}
+	}
+
+	/* woken up only for writing */
+	if (other_blocked)
+		return 1;
 
 	vdbg("Reading connection [%p] from %s\n", conn,
 		fd == conn->client.fd ? "client" : "server");
 
 	len = wl_connection_read(wl_conn);
+	++conn->counters.recvmsg;
 	if (len < 0 && errno != EAGAIN) {
 		perror("wl_connection_read");
 		return -1;
@@ -440,6 +733,20 @@ wldbg_connection_kill(struct wldbg_connection *conn)
 	kill(conn->client.pid, SIGTERM);
 }
 
+int
+wldbg_report(struct wldbg *wldbg)
+{
+	struct wldbg_report_callback *rcb;
+	int n = 0;
+
+	wl_list_for_each(rcb, &wldbg->report_callbacks, link) {
+		rcb->func(rcb->data);
+		++n;
+	}
+
+	return n;
+}
+
 static int
 dispatch_signals(int fd, void *data)
 {
@@ -447,6 +754,7 @@ dispatch_signals(int fd, void *data)
 	size_t len;
 	struct signalfd_siginfo si;
 	struct wldbg *wldbg = data;
+	struct wldbg_exit_callback *ecb;
 	pid_t pid;
 
 	len = read(fd, &si, sizeof si);
@@ -459,15 +767,23 @@ dispatch_signals(int fd, void *data)
 
 	if (si.ssi_signo == SIGCHLD) {
 		/* Just print message and let epoll exit with
-		 * the right exit code according to if it was HUP or ERR */
-		pid = waitpid(-1, &s, WNOHANG);
-		fprintf(stderr, "Client '%d' exited %s...\n",
-			pid, WIFEXITED(s) ? "" : "abnormally");
+		 * the right exit code according to if it was HUP or ERR.
+		 * More children may have exited for one signal */
+		while ((pid = waitpid(-1, &s, WNOHANG)) > 0) {
+			if (wl_list_empty(&wldbg->exit_callbacks))
+				fprintf(stderr, "Client '%d' exited %s...\n",
+					pid, WIFEXITED(s) ? "" : "abnormally");
+
+			wl_list_for_each(ecb, &wldbg->exit_callbacks, link)
+				ecb->func(pid, s, ecb->data);
+		}
 	} else if (si.ssi_signo == SIGINT) {
 		fprintf(stderr, "Interrupted...\n");
 
 		wldbg_foreach_connection(wldbg, wldbg_connection_kill);
 		wldbg->flags.exit = 1;
+	} else if (si.ssi_signo == SIGUSR1) {
+		wldbg_report(wldbg);
 	} else {
 		assert(0 && "Got unhandled signal from epoll");
 	}
@@ -508,6 +824,12 @@ create_client_connection(struct wldbg_connection *conn)
 		return -1;
 	}
 
+	/* our end must not leak into clients we spawn later */
+	if (fcntl(sock[0], F_SETFD, FD_CLOEXEC) < 0) {
+		perror("Setting FD_CLOEXEC");
+		goto err;
+	}
+
 	if (create_client_connection_for_fd(conn, sock[0]) < 0)
 		goto err;
 
@@ -527,8 +849,10 @@ static struct wldbg_connection *
 spawn_client(struct wldbg *wldbg, char *path, char *argv[])
 {
 	char sockstr[8];
-	int sock;
+	int sock, ret;
 	struct wldbg_connection *conn;
+	posix_spawnattr_t attr;
+	sigset_t signals;
 
 	if (!path) {
 		fprintf(stderr, "No path to program given\n");
@@ -566,25 +890,38 @@ spawn_client(struct wldbg *wldbg, char *path, char *argv[])
 		goto err_sock;
 	}
 
-	conn->client.pid = fork();
-
-	if (conn->client.pid == -1) {
-		perror("fork");
+	/* posix_spawn does not copy our page tables like fork,
+	 * which matters when we respawn clients often.
+	 * The client should not inherit signals that we block
+	 * for signalfd, our end of the socket is CLOEXEC */
+	sigemptyset(&signals);
+	if ((ret = posix_spawnattr_init(&attr)) != 0
+	    || (ret = posix_spawnattr_setsigmask(&attr, &signals)) != 0
+	    || (ret = posix_spawnattr_setflags(&attr,
+					       POSIX_SPAWN_SETSIGMASK)) != 0) {
+		fprintf(stderr, "Setting up spawn attributes: %s\n",
+			strerror(ret));
 		goto err_sock;
 	}
 
-	/* exec client in child */
-	if (conn->client.pid == 0) {
-		close(conn->client.fd);
-
-		execvp(path, argv);
+	ret = posix_spawnp(&conn->client.pid, path, NULL, &attr,
+			   argv, environ);
+	posix_spawnattr_destroy(&attr);
 
-		perror("Exec failed");
-		abort();
+	if (ret != 0) {
+		fprintf(stderr, "Spawning '%s' failed: %s\n",
+			path, strerror(ret));
+		goto err_sock;
 	}
 
 	close(sock);
 
+	/* the socket was created by us, so the program we got for
+	 * the connection is wldbg. Use the spawned program instead */
+	free(conn->client.program);
+	conn->client.program = strdup(strrchr(path, '/') ?
+				      strrchr(path, '/') + 1 : path);
+
 	return conn;
 
 err_sock:
@@ -594,6 +931,19 @@ err:
 	return NULL;
 }
 
+struct wldbg_connection *
+wldbg_spawn_client(struct wldbg *wldbg)
+{
+	struct wldbg_connection *conn;
+
+	conn = spawn_client(wldbg, wldbg->client.path, wldbg->client.argv);
+	if (!conn)
+		return NULL;
+
+	wldbg_add_connection(conn);
+	return conn;
+}
+
 static int
 wldbg_run(struct wldbg *wldbg)
 {
@@ -604,7 +954,7 @@ wldbg_run(struct wldbg *wldbg)
 
 	wldbg->flags.running = 1;
 
-	while((ret = wldbg_dispatch(wldbg)) > 0) {
+	while((ret = wldbg_dispatch(wldbg, -1)) > 0) {
 		if (wldbg->flags.error) {
 			dbg("Exiting for error flag");
 			ret = -1;
@@ -616,10 +966,6 @@ wldbg_run(struct wldbg *wldbg)
 			ret = 0;
 			break;
 		}
-
-		if (wldbg->flags.fuzz_mode) {
-            wldbg_fuzz_send_next(wldbg);
-        }
 	}
 
 	wldbg->flags.running = 0;
@@ -627,6 +973,37 @@ wldbg_run(struct wldbg *wldbg)
 	return ret;
 }
 
+int
+wldbg_dispatch_nested(struct wldbg *wldbg)
+{
+	struct wldbg_message message = wldbg->message;
+	char *buffer = wldbg->buffer;
+	unsigned int skip = wldbg->flags.skip;
+	int ret;
+
+	if (wldbg->flags.exit || wldbg->flags.error)
+		return 0;
+
+	/* the processed message points into the buffer,
+	 * the nested messages need a buffer of their own */
+	wldbg->buffer = malloc(4096);
+	if (!wldbg->buffer) {
+		wldbg->buffer = buffer;
+		return -1;
+	}
+
+	wldbg->flags.skip = 0;
+
+	ret = wldbg_dispatch(wldbg, 0);
+
+	free(wldbg->buffer);
+	wldbg->buffer = buffer;
+	wldbg->message = message;
+	wldbg->flags.skip = skip;
+
+	return ret;
+}
+
 static void
 free_server_mode_resources(struct wldbg *wldbg)
 {
@@ -663,6 +1040,13 @@ wldbg_destroy(struct wldbg *wldbg)
 {
 	struct pass *pass, *pass_tmp;
 	struct wldbg_fd_callback *cb, *cb_tmp;
+	struct wldbg_report_callback *rcb, *rcb_tmp;
+	struct wldbg_exit_callback *ecb, *ecb_tmp;
+	struct wldbg_close_callback *ccb, *ccb_tmp;
+	struct wldbg_timer *timer, *timer_tmp;
+
+	if (wldbg->flags.profiling)
+		wldbg_print_profile(wldbg);
 
 	/* free buffer */
 	free(wldbg->buffer);
@@ -675,17 +1059,35 @@ wldbg_destroy(struct wldbg *wldbg)
 	wl_list_for_each_safe(pass, pass_tmp, &wldbg->passes, link) {
 		if (pass->wldbg_pass.destroy)
 			pass->wldbg_pass.destroy(pass->wldbg_pass.user_data);
-		free(pass->name);
-		free(pass);
+		dealloc_pass(pass);
+	}
+
+	/* their fd callbacks are freed below */
+	wl_list_for_each_safe(timer, timer_tmp, &wldbg->timers, link) {
+		close(timer->fd);
+		free(timer);
 	}
 
 	wl_list_for_each_safe(cb, cb_tmp, &wldbg->monitored_fds, link) {
 		free(cb);
 	}
 
+	wl_list_for_each_safe(rcb, rcb_tmp, &wldbg->report_callbacks, link)
+		free(rcb);
+	wl_list_for_each_safe(ecb, ecb_tmp, &wldbg->exit_callbacks, link)
+		free(ecb);
+	wl_list_for_each_safe(ccb, ccb_tmp, &wldbg->close_callbacks, link)
+		free(ccb);
+
 	if (wldbg->flags.server_mode)
 		free_server_mode_resources(wldbg);
 
+	wldbg_metrics_destroy(wldbg);
+	wldbg_control_destroy(wldbg);
+	wldbg_pipeline_rules_destroy(wldbg);
+	if (wldbg->proxy_latency)
+		wldbg_histogram_destroy(wldbg->proxy_latency);
+
 	/* if there are any connections left that haven't got
 	 * HUP, free them */
 	wldbg_foreach_connection(wldbg, wldbg_connection_destroy);
@@ -707,7 +1109,12 @@ wldbg_init(struct wldbg *wldbg)
 
 	wl_list_init(&wldbg->passes);
 	wl_list_init(&wldbg->monitored_fds);
+	wl_list_init(&wldbg->report_callbacks);
+	wl_list_init(&wldbg->exit_callbacks);
+	wl_list_init(&wldbg->close_callbacks);
+	wl_list_init(&wldbg->timers);
 	wl_list_init(&wldbg->connections);
+	wl_list_init(&wldbg->pipeline_rules);
 
 	wldbg->epoll_fd = epoll_create1(0);
 	if (wldbg->epoll_fd == -1) {
@@ -718,6 +1125,7 @@ wldbg_init(struct wldbg *wldbg)
 	sigemptyset(&signals);
 	sigaddset(&signals, SIGINT);
 	sigaddset(&signals, SIGCHLD);
+	sigaddset(&signals, SIGUSR1);
 
 	/* block signals, let them come to signalfd */
 	if (sigprocmask(SIG_BLOCK, &signals, NULL) < 0) {
@@ -761,6 +1169,16 @@ help(void)
 	fprintf(stderr, "\twldbg [-i|--interactive] ARGUMENTS [PROGRAM]\n");
 	fprintf(stderr, "\twldbg pass ARGUMENTS, pass ARGUMENTS,... -- PROGRAM\n");
 	fprintf(stderr, "\twldbg [-s|--server-mode]\n");
+	fprintf(stderr, "\twldbg attach [socket=PATH] [pass ARGUMENTS, ...]\n");
+	fprintf(stderr, "\twldbg control [socket=PATH] COMMAND\n");
+	fprintf(stderr, "\nOptions:\n");
+	fprintf(stderr, "\t--metrics=PATH  export counters on unix socket PATH\n");
+	fprintf(stderr, "\t--control[=PATH] take commands on unix socket PATH,\n"
+			"\t                with -s run as a daemon\n");
+	fprintf(stderr, "\t--profile       measure overhead of wldbg and passes\n");
+	fprintf(stderr, "\t--pipeline=PATTERN:PASS,PASS,...\n"
+			"\t                with -s clients whose program matches\n"
+			"\t                PATTERN run only these passes\n");
 	fprintf(stderr, "\nTry 'wldbg help' too.\n"
 			"For interactive mode and server-mode description "
 			"see documentation.\n");
@@ -792,6 +1210,9 @@ server_mode_accept(int fd, void *data)
 		goto err;
 	}
 
+	/* on failure the connection just keeps the shared passes */
+	wldbg_connection_apply_rules(conn);
+
 	wldbg_add_connection(conn);
 	dbg("Created new connection to client: %s\n", name.sun_path);
 
@@ -867,6 +1288,10 @@ parse_opts(struct wldbg *wldbg, struct wldbg_options *options,
 			return -1;
 
 		return 0;
+	} else if (argv[pass_off] && strcmp(argv[pass_off], "attach") == 0) {
+		/* the passes are loaded by attach_init */
+		return attach_init(wldbg, options, argc - pass_off,
+				   (const char **) argv + pass_off);
 	} else if (options->server_mode) {
 		wldbg->flags.server_mode = 1;
 
@@ -880,10 +1305,14 @@ parse_opts(struct wldbg *wldbg, struct wldbg_options *options,
 		if (server_mode_init(wldbg) < 0)
 			return -1;
 
-		/* server mode is interactive too -- at least
-		 * ATM */
-		if (interactive_init(wldbg) < 0)
+		if (options->control_path) {
+			/* a daemon. It runs until it is killed and the
+			 * passes are loaded through the control socket */
+			wldbg->flags.keep_alive = 1;
+		} else if (interactive_init(wldbg) < 0) {
+			/* server mode is interactive otherwise */
 			return -1;
+		}
 
 		pass_num = 1;
 	} else {
@@ -907,7 +1336,7 @@ int main(int argc, char *argv[])
 {
 	struct wldbg wldbg;
 	struct wldbg_options options;
-	struct wldbg_connection *conn;
+	int i;
 
 	if (argc == 1) {
 		help();
@@ -918,21 +1347,59 @@ int main(int argc, char *argv[])
 	debug_init();
 #endif
 
+	/* talk to another wldbg, nothing to set up */
+	if (strcmp(argv[1], "control") == 0)
+		return wldbg_control_command(argc - 1, argv + 1);
+
 	wldbg_init(&wldbg);
 
 	memset(&options, 0 , sizeof options);
 	if (parse_opts(&wldbg, &options, argc, argv) < 0)
 		goto err;
 
-	if (options.objinfo) {
+	for (i = 0; i < options.pipelines_num; ++i) {
+		if (wldbg_add_pipeline_rule(&wldbg, options.pipelines[i]) < 0)
+			goto err;
+	}
+
+	if (options.pipelines_num > 0 && !wldbg.flags.server_mode)
+		fprintf(stderr, "Pipeline rules are used only "
+				"in server mode\n");
+
+	if (options.objinfo || wldbg_pipeline_rules_need_objinfo(&wldbg)) {
 		/* init gathering additional information about
 		 * the objects */
 		if (wldbg_add_objinfo_pass(&wldbg) < 0)
 			goto err;
 	}
 
+	if (options.profile) {
+		wldbg.proxy_latency = wldbg_histogram_create();
+		if (!wldbg.proxy_latency)
+			goto err;
+
+		wldbg.flags.profiling = 1;
+	}
+
+	if (options.metrics_path) {
+		if (wldbg_metrics_init(&wldbg, options.metrics_path) < 0)
+			goto err;
+	}
+
+	if (options.control_path) {
+		char path[sizeof(struct sockaddr_un) - sizeof(sa_family_t)];
+
+		if (*options.control_path)
+			snprintf(path, sizeof path, "%s",
+				 options.control_path);
+		else if (wldbg_control_default_path(path, sizeof path) < 0)
+			goto err;
+
+		if (wldbg_control_init(&wldbg, path) < 0)
+			goto err;
+	}
+
 #ifdef DEBUG
-	int i;
 	dbg("Program: %s, argc == %d\n", options.path, options.argc);
 	for (i = 0; i < options.argc; ++i)
 		dbg("\targ[%d]: %s\n", i, options.argv[i]);
@@ -950,12 +1417,14 @@ int main(int argc, char *argv[])
 
 	if (wldbg.flags.server_mode) {
 		printf("Listening for incoming connections...\n");
+	} else if (wldbg.flags.attached) {
+		/* the messages come from the other wldbg */
 	} else {
-		conn = spawn_client(&wldbg, options.path, options.argv);
-		if (conn == NULL)
-			goto err;
+		wldbg.client.path = options.path;
+		wldbg.client.argv = options.argv;
 
-		wldbg_add_connection(conn);
+		if (wldbg_spawn_client(&wldbg) == NULL)
+			goto err;
 	}
 
 	if (wldbg_run(&wldbg) < 0)
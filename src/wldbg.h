@@ -26,6 +26,8 @@
 #ifndef _WLDBG_H_
 #define _WLDBG_H_
 
+#include <sys/types.h>
+
 #include "wldbg-pass.h"
 #include "wldbg-objects-info.h"
 
@@ -47,6 +49,9 @@ struct wldbg_message {
 
 	/* pointer to connectoin structure */
 	struct wldbg_connection *connection;
+
+	/* when wldbg read the message (see wldbg_get_time) */
+	uint64_t time;
 };
 
 const struct wl_interface *
@@ -55,6 +60,12 @@ wldbg_message_get_object(struct wldbg_message *msg, uint32_t id);
 const struct wl_interface *
 wldbg_message_get_interface(struct wldbg_message *msg, const char *name);
 
+/* is intf the interface called name? The first one found is saved
+ * in known, then only the pointers are compared */
+int
+wldbg_is_interface(const struct wl_interface **known,
+		   const struct wl_interface *intf, const char *name);
+
 void
 wldbg_message_objects_iterate(struct wldbg_message *message,
 			      void (*func)(uint32_t id,
@@ -82,6 +93,10 @@ wldbg_error(struct wldbg *wldbg);
 int
 wldbg_separate_messages(struct wldbg *wldbg, int state);
 
+/* current time in nanoseconds (CLOCK_MONOTONIC) */
+uint64_t
+wldbg_get_time(void);
+
 struct wldbg_fd_callback;
 
 struct wldbg_fd_callback *
@@ -91,4 +106,46 @@ wldbg_monitor_fd(struct wldbg *wldbg, int fd,
 int
 wldbg_remove_callback(struct wldbg *wldbg, struct wldbg_fd_callback *cb);
 
+struct wldbg_timer;
+
+/* call func after timeout nanoseconds and then every interval
+ * nanoseconds (one-shot if interval is 0, disarmed if timeout is 0).
+ * Timers live in the main loop, so an idle wldbg doesn't wake up
+ * unless some timer is armed. Timers that are not removed are
+ * freed with wldbg */
+struct wldbg_timer *
+wldbg_add_timer(struct wldbg *wldbg, uint64_t timeout, uint64_t interval,
+		void (*func)(void *data), void *data);
+
+/* re-arm or disarm (timeout = 0) the timer */
+int
+wldbg_timer_arm(struct wldbg_timer *timer, uint64_t timeout, uint64_t interval);
+
+int
+wldbg_remove_timer(struct wldbg *wldbg, struct wldbg_timer *timer);
+
+/* call func every time wldbg gets SIGUSR1. Passes use it
+ * to print what they gathered while the client is running */
+int
+wldbg_add_report_callback(struct wldbg *wldbg,
+			  void (*func)(void *data), void *data);
+
+/* call func every time a child of wldbg (a client spawned
+ * by wldbg) exits. status is the status from waitpid().
+ * The report, exit and close callbacks that a pass registers
+ * with its user_data are removed when the pass is unloaded */
+int
+wldbg_add_exit_callback(struct wldbg *wldbg,
+			void (*func)(pid_t pid, int status, void *data),
+			void *data);
+
+/* call func when a connection is closed, before its passes are
+ * destroyed. Passes that keep something about every connection
+ * use it to free it. Removed with the pass like the ones above */
+int
+wldbg_add_close_callback(struct wldbg *wldbg,
+			 void (*func)(struct wldbg_connection *conn,
+				      void *data),
+			 void *data);
+
 #endif /* _WLDBG_H_ */
@@ -0,0 +1,120 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "test-runner.h"
+#include "wayland/wayland-util.h"
+#include "interactive/condition.h"
+
+/* like wl_pointer.motion with a string in the middle */
+static const struct wl_message motion = { "motion", "usff", NULL };
+static const struct wl_message other = { "other", "u", NULL };
+
+/* id 7, opcode 2: time 1000, "abc", x 600.5, y 30 */
+static const uint32_t data[] = {
+	7, (32 << 16) | 2,
+	1000,
+	4, 0x00636261,
+	600 * 256 + 128,
+	30 * 256,
+	0 /* padding after the message, not part of it */
+};
+
+static int
+eval(const char *expr, const struct wl_message *compile_with)
+{
+	struct condition *cond;
+	int ret;
+
+	cond = condition_compile(expr, compile_with);
+	assert(cond);
+	ret = condition_eval(cond, &motion, data, 28);
+	condition_free(cond);
+
+	return ret;
+}
+
+/* check the result with precomputed offsets and with walking
+ * the signature */
+static int
+eval_both(const char *expr)
+{
+	int ret = eval(expr, &motion);
+
+	assert(eval(expr, NULL) == ret);
+	return ret;
+}
+
+TEST(condition_arguments)
+{
+	assert(eval_both("id == 7"));
+	assert(eval_both("arg0 == 1000"));
+	assert(eval_both("arg1 == 4"));
+	assert(eval_both("arg2 == 600"));
+	assert(eval_both("arg3 == 30"));
+	assert(!eval_both("arg2 < 600"));
+}
+
+TEST(condition_precedence)
+{
+	assert(eval_both("1 + 2 * 3 == 7"));
+	assert(eval_both("(1 + 2) * 3 == 9"));
+	assert(eval_both("10 - 4 - 3 == 3"));
+	assert(eval_both("-arg3 + 40 == 10"));
+	assert(eval_both("!(arg0 > 500) || arg0 % 2 == 0"));
+	assert(eval_both("arg2 > 500 && arg0 % 2 == 0"));
+	assert(!eval_both("arg2 > 500 && arg0 % 3 == 0"));
+	assert(eval_both("0 && 1 || 1"));
+	assert(eval_both("0x10 == 16"));
+}
+
+TEST(condition_short_circuit)
+{
+	/* the missing argument would make it false */
+	assert(eval("1 || arg9 == 1", NULL));
+	assert(!eval("0 && arg9 == 0", NULL));
+	assert(!eval("arg9 == 0 || 0", NULL));
+}
+
+TEST(condition_division_by_zero)
+{
+	assert(!eval_both("arg0 / 0 == 0"));
+	assert(!eval_both("arg0 % (arg3 - 30) == 0"));
+	assert(eval_both("-9223372036854775807 - 1 == (-9223372036854775807 - 1) / -1"));
+}
+
+TEST(condition_short_message)
+{
+	struct condition *cond;
+
+	cond = condition_compile("arg3 == 30", NULL);
+	assert(cond);
+	assert(condition_eval(cond, &motion, data, 28));
+	assert(!condition_eval(cond, &motion, data, 24));
+	condition_free(cond);
+}
+
+TEST(condition_other_message)
+{
+	struct condition *cond;
+
+	cond = condition_compile("id == 7", &motion);
+	assert(cond);
+	assert(!condition_eval(cond, &other, data, 28));
+	condition_free(cond);
+}
+
+TEST(condition_errors)
+{
+	struct condition *cond;
+
+	assert(!condition_compile("", NULL));
+	assert(!condition_compile("arg0 ==", NULL));
+	assert(!condition_compile("(1", NULL));
+	assert(!condition_compile("1 2", NULL));
+	assert(!condition_compile("foo > 1", NULL));
+	/* checked when we know the message */
+	assert(!condition_compile("arg4 > 1", &motion));
+	cond = condition_compile("arg4 > 1", NULL);
+	assert(cond);
+	condition_free(cond);
+}
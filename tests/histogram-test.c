@@ -0,0 +1,102 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "test-runner.h"
+#include "wldbg-histogram.h"
+
+TEST(histogram_empty)
+{
+	struct wldbg_histogram h;
+
+	wldbg_histogram_init(&h);
+	assert(h.count == 0);
+	assert(wldbg_histogram_percentile(&h, 50) == 0);
+	assert(wldbg_histogram_mean(&h) == 0);
+}
+
+TEST(histogram_small_values_exact)
+{
+	struct wldbg_histogram h;
+	uint64_t i;
+
+	wldbg_histogram_init(&h);
+	for (i = 1; i <= WLDBG_HISTOGRAM_SUB_COUNT; ++i)
+		wldbg_histogram_add(&h, i);
+
+	assert(h.count == WLDBG_HISTOGRAM_SUB_COUNT);
+	assert(h.min == 1);
+	assert(h.max == WLDBG_HISTOGRAM_SUB_COUNT);
+	assert(wldbg_histogram_percentile(&h, 0) == 1);
+	assert(wldbg_histogram_percentile(&h, 50) == 8);
+	assert(wldbg_histogram_percentile(&h, 100) == WLDBG_HISTOGRAM_SUB_COUNT);
+}
+
+TEST(histogram_relative_error)
+{
+	struct wldbg_histogram h;
+	uint64_t v, p;
+
+	/* every value alone must be reported within 1/16 */
+	for (v = 17; v < (1ULL << 38); v = v * 3 + 7) {
+		wldbg_histogram_init(&h);
+		wldbg_histogram_add(&h, 1);
+		wldbg_histogram_add(&h, v);
+		wldbg_histogram_add(&h, v + 1000000000000ULL);
+
+		p = wldbg_histogram_percentile(&h, 50);
+		assert(p >= v);
+		assert(p - v <= v / WLDBG_HISTOGRAM_SUB_COUNT);
+	}
+}
+
+TEST(histogram_percentiles)
+{
+	struct wldbg_histogram h;
+	uint64_t i, p50, p99;
+
+	wldbg_histogram_init(&h);
+	for (i = 1; i <= 1000; ++i)
+		wldbg_histogram_add(&h, i * 1000);
+
+	p50 = wldbg_histogram_percentile(&h, 50);
+	p99 = wldbg_histogram_percentile(&h, 99);
+
+	assert(p50 >= 500000 && p50 <= 500000 + 500000 / 16);
+	assert(p99 >= 990000 && p99 <= 990000 + 990000 / 16);
+	assert(wldbg_histogram_mean(&h) == 500500);
+}
+
+TEST(histogram_huge_values)
+{
+	struct wldbg_histogram h;
+
+	wldbg_histogram_init(&h);
+	wldbg_histogram_add(&h, UINT64_MAX);
+	wldbg_histogram_add(&h, 1ULL << 50);
+
+	assert(h.max == UINT64_MAX);
+	assert(wldbg_histogram_percentile(&h, 50) <= UINT64_MAX);
+	assert(wldbg_histogram_percentile(&h, 100) == UINT64_MAX);
+}
+
+TEST(histogram_merge)
+{
+	struct wldbg_histogram *a, *b;
+
+	a = wldbg_histogram_create();
+	b = wldbg_histogram_create();
+	assert(a && b);
+
+	wldbg_histogram_add(a, 10);
+	wldbg_histogram_add(b, 5);
+	wldbg_histogram_add(b, 1000);
+
+	wldbg_histogram_merge(a, b);
+	assert(a->count == 3);
+	assert(a->min == 5);
+	assert(a->max == 1000);
+	assert(a->sum == 1015);
+
+	wldbg_histogram_destroy(a);
+	wldbg_histogram_destroy(b);
+}
@@ -0,0 +1,508 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* micro-benchmarks of the libwldbg functions that run for every
+ * message that goes through wldbg. The messages are a mix that
+ * a simple client with a pointer and keyboard sends and gets
+ * when it draws a frame. Run with 'make bench' */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include <wayland-server-protocol.h>
+#include <wayland-client-protocol.h>
+
+/* for ARRAY_LENGTH */
+#include "wayland/wayland-private.h"
+
+#include "bench-runner.h"
+#include "wldbg.h"
+#include "wldbg-private.h"
+#include "wldbg-parse-message.h"
+#include "wldbg-ids-map.h"
+#include "resolve.h"
+#include "util.h"
+
+#ifdef DEBUG
+/* resolve-pass.c uses the debugging
+ * macros, these are in debug.c */
+void
+debug_init(void);
+#endif
+
+/* resolve-pass.c allocates its pass with these,
+ * we do not need the rest of passes.c here */
+struct pass *
+alloc_pass(const char *name)
+{
+	struct pass *pass = calloc(1, sizeof *pass);
+	if (!pass)
+		return NULL;
+
+	pass->name = strdup(name);
+	return pass;
+}
+
+void
+dealloc_pass(struct pass *pass)
+{
+	free(pass->name);
+	free(pass);
+}
+
+enum {
+	DISPLAY_ID = 1,
+	REGISTRY_ID,
+	COMPOSITOR_ID,
+	SHM_ID,
+	SEAT_ID,
+	SURFACE_ID,
+	POINTER_ID,
+	KEYBOARD_ID,
+	POOL_ID,
+	BUFFER_ID,
+	CALLBACK_ID,
+	OUTPUT_ID,
+	NEW_BUFFER_ID,
+};
+
+#define MAX_MESSAGES 64
+#define MAX_WORDS 1024
+
+struct message_mix {
+	struct wldbg_message messages[MAX_MESSAGES];
+	unsigned int count;
+
+	uint32_t words[MAX_WORDS];
+	unsigned int pos;
+};
+
+static struct wldbg wldbg;
+static struct wldbg_connection connection;
+static struct wldbg_pass *resolve_pass;
+
+/* messages that create the objects used in the mix */
+static struct message_mix setup;
+/* the measured messages */
+static struct message_mix mix;
+
+static void
+begin(struct message_mix *m, int from, uint32_t id, uint32_t opcode)
+{
+	struct wldbg_message *msg = &m->messages[m->count];
+
+	assert(m->count < MAX_MESSAGES && m->pos + 2 <= MAX_WORDS);
+
+	msg->data = &m->words[m->pos];
+	msg->from = from;
+	msg->connection = &connection;
+
+	m->words[m->pos++] = id;
+	m->words[m->pos++] = opcode;
+}
+
+static void
+put(struct message_mix *m, uint32_t word)
+{
+	assert(m->pos < MAX_WORDS);
+	m->words[m->pos++] = word;
+}
+
+static void
+put_data(struct message_mix *m, const void *data, uint32_t size)
+{
+	uint32_t words = DIV_ROUNDUP(size, sizeof(uint32_t));
+
+	put(m, size);
+	assert(m->pos + words <= MAX_WORDS);
+
+	memset(&m->words[m->pos], 0, words * sizeof(uint32_t));
+	memcpy(&m->words[m->pos], data, size);
+	m->pos += words;
+}
+
+static void
+put_string(struct message_mix *m, const char *str)
+{
+	put_data(m, str, strlen(str) + 1);
+}
+
+static void
+end(struct message_mix *m)
+{
+	struct wldbg_message *msg = &m->messages[m->count++];
+	uint32_t *data = msg->data;
+
+	msg->size = (uint8_t *) &m->words[m->pos] - (uint8_t *) data;
+	data[1] |= msg->size << 16;
+}
+
+static void
+request(struct message_mix *m, uint32_t id, uint32_t opcode,
+	int n, const uint32_t *args)
+{
+	int i;
+
+	begin(m, CLIENT, id, opcode);
+	for (i = 0; i < n; ++i)
+		put(m, args[i]);
+	end(m);
+}
+
+static void
+event(struct message_mix *m, uint32_t id, uint32_t opcode,
+      int n, const uint32_t *args)
+{
+	int i;
+
+	begin(m, SERVER, id, opcode);
+	for (i = 0; i < n; ++i)
+		put(m, args[i]);
+	end(m);
+}
+
+#define REQUEST(m, id, opcode, ...)					\
+	do {								\
+		const uint32_t args[] = { __VA_ARGS__ };		\
+		request(m, id, opcode, ARRAY_LENGTH(args), args);	\
+	} while (0)
+
+#define EVENT(m, id, opcode, ...)					\
+	do {								\
+		const uint32_t args[] = { __VA_ARGS__ };		\
+		event(m, id, opcode, ARRAY_LENGTH(args), args);		\
+	} while (0)
+
+static void
+put_bind(struct message_mix *m, uint32_t name, const char *intf,
+     uint32_t version, uint32_t id)
+{
+	begin(m, CLIENT, REGISTRY_ID, WL_REGISTRY_BIND);
+	put(m, name);
+	put_string(m, intf);
+	put(m, version);
+	put(m, id);
+	end(m);
+}
+
+static void
+build_setup(struct message_mix *m)
+{
+	REQUEST(m, DISPLAY_ID, WL_DISPLAY_GET_REGISTRY, REGISTRY_ID);
+	put_bind(m, 1, "wl_compositor", 3, COMPOSITOR_ID);
+	put_bind(m, 2, "wl_shm", 1, SHM_ID);
+	put_bind(m, 3, "wl_seat", 5, SEAT_ID);
+	REQUEST(m, COMPOSITOR_ID, WL_COMPOSITOR_CREATE_SURFACE, SURFACE_ID);
+	REQUEST(m, SEAT_ID, WL_SEAT_GET_POINTER, POINTER_ID);
+	REQUEST(m, SEAT_ID, WL_SEAT_GET_KEYBOARD, KEYBOARD_ID);
+	/* the fd goes out of band */
+	REQUEST(m, SHM_ID, WL_SHM_CREATE_POOL, POOL_ID, 4 * 64 * 64);
+	REQUEST(m, POOL_ID, WL_SHM_POOL_CREATE_BUFFER,
+		BUFFER_ID, 0, 64, 64, 4 * 64, 0);
+	REQUEST(m, SURFACE_ID, WL_SURFACE_FRAME, CALLBACK_ID);
+}
+
+static void
+build_mix(struct message_mix *m)
+{
+	const uint32_t keys[] = { 30, 42 };
+	int i;
+
+	/* the last frame is done */
+	event(m, BUFFER_ID, WL_BUFFER_RELEASE, 0, NULL);
+	EVENT(m, CALLBACK_ID, WL_CALLBACK_DONE, 1000);
+	EVENT(m, DISPLAY_ID, WL_DISPLAY_DELETE_ID, CALLBACK_ID);
+
+	/* input */
+	begin(m, SERVER, KEYBOARD_ID, WL_KEYBOARD_ENTER);
+	put(m, 10);
+	put(m, SURFACE_ID);
+	put_data(m, keys, sizeof keys);
+	end(m);
+	EVENT(m, KEYBOARD_ID, WL_KEYBOARD_MODIFIERS, 11, 1, 0, 0, 0);
+	EVENT(m, KEYBOARD_ID, WL_KEYBOARD_KEY, 12, 1001, 30, 1);
+	EVENT(m, KEYBOARD_ID, WL_KEYBOARD_KEY, 13, 1002, 30, 0);
+	EVENT(m, POINTER_ID, WL_POINTER_ENTER, 14, SURFACE_ID, 10 << 8, 10 << 8);
+	event(m, POINTER_ID, WL_POINTER_FRAME, 0, NULL);
+	for (i = 0; i < 8; ++i) {
+		EVENT(m, POINTER_ID, WL_POINTER_MOTION,
+		      1003 + i, (11 + i) << 8, (10 + i) << 8);
+		event(m, POINTER_ID, WL_POINTER_FRAME, 0, NULL);
+	}
+	EVENT(m, POINTER_ID, WL_POINTER_BUTTON, 15, 1011, 0x110, 1);
+	event(m, POINTER_ID, WL_POINTER_FRAME, 0, NULL);
+
+	/* hotplugged output */
+	begin(m, SERVER, REGISTRY_ID, WL_REGISTRY_GLOBAL);
+	put(m, 4);
+	put_string(m, "wl_output");
+	put(m, 2);
+	end(m);
+	put_bind(m, 4, "wl_output", 2, OUTPUT_ID);
+
+	/* draw the next frame */
+	REQUEST(m, POOL_ID, WL_SHM_POOL_CREATE_BUFFER,
+		NEW_BUFFER_ID, 0, 64, 64, 4 * 64, 0);
+	REQUEST(m, SURFACE_ID, WL_SURFACE_ATTACH, BUFFER_ID, 0, 0);
+	REQUEST(m, SURFACE_ID, WL_SURFACE_DAMAGE, 0, 0, 64, 64);
+	REQUEST(m, SURFACE_ID, WL_SURFACE_FRAME, CALLBACK_ID);
+	request(m, SURFACE_ID, WL_SURFACE_COMMIT, 0, NULL);
+}
+
+static void
+run_resolve_pass(struct message_mix *m)
+{
+	unsigned int i;
+
+	for (i = 0; i < m->count; ++i) {
+		if (m->messages[i].from == SERVER)
+			resolve_pass->server_pass(NULL, &m->messages[i]);
+		else
+			resolve_pass->client_pass(NULL, &m->messages[i]);
+	}
+}
+
+static void
+init(void)
+{
+	struct pass *pass;
+	const struct wl_interface *intf;
+
+	if (resolve_pass)
+		return;
+
+#ifdef DEBUG
+	debug_init();
+#endif
+
+	wl_list_init(&wldbg.passes);
+	if (wldbg_add_resolve_pass(&wldbg) < 0) {
+		fprintf(stderr, "Failed adding resolve pass\n");
+		exit(EXIT_FAILURE);
+	}
+
+	pass = wl_container_of(wldbg.passes.next, pass, link);
+	resolve_pass = &pass->wldbg_pass;
+
+	connection.wldbg = &wldbg;
+	connection.resolved_objects = create_resolved_objects();
+	if (!connection.resolved_objects)
+		exit(EXIT_FAILURE);
+
+	build_setup(&setup);
+	build_mix(&mix);
+
+	/* create the objects, then run the mix once so that
+	 * it starts from the state it leaves behind */
+	run_resolve_pass(&setup);
+	run_resolve_pass(&mix);
+
+	/* sanity check, the numbers would be worthless
+	 * if the mix did not resolve */
+	intf = wldbg_message_get_object(&mix.messages[0], OUTPUT_ID);
+	if (!intf || strcmp(intf->name, "wl_output") != 0) {
+		fprintf(stderr, "Resolving the message mix failed, "
+				"is libwayland-client.so available?\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+BENCH(parse_message)
+{
+	struct wldbg_parsed_message pm;
+	uint64_t n;
+	unsigned int i;
+
+	init();
+
+	bench_start(run);
+	for (n = 0; n < run->iterations; ++n) {
+		for (i = 0; i < mix.count; ++i) {
+			wldbg_parse_message(&mix.messages[i], &pm);
+			bench_use(pm.size);
+		}
+	}
+	bench_stop(run, run->iterations * mix.count);
+}
+
+BENCH(resolve_message)
+{
+	struct wldbg_resolved_message rm;
+	uint64_t n;
+	unsigned int i;
+
+	init();
+
+	bench_start(run);
+	for (n = 0; n < run->iterations; ++n) {
+		for (i = 0; i < mix.count; ++i) {
+			wldbg_resolve_message(&mix.messages[i], &rm);
+			bench_use(rm.wl_message);
+		}
+	}
+	bench_stop(run, run->iterations * mix.count);
+}
+
+BENCH(resolve_arguments)
+{
+	struct wldbg_resolved_message rm;
+	struct wldbg_resolved_arg *arg;
+	uint64_t n;
+	unsigned int i;
+
+	init();
+
+	bench_start(run);
+	for (n = 0; n < run->iterations; ++n) {
+		for (i = 0; i < mix.count; ++i) {
+			if (!wldbg_resolve_message(&mix.messages[i], &rm))
+				continue;
+
+			while ((arg = wldbg_resolved_message_next_argument(&rm)))
+				bench_use(arg->data);
+		}
+	}
+	bench_stop(run, run->iterations * mix.count);
+}
+
+/* get_new_ids() is internal to the resolve pass,
+ * so measure it through the pass itself */
+BENCH(resolve_pass_new_ids)
+{
+	uint64_t n;
+
+	init();
+
+	bench_start(run);
+	for (n = 0; n < run->iterations; ++n)
+		run_resolve_pass(&mix);
+	bench_stop(run, run->iterations * mix.count);
+}
+
+/* one message is one operation here. Objects are
+ * created with the lowest free id, so the map grows
+ * by one id at a time */
+#define MAP_IDS 256
+
+BENCH(ids_map_insert)
+{
+	struct wldbg_ids_map map;
+	uint64_t n;
+	uint32_t id;
+
+	bench_start(run);
+	for (n = 0; n < run->iterations; ++n) {
+		wldbg_ids_map_init(&map);
+		for (id = 0; id < MAP_IDS; ++id)
+			wldbg_ids_map_insert(&map, id, &map);
+		bench_use(map.count);
+		wldbg_ids_map_release(&map);
+	}
+	bench_stop(run, run->iterations * MAP_IDS);
+}
+
+BENCH(ids_map_get)
+{
+	struct wldbg_ids_map map;
+	uint64_t n;
+	unsigned int i;
+	uint32_t id;
+
+	init();
+
+	wldbg_ids_map_init(&map);
+	for (id = 0; id < MAP_IDS; ++id)
+		wldbg_ids_map_insert(&map, id, &map);
+
+	bench_start(run);
+	for (n = 0; n < run->iterations; ++n) {
+		/* look up the ids the mix refers to */
+		for (i = 0; i < mix.count; ++i) {
+			id = ((uint32_t *) mix.messages[i].data)[0];
+			bench_use(wldbg_ids_map_get(&map, id));
+		}
+	}
+	bench_stop(run, run->iterations * mix.count);
+
+	wldbg_ids_map_release(&map);
+}
+
+BENCH(get_message_name)
+{
+	char buf[128];
+	uint64_t n;
+	unsigned int i;
+
+	init();
+
+	bench_start(run);
+	for (n = 0; n < run->iterations; ++n) {
+		for (i = 0; i < mix.count; ++i) {
+			wldbg_get_message_name(&mix.messages[i],
+					       buf, sizeof buf);
+			bench_use(buf[0]);
+		}
+	}
+	bench_stop(run, run->iterations * mix.count);
+}
+
+BENCH(message_print)
+{
+	uint64_t n;
+	unsigned int i;
+	int null_fd, stdout_fd;
+
+	init();
+
+	/* print into /dev/null. The runner made stdout fully
+	 * buffered, so this measures formatting, not writes */
+	fflush(stdout);
+	null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+	stdout_fd = dup(STDOUT_FILENO);
+	if (null_fd < 0 || stdout_fd < 0
+	    || dup2(null_fd, STDOUT_FILENO) < 0) {
+		perror("Redirecting stdout");
+		exit(EXIT_FAILURE);
+	}
+	close(null_fd);
+
+	bench_start(run);
+	for (n = 0; n < run->iterations; ++n) {
+		for (i = 0; i < mix.count; ++i) {
+			wldbg_message_print(&mix.messages[i]);
+			putchar('\n');
+		}
+	}
+	bench_stop(run, run->iterations * mix.count);
+
+	fflush(stdout);
+	dup2(stdout_fd, STDOUT_FILENO);
+	close(stdout_fd);
+}
@@ -0,0 +1,403 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <regex.h>
+
+#include "test-runner.h"
+#include "wldbg-private.h"
+#include "interactive/interactive.h"
+#include "interactive/condition.h"
+
+#ifdef DEBUG
+/* debug.c checks close() and friends, it needs to be set up */
+void
+debug_init(void);
+#endif
+
+/* the connection does not resolve objects,
+ * so the messages are named like unknown@5.1 */
+static struct wldbg_connection connection;
+
+static void
+init_wldbgi(struct wldbg_interactive *wldbgi)
+{
+#ifdef DEBUG
+	debug_init();
+#endif
+
+	memset(wldbgi, 0, sizeof *wldbgi);
+	wl_list_init(&wldbgi->filters);
+	wl_list_init(&wldbgi->breakpoints);
+	wl_list_init(&wldbgi->autocmds);
+	match_cache_init(&wldbgi->match_cache);
+}
+
+static void
+compile(regex_t *regex, const char *expr)
+{
+	assert(regcomp(regex, expr, REG_EXTENDED) == 0);
+}
+
+/* the same as the commands: a new rule is inserted after the first
+ * one of the list (or it is the first one). The bit of a rule is its
+ * position in the list, so the tests see the order that really runs */
+static struct filter *
+add_filter(struct wldbg_interactive *wldbgi, const char *expr,
+	   int show_only, const char *cond)
+{
+	struct filter *pf = calloc(1, sizeof *pf);
+
+	assert(pf);
+	pf->filter = strdup(expr);
+	assert(pf->filter);
+	compile(&pf->regex, expr);
+	pf->show_only = show_only;
+	if (cond) {
+		pf->condition = condition_compile(cond, NULL);
+		assert(pf->condition);
+		++wldbgi->conditional_filters;
+	}
+
+	wl_list_insert(wldbgi->filters.next, &pf->link);
+	match_cache_invalidate(&wldbgi->match_cache);
+
+	return pf;
+}
+
+static void
+remove_filter(struct wldbg_interactive *wldbgi, struct filter *pf)
+{
+	wl_list_remove(&pf->link);
+	if (pf->condition)
+		--wldbgi->conditional_filters;
+
+	regfree(&pf->regex);
+	condition_free(pf->condition);
+	free(pf->filter);
+	free(pf);
+	match_cache_invalidate(&wldbgi->match_cache);
+}
+
+static struct breakpoint *
+add_breakpoint(struct wldbg_interactive *wldbgi, const char *expr)
+{
+	struct breakpoint *b = calloc(1, sizeof *b);
+
+	assert(b);
+	b->name_regex = malloc(sizeof *b->name_regex);
+	assert(b->name_regex);
+	compile(b->name_regex, expr);
+
+	wl_list_insert(wldbgi->breakpoints.next, &b->link);
+	match_cache_invalidate(&wldbgi->match_cache);
+
+	return b;
+}
+
+static void
+remove_breakpoint(struct wldbg_interactive *wldbgi, struct breakpoint *b)
+{
+	wl_list_remove(&b->link);
+	regfree(b->name_regex);
+	free(b->name_regex);
+	free(b);
+	match_cache_invalidate(&wldbgi->match_cache);
+}
+
+static struct autocmd *
+add_autocmd(struct wldbg_interactive *wldbgi, const char *expr)
+{
+	struct autocmd *ac = calloc(1, sizeof *ac);
+
+	assert(ac);
+	compile(&ac->regex, expr);
+
+	wl_list_insert(wldbgi->autocmds.next, &ac->link);
+	match_cache_invalidate(&wldbgi->match_cache);
+
+	return ac;
+}
+
+static void
+release_wldbgi(struct wldbg_interactive *wldbgi)
+{
+	struct filter *pf, *pf_tmp;
+	struct breakpoint *b, *b_tmp;
+	struct autocmd *ac, *ac_tmp;
+
+	wl_list_for_each_safe(pf, pf_tmp, &wldbgi->filters, link)
+		remove_filter(wldbgi, pf);
+	wl_list_for_each_safe(b, b_tmp, &wldbgi->breakpoints, link)
+		remove_breakpoint(wldbgi, b);
+	wl_list_for_each_safe(ac, ac_tmp, &wldbgi->autocmds, link) {
+		wl_list_remove(&ac->link);
+		regfree(&ac->regex);
+		free(ac);
+	}
+
+	match_cache_release(&wldbgi->match_cache);
+}
+
+/* decision for a message with one argument */
+static struct match_decision *
+get(struct wldbg_interactive *wldbgi, uint32_t id, uint32_t opcode,
+    int from, uint32_t arg)
+{
+	uint32_t data[] = { id, (12 << 16) | opcode, arg };
+	struct wldbg_message message = {
+		.data = data,
+		.size = sizeof data,
+		.from = from,
+		.connection = &connection,
+	};
+	struct match_decision *d;
+
+	d = match_cache_get(wldbgi, &message);
+	assert(d);
+	assert(d->used);
+	assert(d->id == id && d->opcode == opcode && d->from == from);
+
+	return d;
+}
+
+static int
+skip(struct wldbg_interactive *wldbgi, uint32_t id, uint32_t opcode)
+{
+	uint32_t data[] = { id, (12 << 16) | opcode, 0 };
+	struct wldbg_message message = {
+		.data = data,
+		.size = sizeof data,
+		.from = CLIENT,
+		.connection = &connection,
+	};
+	struct match_decision *d;
+
+	d = match_cache_get(wldbgi, &message);
+	assert(d);
+
+	return match_cache_skip(wldbgi, d, &message);
+}
+
+TEST(match_cache_hits)
+{
+	struct wldbg_interactive wldbgi;
+	struct match_decision *d;
+
+	init_wldbgi(&wldbgi);
+	add_filter(&wldbgi, "^unknown@5\\.1$", 0, NULL);
+
+	d = get(&wldbgi, 5, 1, CLIENT, 0);
+	assert(d->skip);
+	assert(wldbgi.match_cache.misses == 1);
+
+	/* the arguments do not matter */
+	assert(get(&wldbgi, 5, 1, CLIENT, 7) == d);
+	assert(wldbgi.match_cache.hits == 1);
+
+	/* the side, the object and the opcode do. The name of a message
+	 * on an unknown object is the same for both sides */
+	assert(get(&wldbgi, 5, 1, SERVER, 0) != d);
+	assert(!get(&wldbgi, 6, 1, CLIENT, 0)->skip);
+	assert(!get(&wldbgi, 5, 2, CLIENT, 0)->skip);
+	assert(wldbgi.match_cache.misses == 4);
+	assert(wldbgi.match_cache.count == 4);
+
+	release_wldbgi(&wldbgi);
+}
+
+TEST(match_cache_grow)
+{
+	struct wldbg_interactive wldbgi;
+	struct match_cache *cache = &wldbgi.match_cache;
+	uint32_t id;
+
+	init_wldbgi(&wldbgi);
+	add_filter(&wldbgi, "\\.1$", 0, NULL);
+
+	/* the table keeps the load under 3/4 */
+	for (id = 1; id <= 192; ++id)
+		get(&wldbgi, id, id % 2, CLIENT, 0);
+	assert(cache->size == 256);
+	assert(cache->count == 192);
+
+	get(&wldbgi, 193, 1, CLIENT, 0);
+	assert(cache->size == 512);
+	assert(cache->count == 193);
+
+	/* the decisions were moved to the bigger table */
+	for (id = 1; id <= 193; ++id)
+		assert(get(&wldbgi, id, id % 2, CLIENT, 0)->skip == id % 2);
+	assert(cache->hits == 193);
+	assert(cache->misses == 193);
+	assert(cache->count == 193);
+
+	release_wldbgi(&wldbgi);
+}
+
+TEST(match_cache_max_size)
+{
+	struct wldbg_interactive wldbgi;
+	struct match_cache *cache = &wldbgi.match_cache;
+	uint32_t id, generation;
+
+	init_wldbgi(&wldbgi);
+	add_filter(&wldbgi, "@1\\.", 0, NULL);
+
+	for (id = 1; id <= MATCH_CACHE_MAX_SIZE / 4 * 3; ++id)
+		get(&wldbgi, id, 0, CLIENT, 0);
+	assert(cache->size == MATCH_CACHE_MAX_SIZE);
+	assert(cache->count == MATCH_CACHE_MAX_SIZE / 4 * 3);
+
+	/* the table does not grow anymore, it starts from scratch */
+	generation = cache->generation;
+	get(&wldbgi, id, 0, CLIENT, 0);
+	assert(cache->size == MATCH_CACHE_MAX_SIZE);
+	assert(cache->count == 1);
+	assert(cache->generation == generation + 1);
+
+	/* and the decisions are made again */
+	assert(get(&wldbgi, 1, 0, CLIENT, 0)->skip);
+	assert(!get(&wldbgi, 2, 0, CLIENT, 0)->skip);
+	assert(cache->count == 3);
+
+	release_wldbgi(&wldbgi);
+}
+
+TEST(match_cache_rule_added_removed)
+{
+	struct wldbg_interactive wldbgi;
+	struct match_decision *d;
+	struct filter *pf;
+	struct breakpoint *b;
+
+	init_wldbgi(&wldbgi);
+	add_filter(&wldbgi, "^unknown@9\\.", 0, NULL);
+
+	d = get(&wldbgi, 5, 1, CLIENT, 0);
+	assert(!d->skip && d->filters == 0 && d->breakpoints == 0);
+
+	/* the old decision is gone with a new rule... */
+	pf = add_filter(&wldbgi, "^unknown@5\\.", 0, NULL);
+	assert(!d->used);
+	assert(wldbgi.match_cache.count == 0);
+	d = get(&wldbgi, 5, 1, CLIENT, 0);
+	assert(d->skip && d->filters == 2);
+
+	b = add_breakpoint(&wldbgi, "\\.1$");
+	d = get(&wldbgi, 5, 1, CLIENT, 0);
+	assert(d->breakpoints == 1);
+
+	/* ...and when a rule is removed */
+	remove_filter(&wldbgi, pf);
+	d = get(&wldbgi, 5, 1, CLIENT, 0);
+	assert(!d->skip && d->filters == 0 && d->breakpoints == 1);
+
+	remove_breakpoint(&wldbgi, b);
+	d = get(&wldbgi, 5, 1, CLIENT, 0);
+	assert(d->breakpoints == 0);
+	assert(wldbgi.match_cache.misses == 5);
+
+	release_wldbgi(&wldbgi);
+}
+
+TEST(match_cache_autocmd_changes_rules)
+{
+	struct wldbg_interactive wldbgi;
+	struct match_decision *d;
+	uint32_t generation;
+
+	init_wldbgi(&wldbgi);
+	add_autocmd(&wldbgi, "^unknown@5\\.1$");
+
+	d = get(&wldbgi, 5, 1, CLIENT, 0);
+	assert(d->autocmds == 1);
+	assert(!d->skip);
+
+	/* what process_interactive() does with the decision: the command
+	 * of the autocmd ('hide unknown@5' here) adds a filter in the
+	 * middle of the message. The decision must not be used for the
+	 * rest of this message, the bump of the generation says so */
+	generation = wldbgi.match_cache.generation;
+	add_filter(&wldbgi, "unknown@5", 0, NULL);
+	assert(wldbgi.match_cache.generation != generation);
+	assert(!d->used);
+
+	/* the next message is decided with the new filter,
+	 * the autocmd still matches it */
+	d = get(&wldbgi, 5, 1, CLIENT, 0);
+	assert(d->skip);
+	assert(d->autocmds == 1);
+
+	/* new autocmds go after the first one,
+	 * the bits of the others move */
+	add_autocmd(&wldbgi, "unknown");
+	d = get(&wldbgi, 5, 1, CLIENT, 0);
+	assert(d->autocmds == 3);
+	add_autocmd(&wldbgi, "^unknown@6\\.");
+	d = get(&wldbgi, 5, 1, CLIENT, 0);
+	assert(d->autocmds == 5);
+	d = get(&wldbgi, 6, 1, CLIENT, 0);
+	assert(d->autocmds == 6);
+
+	release_wldbgi(&wldbgi);
+}
+
+TEST(match_cache_too_many_rules)
+{
+	struct wldbg_interactive wldbgi;
+	struct match_decision *d;
+	struct filter *last;
+	int i;
+
+	/* the filters without conditions decide as a whole,
+	 * the count does not matter for them. The second
+	 * filter added ends up the last one */
+	init_wldbgi(&wldbgi);
+	add_filter(&wldbgi, "^unknown@9\\.", 0, NULL);
+	last = add_filter(&wldbgi, "^unknown@5\\.", 0, NULL);
+	for (i = 1; i < MATCH_CACHE_MAX_RULES; ++i)
+		add_filter(&wldbgi, "^unknown@9\\.", 0, NULL);
+	assert(wldbgi.filters.prev == &last->link);
+
+	d = get(&wldbgi, 5, 1, CLIENT, 0);
+	assert(d->skip);
+	assert(d->filters == 0);
+	assert(!d->all_filters);
+	assert(skip(&wldbgi, 5, 1) == 1);
+	release_wldbgi(&wldbgi);
+
+	/* with conditions, the last filter has no bit,
+	 * the messages are matched without the decision */
+	init_wldbgi(&wldbgi);
+	add_filter(&wldbgi, "^unknown@9\\.", 0, NULL);
+	last = add_filter(&wldbgi, "^unknown@[56]\\.", 0, "id == 5");
+	for (i = 1; i < MATCH_CACHE_MAX_RULES; ++i)
+		add_filter(&wldbgi, "^unknown@9\\.", 0, NULL);
+	assert(wldbgi.filters.prev == &last->link);
+	assert(skip(&wldbgi, 5, 1) == -1);
+	assert(skip(&wldbgi, 6, 1) == -1);
+
+	/* up to the limit, the bits are enough */
+	last = wl_container_of(wldbgi.filters.next, last, link);
+	remove_filter(&wldbgi, last);
+	d = get(&wldbgi, 5, 1, CLIENT, 0);
+	assert(d->all_filters);
+	assert(d->filters == (uint64_t) 1 << (MATCH_CACHE_MAX_RULES - 1));
+	assert(skip(&wldbgi, 5, 1) == 1);
+	assert(skip(&wldbgi, 6, 1) == 0);
+
+	release_wldbgi(&wldbgi);
+
+	/* breakpoints and autocmds past the limit have no bit */
+	init_wldbgi(&wldbgi);
+	for (i = 0; i <= MATCH_CACHE_MAX_RULES; ++i) {
+		add_breakpoint(&wldbgi, "^unknown@5\\.");
+		add_autocmd(&wldbgi, "^unknown@5\\.");
+	}
+
+	d = get(&wldbgi, 5, 1, CLIENT, 0);
+	assert(d->breakpoints == ~(uint64_t) 0);
+	assert(d->autocmds == ~(uint64_t) 0);
+
+	release_wldbgi(&wldbgi);
+}
@@ -43,6 +43,55 @@ TEST(parse_base_message_fail)
 	assert(ret == 0 && "succeed parsing message");
 }
 
+struct messages_seen {
+	uint32_t ids[4];
+	size_t sizes[4];
+	int count;
+};
+
+static void
+see_message(struct wldbg_message *one, void *data)
+{
+	struct messages_seen *seen = data;
+
+	assert(seen->count < 4);
+	assert(one->from == CLIENT);
+	seen->ids[seen->count] = ((uint32_t *) one->data)[0];
+	seen->sizes[seen->count] = one->size;
+	++seen->count;
+}
+
+TEST(for_each_message_test)
+{
+	/* whole buffer: two messages and one that is cut off */
+	uint32_t data[] = { 1, 0x000c0000, 0xd00d,
+			    2, 0x00080001,
+			    3, 0x00100002, 0xdeed };
+	struct wldbg_message msg = {
+		.data = data,
+		.size = sizeof data,
+		.from = CLIENT,
+	};
+	struct messages_seen seen = { .count = 0 };
+
+	wldbg_for_each_message(&msg, see_message, &seen);
+	assert(seen.count == 2);
+	assert(seen.ids[0] == 1 && seen.sizes[0] == 12);
+	assert(seen.ids[1] == 2 && seen.sizes[1] == 8);
+
+	/* the header itself is not whole */
+	seen.count = 0;
+	msg.size = 4;
+	wldbg_for_each_message(&msg, see_message, &seen);
+	assert(seen.count == 0);
+
+	/* invalid size, do not loop forever */
+	data[1] = 0x00000000;
+	msg.size = sizeof data;
+	wldbg_for_each_message(&msg, see_message, &seen);
+	assert(seen.count == 0);
+}
+
 static const struct wl_message dummy_requests[] = {
 	{ "foo", "4i?o2ih", NULL },
 	{ "empty", "", NULL },
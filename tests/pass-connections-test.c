@@ -0,0 +1,132 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test-runner.h"
+#include "wldbg-private.h"
+#include "pass-connections.h"
+
+struct test_connection {
+	struct wldbg_pass_connection base;
+	int initialized;
+};
+
+static int released;
+
+static void
+init_connection(struct wldbg_pass_connection *base)
+{
+	struct test_connection *tc = (struct test_connection *) base;
+
+	tc->initialized = 1;
+}
+
+static void
+release_connection(struct wldbg_pass_connection *base)
+{
+	struct test_connection *tc = (struct test_connection *) base;
+
+	assert(tc->initialized);
+	++released;
+}
+
+static void
+init_wldbg(struct wldbg *wldbg)
+{
+	memset(wldbg, 0, sizeof *wldbg);
+	wl_list_init(&wldbg->close_callbacks);
+	released = 0;
+}
+
+static void
+init_connection_of(struct wldbg_connection *conn, struct wldbg *wldbg,
+		   unsigned int id)
+{
+	memset(conn, 0, sizeof *conn);
+	conn->wldbg = wldbg;
+	conn->id = id;
+	conn->client.pid = 100 + id;
+	conn->client.program = "client";
+}
+
+TEST(pass_connections_get)
+{
+	struct wldbg wldbg;
+	struct wldbg_connection conn;
+	struct wldbg_pass_connections pcs;
+	struct test_connection *tc;
+
+	init_wldbg(&wldbg);
+	assert(wldbg_pass_connections_init(&pcs, &wldbg,
+					   sizeof(struct test_connection),
+					   init_connection,
+					   release_connection) == 0);
+
+	init_connection_of(&conn, &wldbg, 3);
+	tc = wldbg_pass_connection_get(&pcs, &conn);
+	assert(tc && tc->initialized);
+	assert(tc->base.id == 3 && tc->base.pid == 103);
+	assert(strcmp(tc->base.program, "client") == 0);
+	assert(wldbg_pass_connection_get(&pcs, &conn) == tc);
+	assert(wl_list_length(&pcs.list) == 1);
+
+	/* closed connections are kept for the report */
+	wldbg_connection_closed(&conn);
+	assert(tc->base.closed);
+	assert(wl_list_length(&pcs.list) == 1);
+	assert(released == 0);
+
+	wldbg_pass_connections_release(&pcs);
+	assert(released == 1);
+	assert(wl_list_empty(&wldbg.close_callbacks));
+}
+
+TEST(pass_connections_closed_limit)
+{
+	struct wldbg wldbg;
+	struct wldbg_connection conn[WLDBG_PASS_CONNECTIONS_CLOSED + 3];
+	struct wldbg_pass_connections pcs;
+	struct wldbg_pass_connection *pc;
+	unsigned int i, n = WLDBG_PASS_CONNECTIONS_CLOSED + 3;
+
+	init_wldbg(&wldbg);
+	assert(wldbg_pass_connections_init(&pcs, &wldbg,
+					   sizeof(struct test_connection),
+					   init_connection,
+					   release_connection) == 0);
+
+	for (i = 0; i < n; ++i) {
+		init_connection_of(&conn[i], &wldbg, i + 1);
+		assert(wldbg_pass_connection_get(&pcs, &conn[i]));
+	}
+
+	/* the first one stays open, the rest closes
+	 * in the reverse order of creation */
+	for (i = n - 1; i > 0; --i)
+		wldbg_connection_closed(&conn[i]);
+
+	assert(released == n - 1 - WLDBG_PASS_CONNECTIONS_CLOSED);
+	assert(wl_list_length(&pcs.list) == WLDBG_PASS_CONNECTIONS_CLOSED + 1);
+
+	/* the ones that closed first are gone */
+	assert(wldbg_ids_map_get(&pcs.map, n) == NULL);
+	assert(wldbg_ids_map_get(&pcs.map, n - 1) == NULL);
+	assert(wldbg_ids_map_get(&pcs.map, 1));
+	assert(wldbg_ids_map_get(&pcs.map, 2));
+
+	/* the report still goes in the order of creation */
+	i = 0;
+	wl_list_for_each(pc, &pcs.list, link) {
+		assert(pc->id == i + 1);
+		assert(pc->closed == (i != 0));
+		++i;
+	}
+
+	/* closing a connection twice does not count */
+	wldbg_connection_closed(&conn[1]);
+	assert(released == n - 1 - WLDBG_PASS_CONNECTIONS_CLOSED);
+
+	wldbg_pass_connections_release(&pcs);
+	assert(released == n);
+	assert(wl_list_empty(&wldbg.close_callbacks));
+}
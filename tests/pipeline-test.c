@@ -0,0 +1,355 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "test-runner.h"
+#include "wldbg-private.h"
+#include "passes.h"
+#include "pipeline.h"
+#include "fuzz-pass.h"
+
+#ifdef DEBUG
+/* debug.c checks close() and friends, it needs to be set up */
+void
+debug_init(void);
+#endif
+
+/* passes.c and wldbg.c would bring all of wldbg with them,
+ * these are enough for the rules */
+
+void
+dealloc_pass(struct pass *pass)
+{
+	free(pass->name);
+	free(pass);
+}
+
+struct pass *
+alloc_pass(const char *name)
+{
+	struct pass *pass = calloc(1, sizeof *pass);
+
+	assert(pass);
+	pass->name = strdup(name);
+	assert(pass->name);
+
+	return pass;
+}
+
+/* any other pass is created without callbacks,
+ * 'fail' is a pass that fails to initialize */
+struct pass *
+create_pass_with_args(struct wldbg *wldbg, int argc, const char *argv[])
+{
+	struct pass *pass;
+
+	if (strcmp(argv[0], "fail") == 0)
+		return NULL;
+	else if (strcmp(argv[0], "fuzz") == 0)
+		pass = create_fuzz_pass();
+	else if (strcmp(argv[0], "fuzz-campaign") == 0)
+		pass = create_fuzz_campaign_pass();
+	else
+		return alloc_pass(argv[0]);
+
+	assert(pass);
+	if (pass->wldbg_pass.init(wldbg, &pass->wldbg_pass, argc, argv) != 0) {
+		dealloc_pass(pass);
+		return NULL;
+	}
+
+	return pass;
+}
+
+void
+destroy_pass(struct wldbg *wldbg, struct pass *pass)
+{
+	void *user_data = pass->wldbg_pass.user_data;
+
+	if (user_data) {
+		wldbg_remove_report_callbacks(wldbg, user_data);
+		wldbg_remove_exit_callbacks(wldbg, user_data);
+		wldbg_remove_close_callbacks(wldbg, user_data);
+	}
+
+	if (pass->wldbg_pass.destroy)
+		pass->wldbg_pass.destroy(user_data);
+
+	dealloc_pass(pass);
+}
+
+/* the fuzzer does not send anything without messages */
+int
+wldbg_connection_flush(struct wldbg_connection *conn,
+		       struct wl_connection *wl_conn)
+{
+	assert(0 && "not reached");
+	return -1;
+}
+
+struct wldbg_connection *
+wldbg_spawn_client(struct wldbg *wldbg)
+{
+	assert(0 && "not reached");
+	return NULL;
+}
+
+static void
+init_wldbg(struct wldbg *wldbg)
+{
+	memset(wldbg, 0, sizeof *wldbg);
+
+#ifdef DEBUG
+	debug_init();
+#endif
+
+	wldbg->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	assert(wldbg->epoll_fd >= 0);
+
+	wl_list_init(&wldbg->passes);
+	wl_list_init(&wldbg->monitored_fds);
+	wl_list_init(&wldbg->report_callbacks);
+	wl_list_init(&wldbg->exit_callbacks);
+	wl_list_init(&wldbg->close_callbacks);
+	wl_list_init(&wldbg->timers);
+	wl_list_init(&wldbg->pipeline_rules);
+	wl_list_init(&wldbg->connections);
+
+	/* passes remove their timers themselves then */
+	wldbg->flags.running = 1;
+}
+
+static void
+release_wldbg(struct wldbg *wldbg)
+{
+	wldbg_pipeline_rules_destroy(wldbg);
+
+	assert(wl_list_empty(&wldbg->timers));
+	assert(wl_list_empty(&wldbg->monitored_fds));
+	assert(wl_list_empty(&wldbg->report_callbacks));
+	assert(wl_list_empty(&wldbg->exit_callbacks));
+	assert(wl_list_empty(&wldbg->close_callbacks));
+
+	close(wldbg->epoll_fd);
+}
+
+static void
+init_connection(struct wldbg_connection *conn, struct wldbg *wldbg,
+		unsigned int id, char *program)
+{
+	memset(conn, 0, sizeof *conn);
+	conn->wldbg = wldbg;
+	conn->id = id;
+	conn->client.program = program;
+	wl_list_init(&conn->passes);
+}
+
+static void
+release_connection(struct wldbg_connection *conn)
+{
+	struct pass *pass, *tmp;
+
+	wl_list_for_each_safe(pass, tmp, &conn->passes, link) {
+		wl_list_remove(&pass->link);
+		destroy_pass(conn->wldbg, pass);
+	}
+}
+
+static const char *
+pass_name(struct wldbg_connection *conn, int n)
+{
+	struct pass *pass;
+
+	wl_list_for_each(pass, &conn->passes, link)
+		if (n-- == 0)
+			return pass->name;
+
+	return NULL;
+}
+
+static int
+need_objinfo(const char *rule)
+{
+	struct wldbg wldbg;
+	int ret;
+
+	init_wldbg(&wldbg);
+	wldbg.gathering_info = 1;
+	assert(wldbg_add_pipeline_rule(&wldbg, rule) == 0);
+	ret = wldbg_pipeline_rules_need_objinfo(&wldbg);
+	release_wldbg(&wldbg);
+
+	return ret;
+}
+
+TEST(pipeline_need_objinfo)
+{
+	assert(need_objinfo("*:resolve,objinfo"));
+	assert(need_objinfo("*:objinfo"));
+	assert(need_objinfo("*:resolve, objinfo ,stats"));
+	assert(need_objinfo("*:resolve,objinfo arg,stats"));
+	assert(need_objinfo("*:resolve,\tobjinfo\targ"));
+
+	/* only whole pass names count, not the arguments */
+	assert(!need_objinfo("*:resolve,objinfo2"));
+	assert(!need_objinfo("*:resolve,myobjinfo"));
+	assert(!need_objinfo("*:stats objinfo"));
+	assert(!need_objinfo("*:resolve,stats"));
+}
+
+TEST(pipeline_invalid_rules)
+{
+	struct wldbg wldbg;
+
+	init_wldbg(&wldbg);
+	assert(wldbg_add_pipeline_rule(&wldbg, "stats") == -1);
+	assert(wldbg_add_pipeline_rule(&wldbg, ":stats") == -1);
+	assert(wldbg_add_pipeline_rule(&wldbg, "*:") == -1);
+	assert(wl_list_empty(&wldbg.pipeline_rules));
+
+	/* objinfo can not start in the middle of the connections */
+	assert(wldbg_add_pipeline_rule(&wldbg, "*:objinfo") == -1);
+	wldbg.gathering_info = 1;
+	assert(wldbg_add_pipeline_rule(&wldbg, "*:objinfo") == 0);
+	release_wldbg(&wldbg);
+}
+
+TEST(pipeline_first_match)
+{
+	struct wldbg wldbg;
+	struct wldbg_connection conn;
+
+	init_wldbg(&wldbg);
+	assert(wldbg_add_pipeline_rule(&wldbg, "fire*:stats,trace file=x") == 0);
+	assert(wldbg_add_pipeline_rule(&wldbg, "firefox:latency") == 0);
+	assert(wldbg_add_pipeline_rule(&wldbg, "unknown:pacing") == 0);
+	assert(wldbg_add_pipeline_rule(&wldbg, "*:latency") == 0);
+
+	/* the second rule matches too, but the first one wins */
+	init_connection(&conn, &wldbg, 1, "firefox");
+	assert(wldbg_connection_apply_rules(&conn) == 0);
+	assert(conn.own_pipeline);
+	assert(wl_list_length(&conn.passes) == 2);
+	assert(strcmp(pass_name(&conn, 0), "stats") == 0);
+	assert(strcmp(pass_name(&conn, 1), "trace") == 0);
+	release_connection(&conn);
+
+	init_connection(&conn, &wldbg, 2, "weston");
+	assert(wldbg_connection_apply_rules(&conn) == 0);
+	assert(wl_list_length(&conn.passes) == 1);
+	assert(strcmp(pass_name(&conn, 0), "latency") == 0);
+	release_connection(&conn);
+
+	/* the program of the client is not known */
+	init_connection(&conn, &wldbg, 3, NULL);
+	assert(wldbg_connection_apply_rules(&conn) == 0);
+	assert(wl_list_length(&conn.passes) == 1);
+	assert(strcmp(pass_name(&conn, 0), "pacing") == 0);
+	release_connection(&conn);
+
+	release_wldbg(&wldbg);
+}
+
+TEST(pipeline_no_match)
+{
+	struct wldbg wldbg;
+	struct wldbg_connection conn;
+
+	init_wldbg(&wldbg);
+	assert(wldbg_add_pipeline_rule(&wldbg, "firefox:stats") == 0);
+
+	init_connection(&conn, &wldbg, 1, "weston");
+	assert(wldbg_connection_apply_rules(&conn) == 0);
+	assert(!conn.own_pipeline);
+	assert(wl_list_empty(&conn.passes));
+
+	release_wldbg(&wldbg);
+}
+
+TEST(pipeline_passthrough)
+{
+	struct wldbg wldbg;
+	struct wldbg_connection conn;
+
+	init_wldbg(&wldbg);
+	assert(wldbg_add_pipeline_rule(&wldbg, "*:passthrough") == 0);
+
+	/* its own pipeline without passes, not the shared passes */
+	init_connection(&conn, &wldbg, 1, "weston");
+	assert(wldbg_connection_apply_rules(&conn) == 0);
+	assert(conn.own_pipeline);
+	assert(wl_list_empty(&conn.passes));
+
+	release_wldbg(&wldbg);
+}
+
+TEST(pipeline_failed_pass)
+{
+	struct wldbg wldbg;
+	struct wldbg_connection conn;
+
+	init_wldbg(&wldbg);
+	assert(wldbg_add_pipeline_rule(&wldbg, "*:stats,fail,latency") == 0);
+
+	/* the passes created before are gone,
+	 * the connection uses the shared passes */
+	init_connection(&conn, &wldbg, 1, "weston");
+	assert(wldbg_connection_apply_rules(&conn) == -1);
+	assert(!conn.own_pipeline);
+	assert(wl_list_empty(&conn.passes));
+
+	/* resolve and objinfo are copied from the shared passes,
+	 * that are not running here */
+	wldbg_pipeline_rules_destroy(&wldbg);
+	assert(wldbg_add_pipeline_rule(&wldbg, "*:resolve,stats") == 0);
+	assert(wldbg_connection_apply_rules(&conn) == -1);
+	assert(!conn.own_pipeline);
+	assert(wl_list_empty(&conn.passes));
+
+	release_wldbg(&wldbg);
+}
+
+/* the fuzzer keeps its options in one place, every connection
+ * matching the rule must not get another instance of it */
+static void
+check_fuzz_once(const char *rule)
+{
+	struct wldbg wldbg;
+	struct wldbg_connection first, second;
+
+	init_wldbg(&wldbg);
+	assert(wldbg_add_pipeline_rule(&wldbg, rule) == 0);
+
+	init_connection(&first, &wldbg, 1, "a");
+	assert(wldbg_connection_apply_rules(&first) == 0);
+	assert(first.own_pipeline);
+	assert(wl_list_length(&first.passes) == 1);
+
+	/* the second one falls back to the shared passes */
+	init_connection(&second, &wldbg, 2, "b");
+	assert(wldbg_connection_apply_rules(&second) == -1);
+	assert(!second.own_pipeline);
+	assert(wl_list_empty(&second.passes));
+
+	/* once the first is gone, the fuzzer is free again */
+	release_connection(&first);
+	init_connection(&second, &wldbg, 2, "b");
+	assert(wldbg_connection_apply_rules(&second) == 0);
+	assert(second.own_pipeline);
+	assert(wl_list_length(&second.passes) == 1);
+	release_connection(&second);
+
+	release_wldbg(&wldbg);
+}
+
+TEST(pipeline_fuzz_loaded_once)
+{
+	check_fuzz_once("*:fuzz 5");
+}
+
+TEST(pipeline_fuzz_campaign_loaded_once)
+{
+	check_fuzz_once("*:fuzz-campaign jobs=1 crashes=/tmp 5");
+}
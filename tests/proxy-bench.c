@@ -0,0 +1,1629 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* End-to-end benchmark of the proxy. The benchmark is the compositor,
+ * a copy of itself (started with --client) is the client and the real
+ * wldbg binary sits between them. Both sides speak just enough
+ * of the wayland protocol to get the objects resolved and then flood
+ * the connection with messages of one profile. Every message carries
+ * the time when it was sent, so the receiver can count throughput
+ * and the latency. The 'direct' configuration runs the same traffic
+ * without wldbg and is the reference for the added latency. */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "wldbg-histogram.h"
+
+#define MAX_FDS			28
+#define MAX_CONNECTIONS		64
+#define MAX_CONFIGS		16
+#define BUFFER_SIZE		4096
+#define ARRAY_SIZE		2048
+#define SOCKET_NAME		"bench-0"
+/* name of the socket that wldbg in server mode renames ours to */
+#define WLDBG_SOCKET_NAME	"wldbg-wayland-0"
+
+/* ids of the objects created by the setup */
+#define REGISTRY_ID		2
+#define COMPOSITOR_ID		3
+#define SURFACE_ID		4
+#define SHM_ID			5
+#define SEAT_ID			6
+#define POINTER_ID		7
+#define KEYBOARD_ID		8
+#define SETUP_SYNC_ID		9
+#define PHASE_SYNC_ID		10
+#define FINAL_SYNC_ID		11
+#define FIRST_FREE_ID		12
+
+enum direction {
+	TO_SERVER,
+	TO_CLIENT,
+};
+
+struct profile {
+	const char *name;
+	const char *description;
+	enum direction direction;
+	int connections;
+
+	/* timestamped units in the throughput and latency phase */
+	unsigned int count;
+	unsigned int latency_count;
+
+	/* put one unit to buf, return its size
+	 * and set nfds to number of fds it carries */
+	size_t (*fill)(uint32_t *buf, uint64_t ts,
+		       unsigned int seq, int *nfds);
+	/* return 1 and set ts if the message is timestamped */
+	int (*timestamp)(const uint32_t *msg, uint64_t *ts);
+};
+
+struct config {
+	char name[32];
+	/* arguments of wldbg (options and passes), NULL for direct */
+	char *args;
+};
+
+struct peer {
+	int fd;
+	size_t len;
+	char buf[4 * BUFFER_SIZE];
+
+	unsigned int timestamped;
+	unsigned int expected;
+	int got_final_sync;
+};
+
+struct bench_result {
+	uint64_t messages;
+	uint64_t bytes;
+	uint64_t first_sent;
+	uint64_t last_received;
+	struct wldbg_histogram latency;
+};
+
+struct baseline {
+	char profile[32];
+	char config[32];
+	double msgs;
+	double mbs;
+	uint64_t p50;
+	uint64_t p99;
+};
+
+static struct {
+	const char *self;
+	const char *wldbg;
+	char tmpdir[64];
+	double scale;
+	double threshold;
+	int verbose;
+
+	struct config configs[MAX_CONFIGS];
+	int configs_num;
+
+	struct baseline *baseline;
+	int baseline_num;
+	FILE *save;
+
+	int regressions;
+} bench;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+sleep_ns(uint64_t ns)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ns / 1000000000ULL;
+	ts.tv_nsec = ns % 1000000000ULL;
+	while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+		;
+}
+
+static inline uint32_t
+header(uint32_t size, uint32_t opcode)
+{
+	return (size << 16) | opcode;
+}
+
+/*
+ * Profiles
+ */
+
+/* wl_pointer.motion(time, x, y) -- small fixed-size input events */
+static size_t
+fill_motion(uint32_t *buf, uint64_t ts, unsigned int seq, int *nfds)
+{
+	buf[0] = POINTER_ID;
+	buf[1] = header(20, 2);
+	buf[2] = seq;
+	buf[3] = (uint32_t) ts;
+	buf[4] = (uint32_t) (ts >> 32);
+
+	*nfds = 0;
+	return 20;
+}
+
+static int
+timestamp_motion(const uint32_t *msg, uint64_t *ts)
+{
+	if (msg[0] != POINTER_ID || (msg[1] & 0xffff) != 2)
+		return 0;
+
+	*ts = msg[3] | ((uint64_t) msg[4] << 32);
+	return 1;
+}
+
+/* wl_keyboard.enter(serial, surface, keys) with big keys array */
+static size_t
+fill_enter(uint32_t *buf, uint64_t ts, unsigned int seq, int *nfds)
+{
+	size_t size = 20 + ARRAY_SIZE;
+
+	buf[0] = KEYBOARD_ID;
+	buf[1] = header(size, 1);
+	buf[2] = seq;
+	buf[3] = SURFACE_ID;
+	buf[4] = ARRAY_SIZE;
+	memset(buf + 5, 0, ARRAY_SIZE);
+	buf[5] = (uint32_t) ts;
+	buf[6] = (uint32_t) (ts >> 32);
+
+	*nfds = 0;
+	return size;
+}
+
+static int
+timestamp_enter(const uint32_t *msg, uint64_t *ts)
+{
+	if (msg[0] != KEYBOARD_ID || (msg[1] & 0xffff) != 1)
+		return 0;
+
+	*ts = msg[5] | ((uint64_t) msg[6] << 32);
+	return 1;
+}
+
+/* wl_surface.damage(x, y, width, height) */
+static size_t
+fill_damage(uint32_t *buf, uint64_t ts, unsigned int seq, int *nfds)
+{
+	(void) seq;
+
+	buf[0] = SURFACE_ID;
+	buf[1] = header(24, 2);
+	buf[2] = (uint32_t) ts;
+	buf[3] = (uint32_t) (ts >> 32);
+	buf[4] = 1;
+	buf[5] = 1;
+
+	*nfds = 0;
+	return 24;
+}
+
+static int
+timestamp_damage(const uint32_t *msg, uint64_t *ts)
+{
+	if (msg[0] != SURFACE_ID || (msg[1] & 0xffff) != 2)
+		return 0;
+
+	*ts = msg[2] | ((uint64_t) msg[3] << 32);
+	return 1;
+}
+
+/* wl_shm.create_pool with fd, wl_shm_pool.create_buffer,
+ * wl_buffer.destroy and wl_shm_pool.destroy. The objects get new ids
+ * every time, the server does not send delete_id */
+static size_t
+fill_shm(uint32_t *buf, uint64_t ts, unsigned int seq, int *nfds)
+{
+	uint32_t pool = FIRST_FREE_ID + 2 * seq;
+	uint32_t buffer = pool + 1;
+
+	/* create_pool(new id, fd, size) */
+	buf[0] = SHM_ID;
+	buf[1] = header(16, 0);
+	buf[2] = pool;
+	buf[3] = 4096;
+	/* create_buffer(new id, offset, width, height, stride, format) */
+	buf[4] = pool;
+	buf[5] = header(32, 0);
+	buf[6] = buffer;
+	buf[7] = (uint32_t) ts;
+	buf[8] = (uint32_t) (ts >> 32);
+	buf[9] = 1;
+	buf[10] = 4;
+	buf[11] = 0;
+	/* wl_buffer.destroy */
+	buf[12] = buffer;
+	buf[13] = header(8, 0);
+	/* wl_shm_pool.destroy */
+	buf[14] = pool;
+	buf[15] = header(8, 1);
+
+	*nfds = 1;
+	return 64;
+}
+
+static int
+timestamp_shm(const uint32_t *msg, uint64_t *ts)
+{
+	if (msg[0] < FIRST_FREE_ID || msg[1] != header(32, 0))
+		return 0;
+
+	*ts = msg[3] | ((uint64_t) msg[4] << 32);
+	return 1;
+}
+
+static struct profile profiles[] = {
+	{ "small", "wl_pointer.motion events",
+	  TO_CLIENT, 1, 200000, 2000, fill_motion, timestamp_motion },
+	{ "array", "wl_keyboard.enter events with 2KB of keys",
+	  TO_CLIENT, 1, 20000, 2000, fill_enter, timestamp_enter },
+	{ "shm", "wl_shm pools and buffers, one fd per pool",
+	  TO_SERVER, 1, 20000, 2000, fill_shm, timestamp_shm },
+	{ "connections", "wl_surface.damage requests from 16 clients",
+	  TO_SERVER, 16, 200000, 2000, fill_damage, timestamp_damage },
+};
+
+#define PROFILES_NUM (sizeof profiles / sizeof profiles[0])
+
+static struct profile *
+get_profile(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < PROFILES_NUM; ++i)
+		if (strcmp(profiles[i].name, name) == 0)
+			return &profiles[i];
+
+	return NULL;
+}
+
+/*
+ * Sending and receiving messages
+ */
+
+static int
+send_all(int fd, const void *data, size_t size, const int *fds, int nfds)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char cmsgbuf[CMSG_SPACE(MAX_FDS * sizeof(int))];
+	ssize_t ret;
+
+	while (size > 0) {
+		memset(&msg, 0, sizeof msg);
+		iov.iov_base = (void *) data;
+		iov.iov_len = size;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+
+		if (nfds > 0) {
+			msg.msg_control = cmsgbuf;
+			msg.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+			cmsg = CMSG_FIRSTHDR(&msg);
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_RIGHTS;
+			cmsg->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+			memcpy(CMSG_DATA(cmsg), fds, nfds * sizeof(int));
+		}
+
+		ret = sendmsg(fd, &msg, MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("sendmsg");
+			return -1;
+		}
+
+		/* fds go with the first byte */
+		nfds = 0;
+		data = (const char *) data + ret;
+		size -= ret;
+	}
+
+	return 0;
+}
+
+/* read more data to the peer's buffer and close
+ * the file descriptors that came with it */
+static int
+peer_read(struct peer *peer)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char cmsgbuf[CMSG_SPACE(MAX_FDS * sizeof(int))];
+	int *fds;
+	size_t i, n;
+	ssize_t ret;
+
+	memset(&msg, 0, sizeof msg);
+	iov.iov_base = peer->buf + peer->len;
+	iov.iov_len = sizeof peer->buf - peer->len;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsgbuf;
+	msg.msg_controllen = sizeof cmsgbuf;
+
+	do {
+		ret = recvmsg(peer->fd, &msg, MSG_CMSG_CLOEXEC);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0) {
+		perror("recvmsg");
+		return -1;
+	}
+
+	if (ret == 0) {
+		fprintf(stderr, "Connection closed unexpectedly\n");
+		return -1;
+	}
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+	     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET
+		    || cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+
+		fds = (int *) CMSG_DATA(cmsg);
+		n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (i = 0; i < n; ++i)
+			close(fds[i]);
+	}
+
+	peer->len += ret;
+	return 0;
+}
+
+/* get the size of the next complete message in the buffer,
+ * 0 if there is not whole message yet, -1 on garbage */
+static int
+peer_message_size(struct peer *peer, size_t off)
+{
+	uint32_t *msg = (uint32_t *) (peer->buf + off);
+	uint32_t size;
+
+	if (peer->len - off < 8)
+		return 0;
+
+	size = msg[1] >> 16;
+	if (size < 8 || size % 4 != 0) {
+		fprintf(stderr, "Got invalid message (size %u)\n", size);
+		return -1;
+	}
+
+	if (peer->len - off < size)
+		return 0;
+
+	return size;
+}
+
+static void
+peer_consume(struct peer *peer, size_t off)
+{
+	memmove(peer->buf, peer->buf + off, peer->len - off);
+	peer->len -= off;
+}
+
+static int
+send_callback_done(int fd, uint32_t id)
+{
+	uint32_t msg[3] = { id, header(12, 0), 0 };
+
+	return send_all(fd, msg, sizeof msg, NULL, 0);
+}
+
+static int
+send_sync(int fd, uint32_t id)
+{
+	uint32_t msg[3] = { 1, header(12, 0), id };
+
+	return send_all(fd, msg, sizeof msg, NULL, 0);
+}
+
+static int
+is_sync(const uint32_t *msg, uint32_t id)
+{
+	return msg[0] == 1 && msg[1] == header(12, 0) && msg[2] == id;
+}
+
+/* read messages until there is the one that is wl_display.sync
+ * with id (when from client) or wl_callback.done on id (when from server) */
+static int
+peer_wait_for(struct peer *peer, uint32_t id, int from_client)
+{
+	uint32_t *msg;
+	size_t off;
+	int size;
+
+	while (1) {
+		off = 0;
+		while ((size = peer_message_size(peer, off)) > 0) {
+			msg = (uint32_t *) (peer->buf + off);
+			off += size;
+
+			if ((from_client && is_sync(msg, id))
+			    || (!from_client && msg[0] == id)) {
+				peer_consume(peer, off);
+				return 0;
+			}
+		}
+
+		if (size < 0)
+			return -1;
+
+		peer_consume(peer, off);
+		if (peer_read(peer) < 0)
+			return -1;
+	}
+}
+
+/* throughput -- send count units as fast as we can,
+ * in buffers of the size that libwayland uses */
+static int
+send_flood(int fd, const struct profile *p, unsigned int count, int shm_fd)
+{
+	uint32_t buf[(BUFFER_SIZE + 20 + ARRAY_SIZE) / 4];
+	int fds[MAX_FDS];
+	unsigned int seq;
+	size_t len = 0, size;
+	int nfds = 0, n, i;
+
+	for (seq = 0; seq < count; ++seq) {
+		size = p->fill(buf + len / 4, now_ns(), seq, &n);
+		if (len + size > BUFFER_SIZE || nfds + n > MAX_FDS) {
+			if (send_all(fd, buf, len, fds, nfds) < 0)
+				return -1;
+
+			memmove(buf, buf + len / 4, size);
+			len = nfds = 0;
+		}
+
+		len += size;
+		for (i = 0; i < n; ++i)
+			fds[nfds++] = shm_fd;
+	}
+
+	if (len > 0 && send_all(fd, buf, len, fds, nfds) < 0)
+		return -1;
+
+	return 0;
+}
+
+/* latency -- send one unit at a time with pauses, so that
+ * the messages do not queue. All clients together
+ * send at the same rate as one client alone */
+static int
+send_paced(int fd, const struct profile *p, unsigned int first,
+	   unsigned int latency_count, int shm_fd)
+{
+	uint32_t buf[(20 + ARRAY_SIZE) / 4];
+	int fds[MAX_FDS];
+	unsigned int seq;
+	size_t size;
+	int n, i;
+
+	for (i = 0; i < MAX_FDS; ++i)
+		fds[i] = shm_fd;
+
+	for (seq = first; seq < first + latency_count; ++seq) {
+		size = p->fill(buf, now_ns(), seq, &n);
+		if (send_all(fd, buf, size, fds, n) < 0)
+			return -1;
+
+		sleep_ns(20000 * p->connections);
+	}
+
+	return 0;
+}
+
+/* receive count + latency_count timestamped units from each peer.
+ * Between the throughput and latency phase, the queues must be empty:
+ * when the traffic goes to client, the client lets the server know
+ * that it got everything by wl_display.sync. When it goes to server,
+ * the server answers the clients' syncs when it has them all.
+ * The final sync tells the server that the client is done */
+static int
+receive_units(struct peer *peers, int peers_num, const struct profile *p,
+	      unsigned int count, unsigned int latency_count,
+	      struct bench_result *res)
+{
+	struct pollfd pfds[MAX_CONNECTIONS];
+	uint32_t *msg;
+	uint64_t ts, now;
+	size_t off;
+	int i, j, size, done = 0, phase_syncs = 0;
+
+	memset(res, 0, sizeof *res);
+	wldbg_histogram_init(&res->latency);
+	res->first_sent = UINT64_MAX;
+
+	for (i = 0; i < peers_num; ++i) {
+		peers[i].timestamped = 0;
+		peers[i].expected = count + latency_count;
+		peers[i].got_final_sync = p->direction == TO_CLIENT;
+	}
+
+	while (done < peers_num) {
+		for (i = 0; i < peers_num; ++i) {
+			/* do not poll the peers that are done */
+			if (peers[i].timestamped == peers[i].expected
+			    && peers[i].got_final_sync)
+				pfds[i].fd = -1;
+			else
+				pfds[i].fd = peers[i].fd;
+			pfds[i].events = POLLIN;
+			pfds[i].revents = 0;
+		}
+
+		if (poll(pfds, peers_num, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			return -1;
+		}
+
+		for (i = 0; i < peers_num; ++i) {
+			struct peer *peer = &peers[i];
+
+			if (pfds[i].fd < 0 || !pfds[i].revents)
+				continue;
+
+			if (peer_read(peer) < 0)
+				return -1;
+
+			now = now_ns();
+			off = 0;
+			while ((size = peer_message_size(peer, off)) > 0) {
+				msg = (uint32_t *) (peer->buf + off);
+				off += size;
+
+				if (is_sync(msg, FINAL_SYNC_ID)) {
+					peer->got_final_sync = 1;
+					if (send_callback_done(peer->fd,
+							FINAL_SYNC_ID) < 0)
+						return -1;
+					continue;
+				}
+
+				if (is_sync(msg, PHASE_SYNC_ID)) {
+					if (++phase_syncs < peers_num)
+						continue;
+
+					for (j = 0; j < peers_num; ++j)
+						if (send_callback_done(peers[j].fd,
+							PHASE_SYNC_ID) < 0)
+							return -1;
+					continue;
+				}
+
+				if (peer->timestamped < count) {
+					res->messages++;
+					res->bytes += size;
+				}
+
+				if (!p->timestamp(msg, &ts))
+					continue;
+
+				if (peer->timestamped < count) {
+					if (ts < res->first_sent)
+						res->first_sent = ts;
+					if (now > res->last_received)
+						res->last_received = now;
+				} else if (now > ts) {
+					wldbg_histogram_add(&res->latency,
+							    now - ts);
+				}
+
+				if (++peer->timestamped == count
+				    && p->direction == TO_CLIENT
+				    && send_sync(peer->fd, PHASE_SYNC_ID) < 0)
+					return -1;
+			}
+
+			if (size < 0)
+				return -1;
+
+			peer_consume(peer, off);
+
+			if (peer->timestamped == peer->expected
+			    && peer->got_final_sync)
+				++done;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * The client
+ */
+
+static size_t
+put_string(uint32_t *buf, const char *str)
+{
+	size_t len = strlen(str) + 1;
+
+	buf[0] = len;
+	memset(buf + 1, 0, (len + 3) & ~3);
+	memcpy(buf + 1, str, len);
+
+	return 1 + (len + 3) / 4;
+}
+
+static size_t
+put_bind(uint32_t *buf, uint32_t name, const char *intf,
+	 uint32_t version, uint32_t id)
+{
+	size_t n = 3;
+
+	n += put_string(buf + n, intf);
+	buf[n++] = version;
+	buf[n++] = id;
+
+	buf[0] = REGISTRY_ID;
+	buf[1] = header(n * 4, 0);
+	buf[2] = name;
+
+	return n;
+}
+
+static int
+client_setup(int fd)
+{
+	uint32_t buf[128];
+	size_t n = 0;
+
+	/* wl_display.get_registry */
+	buf[n++] = 1;
+	buf[n++] = header(12, 1);
+	buf[n++] = REGISTRY_ID;
+
+	n += put_bind(buf + n, 1, "wl_compositor", 4, COMPOSITOR_ID);
+
+	/* wl_compositor.create_surface */
+	buf[n++] = COMPOSITOR_ID;
+	buf[n++] = header(12, 0);
+	buf[n++] = SURFACE_ID;
+
+	n += put_bind(buf + n, 2, "wl_shm", 1, SHM_ID);
+	n += put_bind(buf + n, 3, "wl_seat", 4, SEAT_ID);
+
+	/* wl_seat.get_pointer and get_keyboard */
+	buf[n++] = SEAT_ID;
+	buf[n++] = header(12, 0);
+	buf[n++] = POINTER_ID;
+	buf[n++] = SEAT_ID;
+	buf[n++] = header(12, 1);
+	buf[n++] = KEYBOARD_ID;
+
+	/* wl_display.sync */
+	buf[n++] = 1;
+	buf[n++] = header(12, 0);
+	buf[n++] = SETUP_SYNC_ID;
+
+	return send_all(fd, buf, n * 4, NULL, 0);
+}
+
+static int
+connect_to_display(void)
+{
+	struct sockaddr_un addr;
+	const char *dir, *display, *env;
+	int fd, i;
+
+	env = getenv("WAYLAND_SOCKET");
+	if (env) {
+		fd = atoi(env);
+		unsetenv("WAYLAND_SOCKET");
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+		return fd;
+	}
+
+	dir = getenv("XDG_RUNTIME_DIR");
+	display = getenv("WAYLAND_DISPLAY");
+	if (!dir || !display)
+		return -1;
+
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof addr.sun_path, "%s/%s", dir, display);
+
+	/* wldbg in server mode may still be creating the socket */
+	for (i = 0; i < 500; ++i) {
+		fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd < 0)
+			return -1;
+
+		if (connect(fd, (struct sockaddr *) &addr, sizeof addr) == 0)
+			return fd;
+
+		close(fd);
+		sleep_ns(2000000);
+	}
+
+	perror("connect");
+	return -1;
+}
+
+static int
+run_client(int argc, char *argv[])
+{
+	struct profile *p;
+	struct peer *peer;
+	struct bench_result res;
+	unsigned int count, latency_count;
+	char path[] = "/tmp/wldbg-bench-shm-XXXXXX";
+	int shm_fd, ret = -1;
+	FILE *f;
+
+	if (argc != 5) {
+		fprintf(stderr, "Usage: --client PROFILE COUNT "
+				"LATENCY_COUNT RESULT_FILE\n");
+		return EXIT_FAILURE;
+	}
+
+	p = get_profile(argv[1]);
+	if (!p) {
+		fprintf(stderr, "Unknown profile '%s'\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	count = atoi(argv[2]);
+	latency_count = atoi(argv[3]);
+
+	peer = calloc(1, sizeof *peer);
+	if (!peer)
+		return EXIT_FAILURE;
+
+	peer->fd = connect_to_display();
+	if (peer->fd < 0) {
+		fprintf(stderr, "Failed connecting to display\n");
+		goto out;
+	}
+
+	if (client_setup(peer->fd) < 0
+	    || peer_wait_for(peer, SETUP_SYNC_ID, 0) < 0)
+		goto out;
+
+	if (p->direction == TO_SERVER) {
+		shm_fd = mkstemp(path);
+		if (shm_fd < 0) {
+			perror("mkstemp");
+			goto out;
+		}
+
+		unlink(path);
+		if (ftruncate(shm_fd, 4096) < 0)
+			perror("ftruncate");
+
+		if (send_flood(peer->fd, p, count, shm_fd) < 0
+		    || send_sync(peer->fd, PHASE_SYNC_ID) < 0
+		    || peer_wait_for(peer, PHASE_SYNC_ID, 0) < 0
+		    || send_paced(peer->fd, p, count, latency_count, shm_fd) < 0
+		    || send_sync(peer->fd, FINAL_SYNC_ID) < 0
+		    || peer_wait_for(peer, FINAL_SYNC_ID, 0) < 0) {
+			close(shm_fd);
+			goto out;
+		}
+
+		close(shm_fd);
+		ret = 0;
+		goto out;
+	}
+
+	if (receive_units(peer, 1, p, count, latency_count, &res) < 0)
+		goto out;
+
+	f = fopen(argv[4], "w");
+	if (!f) {
+		perror("Opening result file");
+		goto out;
+	}
+
+	if (fwrite(&res, sizeof res, 1, f) == 1)
+		ret = 0;
+	fclose(f);
+
+out:
+	if (peer->fd >= 0)
+		close(peer->fd);
+	free(peer);
+	return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * The server and the runs
+ */
+
+static void
+socket_path(char *buf, size_t size, const char *name)
+{
+	snprintf(buf, size, "%s/%s", bench.tmpdir, name);
+}
+
+static void
+cleanup_sockets(void)
+{
+	char path[128];
+
+	socket_path(path, sizeof path, SOCKET_NAME);
+	unlink(path);
+	socket_path(path, sizeof path, SOCKET_NAME ".lock");
+	unlink(path);
+	socket_path(path, sizeof path, WLDBG_SOCKET_NAME);
+	unlink(path);
+	socket_path(path, sizeof path, "result");
+	unlink(path);
+}
+
+static int
+create_listener(void)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	cleanup_sockets();
+
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	socket_path(addr.sun_path, sizeof addr.sun_path, SOCKET_NAME);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	if (bind(fd, (struct sockaddr *) &addr, sizeof addr) < 0
+	    || listen(fd, MAX_CONNECTIONS) < 0) {
+		perror("Creating listening socket");
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* accept connection from wldbg (or the client), give up
+ * when wldbg exits before connecting */
+static int
+accept_timeout(int fd, pid_t wldbg)
+{
+	struct pollfd pfd = { fd, POLLIN, 0 };
+	int i, ret, status;
+
+	for (i = 0; i < 100; ++i) {
+		ret = poll(&pfd, 1, 100);
+		if (ret > 0)
+			return accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+
+		if (ret < 0 && errno != EINTR)
+			break;
+
+		if (wldbg > 0 && waitpid(wldbg, &status, WNOHANG) == wldbg) {
+			fprintf(stderr, "wldbg exited\n");
+			return -1;
+		}
+	}
+
+	fprintf(stderr, "Client did not connect\n");
+	return -1;
+}
+
+/* split args by whitespace to argv, returns number of arguments */
+static int
+split_args(char *args, char **argv, int max)
+{
+	int argc = 0;
+	char *tok;
+
+	for (tok = strtok(args, " \t"); tok && argc < max;
+	     tok = strtok(NULL, " \t"))
+		argv[argc++] = tok;
+
+	return argc;
+}
+
+static void
+redirect_output(void)
+{
+	int fd;
+
+	if (bench.verbose)
+		return;
+
+	fd = open("/dev/null", O_RDWR);
+	if (fd < 0)
+		return;
+
+	dup2(fd, STDOUT_FILENO);
+	dup2(fd, STDERR_FILENO);
+	close(fd);
+}
+
+static pid_t
+spawn_client(const struct profile *p, unsigned int count,
+	     unsigned int latency_count, int socket_fd)
+{
+	char cnt[16], lcnt[16], sock[16], result[128];
+	pid_t pid;
+
+	snprintf(cnt, sizeof cnt, "%u", count);
+	snprintf(lcnt, sizeof lcnt, "%u", latency_count);
+	socket_path(result, sizeof result, "result");
+
+	pid = fork();
+	if (pid != 0)
+		return pid;
+
+	if (socket_fd >= 0) {
+		snprintf(sock, sizeof sock, "%d", socket_fd);
+		setenv("WAYLAND_SOCKET", sock, 1);
+	}
+
+	execl(bench.self, bench.self, "--client", p->name,
+	      cnt, lcnt, result, (char *) NULL);
+	perror("Executing client");
+	_exit(EXIT_FAILURE);
+}
+
+/* run wldbg with config in normal mode with one client
+ * or in server mode (script on stdin) for more clients */
+static pid_t
+spawn_wldbg(const struct profile *p, const struct config *conf,
+	    unsigned int count, unsigned int latency_count, int *script)
+{
+	char cnt[16], lcnt[16], result[128];
+	char *argv[64], *args;
+	int argc = 0, pipefd[2];
+	pid_t pid;
+
+	snprintf(cnt, sizeof cnt, "%u", count);
+	snprintf(lcnt, sizeof lcnt, "%u", latency_count);
+	socket_path(result, sizeof result, "result");
+
+	if (script && pipe(pipefd) < 0) {
+		perror("pipe");
+		return -1;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return -1;
+	}
+
+	if (pid > 0) {
+		if (script) {
+			close(pipefd[0]);
+			*script = pipefd[1];
+		}
+
+		return pid;
+	}
+
+	args = strdup(conf->args);
+	argv[argc++] = (char *) bench.wldbg;
+
+	if (script) {
+		/* server mode takes only options on the command
+		 * line, passes are added by the script */
+		argv[argc++] = "-s";
+		for (argv[argc] = strtok(args, " \t");
+		     argv[argc] && argv[argc][0] == '-';
+		     argv[argc] = strtok(NULL, " \t"))
+			++argc;
+		argv[argc] = NULL;
+
+		dup2(pipefd[0], STDIN_FILENO);
+		close(pipefd[0]);
+		close(pipefd[1]);
+	} else {
+		argc += split_args(args, argv + argc, 48);
+		argv[argc++] = "--";
+		argv[argc++] = (char *) bench.self;
+		argv[argc++] = "--client";
+		argv[argc++] = (char *) p->name;
+		argv[argc++] = cnt;
+		argv[argc++] = lcnt;
+		argv[argc++] = result;
+		argv[argc] = NULL;
+	}
+
+	redirect_output();
+
+	execvp(bench.wldbg, argv);
+	perror("Executing wldbg");
+	_exit(EXIT_FAILURE);
+}
+
+/* write the interactive commands that replace the printing pass
+ * with the passes from the config and let the clients go */
+static void
+write_script(int fd, const struct config *conf)
+{
+	char *args, *tok, *save;
+	FILE *f;
+
+	f = fdopen(fd, "w");
+	if (!f)
+		return;
+
+	fprintf(f, "pass remove dump\n");
+
+	args = strdup(conf->args);
+	tok = args;
+	/* skip the options */
+	while (*tok == '-' || *tok == ' ') {
+		while (*tok && *tok != ' ')
+			++tok;
+		while (*tok == ' ')
+			++tok;
+	}
+
+	for (tok = strtok_r(tok, ",", &save); tok;
+	     tok = strtok_r(NULL, ",", &save)) {
+		while (*tok == ' ')
+			++tok;
+		if (*tok)
+			fprintf(f, "pass add %s\n", tok);
+	}
+
+	fprintf(f, "continue\n");
+	free(args);
+	fclose(f);
+}
+
+static int
+wait_for_server_mode(pid_t pid)
+{
+	char path[128];
+	struct stat st;
+	int i, status;
+
+	socket_path(path, sizeof path, WLDBG_SOCKET_NAME);
+
+	for (i = 0; i < 1000; ++i) {
+		if (stat(path, &st) == 0)
+			return 0;
+
+		if (waitpid(pid, &status, WNOHANG) == pid) {
+			fprintf(stderr, "wldbg exited in server mode "
+					"(is the dump pass available?)\n");
+			return -1;
+		}
+
+		sleep_ns(5000000);
+	}
+
+	fprintf(stderr, "wldbg did not start the server mode\n");
+	return -1;
+}
+
+static int
+wait_for_child(pid_t pid)
+{
+	int status;
+
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR)
+			return -1;
+	}
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+static int
+read_result(struct bench_result *res)
+{
+	char path[128];
+	FILE *f;
+	int ret;
+
+	socket_path(path, sizeof path, "result");
+	f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "Client did not write the result\n");
+		return -1;
+	}
+
+	ret = fread(res, sizeof *res, 1, f) == 1 ? 0 : -1;
+	fclose(f);
+
+	return ret;
+}
+
+static int
+run(const struct profile *p, const struct config *conf,
+    struct bench_result *res)
+{
+	struct peer *peers;
+	/* processes that exit when the run is over */
+	pid_t pids[MAX_CONNECTIONS];
+	pid_t server_mode = 0, watched;
+	unsigned int count, latency_count;
+	int listen_fd, sv[2], script = -1;
+	int i, n = p->connections, ret = -1, pids_num = 0;
+
+	count = p->count * bench.scale / n;
+	latency_count = p->latency_count * bench.scale / n;
+	if (count == 0)
+		count = 1;
+	if (latency_count == 0)
+		latency_count = 1;
+
+	peers = calloc(n, sizeof *peers);
+	if (!peers)
+		return -1;
+
+	for (i = 0; i < n; ++i)
+		peers[i].fd = -1;
+
+	listen_fd = create_listener();
+	if (listen_fd < 0) {
+		free(peers);
+		return -1;
+	}
+
+	if (!conf->args && n == 1) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+			perror("socketpair");
+			goto out;
+		}
+
+		pids[0] = spawn_client(p, count, latency_count, sv[1]);
+		close(sv[1]);
+		peers[0].fd = sv[0];
+		if (pids[0] < 0)
+			goto out;
+		pids_num = 1;
+	} else if (n == 1) {
+		/* the client is the child of wldbg */
+		pids[0] = spawn_wldbg(p, conf, count, latency_count, NULL);
+		if (pids[0] < 0)
+			goto out;
+		pids_num = 1;
+	} else {
+		if (conf->args) {
+			server_mode = spawn_wldbg(p, conf, count,
+						  latency_count, &script);
+			if (server_mode < 0)
+				goto out;
+
+			write_script(script, conf);
+			if (wait_for_server_mode(server_mode) < 0) {
+				server_mode = 0;
+				goto out;
+			}
+		}
+
+		for (i = 0; i < n; ++i) {
+			pids[i] = spawn_client(p, count, latency_count, -1);
+			if (pids[i] < 0)
+				goto out;
+			++pids_num;
+		}
+	}
+
+	/* wldbg that we connect through, or the direct client */
+	watched = server_mode > 0 ? server_mode : pids[0];
+	for (i = 0; i < n; ++i) {
+		if (peers[i].fd < 0)
+			peers[i].fd = accept_timeout(listen_fd, watched);
+		if (peers[i].fd < 0)
+			goto out;
+
+		if (peer_wait_for(&peers[i], SETUP_SYNC_ID, 1) < 0)
+			goto out;
+	}
+
+	/* start all clients at once, when some of them would be
+	 * sending already, we would not read them while waiting
+	 * for the setup of the others */
+	for (i = 0; i < n; ++i)
+		if (send_callback_done(peers[i].fd, SETUP_SYNC_ID) < 0)
+			goto out;
+
+	if (p->direction == TO_SERVER) {
+		if (receive_units(peers, n, p, count, latency_count, res) < 0)
+			goto out;
+	} else if (send_flood(peers[0].fd, p, count, -1) < 0
+		   || peer_wait_for(&peers[0], PHASE_SYNC_ID, 1) < 0
+		   || send_callback_done(peers[0].fd, PHASE_SYNC_ID) < 0
+		   || send_paced(peers[0].fd, p, count, latency_count, -1) < 0) {
+		goto out;
+	}
+
+	/* keep our end open until the client is done,
+	 * so that wldbg does not see hang up before it forwarded
+	 * everything */
+	ret = 0;
+	for (i = 0; i < pids_num; ++i)
+		if (wait_for_child(pids[i]) < 0)
+			ret = -1;
+	pids_num = 0;
+
+out:
+	for (i = 0; i < pids_num; ++i) {
+		kill(pids[i], SIGTERM);
+		wait_for_child(pids[i]);
+	}
+
+	/* wldbg in server mode runs until we stop it */
+	if (server_mode > 0) {
+		kill(server_mode, SIGTERM);
+		wait_for_child(server_mode);
+	}
+
+	for (i = 0; i < n; ++i)
+		if (peers[i].fd >= 0)
+			close(peers[i].fd);
+	if (listen_fd >= 0)
+		close(listen_fd);
+
+	if (ret == 0 && p->direction == TO_CLIENT)
+		ret = read_result(res);
+
+	cleanup_sockets();
+	free(peers);
+	return ret;
+}
+
+/*
+ * Reporting
+ */
+
+static struct baseline *
+find_baseline(const char *profile, const char *config)
+{
+	int i;
+
+	for (i = 0; i < bench.baseline_num; ++i)
+		if (strcmp(bench.baseline[i].profile, profile) == 0
+		    && strcmp(bench.baseline[i].config, config) == 0)
+			return &bench.baseline[i];
+
+	return NULL;
+}
+
+static int
+load_baseline(const char *path)
+{
+	struct baseline b, *tmp;
+	char line[256];
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		printf("# no baseline in %s\n", path);
+		return 0;
+	}
+
+	while (fgets(line, sizeof line, f)) {
+		if (line[0] == '#')
+			continue;
+
+		if (sscanf(line, "%31s %31s %lf %lf %" SCNu64 " %" SCNu64,
+			   b.profile, b.config, &b.msgs, &b.mbs, &b.p50, &b.p99) != 6)
+			continue;
+
+		tmp = realloc(bench.baseline,
+			      (bench.baseline_num + 1) * sizeof b);
+		if (!tmp) {
+			fclose(f);
+			return -1;
+		}
+
+		bench.baseline = tmp;
+		bench.baseline[bench.baseline_num++] = b;
+	}
+
+	fclose(f);
+	return 0;
+}
+
+static double
+change(double now, double then)
+{
+	return then > 0 ? (now - then) * 100.0 / then : 0.0;
+}
+
+static void
+report(const struct profile *p, const struct config *conf,
+       const struct bench_result *res, const struct bench_result *direct)
+{
+	struct baseline *b;
+	double elapsed, msgs, mbs, dmsgs, dp99;
+	uint64_t p50, p99;
+
+	elapsed = res->last_received > res->first_sent ?
+		(res->last_received - res->first_sent) / 1e9 : 0.0;
+	msgs = elapsed > 0 ? res->messages / elapsed : 0.0;
+	mbs = elapsed > 0 ? res->bytes / elapsed / 1e6 : 0.0;
+	p50 = wldbg_histogram_percentile(&res->latency, 50);
+	p99 = wldbg_histogram_percentile(&res->latency, 99);
+
+	printf("%-12s %-10s %12.0f %9.2f %9" PRIu64 " %9" PRIu64,
+	       p->name, conf->name, msgs, mbs, p50, p99);
+
+	if (direct && conf->args)
+		printf(" %9" PRId64 " %9" PRId64, (int64_t) (p50
+		       - wldbg_histogram_percentile(&direct->latency, 50)),
+		       (int64_t) (p99
+		       - wldbg_histogram_percentile(&direct->latency, 99)));
+	else
+		printf(" %9s %9s", "-", "-");
+
+	b = find_baseline(p->name, conf->name);
+	if (b) {
+		dmsgs = change(msgs, b->msgs);
+		dp99 = change(p99, b->p99);
+		printf("  msgs/s %+.1f%% p99 %+.1f%%", dmsgs, dp99);
+
+		if (dmsgs < -bench.threshold || dp99 > bench.threshold) {
+			printf(" REGRESSION");
+			++bench.regressions;
+		}
+	}
+
+	putchar('\n');
+	fflush(stdout);
+
+	if (bench.save)
+		fprintf(bench.save, "%s %s %.0f %.2f %" PRIu64 " %" PRIu64 "\n",
+			p->name, conf->name, msgs, mbs, p50, p99);
+}
+
+static int
+add_config(const char *spec)
+{
+	struct config *conf;
+	const char *colon;
+	size_t len;
+
+	if (bench.configs_num == MAX_CONFIGS) {
+		fprintf(stderr, "Too many configurations\n");
+		return -1;
+	}
+
+	conf = &bench.configs[bench.configs_num];
+	colon = strchr(spec, ':');
+	len = colon ? (size_t) (colon - spec) : strlen(spec);
+	if (len == 0 || len >= sizeof conf->name) {
+		fprintf(stderr, "Invalid configuration name: '%s'\n", spec);
+		return -1;
+	}
+
+	memcpy(conf->name, spec, len);
+	conf->name[len] = '\0';
+
+	/* 'direct' is without wldbg, otherwise the default
+	 * arguments are the name of the pass */
+	if (strcmp(conf->name, "direct") == 0)
+		conf->args = NULL;
+	else
+		conf->args = strdup(colon ? colon + 1 : conf->name);
+
+	++bench.configs_num;
+	return 0;
+}
+
+/* return the value if arg is --option=value */
+static const char *
+option_value(const char *arg, const char *option)
+{
+	size_t len = strlen(option);
+
+	if (strncmp(arg, option, len) != 0)
+		return NULL;
+
+	return arg + len;
+}
+
+static void
+usage(const char *name)
+{
+	unsigned int i;
+
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\n", name);
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "\t--wldbg=PATH\t\tpath to wldbg binary\n");
+	fprintf(stderr, "\t--profile=NAME\t\trun only this profile "
+			"(can be repeated)\n");
+	fprintf(stderr, "\t--config=NAME[:ARGS]\trun wldbg with ARGS "
+			"(options and passes), can be repeated.\n"
+			"\t\t\t\t'direct' is without wldbg\n");
+	fprintf(stderr, "\t--scale=N\t\tmultiply the number of messages\n");
+	fprintf(stderr, "\t--baseline=FILE\t\tcompare with results in FILE\n");
+	fprintf(stderr, "\t--save=FILE\t\tsave results to FILE\n");
+	fprintf(stderr, "\t--threshold=PCT\t\treport regressions "
+			"bigger than PCT (default 10)\n");
+	fprintf(stderr, "\t--verbose\t\tshow the output of wldbg\n");
+	fprintf(stderr, "\nProfiles:\n");
+	for (i = 0; i < PROFILES_NUM; ++i)
+		fprintf(stderr, "\t%-12s %s\n", profiles[i].name,
+			profiles[i].description);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static char self[4096];
+	const char *selected[PROFILES_NUM];
+	struct bench_result res, direct;
+	unsigned int i, selected_num = 0;
+	const char *arg;
+	int c, j, k, have_direct;
+	ssize_t len;
+
+	if (argc > 1 && strcmp(argv[1], "--client") == 0)
+		return run_client(argc - 1, argv + 1);
+
+	bench.wldbg = "wldbg";
+	bench.scale = 1.0;
+	bench.threshold = 10.0;
+
+	for (c = 1; c < argc; ++c) {
+		if ((arg = option_value(argv[c], "--wldbg="))) {
+			bench.wldbg = arg;
+		} else if ((arg = option_value(argv[c], "--profile="))) {
+			if (!get_profile(arg)) {
+				fprintf(stderr, "Unknown profile '%s'\n", arg);
+				return EXIT_FAILURE;
+			}
+			if (selected_num < PROFILES_NUM)
+				selected[selected_num++] = arg;
+		} else if ((arg = option_value(argv[c], "--config="))) {
+			if (add_config(arg) < 0)
+				return EXIT_FAILURE;
+		} else if ((arg = option_value(argv[c], "--scale="))) {
+			bench.scale = atof(arg);
+		} else if ((arg = option_value(argv[c], "--baseline="))) {
+			if (load_baseline(arg) < 0)
+				return EXIT_FAILURE;
+		} else if ((arg = option_value(argv[c], "--save="))) {
+			bench.save = fopen(arg, "w");
+			if (!bench.save) {
+				perror("Opening file for results");
+				return EXIT_FAILURE;
+			}
+		} else if ((arg = option_value(argv[c], "--threshold="))) {
+			bench.threshold = atof(arg);
+		} else if (strcmp(argv[c], "--verbose") == 0) {
+			bench.verbose = 1;
+		} else {
+			usage(argv[0]);
+			return strcmp(argv[c], "--help") == 0 ?
+				EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (bench.scale <= 0) {
+		fprintf(stderr, "Invalid scale\n");
+		return EXIT_FAILURE;
+	}
+
+	if (bench.configs_num == 0) {
+		add_config("direct");
+		add_config("stats");
+		add_config("objinfo:-g stats");
+		add_config("latency");
+	}
+
+	/* the client is this binary, wldbg has to find it
+	 * wherever the working directory is */
+	len = readlink("/proc/self/exe", self, sizeof self - 1);
+	if (len < 0) {
+		perror("Finding own binary");
+		return EXIT_FAILURE;
+	}
+	self[len] = '\0';
+	bench.self = self;
+
+	strcpy(bench.tmpdir, "/tmp/wldbg-bench-XXXXXX");
+	if (!mkdtemp(bench.tmpdir)) {
+		perror("Creating temporary directory");
+		return EXIT_FAILURE;
+	}
+
+	setenv("XDG_RUNTIME_DIR", bench.tmpdir, 1);
+	setenv("WAYLAND_DISPLAY", SOCKET_NAME, 1);
+	signal(SIGPIPE, SIG_IGN);
+
+	printf("# %-10s %-10s %12s %9s %9s %9s %9s %9s\n", "profile",
+	       "config", "msgs/s", "MB/s", "p50(ns)", "p99(ns)",
+	       "+p50(ns)", "+p99(ns)");
+	if (bench.save)
+		fprintf(bench.save, "# profile config msgs/s MB/s "
+				    "p50(ns) p99(ns)\n");
+
+	for (i = 0; i < PROFILES_NUM; ++i) {
+		if (selected_num > 0) {
+			for (k = 0; k < (int) selected_num; ++k)
+				if (strcmp(selected[k], profiles[i].name) == 0)
+					break;
+			if (k == (int) selected_num)
+				continue;
+		}
+
+		have_direct = 0;
+		for (j = 0; j < bench.configs_num; ++j) {
+			if (run(&profiles[i], &bench.configs[j], &res) < 0) {
+				printf("%-12s %-10s failed\n", profiles[i].name,
+				       bench.configs[j].name);
+				continue;
+			}
+
+			if (!bench.configs[j].args) {
+				direct = res;
+				have_direct = 1;
+			}
+
+			report(&profiles[i], &bench.configs[j], &res,
+			       have_direct ? &direct : NULL);
+		}
+	}
+
+	if (bench.save)
+		fclose(bench.save);
+	rmdir(bench.tmpdir);
+	free(bench.baseline);
+
+	if (bench.regressions > 0)
+		printf("# %d regressions against the baseline\n",
+		       bench.regressions);
+
+	return EXIT_SUCCESS;
+}
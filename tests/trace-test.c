@@ -0,0 +1,157 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test-runner.h"
+#include "wldbg.h"
+#include "trace.h"
+
+static const struct trace_message messages[] = {
+	{ 1000, 1, CLIENT, "wl_display", 1, "sync", 3, 3 },
+	{ 2500, 1, SERVER, "wl_callback", 3, "done", 42, 42 },
+	{ 4000, 2, CLIENT, "wl_surface", 7, "frame", 9, 9 },
+};
+
+/* write a short capture like the trace pass does */
+static char *
+write_capture(size_t *size)
+{
+	char *buf = NULL;
+	FILE *out;
+	unsigned int i;
+
+	out = open_memstream(&buf, size);
+	assert(out);
+
+	fputs(TRACE_CAPTURE_HEADER, out);
+	trace_capture_connection(out, 1, 100, "weston-terminal");
+	/* the program must not break the format */
+	trace_capture_connection(out, 2, 200, "my\tprogram\n");
+	for (i = 0; i < sizeof messages / sizeof messages[0]; ++i)
+		trace_capture_message(out, &messages[i]);
+
+	fclose(out);
+	return buf;
+}
+
+static void
+check_message(const struct trace_message *msg,
+	      const struct trace_message *expected)
+{
+	assert(msg->time == expected->time);
+	assert(msg->connection == expected->connection);
+	assert(msg->from == expected->from);
+	assert(strcmp(msg->interface, expected->interface) == 0);
+	assert(msg->id == expected->id);
+	assert(strcmp(msg->name, expected->name) == 0);
+	assert(msg->first_arg == expected->first_arg);
+	assert(msg->last_arg == expected->last_arg);
+}
+
+TEST(trace_capture_parse_short)
+{
+	struct trace_message msg;
+	const char *program;
+	uint32_t connection;
+	int pid, m = 0, c = 0;
+	char *buf, *line = NULL;
+	size_t size, len = 0;
+	FILE *in;
+
+	buf = write_capture(&size);
+	in = fmemopen(buf, size, "r");
+	assert(in);
+
+	while (getline(&line, &len, in) >= 0) {
+		switch (trace_capture_parse(line, &msg, &connection,
+					    &pid, &program)) {
+		case 'c':
+			if (c++ == 0) {
+				assert(connection == 1 && pid == 100);
+				assert(strcmp(program, "weston-terminal") == 0);
+			} else {
+				assert(connection == 2 && pid == 200);
+				assert(strcmp(program, "my program ") == 0);
+			}
+			break;
+		case 'm':
+			assert(m < 3);
+			check_message(&msg, &messages[m++]);
+			break;
+		case 0:
+			/* only the header is skipped */
+			assert(c == 0 && m == 0);
+			break;
+		default:
+			assert(0 && "malformed line");
+		}
+	}
+
+	assert(c == 2);
+	assert(m == 3);
+
+	free(line);
+	fclose(in);
+	free(buf);
+}
+
+TEST(trace_capture_parse_truncated)
+{
+	const char *record = "m\t1000\t1\tC\twl_display\t1\tsync\t3\t3\n";
+	struct trace_message msg;
+	const char *program;
+	uint32_t connection;
+	int pid;
+	char *buf;
+	size_t size, last;
+
+	/* the pass was killed in the middle of the last record,
+	 * it has lost the last argument and the newline */
+	buf = write_capture(&size);
+	last = size - 1;
+	while (buf[last - 1] != '\n')
+		--last;
+	assert(strcmp(buf + size - 3, "\t9\n") == 0);
+	buf[size - 3] = '\0';
+	assert(trace_capture_parse(buf + last, &msg, &connection,
+				   &pid, &program) == -1);
+	free(buf);
+
+	/* every cut that loses a field is refused */
+	for (size = 1; size < strlen(record); ++size) {
+		if (record[size] != '\t')
+			continue;
+
+		buf = strndup(record, size);
+		assert(buf);
+		assert(trace_capture_parse(buf, &msg, &connection,
+					   &pid, &program) == -1);
+		free(buf);
+	}
+
+	buf = strdup("c\t1\t100\n");
+	assert(buf);
+	assert(trace_capture_parse(buf, &msg, &connection,
+				   &pid, &program) == -1);
+	free(buf);
+}
+
+TEST(trace_capture_parse_skipped)
+{
+	struct trace_message msg;
+	const char *program;
+	uint32_t connection;
+	int pid;
+	char line[32];
+
+	strcpy(line, "\n");
+	assert(trace_capture_parse(line, &msg, &connection,
+				   &pid, &program) == 0);
+	strcpy(line, "# a comment\n");
+	assert(trace_capture_parse(line, &msg, &connection,
+				   &pid, &program) == 0);
+	strcpy(line, "x\t1\t2\t3\n");
+	assert(trace_capture_parse(line, &msg, &connection,
+				   &pid, &program) == -1);
+}
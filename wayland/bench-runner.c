@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* runner for micro-benchmarks, the counterpart of test-runner.c.
+ * Every benchmark is warmed up, calibrated to run for about
+ * --time milliseconds and then measured --repeat times. Results
+ * (median and minimum per message) are printed to stdout
+ * as tab-separated values, one line per benchmark. The output
+ * can be saved with --save and compared with --baseline */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sched.h>
+#include <time.h>
+#include <errno.h>
+
+#include "bench-runner.h"
+
+extern const struct bench __start_bench_section, __stop_bench_section;
+
+#define MAX_REPEAT 101
+
+static unsigned int repeat = 7;
+static uint64_t run_time_ns = 200 * 1000000ULL;
+static uint64_t warmup_ns = 100 * 1000000ULL;
+
+struct baseline {
+	char name[64];
+	double ns;
+};
+
+static struct baseline *baseline;
+static int baseline_num;
+static int have_baseline;
+static double threshold = 10.0;
+static int regressions;
+static FILE *save;
+
+static uint64_t
+get_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* time stamp counter ticks with constant rate on current x86
+ * cpus, so it is rather reference cycles than core cycles.
+ * Still good enough to compare runs on the same machine */
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_CYCLES 1
+
+static inline uint64_t
+get_cycles(void)
+{
+	uint32_t lo, hi;
+
+	__asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+#else
+#define HAVE_CYCLES 0
+
+static inline uint64_t
+get_cycles(void)
+{
+	return 0;
+}
+#endif
+
+void
+bench_start(struct bench_run *run)
+{
+	run->start_ns = get_ns();
+	run->start_cycles = get_cycles();
+}
+
+void
+bench_stop(struct bench_run *run, uint64_t messages)
+{
+	run->cycles = get_cycles() - run->start_cycles;
+	run->ns = get_ns() - run->start_ns;
+	run->messages = messages;
+}
+
+static void
+run_once(const struct bench *b, uint64_t iterations, struct bench_run *run)
+{
+	memset(run, 0, sizeof *run);
+	run->iterations = iterations;
+
+	b->run(run);
+
+	if (run->messages == 0) {
+		fprintf(stderr, "Benchmark '%s' did not call bench_stop()\n",
+			b->name);
+		abort();
+	}
+}
+
+/* find the number of iterations that takes about run_time_ns,
+ * this also warms up caches and branch predictors */
+static uint64_t
+calibrate(const struct bench *b)
+{
+	struct bench_run run;
+	uint64_t iterations = 1, start = get_ns();
+
+	while (1) {
+		run_once(b, iterations, &run);
+
+		if (run.ns >= run_time_ns / 10
+		    && get_ns() - start >= warmup_ns)
+			break;
+
+		if (run.ns < run_time_ns / 10)
+			iterations *= 2;
+	}
+
+	iterations = iterations * run_time_ns / (run.ns ? run.ns : 1);
+	return iterations ? iterations : 1;
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+static struct baseline *
+find_baseline(const char *name)
+{
+	int i;
+
+	for (i = 0; i < baseline_num; ++i)
+		if (strcmp(baseline[i].name, name) == 0)
+			return &baseline[i];
+
+	return NULL;
+}
+
+static int
+load_baseline(const char *path)
+{
+	struct baseline b, *tmp;
+	char line[256];
+	FILE *f;
+
+	have_baseline = 1;
+
+	f = fopen(path, "r");
+	if (!f) {
+		printf("# no baseline in %s\n", path);
+		return 0;
+	}
+
+	while (fgets(line, sizeof line, f)) {
+		if (line[0] == '#')
+			continue;
+
+		if (sscanf(line, "%63s %*s %*s %lf", b.name, &b.ns) != 2)
+			continue;
+
+		tmp = realloc(baseline, (baseline_num + 1) * sizeof b);
+		if (!tmp) {
+			fclose(f);
+			return -1;
+		}
+
+		baseline = tmp;
+		baseline[baseline_num++] = b;
+	}
+
+	fclose(f);
+	return 0;
+}
+
+static void
+report(const struct bench *b, uint64_t iterations, uint64_t messages,
+       double ns, double min_ns, double cycles)
+{
+	struct baseline *base;
+	char line[256], cycles_str[32];
+	double change;
+
+	if (HAVE_CYCLES)
+		snprintf(cycles_str, sizeof cycles_str, "%.1f", cycles);
+	else
+		snprintf(cycles_str, sizeof cycles_str, "-");
+
+	snprintf(line, sizeof line,
+		 "%s\t%" PRIu64 "\t%" PRIu64 "\t%.2f\t%.2f\t%s",
+		 b->name, iterations, messages, ns, min_ns, cycles_str);
+
+	printf("%s", line);
+	if (save)
+		fprintf(save, "%s\n", line);
+
+	base = find_baseline(b->name);
+	if (base && base->ns > 0) {
+		change = (ns - base->ns) * 100.0 / base->ns;
+		printf("\t%+.1f%%", change);
+
+		if (change > threshold) {
+			printf(" REGRESSION");
+			++regressions;
+		}
+	} else if (have_baseline) {
+		printf("\t-");
+	}
+
+	putchar('\n');
+
+	/* stdout is fully buffered, but we want to see the progress */
+	fflush(stdout);
+}
+
+static void
+run_bench(const struct bench *b)
+{
+	struct bench_run run;
+	double ns[MAX_REPEAT], cycles[MAX_REPEAT];
+	uint64_t iterations;
+	unsigned int i;
+
+	iterations = calibrate(b);
+
+	for (i = 0; i < repeat; ++i) {
+		run_once(b, iterations, &run);
+		ns[i] = (double) run.ns / run.messages;
+		cycles[i] = (double) run.cycles / run.messages;
+	}
+
+	qsort(ns, repeat, sizeof ns[0], cmp_double);
+	qsort(cycles, repeat, sizeof cycles[0], cmp_double);
+
+	report(b, iterations, run.messages,
+	       ns[repeat / 2], ns[0], cycles[repeat / 2]);
+}
+
+static const struct bench *
+find_bench(const char *name)
+{
+	const struct bench *b;
+
+	for (b = &__start_bench_section; b < &__stop_bench_section; b++)
+		if (strcmp(b->name, name) == 0)
+			return b;
+
+	return NULL;
+}
+
+static void
+usage(const char *name, int status)
+{
+	const struct bench *b;
+
+	fprintf(stderr, "Usage: %s [OPTIONS] [BENCHMARK...]\n\n"
+		"With no arguments, run all benchmarks.\n\n"
+		"  --repeat=N   measure every benchmark N times (default %u)\n"
+		"  --time=MS    duration of one measured run (default %" PRIu64 ")\n"
+		"  --warmup=MS  minimal warmup time (default %" PRIu64 ")\n"
+		"  --cpu=N      pin the benchmark to cpu N\n"
+		"  --save=FILE  save the results to FILE\n"
+		"  --baseline=FILE\n"
+		"               compare with results saved in FILE\n"
+		"  --threshold=PCT\n"
+		"               report slowdowns over PCT %% (default %.0f)\n\n"
+		"Available benchmarks:\n\n",
+		name, repeat, run_time_ns / 1000000, warmup_ns / 1000000,
+		threshold);
+
+	for (b = &__start_bench_section; b < &__stop_bench_section; b++)
+		fprintf(stderr, "  %s\n", b->name);
+
+	fprintf(stderr, "\n");
+
+	exit(status);
+}
+
+static int
+pin_cpu(const char *arg)
+{
+	cpu_set_t set;
+	char *end;
+	long cpu;
+
+	cpu = strtol(arg, &end, 10);
+	if (*end != '\0' || cpu < 0 || cpu >= CPU_SETSIZE) {
+		fprintf(stderr, "Invalid cpu: %s\n", arg);
+		return -1;
+	}
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof set, &set) < 0) {
+		perror("Pinning to cpu");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+parse_number(const char *arg, unsigned long max, unsigned long *out)
+{
+	char *end;
+
+	errno = 0;
+	*out = strtoul(arg, &end, 10);
+	if (errno || *end != '\0' || *out == 0 || *out > max) {
+		fprintf(stderr, "Invalid number: %s\n", arg);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const struct bench *b;
+	const char *baseline_path = NULL;
+	unsigned long val;
+	int i, first_name = 0;
+
+	for (i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--help") == 0) {
+			usage(argv[0], EXIT_SUCCESS);
+		} else if (strncmp(argv[i], "--repeat=", 9) == 0) {
+			if (parse_number(argv[i] + 9, MAX_REPEAT, &val) < 0)
+				return EXIT_FAILURE;
+			repeat = val;
+		} else if (strncmp(argv[i], "--time=", 7) == 0) {
+			if (parse_number(argv[i] + 7, 60000, &val) < 0)
+				return EXIT_FAILURE;
+			run_time_ns = val * 1000000ULL;
+		} else if (strncmp(argv[i], "--warmup=", 9) == 0) {
+			if (parse_number(argv[i] + 9, 60000, &val) < 0)
+				return EXIT_FAILURE;
+			warmup_ns = val * 1000000ULL;
+		} else if (strncmp(argv[i], "--cpu=", 6) == 0) {
+			if (pin_cpu(argv[i] + 6) < 0)
+				return EXIT_FAILURE;
+		} else if (strncmp(argv[i], "--save=", 7) == 0) {
+			save = fopen(argv[i] + 7, "w");
+			if (!save) {
+				perror("Opening file for results");
+				return EXIT_FAILURE;
+			}
+		} else if (strncmp(argv[i], "--baseline=", 11) == 0) {
+			baseline_path = argv[i] + 11;
+		} else if (strncmp(argv[i], "--threshold=", 12) == 0) {
+			threshold = atof(argv[i] + 12);
+		} else if (strncmp(argv[i], "--", 2) == 0) {
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			usage(argv[0], EXIT_FAILURE);
+		} else {
+			if (!find_bench(argv[i])) {
+				fprintf(stderr, "unknown benchmark: \"%s\"\n",
+					argv[i]);
+				usage(argv[0], EXIT_FAILURE);
+			}
+
+			if (!first_name)
+				first_name = i;
+		}
+	}
+
+	/* benchmarks may print into a null sink, make the cost
+	 * of that independent of where our stdout goes */
+	setvbuf(stdout, NULL, _IOFBF, BUFSIZ);
+
+	if (baseline_path && load_baseline(baseline_path) < 0) {
+		fprintf(stderr, "Failed loading the baseline\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("# name\titerations\tmessages\tns/msg\tmin-ns/msg\tcycles/msg%s\n",
+	       have_baseline ? "\tchange" : "");
+	if (save)
+		fprintf(save, "# name\titerations\tmessages\t"
+			"ns/msg\tmin-ns/msg\tcycles/msg\n");
+
+	if (first_name) {
+		for (i = first_name; i < argc; ++i)
+			if (strncmp(argv[i], "--", 2) != 0)
+				run_bench(find_bench(argv[i]));
+	} else {
+		for (b = &__start_bench_section; b < &__stop_bench_section; b++)
+			run_bench(b);
+	}
+
+	if (save)
+		fclose(save);
+	free(baseline);
+
+	if (regressions > 0)
+		printf("# %d regressions against the baseline\n", regressions);
+
+	return EXIT_SUCCESS;
+}
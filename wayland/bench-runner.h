@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _BENCH_RUNNER_H_
+#define _BENCH_RUNNER_H_
+
+#include <stdint.h>
+
+/* state of one measured run. The runner sets the number of
+ * iterations, the benchmark does its setup, then runs the
+ * measured loop between bench_start() and bench_stop() */
+struct bench_run {
+	uint64_t iterations;
+	/* number of messages processed in the measured loop */
+	uint64_t messages;
+
+	uint64_t start_ns;
+	uint64_t ns;
+	uint64_t start_cycles;
+	uint64_t cycles;
+};
+
+struct bench {
+	const char *name;
+	void (*run)(struct bench_run *run);
+} __attribute__ ((aligned (16)));
+
+#define BENCH(name)						\
+	static void name(struct bench_run *run);		\
+								\
+	const struct bench bench##name				\
+		 __attribute__ ((section ("bench_section"))) = {\
+		#name, name					\
+	};							\
+								\
+	static void name(struct bench_run *run)
+
+void
+bench_start(struct bench_run *run);
+
+void
+bench_stop(struct bench_run *run, uint64_t messages);
+
+/* prevent the compiler from optimizing away a computed value */
+#define bench_use(value)					\
+	__asm__ __volatile__ ("" : : "g" (value) : "memory")
+
+#endif /* _BENCH_RUNNER_H_ */
@@ -183,6 +183,7 @@ close_fds(struct wl_buffer *buffer, int max)
 	count = size / sizeof fds[0];
 	if (max > 0 && max < count)
 		count = max;
+	size = count * sizeof fds[0];
 	for (i = 0; i < count; i++)
 		close(fds[i]);
 	buffer->tail += size;
@@ -413,7 +414,7 @@ int
 wl_connection_copy_fds(struct wl_connection *conn1, struct wl_connection *conn2)
 {
 	uint32_t size = wl_buffer_size(&conn1->fds_in);
-	void *data = conn1->fds_in.data;
+	int32_t fds[sizeof(conn1->fds_in.data) / sizeof(int32_t)];
 	int ret;
 
 	if (size == 0)
@@ -428,8 +429,8 @@ wl_connection_copy_fds(struct wl_connection *conn1, struct wl_connection *conn2)
 
 
 	/* copy fds from conn1 to conn2 */
-	ret = wl_buffer_put(&conn2->fds_out,
-			    ((char *) data) + conn1->fds_in.tail, size);
+	wl_buffer_copy(&conn1->fds_in, fds, size);
+	ret = wl_buffer_put(&conn2->fds_out, fds, size);
 
 	/* remove copied fds from conn1 */
 	conn1->fds_in.tail += size;